@@ -18,6 +18,7 @@ struct BroadwayOutput {
   GString *buf;
   int error;
   guint32 serial;
+  guint64 bytes_sent;
 };
 
 static void
@@ -51,6 +52,8 @@ broadway_output_send_cmd (BroadwayOutput *output,
   // FIXME: we should really emit these as a single write
   g_output_stream_write_all (output->out, header, p, NULL, NULL, NULL);
   g_output_stream_write_all (output->out, buf, count, NULL, NULL, NULL);
+
+  output->bytes_sent += p + count;
 }
 
 void broadway_output_pong (BroadwayOutput *output)
@@ -100,6 +103,13 @@ broadway_output_get_next_serial (BroadwayOutput *output)
   return output->serial;
 }
 
+/* Everything written so far, including what is not flushed yet */
+guint64
+broadway_output_get_bytes_queued (BroadwayOutput *output)
+{
+  return output->bytes_sent + output->buf->len;
+}
+
 void
 broadway_output_set_next_serial (BroadwayOutput *output,
                                  guint32 serial)
@@ -332,49 +342,133 @@ append_type (BroadwayOutput *output, guint32 type, BroadwayNode *node)
  * against the old tree.  This allows us to avoid sending certain
  * parts.
  *
- * Reusing existing dom nodes are problematic because doing so
- * automatically inherits all their children.  There are two cases
- * where we do this:
+ * Both sides number the nodes of each tree in pre-order, and the
+ * client keeps the dom node for each number of the old tree around
+ * until the new tree is complete. Reusing existing dom nodes is
+ * problematic because doing so automatically inherits all their
+ * children, so every old node is used at most once, and never
+ * together with one of its ancestors or descendants.
  *
- * If the entire sub tree is identical we emit a KEEP_ALL node which
- * just reuses the entire old dom subtree.
+ * If a subtree at the same position is identical we emit a KEEP_ALL
+ * node which just reuses the entire old dom subtree.
  *
  * If a the node is unchanged (but some descendant may have changed),
  * and all parents are also unchanged, then we can just avoid
  * changing the dom node at all, and we emit a KEEP_THIS node.
  *
+ * Otherwise, if an identical subtree exists anywhere in the old tree
+ * (e.g. because siblings were inserted, removed or reordered), we emit
+ * a REUSE node with its number, which moves the old dom subtree here.
+ *
  ***********************************/
+
+static void
+add_old_nodes (GHashTable   *old_nodes,
+               BroadwayNode *node)
+{
+  GSList *same_hash;
+  guint32 i;
+
+  same_hash = g_hash_table_lookup (old_nodes, GUINT_TO_POINTER (node->hash));
+  g_hash_table_replace (old_nodes, GUINT_TO_POINTER (node->hash),
+                        g_slist_prepend (same_hash, node));
+
+  for (i = 0; i < node->n_children; i++)
+    add_old_nodes (old_nodes, node->children[i]);
+}
+
+static gboolean
+subtree_is_unused (BroadwayNode *node)
+{
+  guint32 i;
+
+  if (node->reused)
+    return FALSE;
+
+  for (i = 0; i < node->n_children; i++)
+    if (!subtree_is_unused (node->children[i]))
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+mark_subtree_reused (BroadwayNode *node)
+{
+  guint32 i;
+
+  node->reused = TRUE;
+  for (i = 0; i < node->n_children; i++)
+    mark_subtree_reused (node->children[i]);
+}
+
+static BroadwayNode *
+find_reusable_node (GHashTable   *old_nodes,
+                    BroadwayNode *node)
+{
+  GSList *l;
+
+  if (old_nodes == NULL)
+    return NULL;
+
+  for (l = g_hash_table_lookup (old_nodes, GUINT_TO_POINTER (node->hash)); l != NULL; l = l->next)
+    {
+      BroadwayNode *old_node = l->data;
+
+      if (broadway_node_deep_equal (node, old_node) &&
+          subtree_is_unused (old_node))
+        return old_node;
+    }
+
+  return NULL;
+}
+
 static void
 append_node (BroadwayOutput *output,
              BroadwayNode   *node,
              BroadwayNode   *old_node,
+             GHashTable     *old_nodes,
              gboolean        all_parents_are_kept)
 {
+  BroadwayNode *reusable;
   guint32 i;
 
   append_node_depth++;
 
-  if (old_node != NULL && broadway_node_equal (node, old_node))
+  if (old_node != NULL && !old_node->reused && broadway_node_equal (node, old_node))
     {
-      if (broadway_node_deep_equal (node, old_node))
+      if (broadway_node_deep_equal (node, old_node) &&
+          subtree_is_unused (old_node))
         {
           append_type (output, BROADWAY_NODE_KEEP_ALL, node);
+          mark_subtree_reused (old_node);
           goto out;
         }
 
       if (all_parents_are_kept)
         {
           append_type (output, BROADWAY_NODE_KEEP_THIS, node);
+          old_node->reused = TRUE;
           append_uint32 (output, node->n_children);
           for (i = 0; i < node->n_children; i++)
             append_node (output, node->children[i],
                          i < old_node->n_children ? old_node->children[i] : NULL,
+                         old_nodes,
                          TRUE);
 
           goto out;
         }
     }
 
+  reusable = find_reusable_node (old_nodes, node);
+  if (reusable != NULL)
+    {
+      append_type (output, BROADWAY_NODE_REUSE, node);
+      append_uint32 (output, reusable->id);
+      mark_subtree_reused (reusable);
+      goto out;
+    }
+
   append_type (output, node->type, node);
   for (i = 0; i < node->n_data; i++)
     append_uint32 (output, node->data[i]);
@@ -382,6 +476,7 @@ append_node (BroadwayOutput *output,
     append_node (output,
                  node->children[i],
                  (old_node != NULL && i < old_node->n_children) ? old_node->children[i] : NULL,
+                 old_nodes,
                  FALSE);
 
  out:
@@ -394,6 +489,7 @@ broadway_output_surface_set_nodes (BroadwayOutput *output,
                                    BroadwayNode   *root,
                                    BroadwayNode   *old_root)
 {
+  GHashTable *old_nodes = NULL;
   gsize size_pos, start, end;
 
   /* Early return if nothing changed */
@@ -408,13 +504,22 @@ broadway_output_surface_set_nodes (BroadwayOutput *output,
   size_pos = output->buf->len;
   append_uint32 (output, 0);
 
+  if (old_root != NULL)
+    {
+      old_nodes = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_slist_free);
+      add_old_nodes (old_nodes, old_root);
+    }
+
   start = output->buf->len;
 #ifdef DEBUG_NODE_SENDING
   g_print ("====== node tree for %d =======\n", id);
 #endif
-  append_node (output, root, old_root, TRUE);
+  append_node (output, root, old_root, old_nodes, TRUE);
   end = output->buf->len;
   patch_uint32 (output, (end - start) / 4, size_pos);
+
+  if (old_nodes)
+    g_hash_table_unref (old_nodes);
 }
 
 void
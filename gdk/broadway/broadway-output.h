@@ -25,6 +25,7 @@ int             broadway_output_has_error           (BroadwayOutput *output);
 void            broadway_output_set_next_serial     (BroadwayOutput *output,
                                                      guint32         serial);
 guint32         broadway_output_get_next_serial     (BroadwayOutput *output);
+guint64         broadway_output_get_bytes_queued    (BroadwayOutput *output);
 void            broadway_output_new_surface         (BroadwayOutput *output,
                                                      int             id,
                                                      int             x,
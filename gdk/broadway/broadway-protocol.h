@@ -22,6 +22,12 @@ typedef enum { /* Sync changes with broadway.js */
   BROADWAY_NODE_CLIP = 10,
   BROADWAY_NODE_KEEP_ALL = 11,
   BROADWAY_NODE_KEEP_THIS = 12,
+  BROADWAY_NODE_TEXT = 13,
+  BROADWAY_NODE_TRANSFORM = 14,
+  BROADWAY_NODE_COLOR_MATRIX = 15,
+  BROADWAY_NODE_CROSS_FADE = 16,
+  BROADWAY_NODE_BLEND = 17,
+  BROADWAY_NODE_REUSE = 18,
 } BroadwayNodeType;
 
 static const char *broadway_node_type_names[] G_GNUC_UNUSED =  {
@@ -38,6 +44,12 @@ static const char *broadway_node_type_names[] G_GNUC_UNUSED =  {
   "CLIP",
   "KEEP_ALL",
   "KEEP_THIS",
+  "TEXT",
+  "TRANSFORM",
+  "COLOR_MATRIX",
+  "CROSS_FADE",
+  "BLEND",
+  "REUSE",
 };
 
 typedef enum {
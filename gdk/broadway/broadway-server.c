@@ -39,8 +39,19 @@
 typedef struct {
   int id;
   guint32 tag;
+  gint64 send_time;
+  guint64 bytes; /* output queued up to and including the roundtrip */
 } BroadwayOutstandingRoundtrip;
 
+/* Node trees are held back while more than the link can deliver in
+ * its round trip time plus LINK_TARGET_DELAY is in flight. A held back
+ * tree is replaced by any newer one for the same surface, so slow
+ * links skip frames instead of building up latency. Below
+ * LINK_MIN_IN_FLIGHT bytes nothing is ever held back.
+ */
+#define LINK_TARGET_DELAY (50 * G_TIME_SPAN_MILLISECOND)
+#define LINK_MIN_IN_FLIGHT (256 * 1024)
+
 typedef struct BroadwayInput BroadwayInput;
 typedef struct BroadwaySurface BroadwaySurface;
 struct _BroadwayServer {
@@ -67,6 +78,7 @@ struct _BroadwayServer {
 
   guint32 next_texture_id;
   GHashTable *textures;
+  GArray *held_textures; /* released while a held back tree may use them */
 
   guint32 screen_width;
   guint32 screen_height;
@@ -89,6 +101,13 @@ struct _BroadwayServer {
   int future_mouse_in_surface;
 
   GList *outstanding_roundtrips;
+
+  /* Link estimates for the current client, from the roundtrips */
+  gint64 rtt; /* smoothed, in microseconds */
+  double bandwidth; /* bytes per second */
+  guint64 bytes_acked;
+  guint32 frames_sent;
+  guint32 frames_skipped;
 };
 
 struct _BroadwayServerClass
@@ -126,10 +145,14 @@ struct BroadwaySurface {
   gint32 transient_for;
   guint32 texture;
   BroadwayNode *nodes;
+  /* If nodes_pending, the tree the client has, or NULL */
+  BroadwayNode *sent_nodes;
+  gboolean nodes_pending;
 };
 
 static void broadway_server_resync_surfaces (BroadwayServer *server);
 static void send_outstanding_roundtrips (BroadwayServer *server);
+static void broadway_server_send_pending_nodes (BroadwayServer *server);
 
 static GType broadway_server_get_type (void);
 
@@ -205,6 +228,7 @@ broadway_server_init (BroadwayServer *server)
   server->id_counter = 0;
   server->textures = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
                                             (GDestroyNotify)g_bytes_unref);
+  server->held_textures = g_array_new (FALSE, FALSE, sizeof (guint32));
 
   root = g_new0 (BroadwaySurface, 1);
   root->id = server->id_counter++;
@@ -228,6 +252,7 @@ broadway_server_finalize (GObject *object)
   g_free (server->ssl_cert);
   g_free (server->ssl_key);
   g_hash_table_destroy (server->textures);
+  g_array_unref (server->held_textures);
 
   G_OBJECT_CLASS (broadway_server_parent_class)->finalize (object);
 }
@@ -245,6 +270,8 @@ broadway_surface_free (BroadwaySurface *surface)
 {
   if (surface->nodes)
     broadway_node_free (surface->nodes);
+  if (surface->sent_nodes)
+    broadway_node_free (surface->sent_nodes);
   g_free (surface);
 }
 
@@ -508,6 +535,51 @@ queue_input_message (BroadwayServer *server, BroadwayInputMsg *msg)
   server->input_messages = g_list_append (server->input_messages, g_memdup (msg, sizeof (BroadwayInputMsg)));
 }
 
+/* The client handles messages in order, so when it answers a
+ * roundtrip, everything sent before it has arrived.
+ */
+static void
+update_link_estimates (BroadwayServer              *server,
+                       BroadwayOutstandingRoundtrip *rt)
+{
+  gint64 now = g_get_monotonic_time ();
+  gint64 rtt = MAX (now - rt->send_time, 1);
+  double delivery_rate;
+
+  if (rt->bytes <= server->bytes_acked)
+    return;
+
+  /* The rate at which data got through, but an idle link delivers
+   * less than it could, so we let the estimate decay slowly rather
+   * than follow each sample */
+  delivery_rate = (rt->bytes - server->bytes_acked) * (double) G_USEC_PER_SEC / rtt;
+  server->bandwidth = MAX (delivery_rate, server->bandwidth * 0.9);
+
+  if (server->rtt == 0)
+    server->rtt = rtt;
+  else
+    server->rtt = (7 * server->rtt + rtt) / 8;
+
+  server->bytes_acked = rt->bytes;
+}
+
+static gboolean
+broadway_server_is_congested (BroadwayServer *server)
+{
+  guint64 in_flight;
+  double budget;
+
+  /* Without outstanding roundtrips, nothing tells us when to resume */
+  if (server->output == NULL ||
+      server->outstanding_roundtrips == NULL)
+    return FALSE;
+
+  in_flight = broadway_output_get_bytes_queued (server->output) - server->bytes_acked;
+  budget = server->bandwidth * (server->rtt + LINK_TARGET_DELAY) / G_USEC_PER_SEC;
+
+  return in_flight > MAX (budget, LINK_MIN_IN_FLIGHT);
+}
+
 static void
 parse_input_message (BroadwayInput *input, const unsigned char *message)
 {
@@ -605,8 +677,12 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
         if (rt->id == msg.roundtrip_notify.id &&
             rt->tag == msg.roundtrip_notify.tag)
           {
+            update_link_estimates (server, rt);
             server->outstanding_roundtrips = g_list_delete_link (server->outstanding_roundtrips, l);
             g_free (rt);
+
+            /* Maybe there is room for held back frames now */
+            broadway_server_flush (server);
             break;
           }
       }
@@ -878,6 +954,8 @@ broadway_server_fake_roundtrip_reply (BroadwayServer *server,
 void
 broadway_server_flush (BroadwayServer *server)
 {
+  broadway_server_send_pending_nodes (server);
+
   if (server->output &&
       !broadway_output_flush (server->output))
     {
@@ -901,6 +979,8 @@ broadway_server_roundtrip (BroadwayServer *server,
       server->outstanding_roundtrips = g_list_prepend (server->outstanding_roundtrips, rt);
 
       broadway_output_roundtrip (server->output, id, tag);
+      rt->send_time = g_get_monotonic_time ();
+      rt->bytes = broadway_output_get_bytes_queued (server->output);
     }
   else
     broadway_server_fake_roundtrip_reply (server, id, tag);
@@ -1126,6 +1206,10 @@ start (BroadwayInput *input)
   broadway_output_set_next_serial (server->output, server->saved_serial);
   broadway_output_flush (server->output);
 
+  server->rtt = 0;
+  server->bandwidth = 0;
+  server->bytes_acked = 0;
+
   broadway_server_resync_surfaces (server);
 
   if (server->pointer_grab_surface_id != -1)
@@ -1161,6 +1245,36 @@ send_data (HttpRequest *request,
 #include "clienthtml.h"
 #include "broadwayjs.h"
 
+/* Link statistics for monitoring, as JSON */
+static void
+send_stats (HttpRequest *request)
+{
+  BroadwayServer *server = request->server;
+  char *stats;
+
+  stats = g_strdup_printf ("{\n"
+                           "  \"connected\": %s,\n"
+                           "  \"rtt_ms\": %.1f,\n"
+                           "  \"bandwidth_bytes_per_second\": %.0f,\n"
+                           "  \"bytes_sent\": %" G_GUINT64_FORMAT ",\n"
+                           "  \"bytes_in_flight\": %" G_GUINT64_FORMAT ",\n"
+                           "  \"congested\": %s,\n"
+                           "  \"frames_sent\": %u,\n"
+                           "  \"frames_skipped\": %u\n"
+                           "}\n",
+                           server->output ? "true" : "false",
+                           server->rtt / 1000.0,
+                           server->bandwidth,
+                           server->output ? broadway_output_get_bytes_queued (server->output) : 0,
+                           server->output ? broadway_output_get_bytes_queued (server->output) - server->bytes_acked : 0,
+                           broadway_server_is_congested (server) ? "true" : "false",
+                           server->frames_sent,
+                           server->frames_skipped);
+
+  send_data (request, "application/json", stats, strlen (stats));
+  g_free (stats);
+}
+
 static void
 got_request (HttpRequest *request)
 {
@@ -1201,6 +1315,8 @@ got_request (HttpRequest *request)
     send_data (request, "text/javascript", broadway_js, G_N_ELEMENTS(broadway_js) - 1);
   else if (strcmp (escaped, "/socket") == 0)
     start_input (request);
+  else if (strcmp (escaped, "/stats") == 0)
+    send_stats (request);
   else
     send_error (request, 404, "File not found");
 
@@ -1605,6 +1721,19 @@ broadway_server_has_client (BroadwayServer *server)
   return server->output != NULL;
 }
 
+static void
+broadway_node_number (BroadwayNode *node,
+                      guint32      *next_id)
+{
+  guint32 i;
+
+  node->id = (*next_id)++;
+  node->reused = FALSE;
+
+  for (i = 0; i < node->n_children; i++)
+    broadway_node_number (node->children[i], next_id);
+}
+
 /* passes ownership of nodes */
 void
 broadway_server_surface_set_nodes (BroadwayServer   *server,
@@ -1612,19 +1741,122 @@ broadway_server_surface_set_nodes (BroadwayServer   *server,
                                    BroadwayNode     *root)
 {
   BroadwaySurface *surface;
+  guint32 next_id = 0;
 
   surface = broadway_server_lookup_surface (server, id);
   if (surface == NULL)
     return;
 
+  broadway_node_number (root, &next_id);
+
+  if (server->output != NULL &&
+      broadway_server_is_congested (server))
+    {
+      /* Hold the tree back, keeping the one the client has to diff against */
+      if (surface->nodes_pending)
+        {
+          if (surface->nodes)
+            broadway_node_free (surface->nodes);
+          server->frames_skipped++;
+        }
+      else
+        {
+          surface->sent_nodes = surface->nodes;
+          surface->nodes_pending = TRUE;
+        }
+      surface->nodes = root;
+      return;
+    }
+
   if (server->output != NULL)
-    broadway_output_surface_set_nodes (server->output, surface->id,
-                                       root,
-                                       surface->nodes);
+    {
+      broadway_output_surface_set_nodes (server->output, surface->id,
+                                         root,
+                                         surface->nodes_pending ? surface->sent_nodes : surface->nodes);
+      server->frames_sent++;
+    }
 
   if (surface->nodes)
     broadway_node_free (surface->nodes);
+  if (surface->sent_nodes)
+    broadway_node_free (surface->sent_nodes);
   surface->nodes = root;
+  surface->sent_nodes = NULL;
+  surface->nodes_pending = FALSE;
+
+  broadway_server_release_held_textures (server);
+}
+
+static gboolean
+broadway_server_has_pending_nodes (BroadwayServer *server)
+{
+  GList *l;
+
+  for (l = server->surfaces; l != NULL; l = l->next)
+    {
+      BroadwaySurface *surface = l->data;
+
+      if (surface->nodes_pending)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+broadway_server_do_release_texture (BroadwayServer *server,
+                                    guint32         id)
+{
+  g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
+
+  if (server->output)
+    broadway_output_release_texture (server->output, id);
+}
+
+/* Releases the textures held for trees that have been sent now */
+static void
+broadway_server_release_held_textures (BroadwayServer *server)
+{
+  guint i;
+
+  if (server->held_textures->len == 0 ||
+      broadway_server_has_pending_nodes (server))
+    return;
+
+  for (i = 0; i < server->held_textures->len; i++)
+    broadway_server_do_release_texture (server, g_array_index (server->held_textures, guint32, i));
+
+  g_array_set_size (server->held_textures, 0);
+}
+
+static void
+broadway_server_send_pending_nodes (BroadwayServer *server)
+{
+  GList *l;
+
+  if (server->output == NULL ||
+      broadway_server_is_congested (server))
+    return;
+
+  for (l = server->surfaces; l != NULL; l = l->next)
+    {
+      BroadwaySurface *surface = l->data;
+
+      if (!surface->nodes_pending)
+        continue;
+
+      broadway_output_surface_set_nodes (server->output, surface->id,
+                                         surface->nodes,
+                                         surface->sent_nodes);
+      server->frames_sent++;
+
+      if (surface->sent_nodes)
+        broadway_node_free (surface->sent_nodes);
+      surface->sent_nodes = NULL;
+      surface->nodes_pending = FALSE;
+    }
+
+  broadway_server_release_held_textures (server);
 }
 
 guint32
@@ -1648,10 +1880,15 @@ void
 broadway_server_release_texture (BroadwayServer   *server,
                                  guint32           id)
 {
-  g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
+  /* A tree held back while the client is congested may still use the
+   * texture, so the client must keep it until that tree was sent. */
+  if (server->output && broadway_server_has_pending_nodes (server))
+    {
+      g_array_append_val (server->held_textures, id);
+      return;
+    }
 
-  if (server->output)
-    broadway_output_release_texture (server->output, id);
+  broadway_server_do_release_texture (server, id);
 }
 
 gboolean
@@ -1868,6 +2105,12 @@ broadway_server_resync_surfaces (BroadwayServer *server)
         broadway_output_set_transient_for (server->output, surface->id,
                                            surface->transient_for);
 
+      /* The new client has none of the old trees */
+      if (surface->sent_nodes)
+        broadway_node_free (surface->sent_nodes);
+      surface->sent_nodes = NULL;
+      surface->nodes_pending = FALSE;
+
       if (surface->nodes)
         broadway_output_surface_set_nodes (server->output, surface->id,
                                            surface->nodes, NULL);
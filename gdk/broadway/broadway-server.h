@@ -23,6 +23,8 @@ typedef struct _BroadwayNode BroadwayNode;
 struct _BroadwayNode {
   guint32 type;
   guint32 hash; /* deep hash */
+  guint32 id; /* index in pre-order, matches the client side */
+  gboolean reused; /* DOM node already taken by the new tree */
   guint32 n_children;
   BroadwayNode **children;
   guint32 n_data;
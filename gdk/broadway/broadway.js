@@ -297,12 +297,42 @@ function cmdLowerSurface(id)
     restackSurfaces();
 }
 
-function SwapNodes(node_data, div) {
+/* Nodes are numbered in pre-order, the same way the server does it.
+   For each number we keep the dom node and the size of its subtree,
+   so that the next tree can refer to any old subtree. */
+function SwapNodes(node_data, div, old_nodes, old_sizes) {
     this.node_data = node_data;
     this.node_data_signed = new Int32Array(node_data);
+    this.node_data_float = new Float32Array(node_data.buffer);
     this.data_pos = 0;
     this.div = div;
     this.outstanding = 1;
+    this.old_nodes = old_nodes;
+    this.old_sizes = old_sizes;
+    this.nodes = [];
+    this.sizes = [];
+    this.next_id = 0;
+}
+
+SwapNodes.prototype.oldChildren = function(oldId) {
+    var children = [];
+    if (oldId === undefined || oldId < 0)
+        return children;
+
+    var end = oldId + this.old_sizes[oldId];
+    for (var child = oldId + 1; child < end; child += this.old_sizes[child])
+        children.push(child);
+    return children;
+}
+
+SwapNodes.prototype.reuseSubtree = function(id, oldId) {
+    var size = this.old_sizes[oldId];
+    for (var i = 0; i < size; i++) {
+        this.nodes[id + i] = this.old_nodes[oldId + i];
+        this.sizes[id + i] = this.old_sizes[oldId + i];
+    }
+    this.next_id = id + size;
+    return this.old_nodes[oldId];
 }
 
 SwapNodes.prototype.decode_uint32 = function() {
@@ -331,6 +361,17 @@ SwapNodes.prototype.decode_float = function() {
     return this.decode_int32() / 256.0;
 }
 
+SwapNodes.prototype.decode_float32 = function() {
+    return this.node_data_float[this.data_pos++];
+}
+
+SwapNodes.prototype.decode_matrix = function() {
+    var m = [];
+    for (var i = 0; i < 16; i++)
+        m[i] = this.decode_float32 ();
+    return m;
+}
+
 SwapNodes.prototype.decode_size = function() {
     var s = new Object();
     s.width = this.decode_float ();
@@ -415,17 +456,91 @@ function set_rrect_style (div, rrect) {
     div.style["border-bottom-left-radius"] = args(px(rrect.sizes[3].width), px(rrect.sizes[3].height));
 }
 
-SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
+function set_mask_style (div, url, x, y) {
+    var image = "url(" + url + ")";
+    var position = args(px(-x), px(-y));
+    div.style["-webkit-mask-image"] = image;
+    div.style["-webkit-mask-position"] = position;
+    div.style["-webkit-mask-repeat"] = "no-repeat";
+    div.style["mask-image"] = image;
+    div.style["mask-position"] = position;
+    div.style["mask-repeat"] = "no-repeat";
+}
+
+/* The blend and cross-fade nodes style their second child, which can
+   change or be reused elsewhere independently of the node itself. So
+   this is done by stylesheet rules rather than inline styles. */
+var blendModes = [ "normal", "multiply", "screen", "overlay", "darken",
+                   "lighten", "color-dodge", "color-burn", "hard-light",
+                   "soft-light", "difference", "exclusion", "color",
+                   "hue", "saturation", "luminosity" ];
+var blendStyle = null;
+
+function ensureBlendStyle() {
+    if (blendStyle)
+        return;
+
+    var rules = ".cross-fade > :nth-child(2) { mix-blend-mode: plus-lighter; }\n";
+    for (var i = 0; i < blendModes.length; i++)
+        rules = rules + ".blend-" + blendModes[i] + " > :nth-child(2) { mix-blend-mode: " + blendModes[i] + "; }\n";
+
+    blendStyle = document.createElement('style');
+    blendStyle.textContent = rules;
+    document.head.appendChild(blendStyle);
+}
+
+/* Color matrices are svg filters, shared between all nodes using the
+   same matrix */
+var colorMatrixFilters = {};
+var colorMatrixDefs = null;
+var nextColorMatrixFilter = 0;
+
+function getColorMatrixFilter(matrix, offset) {
+    var values = [];
+    for (var row = 0; row < 4; row++) {
+        for (var col = 0; col < 4; col++)
+            values.push(matrix[col * 4 + row]);
+        values.push(offset[row]);
+    }
+    values = values.join(" ");
+
+    var id = colorMatrixFilters[values];
+    if (id)
+        return id;
+
+    var svgns = "http://www.w3.org/2000/svg";
+    if (!colorMatrixDefs) {
+        var svg = document.createElementNS(svgns, "svg");
+        svg.style["position"] = "absolute";
+        svg.style["width"] = px(0);
+        svg.style["height"] = px(0);
+        colorMatrixDefs = document.createElementNS(svgns, "defs");
+        svg.appendChild(colorMatrixDefs);
+        document.body.appendChild(svg);
+    }
+
+    id = "color-matrix-" + nextColorMatrixFilter++;
+    var filter = document.createElementNS(svgns, "filter");
+    filter.setAttribute("id", id);
+    filter.setAttribute("color-interpolation-filters", "sRGB");
+    var fe = document.createElementNS(svgns, "feColorMatrix");
+    fe.setAttribute("type", "matrix");
+    fe.setAttribute("values", values);
+    filter.appendChild(fe);
+    colorMatrixDefs.appendChild(filter);
+
+    colorMatrixFilters[values] = id;
+    return id;
+}
+
+SwapNodes.prototype.insertNode = function(parent, posInParent, oldId)
 {
     var type = this.decode_uint32();
+    var id = this.next_id++;
     var newNode = null;
 
-    // We need to dup this because as we reuse children the original order is lost
-    var oldChildren = [];
-    if (oldNode) {
-        for (var i = 0; i < oldNode.children.length; i++)
-            oldChildren[i] = oldNode.children[i];
-    }
+    // The children in the old tree, by number, as the dom may already have changed
+    var oldChildren = this.oldChildren(oldId);
 
     switch (type)
     {
@@ -446,6 +561,36 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
         }
         break;
 
+    case 13:  // TEXT
+        {
+            var rect = this.decode_rect();
+            var c = this.decode_color ();
+            var len = this.decode_uint32();
+            var div = document.createElement('div');
+            div.style["position"] = "absolute";
+            set_rect_style(div, rect);
+
+            /* Each glyph is a box of the text color, masked by its
+               shape in one of the glyph atlas textures */
+            for (var i = 0; i < len; i++) {
+                var texture_id = this.decode_uint32();
+                var src = this.decode_uint32();
+                var size = this.decode_uint32();
+                var dest = this.decode_point();
+                var glyph = document.createElement('div');
+                glyph.style["position"] = "absolute";
+                glyph.style["left"] = px(dest.x);
+                glyph.style["top"] = px(dest.y);
+                glyph.style["width"] = px(size >>> 16);
+                glyph.style["height"] = px(size & 0xffff);
+                glyph.style["background-color"] = c;
+                set_mask_style(glyph, textures[texture_id], src >>> 16, src & 0xffff);
+                div.appendChild(glyph);
+            }
+            newNode = div;
+        }
+        break;
+
     case 2:  // COLOR
         {
             var rect = this.decode_rect();
@@ -629,6 +774,73 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
         }
         break;
 
+    case 14:  // TRANSFORM
+        {
+            var matrix = this.decode_matrix();
+            var div = document.createElement('div');
+            div.style["position"] = "absolute";
+            div.style["left"] = px(0);
+            div.style["top"] = px(0);
+            div.style["transform-origin"] = args(px(0), px(0));
+            div.style["transform"] = "matrix3d(" + matrix.join(",") + ")";
+
+            this.insertNode(div, -1, oldChildren[0]);
+            newNode = div;
+        }
+        break;
+
+    case 15:  // COLOR_MATRIX
+        {
+            var matrix = this.decode_matrix();
+            var offset = [];
+            for (var i = 0; i < 4; i++)
+                offset[i] = this.decode_float32();
+            var div = document.createElement('div');
+            div.style["position"] = "absolute";
+            div.style["left"] = px(0);
+            div.style["top"] = px(0);
+            div.style["filter"] = "url(#" + getColorMatrixFilter(matrix, offset) + ")";
+
+            this.insertNode(div, -1, oldChildren[0]);
+            newNode = div;
+        }
+        break;
+
+    case 16:  // CROSS_FADE
+        {
+            var progress = this.decode_float();
+            ensureBlendStyle();
+            var div = document.createElement('div');
+            div.style["position"] = "absolute";
+            div.style["left"] = px(0);
+            div.style["top"] = px(0);
+            div.style["isolation"] = "isolate";
+            div.className = "cross-fade";
+
+            /* The children are opacity nodes with progress applied */
+            this.insertNode(div, -1, oldChildren[0]);
+            this.insertNode(div, -1, oldChildren[1]);
+            newNode = div;
+        }
+        break;
+
+    case 17:  // BLEND
+        {
+            var mode = this.decode_uint32();
+            ensureBlendStyle();
+            var div = document.createElement('div');
+            div.style["position"] = "absolute";
+            div.style["left"] = px(0);
+            div.style["top"] = px(0);
+            div.style["isolation"] = "isolate";
+            div.className = "blend-" + blendModes[mode];
+
+            this.insertNode(div, -1, oldChildren[0]);
+            this.insertNode(div, -1, oldChildren[1]);
+            newNode = div;
+        }
+        break;
+
    /* Generic nodes */
 
     case 1: // CONTAINER
@@ -644,25 +856,26 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
 
     case 11:  // KEEP_ALL
         {
-            if (!oldNode)
+            if (oldId === undefined || oldId < 0)
                 alert("KEEP_ALL with no oldNode");
 
-            if (oldNode.parentNode != parent)
-                newNode = oldNode;
-            else
-                newNode = null;
+            newNode = this.reuseSubtree(id, oldId);
+        }
+        break;
+
+    case 18:  // REUSE
+        {
+            var reuseId = this.decode_uint32();
+            newNode = this.reuseSubtree(id, reuseId);
         }
         break;
 
     case 12:  // KEEP_THIS
         {
-            if (!oldNode)
+            if (oldId === undefined || oldId < 0)
                 alert("KEEP_THIS with no oldNode ");
 
-            /* We only get keep-this if all parents were kept, check this */
-            if (oldNode.parentNode != parent)
-                alert("Got KEEP_THIS for non-kept parent");
-
+            var oldNode = this.old_nodes[oldId];
             var len = this.decode_uint32();
             var i;
 
@@ -672,11 +885,11 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
             }
 
             /* Remove children that are after the new length */
-            for (i = oldChildren.length - 1; i > len - 1; i--)
-                oldNode.removeChild(oldChildren[i]);
+            while (oldNode.children.length > len)
+                oldNode.removeChild(oldNode.lastChild);
 
-            /* NOTE: No need to modify the parent, we're keeping this node as is */
-            newNode = null;
+            /* NOTE: The parent only changes if some sibling was moved around */
+            newNode = oldNode;
         }
         break;
 
@@ -684,11 +897,17 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
         alert("Unexpected node type " + type);
     }
 
-    if (newNode) {
-        if (posInParent >= 0 && parent.children[posInParent])
+    this.nodes[id] = newNode;
+    this.sizes[id] = this.next_id - id;
+
+    if (!newNode)
+        return;
+
+    if (posInParent >= 0 && parent.children[posInParent]) {
+        if (parent.children[posInParent] != newNode)
             parent.replaceChild(newNode, parent.children[posInParent]);
-        else
-            parent.appendChild(newNode);
+    } else {
+        parent.appendChild(newNode);
     }
 }
 
@@ -701,10 +920,13 @@ function cmdSurfaceSetNodes(id, node_data)
 
     /* We use a secondary div so that we can remove all previous children in one go */
 
-    var swap = new SwapNodes (node_data, div);
-    swap.insertNode(div, 0, div.firstChild);
+    var swap = new SwapNodes (node_data, div, surface.nodes, surface.node_sizes);
+    swap.insertNode(div, 0, surface.nodes ? 0 : -1);
     if (swap.data_pos != node_data.length)
         alert ("Did not consume entire array (len " + node_data.length + " end " + end + ")");
+
+    surface.nodes = swap.nodes;
+    surface.node_sizes = swap.sizes;
 }
 
 function cmdUploadTexture(id, data)
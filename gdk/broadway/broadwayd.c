@@ -223,6 +223,8 @@ get_client_serial (BroadwayClient *client, guint32 daemon_serial)
 #define NODE_SIZE_RRECT (NODE_SIZE_RECT + 4 * NODE_SIZE_SIZE)
 #define NODE_SIZE_COLOR_STOP (NODE_SIZE_FLOAT + NODE_SIZE_COLOR)
 #define NODE_SIZE_SHADOW (NODE_SIZE_COLOR + 3 * NODE_SIZE_FLOAT)
+#define NODE_SIZE_GLYPH (3 + NODE_SIZE_POINT)
+#define NODE_SIZE_MATRIX (16 * NODE_SIZE_FLOAT)
 
 static guint32
 rotl (guint32 value, int shift)
@@ -238,9 +240,9 @@ decode_nodes (BroadwayClient *client,
 {
   BroadwayNode *node;
   guint32 type;
-  guint32 i, n_stops, n_shadows;
+  guint32 i, n_stops, n_shadows, n_glyphs;
   guint32 size, n_children;
-  gint32 texture_offset;
+  gint32 texture_offset, texture_stride;
   guint32 hash;
 
   g_assert (*pos < len);
@@ -248,6 +250,7 @@ decode_nodes (BroadwayClient *client,
   size = 0;
   n_children = 0;
   texture_offset = -1;
+  texture_stride = 1;
 
   type = data[(*pos)++];
   switch (type) {
@@ -265,6 +268,14 @@ decode_nodes (BroadwayClient *client,
     texture_offset = 4;
     size = 5;
     break;
+  case BROADWAY_NODE_TEXT:
+    size = NODE_SIZE_RECT + NODE_SIZE_COLOR;
+    n_glyphs = data[*pos + size++];
+    /* Each glyph starts with the id of its atlas texture */
+    texture_offset = size;
+    texture_stride = NODE_SIZE_GLYPH;
+    size += n_glyphs * NODE_SIZE_GLYPH;
+    break;
   case BROADWAY_NODE_CONTAINER:
     size = 1;
     n_children = data[*pos];
@@ -292,6 +303,22 @@ decode_nodes (BroadwayClient *client,
     size = NODE_SIZE_FLOAT;
     n_children = 1;
     break;
+  case BROADWAY_NODE_TRANSFORM:
+    size = NODE_SIZE_MATRIX;
+    n_children = 1;
+    break;
+  case BROADWAY_NODE_COLOR_MATRIX:
+    size = NODE_SIZE_MATRIX + 4 * NODE_SIZE_FLOAT;
+    n_children = 1;
+    break;
+  case BROADWAY_NODE_CROSS_FADE:
+    size = NODE_SIZE_FLOAT;
+    n_children = 2;
+    break;
+  case BROADWAY_NODE_BLEND:
+    size = 1;
+    n_children = 2;
+    break;
   default:
     g_assert_not_reached ();
   }
@@ -304,7 +331,8 @@ decode_nodes (BroadwayClient *client,
   for (i = 0; i < size; i++)
     {
       node->data[i] = data[(*pos)++];
-      if (i == texture_offset)
+      if (texture_offset >= 0 && (gint32) i >= texture_offset &&
+          (i - texture_offset) % texture_stride == 0)
         node->data[i] = GPOINTER_TO_INT (g_hash_table_lookup (client->textures,
                                                               GINT_TO_POINTER (node->data[i])));
     }
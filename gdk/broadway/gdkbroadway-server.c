@@ -48,6 +48,11 @@ struct _GdkBroadwayServer {
 
   guint process_input_idle;
   GList *incomming;
+
+  /* Textures handed to the encoder pool, in upload order */
+  GQueue pending_uploads;
+  GMutex upload_mutex;
+  GCond upload_cond;
 };
 
 struct _GdkBroadwayServerClass
@@ -56,6 +61,8 @@ struct _GdkBroadwayServerClass
 };
 
 static gboolean input_available_cb (gpointer stream, gpointer user_data);
+static void gdk_broadway_server_flush_uploads (GdkBroadwayServer *server);
+static void gdk_broadway_server_drop_uploads (GdkBroadwayServer *server);
 
 static GType gdk_broadway_server_get_type (void);
 
@@ -66,11 +73,20 @@ gdk_broadway_server_init (GdkBroadwayServer *server)
 {
   server->next_serial = 1;
   server->next_texture_id = 1;
+  g_queue_init (&server->pending_uploads);
+  g_mutex_init (&server->upload_mutex);
+  g_cond_init (&server->upload_cond);
 }
 
 static void
 gdk_broadway_server_finalize (GObject *object)
 {
+  GdkBroadwayServer *server = GDK_BROADWAY_SERVER (object);
+
+  gdk_broadway_server_drop_uploads (server);
+  g_mutex_clear (&server->upload_mutex);
+  g_cond_clear (&server->upload_cond);
+
   G_OBJECT_CLASS (gdk_broadway_server_parent_class)->finalize (object);
 }
 
@@ -170,6 +186,12 @@ gdk_broadway_server_send_message_with_size (GdkBroadwayServer *server, BroadwayR
   gsize written;
   guchar *buf;
 
+  /* Everything but the uploads themselves may refer to a texture id,
+   * so make sure the pending uploads reach the daemon first.
+   */
+  if (type != BROADWAY_REQUEST_UPLOAD_TEXTURE)
+    gdk_broadway_server_flush_uploads (server);
+
   base->size = size;
   base->type = type;
   base->serial = server->next_serial++;
@@ -612,59 +634,164 @@ open_shared_memory (void)
 }
 
 typedef struct {
+  GdkBroadwayServer *server;
+  cairo_surface_t *surface;
+  guint32 id;
   int fd;
   gsize size;
-} PngData;
+  gboolean done;
+} BroadwayPendingUpload;
 
-static cairo_status_t
-write_png_cb (void         *closure,
-              const guchar *data,
-              unsigned int  length)
+static gboolean
+write_png_cb (const gchar  *data,
+              gsize         length,
+              GError      **error,
+              gpointer      user_data)
 {
-  PngData *png_data = closure;
-  int fd = png_data->fd;
+  BroadwayPendingUpload *upload = user_data;
+  int fd = upload->fd;
 
   while (length)
     {
       gssize ret = write (fd, data, length);
 
       if (ret <= 0)
-        return CAIRO_STATUS_WRITE_ERROR;
+        {
+          g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                               "Failed to write texture data");
+          return FALSE;
+        }
 
-      png_data->size += ret;
+      upload->size += ret;
       length -= ret;
       data += ret;
     }
 
-  return CAIRO_STATUS_SUCCESS;
+  return TRUE;
 }
 
-guint32
-gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
-                                    GdkTexture        *texture)
+/* Texture uploads are encoded on a pool of worker threads, so that
+ * the textures needed by a frame compress in parallel and off the
+ * main thread. They are sent in order once some other request needs
+ * them, see gdk_broadway_server_flush_uploads().
+ *
+ * The browser decodes the data as PNG, but we favour speed over size
+ * here: most textures are small icons and text, and the lowest zlib
+ * level is several times faster than the default one.
+ */
+static void
+encode_texture_thread (gpointer data,
+                       gpointer user_data)
 {
-  guint32 id;
-  cairo_surface_t *surface = gdk_texture_download_surface (texture);
-  BroadwayRequestUploadTexture msg;
-  PngData data;
+  BroadwayPendingUpload *upload = data;
+  GdkBroadwayServer *server = upload->server;
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
 
-  id = server->next_texture_id++;
+  pixbuf = gdk_pixbuf_get_from_surface (upload->surface, 0, 0,
+                                        cairo_image_surface_get_width (upload->surface),
+                                        cairo_image_surface_get_height (upload->surface));
 
-  data.fd = open_shared_memory ();
-  data.size = 0;
-  cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
+  if (!gdk_pixbuf_save_to_callback (pixbuf, write_png_cb, upload, "png", &error,
+                                    "compression", "1",
+                                    NULL))
+    {
+      g_warning ("Failed to encode texture %u: %s", upload->id, error->message);
+      g_error_free (error);
+    }
 
-  msg.id = id;
-  msg.offset = 0;
-  msg.size = data.size;
+  g_object_unref (pixbuf);
 
-  /* This passes ownership of fd */
-  gdk_broadway_server_send_fd_message (server, msg,
-                                       BROADWAY_REQUEST_UPLOAD_TEXTURE, data.fd);
+  g_mutex_lock (&server->upload_mutex);
+  upload->done = TRUE;
+  g_cond_broadcast (&server->upload_cond);
+  g_mutex_unlock (&server->upload_mutex);
+}
 
-  return id;
+static GThreadPool *
+get_encode_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *p;
+
+      p = g_thread_pool_new (encode_texture_thread, NULL,
+                             g_get_num_processors (), FALSE, NULL);
+      g_once_init_leave (&pool, p);
+    }
+
+  return pool;
+}
+
+static void
+wait_for_upload (GdkBroadwayServer     *server,
+                 BroadwayPendingUpload *upload)
+{
+  g_mutex_lock (&server->upload_mutex);
+  while (!upload->done)
+    g_cond_wait (&server->upload_cond, &server->upload_mutex);
+  g_mutex_unlock (&server->upload_mutex);
 }
 
+static void
+gdk_broadway_server_drop_uploads (GdkBroadwayServer *server)
+{
+  BroadwayPendingUpload *upload;
+
+  while ((upload = g_queue_pop_head (&server->pending_uploads)) != NULL)
+    {
+      wait_for_upload (server, upload);
+
+      if (upload->fd != -1)
+        close (upload->fd);
+      cairo_surface_destroy (upload->surface);
+      g_free (upload);
+    }
+}
+
+static void
+gdk_broadway_server_flush_uploads (GdkBroadwayServer *server)
+{
+  BroadwayPendingUpload *upload;
+
+  while ((upload = g_queue_pop_head (&server->pending_uploads)) != NULL)
+    {
+      BroadwayRequestUploadTexture msg;
+
+      wait_for_upload (server, upload);
+
+      msg.id = upload->id;
+      msg.offset = 0;
+      msg.size = upload->size;
+
+      /* This passes ownership of fd */
+      gdk_broadway_server_send_fd_message (server, msg,
+                                           BROADWAY_REQUEST_UPLOAD_TEXTURE, upload->fd);
+
+      cairo_surface_destroy (upload->surface);
+      g_free (upload);
+    }
+}
+
+guint32
+gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
+                                    GdkTexture        *texture)
+{
+  BroadwayPendingUpload *upload;
+
+  upload = g_new0 (BroadwayPendingUpload, 1);
+  upload->server = server;
+  upload->id = server->next_texture_id++;
+  upload->surface = gdk_texture_download_surface (texture);
+  upload->fd = open_shared_memory ();
+
+  g_queue_push_tail (&server->pending_uploads, upload);
+  g_thread_pool_push (get_encode_pool (), upload, NULL);
+
+  return upload->id;
+}
 
 void
 gdk_broadway_server_release_texture (GdkBroadwayServer *server,
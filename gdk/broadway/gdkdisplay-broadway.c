@@ -70,6 +70,48 @@ compare_surface (cairo_surface_t *a,
   return TRUE;
 }
 
+/* Hashes the full contents of the texture. Textures are immutable,
+ * so this is computed once and kept on the texture, which lets
+ * byte-identical textures share a single upload.
+ */
+static guint
+gdk_texture_hash (GdkTexture *self)
+{
+  cairo_surface_t *surface;
+  unsigned char *data;
+  int stride;
+  guint32 *row;
+  int x, y;
+  guint h;
+
+  h = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (self), "broadway-hash"));
+  if (h != 0)
+    return h;
+
+  surface = gdk_texture_download_surface (self);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  /* FNV-1a over whole pixels */
+  h = 2166136261u ^ self->width ^ (self->height << 16);
+  for (y = 0; y < self->height; y++, data += stride)
+    {
+      row = (guint32 *)data;
+      for (x = 0; x < self->width; x++)
+        h = (h ^ row[x]) * 16777619u;
+    }
+
+  cairo_surface_destroy (surface);
+
+  /* 0 means "not computed yet" */
+  if (h == 0)
+    h = 1;
+
+  g_object_set_data (G_OBJECT (self), "broadway-hash", GUINT_TO_POINTER (h));
+
+  return h;
+}
+
 static gboolean
 gdk_texture_equal (GdkTexture *a,
                    GdkTexture *b)
@@ -85,6 +127,9 @@ gdk_texture_equal (GdkTexture *a,
       a->height != b->height)
     return FALSE;
 
+  if (gdk_texture_hash (a) != gdk_texture_hash (b))
+    return FALSE;
+
   surface_a = gdk_texture_download_surface (a);
   surface_b = gdk_texture_download_surface (b);
 
@@ -96,39 +141,6 @@ gdk_texture_equal (GdkTexture *a,
   return res;
 }
 
-static guint
-gdk_texture_hash (GdkTexture *self)
-{
-  cairo_surface_t *surface;
-  unsigned char *data;
-  int stride;
-  guint32 *row;
-  guint64 sum;
-  int x, y, width, height;
-  guint h;
-
-  surface = gdk_texture_download_surface (self);
-  data = cairo_image_surface_get_data (surface);
-  stride = cairo_image_surface_get_stride (surface);
-
-  width = MIN (self->width, 4);
-  height = MIN (self->height, 4);
-
-  sum = 0;
-  for (y = 0; y < height; y++, data += stride)
-    {
-      row = (guint32 *)data;
-      for (x = 0; x < width; x++)
-        sum += row[x];
-    }
-
-  cairo_surface_destroy (surface);
-
-  h = sum / (width * height);
-
-  return h ^ self->width ^ (self->height << 16);
-}
-
 static void   gdk_broadway_display_dispose            (GObject            *object);
 static void   gdk_broadway_display_finalize           (GObject            *object);
 
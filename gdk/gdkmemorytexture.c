@@ -254,6 +254,335 @@ SWIZZLE_PREMULTIPLY (0,1,2,3, 3,0,1,2)
 SWIZZLE_PREMULTIPLY (3,2,1,0, 0,3,2,1)
 SWIZZLE_PREMULTIPLY (0,1,2,3, 0,3,2,1)
 
+
+/* Vectorized versions of the converters above. They convert as many
+ * pixels as fit into whole vectors and leave the rest of each row to
+ * the scalar code, so the results are identical.
+ */
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* Premultiplies 2 pixels unpacked to 16 bits per channel, keeping
+ * the alpha channel selected by @alpha_mask as it is.
+ */
+static inline __m128i
+premultiply_sse2 (__m128i c,
+                  __m128i a,
+                  __m128i alpha_mask)
+{
+  __m128i t;
+
+  t = _mm_add_epi16 (_mm_mullo_epi16 (c, a), _mm_set1_epi16 (0x80));
+  t = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+
+  return _mm_or_si128 (_mm_andnot_si128 (alpha_mask, t), _mm_and_si128 (alpha_mask, c));
+}
+
+#define SSE2_BROADCAST(v,i) _mm_shufflehi_epi16 (_mm_shufflelo_epi16 ((v), _MM_SHUFFLE (i,i,i,i)), _MM_SHUFFLE (i,i,i,i))
+#define SSE2_SRC_LANE(j, A,R,G,B, A2,R2,G2,B2) ((j) == (A) ? (A2) : (j) == (R) ? (R2) : (j) == (G) ? (G2) : (B2))
+#define SSE2_REORDER(v, A,R,G,B, A2,R2,G2,B2) \
+  _mm_shufflehi_epi16 (_mm_shufflelo_epi16 ((v), _MM_SHUFFLE (SSE2_SRC_LANE (3, A,R,G,B, A2,R2,G2,B2), \
+                                                              SSE2_SRC_LANE (2, A,R,G,B, A2,R2,G2,B2), \
+                                                              SSE2_SRC_LANE (1, A,R,G,B, A2,R2,G2,B2), \
+                                                              SSE2_SRC_LANE (0, A,R,G,B, A2,R2,G2,B2))), \
+                                            _MM_SHUFFLE (SSE2_SRC_LANE (3, A,R,G,B, A2,R2,G2,B2), \
+                                                         SSE2_SRC_LANE (2, A,R,G,B, A2,R2,G2,B2), \
+                                                         SSE2_SRC_LANE (1, A,R,G,B, A2,R2,G2,B2), \
+                                                         SSE2_SRC_LANE (0, A,R,G,B, A2,R2,G2,B2)))
+
+#define SWIZZLE_PREMULTIPLY_SSE2(A,R,G,B, A2,R2,G2,B2) \
+static void \
+convert_swizzle_premultiply_sse2_ ## A ## R ## G ## B ## _ ## A2 ## R2 ## G2 ## B2 \
+                                    (guchar       *dest_data, \
+                                     gsize         dest_stride, \
+                                     const guchar *src_data, \
+                                     gsize         src_stride, \
+                                     gsize         width, \
+                                     gsize         height) \
+{ \
+  const __m128i zero = _mm_setzero_si128 (); \
+  const __m128i alpha_mask = _mm_setr_epi16 (A2 == 0 ? -1 : 0, A2 == 1 ? -1 : 0, \
+                                             A2 == 2 ? -1 : 0, A2 == 3 ? -1 : 0, \
+                                             A2 == 0 ? -1 : 0, A2 == 1 ? -1 : 0, \
+                                             A2 == 2 ? -1 : 0, A2 == 3 ? -1 : 0); \
+  gsize x, y; \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 4 <= width; x += 4) \
+        { \
+          __m128i in = _mm_loadu_si128 ((const __m128i *) (src_data + 4 * x)); \
+          __m128i lo = _mm_unpacklo_epi8 (in, zero); \
+          __m128i hi = _mm_unpackhi_epi8 (in, zero); \
+\
+          lo = premultiply_sse2 (lo, SSE2_BROADCAST (lo, A2), alpha_mask); \
+          hi = premultiply_sse2 (hi, SSE2_BROADCAST (hi, A2), alpha_mask); \
+          lo = SSE2_REORDER (lo, A,R,G,B, A2,R2,G2,B2); \
+          hi = SSE2_REORDER (hi, A,R,G,B, A2,R2,G2,B2); \
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), _mm_packus_epi16 (lo, hi)); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle_premultiply_ ## A ## R ## G ## B ## _ ## A2 ## R2 ## G2 ## B2 \
+            (dest_data + 4 * x, dest_stride, src_data + 4 * x, src_stride, width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_PREMULTIPLY_SSE2 (3,2,1,0, 3,2,1,0)
+SWIZZLE_PREMULTIPLY_SSE2 (0,1,2,3, 3,2,1,0)
+SWIZZLE_PREMULTIPLY_SSE2 (3,2,1,0, 0,1,2,3)
+SWIZZLE_PREMULTIPLY_SSE2 (0,1,2,3, 0,1,2,3)
+SWIZZLE_PREMULTIPLY_SSE2 (3,2,1,0, 3,0,1,2)
+SWIZZLE_PREMULTIPLY_SSE2 (0,1,2,3, 3,0,1,2)
+SWIZZLE_PREMULTIPLY_SSE2 (3,2,1,0, 0,3,2,1)
+SWIZZLE_PREMULTIPLY_SSE2 (0,1,2,3, 0,3,2,1)
+#endif /* __SSE2__ */
+
+/* SSSE3 isn't part of the x86-64 baseline, so these are compiled
+ * for it explicitly and only used if the CPU supports it.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_SSSE3_CONVERT 1
+#include <tmmintrin.h>
+
+#define SWIZZLE_SSSE3(A,R,G,B) \
+__attribute__ ((target ("ssse3"))) static void \
+convert_swizzle_ssse3_ ## A ## R ## G ## B (guchar       *dest_data, \
+                                            gsize         dest_stride, \
+                                            const guchar *src_data, \
+                                            gsize         src_stride, \
+                                            gsize         width, \
+                                            gsize         height) \
+{ \
+  guint8 order[16]; \
+  __m128i shuffle; \
+  gsize x, y; \
+\
+  for (x = 0; x < 4; x++) \
+    { \
+      order[4 * x + A] = 4 * x + 0; \
+      order[4 * x + R] = 4 * x + 1; \
+      order[4 * x + G] = 4 * x + 2; \
+      order[4 * x + B] = 4 * x + 3; \
+    } \
+  shuffle = _mm_loadu_si128 ((const __m128i *) order); \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 4 <= width; x += 4) \
+        { \
+          __m128i in = _mm_loadu_si128 ((const __m128i *) (src_data + 4 * x)); \
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), _mm_shuffle_epi8 (in, shuffle)); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle ## A ## R ## G ## B (dest_data + 4 * x, dest_stride, \
+                                             src_data + 4 * x, src_stride, \
+                                             width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_SSSE3(3,2,1,0)
+
+/* This reads 16 bytes to convert 4 pixels, so we stop early enough
+ * to not read past the end of the row.
+ */
+#define SWIZZLE_OPAQUE_SSSE3(A,R,G,B) \
+__attribute__ ((target ("ssse3"))) static void \
+convert_swizzle_opaque_ssse3_ ## A ## R ## G ## B (guchar       *dest_data, \
+                                                   gsize         dest_stride, \
+                                                   const guchar *src_data, \
+                                                   gsize         src_stride, \
+                                                   gsize         width, \
+                                                   gsize         height) \
+{ \
+  guint8 order[16], opaque[16]; \
+  __m128i shuffle, alpha; \
+  gsize x, y; \
+\
+  for (x = 0; x < 4; x++) \
+    { \
+      order[4 * x + A] = 0x80; \
+      order[4 * x + R] = 3 * x + 0; \
+      order[4 * x + G] = 3 * x + 1; \
+      order[4 * x + B] = 3 * x + 2; \
+      opaque[4 * x + A] = 0xFF; \
+      opaque[4 * x + R] = 0; \
+      opaque[4 * x + G] = 0; \
+      opaque[4 * x + B] = 0; \
+    } \
+  shuffle = _mm_loadu_si128 ((const __m128i *) order); \
+  alpha = _mm_loadu_si128 ((const __m128i *) opaque); \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 6 <= width; x += 4) \
+        { \
+          __m128i in = _mm_loadu_si128 ((const __m128i *) (src_data + 3 * x)); \
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), \
+                            _mm_or_si128 (_mm_shuffle_epi8 (in, shuffle), alpha)); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle_opaque_ ## A ## R ## G ## B (dest_data + 4 * x, dest_stride, \
+                                                     src_data + 3 * x, src_stride, \
+                                                     width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_OPAQUE_SSSE3(3,2,1,0)
+SWIZZLE_OPAQUE_SSSE3(3,0,1,2)
+SWIZZLE_OPAQUE_SSSE3(0,1,2,3)
+SWIZZLE_OPAQUE_SSSE3(0,3,2,1)
+#endif /* __GNUC__ && __x86_64__ */
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+
+static inline uint8x16_t
+premultiply_neon (uint8x16_t c,
+                  uint8x16_t a)
+{
+  uint16x8_t lo, hi;
+
+  lo = vaddq_u16 (vmull_u8 (vget_low_u8 (c), vget_low_u8 (a)), vdupq_n_u16 (0x80));
+  hi = vaddq_u16 (vmull_u8 (vget_high_u8 (c), vget_high_u8 (a)), vdupq_n_u16 (0x80));
+
+  return vcombine_u8 (vshrn_n_u16 (vaddq_u16 (lo, vshrq_n_u16 (lo, 8)), 8),
+                      vshrn_n_u16 (vaddq_u16 (hi, vshrq_n_u16 (hi, 8)), 8));
+}
+
+#define SWIZZLE_NEON(A,R,G,B) \
+static void \
+convert_swizzle_neon_ ## A ## R ## G ## B (guchar       *dest_data, \
+                                           gsize         dest_stride, \
+                                           const guchar *src_data, \
+                                           gsize         src_stride, \
+                                           gsize         width, \
+                                           gsize         height) \
+{ \
+  gsize x, y; \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 16 <= width; x += 16) \
+        { \
+          uint8x16x4_t in = vld4q_u8 (src_data + 4 * x); \
+          uint8x16x4_t out; \
+\
+          out.val[A] = in.val[0]; \
+          out.val[R] = in.val[1]; \
+          out.val[G] = in.val[2]; \
+          out.val[B] = in.val[3]; \
+          vst4q_u8 (dest_data + 4 * x, out); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle ## A ## R ## G ## B (dest_data + 4 * x, dest_stride, \
+                                             src_data + 4 * x, src_stride, \
+                                             width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_NEON(3,2,1,0)
+
+#define SWIZZLE_OPAQUE_NEON(A,R,G,B) \
+static void \
+convert_swizzle_opaque_neon_ ## A ## R ## G ## B (guchar       *dest_data, \
+                                                  gsize         dest_stride, \
+                                                  const guchar *src_data, \
+                                                  gsize         src_stride, \
+                                                  gsize         width, \
+                                                  gsize         height) \
+{ \
+  gsize x, y; \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 16 <= width; x += 16) \
+        { \
+          uint8x16x3_t in = vld3q_u8 (src_data + 3 * x); \
+          uint8x16x4_t out; \
+\
+          out.val[A] = vdupq_n_u8 (0xFF); \
+          out.val[R] = in.val[0]; \
+          out.val[G] = in.val[1]; \
+          out.val[B] = in.val[2]; \
+          vst4q_u8 (dest_data + 4 * x, out); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle_opaque_ ## A ## R ## G ## B (dest_data + 4 * x, dest_stride, \
+                                                     src_data + 3 * x, src_stride, \
+                                                     width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_OPAQUE_NEON(3,2,1,0)
+SWIZZLE_OPAQUE_NEON(3,0,1,2)
+SWIZZLE_OPAQUE_NEON(0,1,2,3)
+SWIZZLE_OPAQUE_NEON(0,3,2,1)
+
+#define SWIZZLE_PREMULTIPLY_NEON(A,R,G,B, A2,R2,G2,B2) \
+static void \
+convert_swizzle_premultiply_neon_ ## A ## R ## G ## B ## _ ## A2 ## R2 ## G2 ## B2 \
+                                    (guchar       *dest_data, \
+                                     gsize         dest_stride, \
+                                     const guchar *src_data, \
+                                     gsize         src_stride, \
+                                     gsize         width, \
+                                     gsize         height) \
+{ \
+  gsize x, y; \
+\
+  for (y = 0; y < height; y++) \
+    { \
+      for (x = 0; x + 16 <= width; x += 16) \
+        { \
+          uint8x16x4_t in = vld4q_u8 (src_data + 4 * x); \
+          uint8x16x4_t out; \
+\
+          out.val[A] = in.val[A2]; \
+          out.val[R] = premultiply_neon (in.val[R2], in.val[A2]); \
+          out.val[G] = premultiply_neon (in.val[G2], in.val[A2]); \
+          out.val[B] = premultiply_neon (in.val[B2], in.val[A2]); \
+          vst4q_u8 (dest_data + 4 * x, out); \
+        } \
+\
+      if (x < width) \
+        convert_swizzle_premultiply_ ## A ## R ## G ## B ## _ ## A2 ## R2 ## G2 ## B2 \
+            (dest_data + 4 * x, dest_stride, src_data + 4 * x, src_stride, width - x, 1); \
+\
+      dest_data += dest_stride; \
+      src_data += src_stride; \
+    } \
+}
+
+SWIZZLE_PREMULTIPLY_NEON (3,2,1,0, 3,2,1,0)
+SWIZZLE_PREMULTIPLY_NEON (0,1,2,3, 3,2,1,0)
+SWIZZLE_PREMULTIPLY_NEON (3,2,1,0, 0,1,2,3)
+SWIZZLE_PREMULTIPLY_NEON (0,1,2,3, 0,1,2,3)
+SWIZZLE_PREMULTIPLY_NEON (3,2,1,0, 3,0,1,2)
+SWIZZLE_PREMULTIPLY_NEON (0,1,2,3, 3,0,1,2)
+SWIZZLE_PREMULTIPLY_NEON (3,2,1,0, 0,3,2,1)
+SWIZZLE_PREMULTIPLY_NEON (0,1,2,3, 0,3,2,1)
+#endif /* __ARM_NEON */
+
 typedef void (* ConversionFunc) (guchar       *dest_data,
                                  gsize         dest_stride,
                                  const guchar *src_data,
@@ -273,6 +602,58 @@ static ConversionFunc converters[GDK_MEMORY_N_FORMATS][2] =
   { convert_swizzle_opaque_3012, convert_swizzle_opaque_0321 }
 };
 
+/* Replaces the scalar converters with the fastest ones this CPU
+ * supports. Setting GDK_MEMORY_CONVERT_IMPL=c in the environment
+ * keeps the scalar ones, for comparing the two.
+ */
+static void
+init_converters (void)
+{
+  if (g_strcmp0 (g_getenv ("GDK_MEMORY_CONVERT_IMPL"), "c") == 0)
+    return;
+
+#ifdef __SSE2__
+  converters[GDK_MEMORY_B8G8R8A8][0] = convert_swizzle_premultiply_sse2_3210_3210;
+  converters[GDK_MEMORY_B8G8R8A8][1] = convert_swizzle_premultiply_sse2_0123_3210;
+  converters[GDK_MEMORY_A8R8G8B8][0] = convert_swizzle_premultiply_sse2_3210_0123;
+  converters[GDK_MEMORY_A8R8G8B8][1] = convert_swizzle_premultiply_sse2_0123_0123;
+  converters[GDK_MEMORY_R8G8B8A8][0] = convert_swizzle_premultiply_sse2_3210_3012;
+  converters[GDK_MEMORY_R8G8B8A8][1] = convert_swizzle_premultiply_sse2_0123_3012;
+  converters[GDK_MEMORY_A8B8G8R8][0] = convert_swizzle_premultiply_sse2_3210_0321;
+  converters[GDK_MEMORY_A8B8G8R8][1] = convert_swizzle_premultiply_sse2_0123_0321;
+#endif
+
+#ifdef HAVE_SSSE3_CONVERT
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("ssse3"))
+    {
+      converters[GDK_MEMORY_B8G8R8A8_PREMULTIPLIED][1] = convert_swizzle_ssse3_3210;
+      converters[GDK_MEMORY_A8R8G8B8_PREMULTIPLIED][0] = convert_swizzle_ssse3_3210;
+      converters[GDK_MEMORY_R8G8B8][0] = convert_swizzle_opaque_ssse3_3210;
+      converters[GDK_MEMORY_R8G8B8][1] = convert_swizzle_opaque_ssse3_0123;
+      converters[GDK_MEMORY_B8G8R8][0] = convert_swizzle_opaque_ssse3_3012;
+      converters[GDK_MEMORY_B8G8R8][1] = convert_swizzle_opaque_ssse3_0321;
+    }
+#endif
+
+#ifdef __ARM_NEON
+  converters[GDK_MEMORY_B8G8R8A8_PREMULTIPLIED][1] = convert_swizzle_neon_3210;
+  converters[GDK_MEMORY_A8R8G8B8_PREMULTIPLIED][0] = convert_swizzle_neon_3210;
+  converters[GDK_MEMORY_B8G8R8A8][0] = convert_swizzle_premultiply_neon_3210_3210;
+  converters[GDK_MEMORY_B8G8R8A8][1] = convert_swizzle_premultiply_neon_0123_3210;
+  converters[GDK_MEMORY_A8R8G8B8][0] = convert_swizzle_premultiply_neon_3210_0123;
+  converters[GDK_MEMORY_A8R8G8B8][1] = convert_swizzle_premultiply_neon_0123_0123;
+  converters[GDK_MEMORY_R8G8B8A8][0] = convert_swizzle_premultiply_neon_3210_3012;
+  converters[GDK_MEMORY_R8G8B8A8][1] = convert_swizzle_premultiply_neon_0123_3012;
+  converters[GDK_MEMORY_A8B8G8R8][0] = convert_swizzle_premultiply_neon_3210_0321;
+  converters[GDK_MEMORY_A8B8G8R8][1] = convert_swizzle_premultiply_neon_0123_0321;
+  converters[GDK_MEMORY_R8G8B8][0] = convert_swizzle_opaque_neon_3210;
+  converters[GDK_MEMORY_R8G8B8][1] = convert_swizzle_opaque_neon_0123;
+  converters[GDK_MEMORY_B8G8R8][0] = convert_swizzle_opaque_neon_3012;
+  converters[GDK_MEMORY_B8G8R8][1] = convert_swizzle_opaque_neon_0321;
+#endif
+}
+
 void
 gdk_memory_convert (guchar          *dest_data,
                     gsize            dest_stride,
@@ -283,8 +664,16 @@ gdk_memory_convert (guchar          *dest_data,
                     gsize            width,
                     gsize            height)
 {
+  static gsize initialized = 0;
+
   g_assert (dest_format < 2);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
 
+  if (g_once_init_enter (&initialized))
+    {
+      init_converters ();
+      g_once_init_leave (&initialized, 1);
+    }
+
   converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
 }
@@ -35,6 +35,8 @@ GdkMemoryFormat         gdk_memory_texture_get_format       (GdkMemoryTexture  *
 const guchar *          gdk_memory_texture_get_data         (GdkMemoryTexture  *self);
 gsize                   gdk_memory_texture_get_stride       (GdkMemoryTexture  *self);
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
 void                    gdk_memory_convert                  (guchar            *dest_data,
                                                              gsize              dest_stride,
                                                              GdkMemoryFormat    dest_format,
@@ -414,6 +414,132 @@ gdk_texture_new_from_file (GFile   *file,
   return texture;
 }
 
+/* Converts the pixbuf to GDK_MEMORY_DEFAULT up front, so that the
+ * texture can later be downloaded and uploaded with a plain memcpy().
+ * This is meant to run in a worker thread.
+ */
+static GdkTexture *
+gdk_texture_new_for_pixbuf_converted (GdkPixbuf *pixbuf)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data;
+  int width, height;
+  gsize stride;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  stride = width * 4;
+
+  data = g_malloc (stride * height);
+  gdk_memory_convert (data, stride,
+                      GDK_MEMORY_DEFAULT,
+                      gdk_pixbuf_get_pixels (pixbuf),
+                      gdk_pixbuf_get_rowstride (pixbuf),
+                      gdk_pixbuf_get_has_alpha (pixbuf)
+                      ? GDK_MEMORY_GDK_PIXBUF_ALPHA
+                      : GDK_MEMORY_GDK_PIXBUF_OPAQUE,
+                      width, height);
+  bytes = g_bytes_new_take (data, stride * height);
+
+  texture = gdk_memory_texture_new (width, height,
+                                    GDK_MEMORY_DEFAULT,
+                                    bytes,
+                                    stride);
+
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static void
+gdk_texture_new_from_file_thread (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  GFile *file = task_data;
+  GInputStream *stream;
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+
+  stream = G_INPUT_STREAM (g_file_read (file, cancellable, &error));
+  if (stream == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  pixbuf = gdk_pixbuf_new_from_stream (stream, cancellable, &error);
+  g_object_unref (stream);
+  if (pixbuf == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_return_pointer (task,
+                         gdk_texture_new_for_pixbuf_converted (pixbuf),
+                         g_object_unref);
+  g_object_unref (pixbuf);
+}
+
+/**
+ * gdk_texture_new_from_file_async:
+ * @file: #GFile to load
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore.
+ * @callback: (scope async): callback to call when the texture is loaded
+ * @user_data: (closure): the data to pass to callback function
+ *
+ * Asynchronously creates a new texture by loading an image from a file.
+ * The file format is detected automatically.
+ *
+ * Reading and decoding the file happens in a separate thread, so this
+ * is suitable for loading large or many images without blocking the
+ * main loop. When the operation is finished @callback will be called.
+ * You can then call gdk_texture_new_from_file_finish() to get the
+ * result.
+ */
+void
+gdk_texture_new_from_file_async (GFile               *file,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gdk_texture_new_from_file_async);
+  g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+  g_task_run_in_thread (task, gdk_texture_new_from_file_thread);
+  g_object_unref (task);
+}
+
+/**
+ * gdk_texture_new_from_file_finish:
+ * @result: a #GAsyncResult
+ * @error: a #GError location to store the error occurring, or %NULL to
+ *     ignore.
+ *
+ * Finishes an asynchronous texture load started with
+ * gdk_texture_new_from_file_async().
+ *
+ * Returns: (transfer full) (nullable): a new #GdkTexture or %NULL on error.
+ */
+GdkTexture *
+gdk_texture_new_from_file_finish (GAsyncResult  *result,
+                                  GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gdk_texture_new_from_file_async, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * gdk_texture_get_width:
  * @texture: a #GdkTexture
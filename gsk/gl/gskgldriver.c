@@ -53,6 +53,16 @@ struct _GskGLDriver
 
 G_DEFINE_TYPE (GskGLDriver, gsk_gl_driver, G_TYPE_OBJECT)
 
+static void gsk_gl_driver_set_texture_parameters (GskGLDriver *driver,
+                                                  int          min_filter,
+                                                  int          mag_filter);
+
+static inline gboolean
+filter_uses_mipmaps (int filter)
+{
+  return filter != GL_NEAREST && filter != GL_LINEAR;
+}
+
 static Texture *
 texture_new (void)
 {
@@ -395,8 +405,22 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *driver,
 
       if (t)
         {
-          if (t->min_filter == min_filter && t->mag_filter == mag_filter)
-            return t->texture_id;
+          if (t->mag_filter == mag_filter)
+            {
+              /* A mipmapped texture works for any min filter, it's only
+               * sampled from the smaller levels when drawn smaller. And
+               * if we need mipmaps, we can add them to what we have. */
+              if (!filter_uses_mipmaps (t->min_filter) && filter_uses_mipmaps (min_filter))
+                {
+                  gsk_gl_driver_bind_source_texture (driver, t->texture_id);
+                  gsk_gl_driver_set_texture_parameters (driver, min_filter, mag_filter);
+                  glGenerateMipmap (GL_TEXTURE_2D);
+                  t->min_filter = min_filter;
+                }
+
+              if (t->min_filter == min_filter || filter_uses_mipmaps (t->min_filter))
+                return t->texture_id;
+            }
         }
 
       surface = gdk_texture_download_surface (texture);
@@ -651,6 +675,6 @@ gsk_gl_driver_init_texture_with_surface (GskGLDriver     *self,
   t->min_filter = min_filter;
   t->mag_filter = mag_filter;
 
-  if (t->min_filter != GL_NEAREST)
+  if (filter_uses_mipmaps (t->min_filter))
     glGenerateMipmap (GL_TEXTURE_2D);
 }
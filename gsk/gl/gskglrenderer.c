@@ -19,7 +19,6 @@
 #include "gdk/gdkgltextureprivate.h"
 
 #include <epoxy/gl.h>
-#include <cairo-ft.h>
 
 #define SHADER_VERSION_GLES             100
 #define SHADER_VERSION_GL2_LEGACY       110
@@ -68,30 +67,29 @@ dump_framebuffer (const char *filename, int w, int h)
   g_free (data);
 }
 
-static gboolean
-font_has_color_glyphs (const PangoFont *font)
-{
-  cairo_scaled_font_t *scaled_font;
-  gboolean has_color = FALSE;
-
-  scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)font);
-  if (cairo_scaled_font_get_type (scaled_font) == CAIRO_FONT_TYPE_FT)
-    {
-      FT_Face ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
-      has_color = (FT_HAS_COLOR (ft_face) != 0);
-      cairo_ft_scaled_font_unlock_face (scaled_font);
-    }
-
-  return has_color;
-}
-
+/* @bounds is the area @node covers, in device pixels. Textures that
+ * are drawn at less than half their size use mipmaps, so they don't
+ * alias and the GPU doesn't need to read the whole texture.
+ */
 static void
-get_gl_scaling_filters (GskRenderNode *node,
-                        int           *min_filter_r,
-                        int           *mag_filter_r)
+get_gl_scaling_filters (GskGLRenderer         *self,
+                        GskRenderNode         *node,
+                        const graphene_rect_t *bounds,
+                        int                   *min_filter_r,
+                        int                   *mag_filter_r)
 {
   *min_filter_r = GL_LINEAR;
   *mag_filter_r = GL_LINEAR;
+
+  if (gsk_render_node_get_node_type (node) == GSK_TEXTURE_NODE &&
+      self->has_npot_mipmaps)
+    {
+      GdkTexture *texture = gsk_texture_node_get_texture (node);
+
+      if (bounds->size.width < gdk_texture_get_width (texture) / 2.0f ||
+          bounds->size.height < gdk_texture_get_height (texture) / 2.0f)
+        *min_filter_r = GL_LINEAR_MIPMAP_LINEAR;
+    }
 }
 
 static inline void
@@ -196,6 +194,8 @@ struct _GskGLRenderer
   GskGLDriver *gl_driver;
   GskGLProfiler *gl_profiler;
 
+  guint has_npot_mipmaps : 1;
+
   union {
     Program programs[GL_N_PROGRAMS];
     struct {
@@ -329,7 +329,7 @@ render_text_node (GskGLRenderer   *self,
   int y = gsk_text_node_get_y (node) + builder->dy;
 
   /* If the font has color glyphs, we don't need to recolor anything */
-  if (!force_color && font_has_color_glyphs (font))
+  if (!force_color && gsk_text_node_has_color_glyphs (node))
     {
       ops_set_program (builder, &self->blit_program);
     }
@@ -570,7 +570,7 @@ render_texture_node (GskGLRenderer   *self,
   graphene_rect_offset (&node_bounds, builder->dx, builder->dy);
   graphene_matrix_transform_bounds (&builder->current_modelview, &node_bounds, &node_bounds);
 
-  get_gl_scaling_filters (node, &gl_min_filter, &gl_mag_filter);
+  get_gl_scaling_filters (self, node, &node_bounds, &gl_min_filter, &gl_mag_filter);
 
   texture_id = gsk_gl_driver_get_texture_for_texture (self->gl_driver,
                                                       texture,
@@ -639,8 +639,7 @@ render_cairo_node (GskGLRenderer       *self,
   if (surface == NULL)
     return;
 
-  get_gl_scaling_filters (node, &gl_min_filter, &gl_mag_filter);
-
+  get_gl_scaling_filters (self, node, &node->bounds, &gl_min_filter, &gl_mag_filter);
 
   cairo_surface_get_device_scale ((cairo_surface_t *)surface, &scale_x, &scale_y);
   texture_id = gsk_gl_driver_create_texture (self->gl_driver,
@@ -1909,6 +1908,17 @@ gsk_gl_renderer_realize (GskRenderer  *renderer,
 
   gdk_gl_context_make_current (self->gl_context);
 
+  /* GLES 2 can only mipmap power-of-two textures */
+  if (gdk_gl_context_get_use_es (self->gl_context))
+    {
+      int major;
+
+      gdk_gl_context_get_version (self->gl_context, &major, NULL);
+      self->has_npot_mipmaps = major >= 3 || epoxy_has_gl_extension ("GL_OES_texture_npot");
+    }
+  else
+    self->has_npot_mipmaps = TRUE;
+
   g_assert (self->gl_driver == NULL);
   self->gl_profiler = gsk_gl_profiler_new (self->gl_context);
   self->gl_driver = gsk_gl_driver_new (self->gl_context);
@@ -2241,8 +2251,14 @@ add_offscreen_ops (GskGLRenderer   *self,
     {
       GdkTexture *texture = gsk_texture_node_get_texture (child_node);
       int gl_min_filter = GL_NEAREST, gl_mag_filter = GL_NEAREST;
-
-      get_gl_scaling_filters (child_node, &gl_min_filter, &gl_mag_filter);
+      graphene_rect_t device_bounds;
+
+      graphene_rect_init (&device_bounds,
+                          child_node->bounds.origin.x * self->scale_factor,
+                          child_node->bounds.origin.y * self->scale_factor,
+                          child_node->bounds.size.width * self->scale_factor,
+                          child_node->bounds.size.height * self->scale_factor);
+      get_gl_scaling_filters (self, child_node, &device_bounds, &gl_min_filter, &gl_mag_filter);
 
       *texture_id = gsk_gl_driver_get_texture_for_texture (self->gl_driver,
                                                            texture,
@@ -8,6 +8,7 @@
 #include "gskrendernodeprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+#include <string.h>
 
 struct _GskBroadwayRenderer
 {
@@ -115,6 +116,28 @@ add_float (GArray *nodes, float f)
   g_array_append_val (nodes, u);
 }
 
+/* Unlike add_float() this keeps the full precision, which matters
+ * for matrices */
+static void
+add_float32 (GArray *nodes, float f)
+{
+  guint32 u;
+
+  memcpy (&u, &f, sizeof (guint32));
+  g_array_append_val (nodes, u);
+}
+
+static void
+add_matrix (GArray *nodes, const graphene_matrix_t *matrix)
+{
+  float m[16];
+  int i;
+
+  graphene_matrix_to_float (matrix, m);
+  for (i = 0; i < 16; i++)
+    add_float32 (nodes, m[i]);
+}
+
 static void
 add_point (GArray *nodes, const graphene_point_t *point, float offset_x, float offset_y)
 {
@@ -198,72 +221,6 @@ glyph_info_equal (const PangoGlyphInfo *a,
     a->attr.is_cluster_start == b->attr.is_cluster_start;
  }
 
-static guint
-hash_matrix (const graphene_matrix_t *matrix)
-{
-  float m[16];
-  guint h = 0;
-  int i;
-
-  graphene_matrix_to_float (matrix, m);
-  for (i = 0; i < 16; i++)
-    h ^= (guint) m[i];
-
-  return h;
-}
-
-static gboolean
-matrix_equal (const graphene_matrix_t *a,
-              const graphene_matrix_t *b)
-{
-  float ma[16];
-  float mb[16];
-  int i;
-
-  graphene_matrix_to_float (a, ma);
-  graphene_matrix_to_float (b, mb);
-  for (i = 0; i < 16; i++)
-    {
-      if (ma[i] != mb[i])
-        return FALSE;
-    }
-
-  return TRUE;
-}
-
-static guint
-hash_vec4 (const graphene_vec4_t *vec4)
-{
-  float v[4];
-  guint h = 0;
-  int i;
-
-  graphene_vec4_to_float (vec4, v);
-  for (i = 0; i < 4; i++)
-    h ^= (guint) v[i];
-
-  return h;
-}
-
-static gboolean
-vec4_equal (const graphene_vec4_t *a,
-            const graphene_vec4_t *b)
-{
-  float va[4];
-  float vb[4];
-  int i;
-
-  graphene_vec4_to_float (a, va);
-  graphene_vec4_to_float (b, vb);
-  for (i = 0; i < 4; i++)
-    {
-      if (va[i] != vb[i])
-        return FALSE;
-    }
-
-  return TRUE;
-}
-
 static guint
 node_cache_hash (GskRenderNode *node)
 {
@@ -289,19 +246,6 @@ node_cache_hash (GskRenderNode *node)
       return h;
     }
 
-  if (type == GSK_COLOR_MATRIX_NODE &&
-      gsk_render_node_get_node_type (gsk_color_matrix_node_get_child (node)) == GSK_TEXTURE_NODE)
-    {
-      const graphene_matrix_t *matrix = gsk_color_matrix_node_peek_color_matrix (node);
-      const graphene_vec4_t *offset = gsk_color_matrix_node_peek_color_offset (node);
-      GskRenderNode *child = gsk_color_matrix_node_get_child (node);
-      GdkTexture *texture = gsk_texture_node_get_texture (child);
-
-      h ^= g_direct_hash (texture) ^ hash_matrix (matrix) ^ hash_vec4 (offset);
-
-      return h;
-    }
-
   return 0;
 }
 
@@ -349,31 +293,6 @@ node_cache_equal (GskRenderNode *a,
       return TRUE;
     }
 
-  if (type == GSK_COLOR_MATRIX_NODE &&
-      gsk_render_node_get_node_type (gsk_color_matrix_node_get_child (a)) == GSK_TEXTURE_NODE &&
-      gsk_render_node_get_node_type (gsk_color_matrix_node_get_child (b)) == GSK_TEXTURE_NODE)
-    {
-      const graphene_matrix_t *a_matrix = gsk_color_matrix_node_peek_color_matrix (a);
-      const graphene_vec4_t *a_offset = gsk_color_matrix_node_peek_color_offset (a);
-      GskRenderNode *a_child = gsk_color_matrix_node_get_child (a);
-      GdkTexture *a_texture = gsk_texture_node_get_texture (a_child);
-      const graphene_matrix_t *b_matrix = gsk_color_matrix_node_peek_color_matrix (b);
-      const graphene_vec4_t *b_offset = gsk_color_matrix_node_peek_color_offset (b);
-      GskRenderNode *b_child = gsk_color_matrix_node_get_child (b);
-      GdkTexture *b_texture = gsk_texture_node_get_texture (b_child);
-
-      if (a_texture != b_texture)
-        return FALSE;
-
-      if (!matrix_equal (a_matrix, b_matrix))
-        return FALSE;
-
-      if (!vec4_equal (a_offset, b_offset))
-        return FALSE;
-
-      return TRUE;
-    }
-
   return FALSE;
 }
 
@@ -417,11 +336,9 @@ node_cache_store (GskRenderNode *node,
   GskRenderNodeType type;
 
   type = gsk_render_node_get_node_type (node);
-  if ((type == GSK_TEXT_NODE &&
-       float_is_int32 (gsk_text_node_get_x (node)) &&
-       float_is_int32 (gsk_text_node_get_y (node))) ||
-      (type == GSK_COLOR_MATRIX_NODE &&
-       gsk_render_node_get_node_type (gsk_color_matrix_node_get_child (node)) == GSK_TEXTURE_NODE))
+  if (type == GSK_TEXT_NODE &&
+      float_is_int32 (gsk_text_node_get_x (node)) &&
+      float_is_int32 (gsk_text_node_get_y (node)))
     {
       NodeCacheElement *element = g_new0 (NodeCacheElement, 1);
       element->texture = texture;
@@ -461,6 +378,318 @@ node_texture_fallback (GskRenderNode *node,
   return texture;
 }
 
+/* Glyphs are rendered once per display and sent to the client as
+ * small atlas textures, white on transparent. Text nodes then only
+ * refer to glyphs in these atlases and the client tints them with
+ * the text color, so changing a line of text costs a few bytes per
+ * glyph instead of a new texture.
+ *
+ * The atlas textures are immutable, so new glyphs go into a new
+ * atlas holding just the glyphs a text node was missing. The whole
+ * cache is dropped once it gets too big. Text with glyphs too big
+ * for an atlas is rendered like any other node.
+ */
+
+#define GLYPH_ATLAS_WIDTH 1024
+#define GLYPH_ATLAS_MAX_HEIGHT 1024
+#define GLYPH_CACHE_MAX_GLYPHS 4096
+
+typedef struct {
+  PangoFont *font;
+  PangoGlyph glyph;
+} GlyphCacheKey;
+
+typedef struct {
+  GdkTexture *atlas; /* NULL for glyphs without ink */
+  int x, y;
+  int draw_x, draw_y;
+  int draw_width, draw_height;
+  guint oversized : 1; /* doesn't fit into an atlas */
+} BroadwayCachedGlyph;
+
+static guint
+glyph_cache_hash (gconstpointer v)
+{
+  const GlyphCacheKey *key = v;
+
+  return GPOINTER_TO_UINT (key->font) ^ key->glyph;
+}
+
+static gboolean
+glyph_cache_equal (gconstpointer v1,
+                   gconstpointer v2)
+{
+  const GlyphCacheKey *key1 = v1;
+  const GlyphCacheKey *key2 = v2;
+
+  return key1->font == key2->font &&
+         key1->glyph == key2->glyph;
+}
+
+static void
+glyph_cache_key_free (gpointer v)
+{
+  GlyphCacheKey *key = v;
+
+  g_object_unref (key->font);
+  g_free (key);
+}
+
+static void
+glyph_cache_value_free (gpointer v)
+{
+  BroadwayCachedGlyph *value = v;
+
+  g_clear_object (&value->atlas);
+  g_free (value);
+}
+
+static GHashTable *
+get_glyph_cache (GdkDisplay *display)
+{
+  GHashTable *cache;
+
+  cache = g_object_get_data (G_OBJECT (display), "gsk-broadway-glyph-cache");
+  if (cache == NULL)
+    {
+      cache = g_hash_table_new_full (glyph_cache_hash, glyph_cache_equal,
+                                     glyph_cache_key_free, glyph_cache_value_free);
+      g_object_set_data_full (G_OBJECT (display), "gsk-broadway-glyph-cache",
+                              cache, (GDestroyNotify) g_hash_table_unref);
+    }
+
+  return cache;
+}
+
+/* Renders the glyphs from @start to @end of @missing into a new atlas */
+static void
+glyph_cache_render_atlas (GHashTable *cache,
+                          PangoFont  *font,
+                          GPtrArray  *missing,
+                          guint       start,
+                          guint       end,
+                          int         width,
+                          int         height)
+{
+  cairo_surface_t *surface;
+  GdkTexture *atlas;
+  cairo_t *cr;
+  guint i;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (surface);
+  cairo_set_source_rgba (cr, 1, 1, 1, 1);
+
+  for (i = start; i < end; i++)
+    {
+      GlyphCacheKey *key = g_ptr_array_index (missing, i);
+      BroadwayCachedGlyph *value = g_hash_table_lookup (cache, key);
+      PangoGlyphInfo glyph_info = { 0, };
+      PangoGlyphString glyph_string;
+
+      glyph_info.glyph = key->glyph;
+      glyph_string.num_glyphs = 1;
+      glyph_string.glyphs = &glyph_info;
+
+      if (key->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
+        cairo_move_to (cr, value->x, value->y - value->draw_y);
+      else
+        cairo_move_to (cr, value->x - value->draw_x, value->y - value->draw_y);
+      pango_cairo_show_glyph_string (cr, font, &glyph_string);
+    }
+
+  cairo_destroy (cr);
+
+  atlas = gdk_texture_new_for_surface (surface);
+  cairo_surface_destroy (surface);
+
+  for (i = start; i < end; i++)
+    {
+      BroadwayCachedGlyph *value = g_hash_table_lookup (cache, g_ptr_array_index (missing, i));
+
+      value->atlas = g_object_ref (atlas);
+    }
+
+  g_object_unref (atlas);
+}
+
+/* Makes sure all glyphs of a text node are in the cache, rendering
+ * the missing ones into new atlases.
+ *
+ * Returns: %FALSE if a glyph is too big for an atlas
+ */
+static gboolean
+glyph_cache_ensure_glyphs (GHashTable           *cache,
+                           PangoFont            *font,
+                           const PangoGlyphInfo *glyphs,
+                           guint                 n_glyphs)
+{
+  GPtrArray *missing = NULL;
+  gboolean fits = TRUE;
+  int x, y, row_height, width, height;
+  guint i, start;
+
+  for (i = 0; i < n_glyphs; i++)
+    {
+      GlyphCacheKey lookup = { font, glyphs[i].glyph };
+      GlyphCacheKey *key;
+      BroadwayCachedGlyph *value;
+      PangoRectangle ink_rect;
+
+      if (glyphs[i].glyph == PANGO_GLYPH_EMPTY)
+        continue;
+
+      value = g_hash_table_lookup (cache, &lookup);
+      if (value)
+        {
+          fits &= !value->oversized;
+          continue;
+        }
+
+      pango_font_get_glyph_extents (font, glyphs[i].glyph, &ink_rect, NULL);
+      pango_extents_to_pixels (&ink_rect, NULL);
+
+      key = g_new0 (GlyphCacheKey, 1);
+      key->font = g_object_ref (font);
+      key->glyph = glyphs[i].glyph;
+
+      value = g_new0 (BroadwayCachedGlyph, 1);
+      value->draw_x = ink_rect.x;
+      value->draw_y = ink_rect.y;
+      value->draw_width = ink_rect.width;
+      value->draw_height = ink_rect.height;
+      value->oversized = ink_rect.width + 2 > GLYPH_ATLAS_WIDTH ||
+                         ink_rect.height + 2 > GLYPH_ATLAS_MAX_HEIGHT;
+
+      g_hash_table_insert (cache, key, value);
+
+      if (value->oversized)
+        {
+          fits = FALSE;
+        }
+      else if (ink_rect.width > 0 && ink_rect.height > 0)
+        {
+          if (missing == NULL)
+            missing = g_ptr_array_new ();
+          g_ptr_array_add (missing, key);
+        }
+    }
+
+  if (missing == NULL)
+    return fits;
+
+  /* Pack the new glyphs in rows, with a pixel of padding. Positions are
+   * sent as 16 bit values, so a full atlas is followed by another one. */
+  start = 0;
+  x = y = 1;
+  row_height = 0;
+  width = height = 1;
+  for (i = 0; i < missing->len; i++)
+    {
+      BroadwayCachedGlyph *value = g_hash_table_lookup (cache, g_ptr_array_index (missing, i));
+
+      if (x > 1 && x + value->draw_width + 1 > GLYPH_ATLAS_WIDTH)
+        {
+          y += row_height + 1;
+          x = 1;
+          row_height = 0;
+        }
+
+      if (y + value->draw_height + 1 > GLYPH_ATLAS_MAX_HEIGHT)
+        {
+          glyph_cache_render_atlas (cache, font, missing, start, i, width, height);
+          start = i;
+          x = y = 1;
+          row_height = 0;
+          width = height = 1;
+        }
+
+      value->x = x;
+      value->y = y;
+      x += value->draw_width + 1;
+      row_height = MAX (row_height, value->draw_height);
+      width = MAX (width, x);
+      height = MAX (height, y + row_height + 1);
+    }
+
+  glyph_cache_render_atlas (cache, font, missing, start, missing->len, width, height);
+
+  g_ptr_array_free (missing, TRUE);
+
+  return fits;
+}
+
+static gboolean
+add_text_node (GdkDisplay    *display,
+               GArray        *nodes,
+               GPtrArray     *node_textures,
+               GskRenderNode *node,
+               float          offset_x,
+               float          offset_y)
+{
+  PangoFont *font = (PangoFont *) gsk_text_node_peek_font (node);
+  const PangoGlyphInfo *glyphs = gsk_text_node_peek_glyphs (node);
+  guint n_glyphs = gsk_text_node_get_num_glyphs (node);
+  float x = gsk_text_node_get_x (node) - node->bounds.origin.x;
+  float y = gsk_text_node_get_y (node) - node->bounds.origin.y;
+  GHashTable *cache = get_glyph_cache (display);
+  GdkTexture *last_atlas = NULL;
+  guint n_glyphs_pos;
+  guint i, n_drawn;
+  int x_position = 0;
+
+  if (!glyph_cache_ensure_glyphs (cache, font, glyphs, n_glyphs))
+    return FALSE;
+
+  add_uint32 (nodes, BROADWAY_NODE_TEXT);
+  add_rect (nodes, &node->bounds, offset_x, offset_y);
+  add_rgba (nodes, gsk_text_node_peek_color (node));
+  n_glyphs_pos = nodes->len;
+  add_uint32 (nodes, 0);
+
+  n_drawn = 0;
+  for (i = 0; i < n_glyphs; i++)
+    {
+      const PangoGlyphInfo *gi = &glyphs[i];
+      GlyphCacheKey lookup = { font, gi->glyph };
+      BroadwayCachedGlyph *glyph;
+      float cx, cy;
+
+      if (gi->glyph == PANGO_GLYPH_EMPTY)
+        goto next;
+
+      glyph = g_hash_table_lookup (cache, &lookup);
+
+      /* e.g. whitespace */
+      if (glyph->atlas == NULL)
+        goto next;
+
+      /* The atlas must outlive the frame even if the cache is dropped */
+      if (glyph->atlas != last_atlas)
+        {
+          g_ptr_array_add (node_textures, g_object_ref (glyph->atlas));
+          last_atlas = glyph->atlas;
+        }
+
+      cx = x + (float)(x_position + gi->geometry.x_offset) / PANGO_SCALE + glyph->draw_x;
+      cy = y + (float)(gi->geometry.y_offset) / PANGO_SCALE + glyph->draw_y;
+
+      add_uint32 (nodes, gdk_broadway_display_ensure_texture (display, glyph->atlas));
+      add_uint32 (nodes, (glyph->x << 16) | glyph->y);
+      add_uint32 (nodes, (glyph->draw_width << 16) | glyph->draw_height);
+      add_float (nodes, cx);
+      add_float (nodes, cy);
+      n_drawn++;
+
+next:
+      x_position += gi->geometry.width;
+    }
+
+  g_array_index (nodes, guint32, n_glyphs_pos) = n_drawn;
+
+  return TRUE;
+}
+
 /* Note: This tracks the offset so that we can convert
    the absolute coordinates of the GskRenderNodes to
    parent-relative which is what the dom uses, and
@@ -572,6 +801,17 @@ gsk_broadway_renderer_add_node (GskRenderer *self,
       }
       return;
 
+    case GSK_TEXT_NODE:
+      {
+        /* Color glyphs can't be tinted, so they use the fallback */
+        if (gsk_text_node_has_color_glyphs (node))
+          break;
+
+        if (!add_text_node (display, nodes, node_textures, node, offset_x, offset_y))
+          break;
+      }
+      return;
+
       /* Bin nodes */
 
     case GSK_SHADOW_NODE:
@@ -627,6 +867,72 @@ gsk_broadway_renderer_add_node (GskRenderer *self,
       }
       return;
 
+    case GSK_TRANSFORM_NODE:
+      {
+        graphene_matrix_t transform;
+
+        /* The child is in the transformed coordinate system, so the
+         * matrix also has to undo the parent offset */
+        graphene_matrix_init_from_matrix (&transform, gsk_transform_node_peek_transform (node));
+        graphene_matrix_translate (&transform, &GRAPHENE_POINT3D_INIT (-offset_x, -offset_y, 0));
+
+        add_uint32 (nodes, BROADWAY_NODE_TRANSFORM);
+        add_matrix (nodes, &transform);
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_transform_node_get_child (node),
+                                        0, 0);
+      }
+      return;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        float offset[4];
+        int i;
+
+        add_uint32 (nodes, BROADWAY_NODE_COLOR_MATRIX);
+        add_matrix (nodes, gsk_color_matrix_node_peek_color_matrix (node));
+        graphene_vec4_to_float (gsk_color_matrix_node_peek_color_offset (node), offset);
+        for (i = 0; i < 4; i++)
+          add_float32 (nodes, offset[i]);
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_color_matrix_node_get_child (node),
+                                        offset_x, offset_y);
+      }
+      return;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        float progress = gsk_cross_fade_node_get_progress (node);
+
+        /* The client adds up the two faded children */
+        add_uint32 (nodes, BROADWAY_NODE_CROSS_FADE);
+        add_float (nodes, progress);
+        add_uint32 (nodes, BROADWAY_NODE_OPACITY);
+        add_float (nodes, 1.0 - progress);
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_cross_fade_node_get_start_child (node),
+                                        offset_x, offset_y);
+        add_uint32 (nodes, BROADWAY_NODE_OPACITY);
+        add_float (nodes, progress);
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_cross_fade_node_get_end_child (node),
+                                        offset_x, offset_y);
+      }
+      return;
+
+    case GSK_BLEND_NODE:
+      {
+        add_uint32 (nodes, BROADWAY_NODE_BLEND);
+        add_uint32 (nodes, gsk_blend_node_get_blend_mode (node));
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_blend_node_get_bottom_child (node),
+                                        offset_x, offset_y);
+        gsk_broadway_renderer_add_node (self, nodes, node_textures,
+                                        gsk_blend_node_get_top_child (node),
+                                        offset_x, offset_y);
+      }
+      return;
+
       /* Generic nodes */
 
     case GSK_CONTAINER_NODE:
@@ -642,13 +948,8 @@ gsk_broadway_renderer_add_node (GskRenderer *self,
       }
       return;
 
-    case GSK_COLOR_MATRIX_NODE:
-    case GSK_TEXT_NODE:
     case GSK_REPEATING_LINEAR_GRADIENT_NODE:
-    case GSK_TRANSFORM_NODE:
     case GSK_REPEAT_NODE:
-    case GSK_BLEND_NODE:
-    case GSK_CROSS_FADE_NODE:
     case GSK_BLUR_NODE:
     default:
       break; /* Fallback */
@@ -689,6 +990,13 @@ gsk_broadway_renderer_render (GskRenderer   *self,
   GdkWindow *window = gsk_renderer_get_window (self);
   GArray *nodes = g_array_new (FALSE, FALSE, sizeof(guint32));
   GPtrArray *node_textures = g_ptr_array_new_with_free_func (g_object_unref);
+  GHashTable *glyph_cache = get_glyph_cache (gsk_renderer_get_display (self));
+
+  /* The textures used by the previous frame are still alive, so
+   * dropping the cache here doesn't invalidate anything on screen.
+   */
+  if (g_hash_table_size (glyph_cache) > GLYPH_CACHE_MAX_GLYPHS)
+    g_hash_table_remove_all (glyph_cache);
 
   gsk_broadway_renderer_add_node (self, nodes, node_textures, root, 0, 0);
   gdk_broadway_window_set_nodes (window, nodes, node_textures);
@@ -51,109 +51,605 @@
 #define BOX_FILTER_SIZE_9 16
 #define BOX_FILTER_SIZE_10 18
 
-/* This applies a single box blur pass to a horizontal range of pixels;
+/* Surfaces with fewer pixels than this are blurred on the calling
+ * thread; handing them to the thread pool costs more than it saves.
+ */
+#define PARALLEL_BLUR_MIN_PIXELS (256 * 256)
+
+/* The vectorized kernels divide by multiplying with a float reciprocal.
+ * That is exact as long as the window sum stays below 2^22, see
+ * blur_divide().
+ */
+#define SIMD_BLUR_MAX_D 8192
+
+typedef void (* BlurStripFunc) (const guchar *src,
+                                guchar       *dst,
+                                int           stride,
+                                int           height,
+                                int           d,
+                                int           offset);
+
+typedef struct {
+  const char    *name;
+  int            strip_width;
+  BlurStripFunc  blur_strip;
+} BlurImpl;
+
+/* This applies a single box blur pass to a vertical strip of columns;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
- * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
+ * in pixels coming into the window from below and remove them when
+ * they leave the window at the top.
  *
- * d is the filter width; for even d shift indicates how the blurred
- * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
- * or 'yy ' (shift=-1)
+ * Working on columns instead of rows means neighbouring pixels in
+ * memory are independent of each other, so the vectorized kernels
+ * below can process a whole strip of them at once.
+ *
+ * d is the filter width; offset is where the blurred result is aligned
+ * with the original, see blur_columns().
  */
 static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+blur_strip_scalar (const guchar *src,
+                   guchar       *dst,
+                   int           stride,
+                   int           height,
+                   int           d,
+                   int           offset,
+                   int           strip_width)
 {
-  int offset;
-  int sum = 0;
+  int sums[32];
+  int i, x;
+
+  g_assert (strip_width <= 32);
+
+  memset (sums, 0, sizeof (sums));
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const guchar *in = src + i * stride;
+
+          for (x = 0; x < strip_width; x++)
+            sums[x] += in[x];
+        }
+
+      if (i >= offset)
+        {
+          guchar *out = dst + (i - offset) * stride;
+
+          if (i >= d)
+            {
+              const guchar *in = src + (i - d) * stride;
+
+              for (x = 0; x < strip_width; x++)
+                sums[x] -= in[x];
+            }
+
+          for (x = 0; x < strip_width; x++)
+            out[x] = (sums[x] + d / 2) / d;
+        }
+    }
+}
+
+static void
+blur_strip_c (const guchar *src,
+              guchar       *dst,
+              int           stride,
+              int           height,
+              int           d,
+              int           offset)
+{
+  blur_strip_scalar (src, dst, stride, height, d, offset, 16);
+}
+
+/* The vectorized kernels compute (sum + d / 2) / d as
+ * trunc ((sum + d / 2 + 0.5) * (1 / d)). For x = sum + d / 2 = q * d + r
+ * the exact value lies in [q + 0.5 / d, q + 1 - 0.5 / d], and the two
+ * float roundings are off by less than x / d * 2^-23, which stays below
+ * 0.5 / d for x < 2^22. So the result matches the integer division.
+ */
+#define blur_divide_bias(d) ((float) ((d) / 2) + 0.5f)
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+static inline __m128i
+blur_divide_sse2 (__m128i sum,
+                  __m128  bias,
+                  __m128  inv_d)
+{
+  return _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_cvtepi32_ps (sum), bias), inv_d));
+}
+
+static void
+blur_strip_sse2 (const guchar *src,
+                 guchar       *dst,
+                 int           stride,
+                 int           height,
+                 int           d,
+                 int           offset)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128 bias = _mm_set1_ps (blur_divide_bias (d));
+  const __m128 inv_d = _mm_set1_ps (1.0f / d);
+  __m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+  int i;
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      __m128i lo, hi;
+
+      if (i >= 0 && i < height)
+        {
+          __m128i in = _mm_loadu_si128 ((const __m128i *) (src + i * stride));
+
+          lo = _mm_unpacklo_epi8 (in, zero);
+          hi = _mm_unpackhi_epi8 (in, zero);
+          s0 = _mm_add_epi32 (s0, _mm_unpacklo_epi16 (lo, zero));
+          s1 = _mm_add_epi32 (s1, _mm_unpackhi_epi16 (lo, zero));
+          s2 = _mm_add_epi32 (s2, _mm_unpacklo_epi16 (hi, zero));
+          s3 = _mm_add_epi32 (s3, _mm_unpackhi_epi16 (hi, zero));
+        }
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            {
+              __m128i in = _mm_loadu_si128 ((const __m128i *) (src + (i - d) * stride));
+
+              lo = _mm_unpacklo_epi8 (in, zero);
+              hi = _mm_unpackhi_epi8 (in, zero);
+              s0 = _mm_sub_epi32 (s0, _mm_unpacklo_epi16 (lo, zero));
+              s1 = _mm_sub_epi32 (s1, _mm_unpackhi_epi16 (lo, zero));
+              s2 = _mm_sub_epi32 (s2, _mm_unpacklo_epi16 (hi, zero));
+              s3 = _mm_sub_epi32 (s3, _mm_unpackhi_epi16 (hi, zero));
+            }
+
+          lo = _mm_packs_epi32 (blur_divide_sse2 (s0, bias, inv_d),
+                                blur_divide_sse2 (s1, bias, inv_d));
+          hi = _mm_packs_epi32 (blur_divide_sse2 (s2, bias, inv_d),
+                                blur_divide_sse2 (s3, bias, inv_d));
+          _mm_storeu_si128 ((__m128i *) (dst + (i - offset) * stride),
+                            _mm_packus_epi16 (lo, hi));
+        }
+    }
+}
+#endif /* __SSE2__ */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_AVX2_BLUR 1
+#include <immintrin.h>
+
+__attribute__ ((target ("avx2"))) static inline __m256i
+blur_load_avx2 (const guchar *p)
+{
+  return _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) p));
+}
+
+__attribute__ ((target ("avx2"))) static inline void
+blur_store_avx2 (guchar  *p,
+                 __m256i  sum,
+                 __m256   bias,
+                 __m256   inv_d)
+{
+  __m256i v = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_add_ps (_mm256_cvtepi32_ps (sum), bias), inv_d));
+  __m128i w = _mm_packs_epi32 (_mm256_castsi256_si128 (v), _mm256_extracti128_si256 (v, 1));
+
+  _mm_storel_epi64 ((__m128i *) p, _mm_packus_epi16 (w, w));
+}
+
+__attribute__ ((target ("avx2"))) static void
+blur_strip_avx2 (const guchar *src,
+                 guchar       *dst,
+                 int           stride,
+                 int           height,
+                 int           d,
+                 int           offset)
+{
+  const __m256 bias = _mm256_set1_ps (blur_divide_bias (d));
+  const __m256 inv_d = _mm256_set1_ps (1.0f / d);
+  __m256i s0, s1, s2, s3;
+  int i;
+
+  s0 = s1 = s2 = s3 = _mm256_setzero_si256 ();
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const guchar *in = src + i * stride;
+
+          s0 = _mm256_add_epi32 (s0, blur_load_avx2 (in));
+          s1 = _mm256_add_epi32 (s1, blur_load_avx2 (in + 8));
+          s2 = _mm256_add_epi32 (s2, blur_load_avx2 (in + 16));
+          s3 = _mm256_add_epi32 (s3, blur_load_avx2 (in + 24));
+        }
+
+      if (i >= offset)
+        {
+          guchar *out = dst + (i - offset) * stride;
+
+          if (i >= d)
+            {
+              const guchar *in = src + (i - d) * stride;
+
+              s0 = _mm256_sub_epi32 (s0, blur_load_avx2 (in));
+              s1 = _mm256_sub_epi32 (s1, blur_load_avx2 (in + 8));
+              s2 = _mm256_sub_epi32 (s2, blur_load_avx2 (in + 16));
+              s3 = _mm256_sub_epi32 (s3, blur_load_avx2 (in + 24));
+            }
+
+          blur_store_avx2 (out, s0, bias, inv_d);
+          blur_store_avx2 (out + 8, s1, bias, inv_d);
+          blur_store_avx2 (out + 16, s2, bias, inv_d);
+          blur_store_avx2 (out + 24, s3, bias, inv_d);
+        }
+    }
+}
+#endif /* __GNUC__ && __x86_64__ */
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+
+static inline uint16x4_t
+blur_divide_neon (int32x4_t   sum,
+                  float32x4_t bias,
+                  float32x4_t inv_d)
+{
+  return vqmovun_s32 (vcvtq_s32_f32 (vmulq_f32 (vaddq_f32 (vcvtq_f32_s32 (sum), bias), inv_d)));
+}
+
+static void
+blur_strip_neon (const guchar *src,
+                 guchar       *dst,
+                 int           stride,
+                 int           height,
+                 int           d,
+                 int           offset)
+{
+  const float32x4_t bias = vdupq_n_f32 (blur_divide_bias (d));
+  const float32x4_t inv_d = vdupq_n_f32 (1.0f / d);
+  int32x4_t s0, s1, s2, s3;
   int i;
 
+  s0 = s1 = s2 = s3 = vdupq_n_s32 (0);
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      uint16x8_t lo, hi;
+
+      if (i >= 0 && i < height)
+        {
+          uint8x16_t in = vld1q_u8 (src + i * stride);
+
+          lo = vmovl_u8 (vget_low_u8 (in));
+          hi = vmovl_u8 (vget_high_u8 (in));
+          s0 = vaddq_s32 (s0, vreinterpretq_s32_u32 (vmovl_u16 (vget_low_u16 (lo))));
+          s1 = vaddq_s32 (s1, vreinterpretq_s32_u32 (vmovl_u16 (vget_high_u16 (lo))));
+          s2 = vaddq_s32 (s2, vreinterpretq_s32_u32 (vmovl_u16 (vget_low_u16 (hi))));
+          s3 = vaddq_s32 (s3, vreinterpretq_s32_u32 (vmovl_u16 (vget_high_u16 (hi))));
+        }
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            {
+              uint8x16_t in = vld1q_u8 (src + (i - d) * stride);
+
+              lo = vmovl_u8 (vget_low_u8 (in));
+              hi = vmovl_u8 (vget_high_u8 (in));
+              s0 = vsubq_s32 (s0, vreinterpretq_s32_u32 (vmovl_u16 (vget_low_u16 (lo))));
+              s1 = vsubq_s32 (s1, vreinterpretq_s32_u32 (vmovl_u16 (vget_high_u16 (lo))));
+              s2 = vsubq_s32 (s2, vreinterpretq_s32_u32 (vmovl_u16 (vget_low_u16 (hi))));
+              s3 = vsubq_s32 (s3, vreinterpretq_s32_u32 (vmovl_u16 (vget_high_u16 (hi))));
+            }
+
+          lo = vcombine_u16 (blur_divide_neon (s0, bias, inv_d), blur_divide_neon (s1, bias, inv_d));
+          hi = vcombine_u16 (blur_divide_neon (s2, bias, inv_d), blur_divide_neon (s3, bias, inv_d));
+          vst1q_u8 (dst + (i - offset) * stride,
+                    vcombine_u8 (vqmovn_u16 (lo), vqmovn_u16 (hi)));
+        }
+    }
+}
+#endif /* __ARM_NEON */
+
+static const BlurImpl blur_impl_c = { "c", 16, blur_strip_c };
+#ifdef __SSE2__
+static const BlurImpl blur_impl_sse2 = { "sse2", 16, blur_strip_sse2 };
+#endif
+#ifdef HAVE_AVX2_BLUR
+static const BlurImpl blur_impl_avx2 = { "avx2", 32, blur_strip_avx2 };
+#endif
+#ifdef __ARM_NEON
+static const BlurImpl blur_impl_neon = { "neon", 16, blur_strip_neon };
+#endif
+
+static const BlurImpl *forced_blur_impl = NULL;
+
+/* SSE2 and NEON are part of the baseline ABI wherever the compiler
+ * defines them, AVX2 needs to be checked for at runtime.
+ */
+static const BlurImpl *
+get_blur_impl (void)
+{
+  static const BlurImpl *impl = NULL;
+
+  if (forced_blur_impl)
+    return forced_blur_impl;
+
+  if (g_once_init_enter (&impl))
+    {
+      const BlurImpl *best = &blur_impl_c;
+
+#ifdef __SSE2__
+      best = &blur_impl_sse2;
+#endif
+#ifdef __ARM_NEON
+      best = &blur_impl_neon;
+#endif
+#ifdef HAVE_AVX2_BLUR
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        best = &blur_impl_avx2;
+#endif
+
+      if (g_strcmp0 (g_getenv ("GSK_BLUR_IMPL"), "c") == 0)
+        best = &blur_impl_c;
+
+      g_once_init_leave (&impl, best);
+    }
+
+  return impl;
+}
+
+/*<private>
+ * gsk_cairo_blur_get_implementation:
+ *
+ * Returns the name of the box blur kernel that is used on this
+ * machine, one of "c", "sse2", "avx2" or "neon". Setting the
+ * environment variable GSK_BLUR_IMPL to "c" forces the scalar
+ * kernel, which is useful for comparing the two.
+ */
+const char *
+gsk_cairo_blur_get_implementation (void)
+{
+  return get_blur_impl ()->name;
+}
+
+/*<private>
+ * gsk_cairo_blur_set_implementation:
+ * @name: (nullable): the name of a box blur kernel, or %NULL
+ *
+ * Makes blurs use the kernel called @name, or the best one for this
+ * machine again if @name is %NULL. This is meant for the tests, which
+ * compare the vectorized kernels to the scalar one.
+ *
+ * Returns: %FALSE if the kernel can't be used on this machine
+ */
+gboolean
+gsk_cairo_blur_set_implementation (const char *name)
+{
+  const BlurImpl *impl = NULL;
+
+  if (name == NULL)
+    {
+      forced_blur_impl = NULL;
+      return TRUE;
+    }
+
+  if (g_str_equal (name, "c"))
+    impl = &blur_impl_c;
+#ifdef __SSE2__
+  else if (g_str_equal (name, "sse2"))
+    impl = &blur_impl_sse2;
+#endif
+#ifdef HAVE_AVX2_BLUR
+  else if (g_str_equal (name, "avx2"))
+    {
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        impl = &blur_impl_avx2;
+    }
+#endif
+#ifdef __ARM_NEON
+  else if (g_str_equal (name, "neon"))
+    impl = &blur_impl_neon;
+#endif
+
+  if (impl == NULL)
+    return FALSE;
+
+  forced_blur_impl = impl;
+  return TRUE;
+}
+
+static void
+blur_pass (const guchar *src,
+           guchar       *dst,
+           int           width,
+           int           x_start,
+           int           x_end,
+           int           height,
+           int           d,
+           int           shift)
+{
+  const BlurImpl *impl = get_blur_impl ();
+  int offset;
+  int x;
+
   if (d % 2 == 1)
     offset = d / 2;
   else
     offset = (d - shift) / 2;
 
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
+  if (d > SIMD_BLUR_MAX_D)
+    impl = &blur_impl_c;
+
+  for (x = x_start; x + impl->strip_width <= x_end; x += impl->strip_width)
+    impl->blur_strip (src + x, dst + x, width, height, d, offset);
+
+  for (; x < x_end; x += 16)
+    blur_strip_scalar (src + x, dst + x, width, height, d, offset, MIN (16, x_end - x));
+}
+
+/* Blurs the columns x_start to x_end of a width x height buffer
+ * vertically, using the same columns of tmp_buffer as scratch space.
+ */
+static void
+blur_columns (guchar *buffer,
+              guchar *tmp_buffer,
+              int     width,
+              int     height,
+              int     x_start,
+              int     x_end,
+              int     d)
+{
+  int i;
+
+  /* We want to produce a symmetric blur that spreads a pixel
+   * equally far to the left and right. If d is odd that happens
+   * naturally, but for d even, we approximate by using a blur
+   * on either side and then a centered blur of size d + 1.
+   * (technique also from the SVG specification)
    */
+  if (d % 2 == 1)
+    {
+      blur_pass (buffer, tmp_buffer, width, x_start, x_end, height, d, 0);
+      blur_pass (tmp_buffer, buffer, width, x_start, x_end, height, d, 0);
+      blur_pass (buffer, tmp_buffer, width, x_start, x_end, height, d, 0);
+    }
+  else
+    {
+      blur_pass (buffer, tmp_buffer, width, x_start, x_end, height, d, 1);
+      blur_pass (tmp_buffer, buffer, width, x_start, x_end, height, d, -1);
+      blur_pass (buffer, tmp_buffer, width, x_start, x_end, height, d + 1, 0);
+    }
+
+  for (i = 0; i < height; i++)
+    memcpy (buffer + i * width + x_start, tmp_buffer + i * width + x_start, x_end - x_start);
+}
+
+typedef struct {
+  guchar *buffer;
+  guchar *tmp_buffer;
+  int     width;
+  int     height;
+  int     d;
+
+  GMutex  mutex;
+  GCond   cond;
+  int     pending;
+} BlurTask;
+
+typedef struct {
+  BlurTask *task;
+  int       x_start;
+  int       x_end;
+} BlurChunk;
+
+static void
+blur_chunk_run (BlurChunk *chunk)
+{
+  BlurTask *task = chunk->task;
+
+  blur_columns (task->buffer, task->tmp_buffer,
+                task->width, task->height,
+                chunk->x_start, chunk->x_end,
+                task->d);
+}
+
+static void
+blur_chunk_thread_func (gpointer data,
+                        gpointer user_data)
+{
+  BlurChunk *chunk = data;
+  BlurTask *task = chunk->task;
+
+  blur_chunk_run (chunk);
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  g_mutex_lock (&task->mutex);
+  task->pending--;
+  if (task->pending == 0)
+    g_cond_signal (&task->cond);
+  g_mutex_unlock (&task->mutex);
+}
+
+static GThreadPool *
+get_blur_thread_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
+      GThreadPool *p;
+      int n_threads = MAX (1, (int) g_get_num_processors () - 1);
+
+      p = g_thread_pool_new (blur_chunk_thread_func, NULL, n_threads, FALSE, NULL);
+      g_once_init_leave (&pool, p);
     }
 
-  memcpy (row, tmp_buffer, row_width);
+  return pool;
 }
 
+/* Blurs all columns of the buffer. Columns are independent of each
+ * other, so for large buffers they are split into chunks that are
+ * blurred in parallel; the calling thread takes the first chunk.
+ */
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_all_columns (guchar *buffer,
+                  guchar *tmp_buffer,
+                  int     width,
+                  int     height,
+                  int     d)
 {
+  BlurTask task;
+  BlurChunk *chunks;
+  int n_chunks, chunk_width;
   int i;
 
-  for (i = 0; i < buffer_height; i++)
+  n_chunks = MIN (g_get_num_processors (), width / 64);
+  if (n_chunks <= 1 || width * height < PARALLEL_BLUR_MIN_PIXELS)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-        }
-      else
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
-        }
+      blur_columns (buffer, tmp_buffer, width, height, 0, width, d);
+      return;
     }
+
+  /* Keep chunk boundaries on multiples of the widest strip, so that
+   * only the last chunk has to deal with leftover columns.
+   */
+  chunk_width = (width / n_chunks + 31) & ~31;
+  n_chunks = (width + chunk_width - 1) / chunk_width;
+
+  task.buffer = buffer;
+  task.tmp_buffer = tmp_buffer;
+  task.width = width;
+  task.height = height;
+  task.d = d;
+  g_mutex_init (&task.mutex);
+  g_cond_init (&task.cond);
+  task.pending = n_chunks - 1;
+
+  chunks = g_newa (BlurChunk, n_chunks);
+  for (i = 0; i < n_chunks; i++)
+    {
+      chunks[i].task = &task;
+      chunks[i].x_start = i * chunk_width;
+      chunks[i].x_end = MIN (width, (i + 1) * chunk_width);
+
+      if (i > 0)
+        g_thread_pool_push (get_blur_thread_pool (), &chunks[i], NULL);
+    }
+
+  blur_chunk_run (&chunks[0]);
+
+  g_mutex_lock (&task.mutex);
+  while (task.pending > 0)
+    g_cond_wait (&task.cond, &task.mutex);
+  g_mutex_unlock (&task.mutex);
+
+  g_mutex_clear (&task.mutex);
+  g_cond_clear (&task.cond);
 }
 
 /* Swaps width and height.
@@ -192,30 +688,33 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
+  guchar *tmp_buffer;
   guchar *flipped_buffer;
   int d = get_box_filter_size (radius);
 
-  flipped_buffer = g_malloc (width * height);
+  tmp_buffer = g_malloc (width * height);
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
-
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      /* Step 1: blur columns */
+      blur_all_columns (buffer, tmp_buffer, width, height, d);
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      flipped_buffer = tmp_buffer;
+
+      /* Step 2: swap rows and columns */
+      flip_buffer (flipped_buffer, buffer, width, height);
+
+      /* Step 3: blur columns (really rows) */
+      blur_all_columns (flipped_buffer, buffer, height, width, d);
+
+      /* Step 4: swap rows and columns */
+      flip_buffer (buffer, flipped_buffer, height, width);
     }
 
-  g_free (flipped_buffer);
+  g_free (tmp_buffer);
 }
 
 /*
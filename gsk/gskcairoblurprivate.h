@@ -40,6 +40,10 @@ void            gsk_cairo_blur_surface          (cairo_surface_t *surface,
                                                  double           radius,
 						 GskBlurFlags     flags);
 int             gsk_cairo_blur_compute_pixels   (double           radius);
+const char *    gsk_cairo_blur_get_implementation (void);
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+gboolean        gsk_cairo_blur_set_implementation (const char   *name);
 
 cairo_t *       gsk_cairo_blur_start_drawing    (cairo_t         *cr,
                                                  float            radius,
@@ -24,9 +24,12 @@
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
 #include "gskroundedrectprivate.h"
+#include "gsktexturemipmapprivate.h"
 
 #include "gdk/gdktextureprivate.h"
 
+#include <cairo-ft.h>
+
 static gboolean
 check_variant_type (GVariant *variant,
                     const char *type_string,
@@ -673,15 +676,29 @@ gsk_texture_node_draw (GskRenderNode *node,
 {
   GskTextureNode *self = (GskTextureNode *) node;
   cairo_surface_t *surface;
-
-  surface = gdk_texture_download_surface (self->texture);
+  double width, height;
+  double x_scale, y_scale;
+  int level;
+
+  /* Large textures drawn small are drawn from a downscaled copy,
+   * so cairo doesn't have to filter the full texture every time */
+  width = node->bounds.size.width;
+  height = node->bounds.size.height;
+  cairo_user_to_device_distance (cr, &width, &height);
+  x_scale = y_scale = 1;
+  cairo_surface_get_device_scale (cairo_get_target (cr), &x_scale, &y_scale);
+  level = gsk_texture_mipmap_get_level (self->texture,
+                                        fabs (width * x_scale),
+                                        fabs (height * y_scale));
+
+  surface = gsk_texture_mipmap_download_surface (self->texture, level);
 
   cairo_save (cr);
 
   cairo_translate (cr, node->bounds.origin.x, node->bounds.origin.y);
   cairo_scale (cr,
-               node->bounds.size.width / gdk_texture_get_width (self->texture),
-               node->bounds.size.height / gdk_texture_get_height (self->texture));
+               node->bounds.size.width / cairo_image_surface_get_width (surface),
+               node->bounds.size.height / cairo_image_surface_get_height (surface));
 
   cairo_set_source_surface (cr, surface, 0, 0);
   cairo_paint (cr);
@@ -883,11 +900,28 @@ draw_shadow (cairo_t             *cr,
     gsk_cairo_blur_finish_drawing (shadow_cr, radius, color, blur_flags);
 }
 
+/* Blurred masks for the corners and sides of box shadows are cached
+ * so that a shadow can be assembled from them at any size. Resizing
+ * a window only moves the slices around, it doesn't blur anything.
+ * Cache keys contain fractional positions, so we drop everything once
+ * a cache grows past this size rather than growing without bounds.
+ */
+#define SHADOW_MASK_CACHE_MAX_SIZE 64
+
 typedef struct {
   float radius;
+  float scale;
+  gboolean inset;
   graphene_size_t corner;
 } CornerMask;
 
+typedef struct {
+  float radius;
+  float scale;
+  gboolean inset;
+  float edge;
+} SideMask;
+
 typedef enum {
   TOP,
   RIGHT,
@@ -900,7 +934,9 @@ corner_mask_hash (CornerMask *mask)
 {
   return ((guint)mask->radius << 24) ^
     ((guint)(mask->corner.width*4)) << 12 ^
-    ((guint)(mask->corner.height*4)) << 0;
+    ((guint)(mask->corner.height*4)) << 0 ^
+    ((guint)(mask->scale*4)) << 20 ^
+    (mask->inset ? 1 << 31 : 0);
 }
 
 static gboolean
@@ -909,10 +945,78 @@ corner_mask_equal (CornerMask *mask1,
 {
   return
     mask1->radius == mask2->radius &&
+    mask1->scale == mask2->scale &&
+    mask1->inset == mask2->inset &&
     mask1->corner.width == mask2->corner.width &&
     mask1->corner.height == mask2->corner.height;
 }
 
+static guint
+side_mask_hash (SideMask *mask)
+{
+  return ((guint)mask->radius << 24) ^
+    ((guint)(mask->edge*64)) << 8 ^
+    ((guint)(mask->scale*4)) << 0 ^
+    (mask->inset ? 1 << 31 : 0);
+}
+
+static gboolean
+side_mask_equal (SideMask *mask1,
+                 SideMask *mask2)
+{
+  return
+    mask1->radius == mask2->radius &&
+    mask1->scale == mask2->scale &&
+    mask1->inset == mask2->inset &&
+    mask1->edge == mask2->edge;
+}
+
+static float
+get_device_scale (cairo_t *cr)
+{
+  double x_scale = 1;
+
+  cairo_surface_get_device_scale (cairo_get_target (cr), &x_scale, NULL);
+
+  return x_scale;
+}
+
+/* An inset shadow is the blurred complement of the box, and since
+ * blurring is linear that is the complement of the blurred box.
+ */
+static void
+invert_mask (cairo_surface_t *mask)
+{
+  guchar *data;
+  int width, height, stride;
+  int x, y;
+
+  cairo_surface_flush (mask);
+
+  data = cairo_image_surface_get_data (mask);
+  width = cairo_image_surface_get_width (mask);
+  height = cairo_image_surface_get_height (mask);
+  stride = cairo_image_surface_get_stride (mask);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      data[y * stride + x] = 255 - data[y * stride + x];
+
+  cairo_surface_mark_dirty (mask);
+}
+
+static void
+shadow_mask_cache_insert (GHashTable      *cache,
+                          gpointer         key,
+                          gsize            key_size,
+                          cairo_surface_t *mask)
+{
+  if (g_hash_table_size (cache) >= SHADOW_MASK_CACHE_MAX_SIZE)
+    g_hash_table_remove_all (cache);
+
+  g_hash_table_insert (cache, g_memdup (key, key_size), mask);
+}
+
 static void
 draw_shadow_corner (cairo_t               *cr,
                     gboolean               inset,
@@ -935,6 +1039,7 @@ draw_shadow_corner (cairo_t               *cr,
   float max_other;
   CornerMask key;
   gboolean overlapped;
+  float scale;
 
   clip_radius = gsk_cairo_blur_compute_pixels (radius);
 
@@ -993,9 +1098,9 @@ draw_shadow_corner (cairo_t               *cr,
   cairo_rectangle (cr, x1, y1, x2 - x1, y2 - y1);
   cairo_clip (cr);
 
-  if (inset || overlapped)
+  if (overlapped)
     {
-      /* Fall back to generic path if inset or if the corner radius
+      /* Fall back to generic path if the corner radius
          runs into each other */
       draw_shadow (cr, inset, box, clip_box, radius, color, GSK_BLUR_X | GSK_BLUR_Y);
       return;
@@ -1004,7 +1109,7 @@ draw_shadow_corner (cairo_t               *cr,
   if (has_empty_clip (cr))
     return;
 
-  /* At this point we're drawing a blurred outset corner. The only
+  /* At this point we're drawing a blurred corner. The only
    * things that affect the output of the blurred mask in this case
    * is:
    *
@@ -1013,34 +1118,43 @@ draw_shadow_corner (cairo_t               *cr,
    *
    * The blur radius (which also defines the clip_radius)
    *
-   * The the horizontal and vertical corner radius
+   * The the horizontal and vertical corner radius, which already
+   * include the spread
+   *
+   * The scale we're drawing at, and whether this is an inset shadow
    *
    * We apply the first position and orientation when drawing the
-   * mask, so we cache rendered masks based on the blur radius and the
-   * corner radius.
+   * mask, so we cache rendered masks based on the rest.
    */
   if (corner_mask_cache == NULL)
     corner_mask_cache = g_hash_table_new_full ((GHashFunc)corner_mask_hash,
                                                (GEqualFunc)corner_mask_equal,
                                                g_free, (GDestroyNotify)cairo_surface_destroy);
 
+  scale = get_device_scale (cr);
+
   key.radius = radius;
+  key.scale = scale;
+  key.inset = inset;
   key.corner = box->corner[corner];
 
   mask = g_hash_table_lookup (corner_mask_cache, &key);
   if (mask == NULL)
     {
       mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
-                                                 drawn_rect->width + clip_radius,
-                                                 drawn_rect->height + clip_radius);
+                                                 ceil (scale * (drawn_rect->width + clip_radius)),
+                                                 ceil (scale * (drawn_rect->height + clip_radius)));
+      cairo_surface_set_device_scale (mask, scale, scale);
       mask_cr = cairo_create (mask);
       gsk_rounded_rect_init_from_rect (&corner_box, &GRAPHENE_RECT_INIT (clip_radius, clip_radius, 2*drawn_rect->width, 2*drawn_rect->height), 0);
       corner_box.corner[0] = box->corner[corner];
       gsk_rounded_rect_path (&corner_box, mask_cr);
       cairo_fill (mask_cr);
-      gsk_cairo_blur_surface (mask, radius, GSK_BLUR_X | GSK_BLUR_Y);
       cairo_destroy (mask_cr);
-      g_hash_table_insert (corner_mask_cache, g_memdup (&key, sizeof (key)), mask);
+      gsk_cairo_blur_surface (mask, scale * radius, GSK_BLUR_X | GSK_BLUR_Y);
+      if (inset)
+        invert_mask (mask);
+      shadow_mask_cache_insert (corner_mask_cache, &key, sizeof (key), mask);
     }
 
   gdk_cairo_set_source_rgba (cr, color);
@@ -1053,6 +1167,65 @@ draw_shadow_corner (cairo_t               *cr,
   cairo_pattern_destroy (pattern);
 }
 
+/* Returns a mask containing the blurred profile across a straight
+ * edge of the box. The mask is ceil(scale) device pixels wide, all of
+ * them filled the same, and is meant to be repeated along the edge.
+ * It has the outside of the box at the top, and the edge is @edge
+ * units from the top. The mask extends clip_radius units beyond both
+ * ends, so that the blur doesn't see the surface boundaries in the
+ * part we use.
+ */
+static cairo_surface_t *
+get_side_mask (cairo_t  *cr,
+               float     radius,
+               gboolean  inset,
+               float     edge)
+{
+  static GHashTable *side_mask_cache = NULL;
+  cairo_surface_t *mask;
+  cairo_t *mask_cr;
+  SideMask key;
+  float scale;
+  int clip_radius;
+  int length;
+
+  if (side_mask_cache == NULL)
+    side_mask_cache = g_hash_table_new_full ((GHashFunc)side_mask_hash,
+                                             (GEqualFunc)side_mask_equal,
+                                             g_free, (GDestroyNotify)cairo_surface_destroy);
+
+  scale = get_device_scale (cr);
+
+  key.radius = radius;
+  key.scale = scale;
+  key.inset = inset;
+  key.edge = edge;
+
+  mask = g_hash_table_lookup (side_mask_cache, &key);
+  if (mask != NULL)
+    return mask;
+
+  clip_radius = gsk_cairo_blur_compute_pixels (radius);
+  length = ceil (edge + clip_radius) + 2 * clip_radius;
+
+  mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
+                                             ceil (scale), ceil (scale * length));
+  cairo_surface_set_device_scale (mask, scale, scale);
+  cairo_surface_set_device_offset (mask, 0, scale * clip_radius);
+  mask_cr = cairo_create (mask);
+  /* At fractional scales a single unit would leave the last column
+   * partially covered, which repeats as stripes */
+  cairo_rectangle (mask_cr, 0, edge, ceil (scale) / scale, length - clip_radius - edge);
+  cairo_fill (mask_cr);
+  cairo_destroy (mask_cr);
+  gsk_cairo_blur_surface (mask, scale * radius, GSK_BLUR_Y);
+  if (inset)
+    invert_mask (mask);
+  shadow_mask_cache_insert (side_mask_cache, &key, sizeof (key), mask);
+
+  return mask;
+}
+
 static void
 draw_shadow_side (cairo_t               *cr,
                   gboolean               inset,
@@ -1066,6 +1239,10 @@ draw_shadow_side (cairo_t               *cr,
   GskBlurFlags blur_flags = GSK_BLUR_REPEAT;
   gdouble clip_radius;
   int x1, x2, y1, y2;
+  cairo_surface_t *mask;
+  cairo_pattern_t *pattern;
+  cairo_matrix_t matrix;
+  float edge;
 
   clip_radius = gsk_cairo_blur_compute_pixels (radius);
 
@@ -1110,7 +1287,54 @@ draw_shadow_side (cairo_t               *cr,
 
   cairo_rectangle (cr, x1, y1, x2 - x1, y2 - y1);
   cairo_clip (cr);
-  draw_shadow (cr, inset, box, clip_box, radius, color, blur_flags);
+
+  /* If the opposite side is within reach of the blur, the profile
+   * across this side depends on both edges, so we can't use a cached
+   * single-edge mask.
+   */
+  if (((side == TOP || side == BOTTOM) && box->bounds.size.height < 2 * clip_radius) ||
+      ((side == LEFT || side == RIGHT) && box->bounds.size.width < 2 * clip_radius))
+    {
+      draw_shadow (cr, inset, box, clip_box, radius, color, blur_flags);
+      return;
+    }
+
+  if (has_empty_clip (cr))
+    return;
+
+  /* The mask has the outside at the top, so map the distance from
+   * the outer end of the drawn rect to the mask's y coordinate.
+   */
+  switch (side)
+    {
+    case TOP:
+      edge = box->bounds.origin.y - y1;
+      cairo_matrix_init (&matrix, 1, 0, 0, 1, 0, -y1);
+      break;
+    case BOTTOM:
+      edge = y2 - (box->bounds.origin.y + box->bounds.size.height);
+      cairo_matrix_init (&matrix, 1, 0, 0, -1, 0, y2);
+      break;
+    case LEFT:
+      edge = box->bounds.origin.x - x1;
+      cairo_matrix_init (&matrix, 0, 1, 1, 0, 0, -x1);
+      break;
+    case RIGHT:
+      edge = x2 - (box->bounds.origin.x + box->bounds.size.width);
+      cairo_matrix_init (&matrix, 0, -1, 1, 0, 0, x2);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  mask = get_side_mask (cr, radius, inset, edge);
+
+  gdk_cairo_set_source_rgba (cr, color);
+  pattern = cairo_pattern_create_for_surface (mask);
+  cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
+  cairo_pattern_set_matrix (pattern, &matrix);
+  cairo_mask (cr, pattern);
+  cairo_pattern_destroy (pattern);
 }
 
 static gboolean
@@ -3837,6 +4061,7 @@ struct _GskTextNode
   GskRenderNode render_node;
 
   PangoFont *font;
+  gboolean has_color_glyphs;
 
   GdkRGBA color;
   double x;
@@ -3846,6 +4071,23 @@ struct _GskTextNode
   PangoGlyphInfo glyphs[];
 };
 
+static gboolean
+font_has_color_glyphs (const PangoFont *font)
+{
+  cairo_scaled_font_t *scaled_font;
+  gboolean has_color = FALSE;
+
+  scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)font);
+  if (cairo_scaled_font_get_type (scaled_font) == CAIRO_FONT_TYPE_FT)
+    {
+      FT_Face ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
+      has_color = (FT_HAS_COLOR (ft_face) != 0);
+      cairo_ft_scaled_font_unlock_face (scaled_font);
+    }
+
+  return has_color;
+}
+
 static void
 gsk_text_node_finalize (GskRenderNode *node)
 {
@@ -4057,6 +4299,7 @@ gsk_text_node_new_with_bounds (PangoFont             *font,
   self = (GskTextNode *) gsk_render_node_new (&GSK_TEXT_NODE_CLASS, sizeof (PangoGlyphInfo) * glyphs->num_glyphs);
 
   self->font = g_object_ref (font);
+  self->has_color_glyphs = font_has_color_glyphs (font);
   self->color = *color;
   self->x = x;
   self->y = y;
@@ -4068,6 +4311,17 @@ gsk_text_node_new_with_bounds (PangoFont             *font,
   return &self->render_node;
 }
 
+/* Color glyphs can't be tinted with the node's color */
+gboolean
+gsk_text_node_has_color_glyphs (GskRenderNode *node)
+{
+  GskTextNode *self = (GskTextNode *) node;
+
+  g_return_val_if_fail (GSK_IS_RENDER_NODE_TYPE (node, GSK_TEXT_NODE), FALSE);
+
+  return self->has_color_glyphs;
+}
+
 const GdkRGBA *
 gsk_text_node_peek_color (GskRenderNode *node)
 {
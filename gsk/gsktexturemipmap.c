@@ -0,0 +1,240 @@
+/* GSK - The GTK Scene Kit
+ *
+ * Copyright 2018 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gsktexturemipmapprivate.h"
+
+#include <math.h>
+
+/* Renderers without hardware mipmaps draw large textures that are
+ * shown much smaller from a downscaled copy. Level n is the texture
+ * scaled down by 2^n, and is produced from level n - 1 with a 2x2 box
+ * filter. Levels above 0 are kept on the texture, so a thumbnail only
+ * pays for the downscaling once.
+ *
+ * The levels of all textures together are limited to a few megabytes,
+ * the textures that were drawn least recently lose theirs first.
+ */
+
+#define MIPMAP_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+typedef struct {
+  GdkTexture *texture; /* not owned, the levels are data of it */
+  GPtrArray *levels;
+  gsize size;
+  GList link;
+} MipmapLevels;
+
+static GQueue mipmap_lru = G_QUEUE_INIT;
+static gsize mipmap_cache_size;
+
+static GQuark
+gsk_texture_mipmap_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("gsk-texture-mipmap");
+
+  return quark;
+}
+
+static void
+mipmap_levels_free (gpointer data)
+{
+  MipmapLevels *levels = data;
+
+  g_queue_unlink (&mipmap_lru, &levels->link);
+  mipmap_cache_size -= levels->size;
+
+  g_ptr_array_unref (levels->levels);
+  g_slice_free (MipmapLevels, levels);
+}
+
+static MipmapLevels *
+mipmap_levels_get (GdkTexture *texture)
+{
+  MipmapLevels *levels;
+
+  levels = g_object_get_qdata (G_OBJECT (texture), gsk_texture_mipmap_quark ());
+  if (levels)
+    {
+      g_queue_unlink (&mipmap_lru, &levels->link);
+      g_queue_push_head_link (&mipmap_lru, &levels->link);
+      return levels;
+    }
+
+  levels = g_slice_new0 (MipmapLevels);
+  levels->texture = texture;
+  levels->levels = g_ptr_array_new_with_free_func ((GDestroyNotify) cairo_surface_destroy);
+  levels->link.data = levels;
+  g_queue_push_head_link (&mipmap_lru, &levels->link);
+
+  g_object_set_qdata_full (G_OBJECT (texture), gsk_texture_mipmap_quark (),
+                           levels, mipmap_levels_free);
+
+  return levels;
+}
+
+/* Drops the levels of other textures until the cache fits again */
+static void
+mipmap_cache_trim (MipmapLevels *keep)
+{
+  while (mipmap_cache_size > MIPMAP_CACHE_MAX_BYTES)
+    {
+      MipmapLevels *oldest = g_queue_peek_tail (&mipmap_lru);
+
+      if (oldest == keep)
+        break;
+
+      g_object_set_qdata (G_OBJECT (oldest->texture), gsk_texture_mipmap_quark (), NULL);
+    }
+}
+
+/*<private>
+ * gsk_texture_mipmap_get_level:
+ * @texture: a #GdkTexture
+ * @width: the width the texture is drawn at, in device pixels
+ * @height: the height the texture is drawn at, in device pixels
+ *
+ * Computes the smallest mipmap level of @texture that is still at
+ * least as large as the size it is drawn at, so that drawing it only
+ * needs to scale down by less than a factor of 2.
+ *
+ * Returns: the mipmap level, 0 for the texture itself
+ */
+int
+gsk_texture_mipmap_get_level (GdkTexture *texture,
+                              float       width,
+                              float       height)
+{
+  int texture_width = gdk_texture_get_width (texture);
+  int texture_height = gdk_texture_get_height (texture);
+  float scale;
+  int level;
+
+  if (width <= 0 || height <= 0)
+    return 0;
+
+  scale = MAX (width / texture_width, height / texture_height);
+  if (scale >= 0.5)
+    return 0;
+
+  level = floor (log2 (1 / scale));
+  level = MIN (level, GSK_TEXTURE_MIPMAP_MAX_LEVELS - 1);
+
+  while (level > 0 &&
+         ((texture_width >> level) == 0 || (texture_height >> level) == 0))
+    level--;
+
+  return level;
+}
+
+/* Halves the size of a premultiplied ARGB32 surface, averaging each
+ * 2x2 block of pixels. An odd last row or column is dropped.
+ */
+static cairo_surface_t *
+downscale_surface (cairo_surface_t *source)
+{
+  cairo_surface_t *surface;
+  const guchar *src;
+  guchar *dest;
+  int src_stride, dest_stride;
+  int width, height;
+  int dx, dy;
+  int x, y, c;
+
+  width = MAX (1, cairo_image_surface_get_width (source) / 2);
+  height = MAX (1, cairo_image_surface_get_height (source) / 2);
+
+  /* Sources that are a single pixel wide or high average with themselves */
+  dx = cairo_image_surface_get_width (source) > 1 ? 4 : 0;
+  dy = cairo_image_surface_get_height (source) > 1 ? cairo_image_surface_get_stride (source) : 0;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cairo_surface_flush (source);
+
+  src = cairo_image_surface_get_data (source);
+  src_stride = cairo_image_surface_get_stride (source);
+  dest = cairo_image_surface_get_data (surface);
+  dest_stride = cairo_image_surface_get_stride (surface);
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *row0 = src + 2 * y * src_stride;
+      const guchar *row1 = row0 + dy;
+      guchar *out = dest + y * dest_stride;
+
+      for (x = 0; x < width; x++)
+        for (c = 0; c < 4; c++)
+          out[4 * x + c] = (row0[8 * x + c] + row0[8 * x + dx + c] +
+                            row1[8 * x + c] + row1[8 * x + dx + c] + 2) / 4;
+    }
+
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+/*<private>
+ * gsk_texture_mipmap_download_surface:
+ * @texture: a #GdkTexture
+ * @level: the mipmap level, as returned by gsk_texture_mipmap_get_level()
+ *
+ * Returns the contents of @texture scaled down by 2^@level.
+ *
+ * Returns: (transfer full): a new reference to an image surface
+ */
+cairo_surface_t *
+gsk_texture_mipmap_download_surface (GdkTexture *texture,
+                                     int         level)
+{
+  MipmapLevels *levels;
+  cairo_surface_t *surface;
+
+  g_return_val_if_fail (level >= 0 && level < GSK_TEXTURE_MIPMAP_MAX_LEVELS, NULL);
+
+  if (level == 0)
+    return gdk_texture_download_surface (texture);
+
+  levels = mipmap_levels_get (texture);
+
+  while ((int) levels->levels->len < level)
+    {
+      cairo_surface_t *source, *scaled;
+
+      if (levels->levels->len == 0)
+        source = gdk_texture_download_surface (texture);
+      else
+        source = cairo_surface_reference (g_ptr_array_index (levels->levels, levels->levels->len - 1));
+
+      scaled = downscale_surface (source);
+      cairo_surface_destroy (source);
+
+      g_ptr_array_add (levels->levels, scaled);
+      levels->size += cairo_image_surface_get_stride (scaled) * cairo_image_surface_get_height (scaled);
+      mipmap_cache_size += cairo_image_surface_get_stride (scaled) * cairo_image_surface_get_height (scaled);
+    }
+
+  surface = cairo_surface_reference (g_ptr_array_index (levels->levels, level - 1));
+
+  mipmap_cache_trim (levels);
+
+  return surface;
+}
@@ -0,0 +1,37 @@
+/* GSK - The GTK Scene Kit
+ *
+ * Copyright 2018 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GSK_TEXTURE_MIPMAP_PRIVATE_H__
+#define __GSK_TEXTURE_MIPMAP_PRIVATE_H__
+
+#include <gdk/gdk.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define GSK_TEXTURE_MIPMAP_MAX_LEVELS 16
+
+int                     gsk_texture_mipmap_get_level            (GdkTexture     *texture,
+                                                                 float           width,
+                                                                 float           height);
+cairo_surface_t *       gsk_texture_mipmap_download_surface     (GdkTexture     *texture,
+                                                                 int             level);
+
+G_END_DECLS
+
+#endif /* __GSK_TEXTURE_MIPMAP_PRIVATE_H__ */
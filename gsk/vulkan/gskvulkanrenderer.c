@@ -6,6 +6,7 @@
 #include "gskprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
+#include "gsktexturemipmapprivate.h"
 #include "gskvulkanbufferprivate.h"
 #include "gskvulkanimageprivate.h"
 #include "gskvulkanpipelineprivate.h"
@@ -20,7 +21,8 @@ typedef struct _GskVulkanTextureData GskVulkanTextureData;
 
 struct _GskVulkanTextureData {
   GdkTexture *texture;
-  GskVulkanImage *image;
+  /* indexed by mipmap level, created on demand */
+  GskVulkanImage *images[GSK_TEXTURE_MIPMAP_MAX_LEVELS];
   GskVulkanRenderer *renderer;
 };
 
@@ -300,18 +302,25 @@ static void
 gsk_vulkan_renderer_clear_texture (gpointer p)
 {
   GskVulkanTextureData *data = p;
+  int i;
 
   if (data->renderer != NULL)
     data->renderer->textures = g_slist_remove (data->renderer->textures, data);
 
-  g_object_unref (data->image);
+  for (i = 0; i < GSK_TEXTURE_MIPMAP_MAX_LEVELS; i++)
+    g_clear_object (&data->images[i]);
 
   g_slice_free (GskVulkanTextureData, data);
 }
 
+/* @level is the mipmap level to use, see gsk_texture_mipmap_get_level().
+ * Textures drawn much smaller than their size are uploaded from a
+ * downscaled copy, which is much cheaper to upload and to sample.
+ */
 GskVulkanImage *
 gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
                                        GdkTexture        *texture,
+                                       int                level,
                                        GskVulkanUploader *uploader)
 {
   GskVulkanTextureData *data;
@@ -319,10 +328,10 @@ gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
   GskVulkanImage *image;
 
   data = gdk_texture_get_render_data (texture, self);
-  if (data)
-    return g_object_ref (data->image);
+  if (data && data->images[level])
+    return g_object_ref (data->images[level]);
 
-  surface = gdk_texture_download_surface (texture);
+  surface = gsk_texture_mipmap_download_surface (texture, level);
   image = gsk_vulkan_image_new_from_data (uploader,
                                           cairo_image_surface_get_data (surface),
                                           cairo_image_surface_get_width (surface),
@@ -330,14 +339,20 @@ gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
                                           cairo_image_surface_get_stride (surface));
   cairo_surface_destroy (surface);
 
+  if (data)
+    {
+      data->images[level] = g_object_ref (image);
+      return image;
+    }
+
   data = g_slice_new0 (GskVulkanTextureData);
-  data->image = image;
+  data->images[level] = image;
   data->texture = texture;
   data->renderer = self;
 
   if (gdk_texture_set_render_data (texture, self, data, gsk_vulkan_renderer_clear_texture))
     {
-      g_object_ref (data->image);
+      g_object_ref (data->images[level]);
       self->textures = g_slist_prepend (self->textures, data);
     }
   else
@@ -23,6 +23,7 @@ GType gsk_vulkan_renderer_get_type (void) G_GNUC_CONST;
 
 GskVulkanImage *        gsk_vulkan_renderer_ref_texture_image           (GskVulkanRenderer      *self,
                                                                          GdkTexture             *texture,
+                                                                         int                     level,
                                                                          GskVulkanUploader      *uploader);
 
 typedef struct
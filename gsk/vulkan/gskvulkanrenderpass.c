@@ -8,6 +8,7 @@
 #include "gskrenderer.h"
 #include "gskrendererprivate.h"
 #include "gskroundedrectprivate.h"
+#include "gsktexturemipmapprivate.h"
 #include "gskvulkanblendmodepipelineprivate.h"
 #include "gskvulkanblurpipelineprivate.h"
 #include "gskvulkanborderpipelineprivate.h"
@@ -25,8 +26,6 @@
 #include "gskvulkanrendererprivate.h"
 #include "gskprivate.h"
 
-#include <cairo-ft.h>
-
 #define ORTHO_NEAR_PLANE        -10000
 #define ORTHO_FAR_PLANE          10000
 
@@ -236,23 +235,6 @@ gsk_vulkan_render_pass_free (GskVulkanRenderPass *self)
   g_slice_free (GskVulkanRenderPass, self);
 }
 
-static gboolean
-font_has_color_glyphs (const PangoFont *font)
-{
-  cairo_scaled_font_t *scaled_font;
-  gboolean has_color = FALSE;
-
-  scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)font);
-  if (cairo_scaled_font_get_type (scaled_font) == CAIRO_FONT_TYPE_FT)
-    {
-      FT_Face ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
-      has_color = (FT_HAS_COLOR (ft_face) != 0);
-      cairo_ft_scaled_font_unlock_face (scaled_font);
-    }
-
-  return has_color;
-}
-
 #define FALLBACK(...) G_STMT_START { \
   GSK_RENDERER_NOTE (gsk_vulkan_render_get_renderer (render), FALLBACK, g_message (__VA_ARGS__)); \
   goto fallback; \
@@ -379,7 +361,7 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         guint texture_index;
         GskVulkanRenderer *renderer = GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render));
 
-        if (font_has_color_glyphs (font))
+        if (gsk_text_node_has_color_glyphs (node))
           {
             if (gsk_vulkan_clip_contains_rect (&constants->clip, &node->bounds))
               pipeline_type = GSK_VULKAN_PIPELINE_COLOR_TEXT;
@@ -678,8 +660,13 @@ gsk_vulkan_render_pass_get_node_as_texture (GskVulkanRenderPass   *self,
     case GSK_TEXTURE_NODE:
       if (graphene_rect_equal (bounds, &node->bounds))
         {
+          GdkTexture *texture = gsk_texture_node_get_texture (node);
+
           result = gsk_vulkan_renderer_ref_texture_image (GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)),
-                                                          gsk_texture_node_get_texture (node),
+                                                          texture,
+                                                          gsk_texture_mipmap_get_level (texture,
+                                                                                        node->bounds.size.width * self->scale_factor,
+                                                                                        node->bounds.size.height * self->scale_factor),
                                                           uploader);
           gsk_vulkan_render_add_cleanup_image (render, result);
           *tex_rect = GRAPHENE_RECT_INIT(0, 0, 1, 1);
@@ -934,8 +921,14 @@ gsk_vulkan_render_pass_upload (GskVulkanRenderPass  *self,
 
         case GSK_VULKAN_OP_TEXTURE:
           {
+            GdkTexture *texture = gsk_texture_node_get_texture (op->render.node);
+            const graphene_rect_t *bounds = &op->render.node->bounds;
+
             op->render.source = gsk_vulkan_renderer_ref_texture_image (GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)),
-                                                                       gsk_texture_node_get_texture (op->render.node),
+                                                                       texture,
+                                                                       gsk_texture_mipmap_get_level (texture,
+                                                                                                     bounds->size.width * self->scale_factor,
+                                                                                                     bounds->size.height * self->scale_factor),
                                                                        uploader);
             op->render.source_rect = GRAPHENE_RECT_INIT(0, 0, 1, 1);
             gsk_vulkan_render_add_cleanup_image (render, op->render.source);
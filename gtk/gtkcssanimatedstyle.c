@@ -512,3 +512,89 @@ gtk_css_animated_style_new_advance (GtkCssAnimatedStyle *source,
 
   return GTK_CSS_STYLE (result);
 }
+
+/* Properties that are only used when rendering and are not inherited.
+ * Animating them changes neither the size of the node nor the styles
+ * of its children. */
+static gboolean
+is_render_property (guint id)
+{
+  switch (id)
+    {
+    case GTK_CSS_PROPERTY_OPACITY:
+    case GTK_CSS_PROPERTY_FILTER:
+    case GTK_CSS_PROPERTY_ICON_TRANSFORM:
+    case GTK_CSS_PROPERTY_ICON_FILTER:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * gtk_css_animated_style_advance_render_values:
+ * @style: the style to advance
+ * @base: the static style @style should be based on
+ * @timestamp: the new time
+ * @affects: (out): what the changed values affect
+ *
+ * Advances @style to @timestamp in place if all its running animations
+ * only change render properties like opacity or transforms. This avoids
+ * creating a new style and propagating a style change through the node
+ * tree every frame for things like spinners and fades.
+ *
+ * Animated styles are owned by their node, so nobody can observe the
+ * change except through the node, which has to redraw using @affects.
+ *
+ * Returns: %TRUE if @style was advanced, %FALSE if
+ *     gtk_css_animated_style_new_advance() must be used
+ */
+gboolean
+gtk_css_animated_style_advance_render_values (GtkCssAnimatedStyle *style,
+                                              GtkCssStyle         *base,
+                                              gint64               timestamp,
+                                              GtkCssAffects       *affects)
+{
+  GSList *l, *animations;
+  guint i;
+
+  gtk_internal_return_val_if_fail (GTK_IS_CSS_ANIMATED_STYLE (style), FALSE);
+  gtk_internal_return_val_if_fail (GTK_IS_CSS_STYLE (base), FALSE);
+
+  if (style->style != base ||
+      timestamp <= style->current_time ||
+      style->animated_values == NULL)
+    return FALSE;
+
+  *affects = 0;
+  for (i = 0; i < style->animated_values->len; i++)
+    {
+      if (g_ptr_array_index (style->animated_values, i) == NULL)
+        continue;
+
+      if (!is_render_property (i))
+        return FALSE;
+
+      *affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (i));
+    }
+
+  /* Finished animations need to be dropped, which the slow path does */
+  for (l = style->animations; l; l = l->next)
+    {
+      if (_gtk_style_animation_is_finished (l->data))
+        return FALSE;
+    }
+
+  animations = NULL;
+  for (l = style->animations; l; l = l->next)
+    animations = g_slist_prepend (animations, _gtk_style_animation_advance (l->data, timestamp));
+  animations = g_slist_reverse (animations);
+
+  g_slist_free_full (style->animations, g_object_unref);
+  style->animations = animations;
+  style->current_time = timestamp;
+
+  gtk_css_animated_style_apply_animations (style);
+
+  return TRUE;
+}
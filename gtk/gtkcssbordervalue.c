@@ -100,6 +100,18 @@ gtk_css_value_border_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_border_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->fill;
+  for (i = 0; i < 4; i++)
+    hash = hash * 31 + (value->values[i] ? gtk_css_value_hash (value->values[i]) : 0);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_border_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -139,6 +151,12 @@ gtk_css_value_border_print (const GtkCssValue *value,
     g_string_append (string, " fill");
 }
 
+static gsize
+gtk_css_value_border_get_size (const GtkCssValue *value)
+{
+  return sizeof (GtkCssValue);
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_BORDER = {
   gtk_css_value_border_free,
   gtk_css_value_border_compute,
@@ -146,7 +164,9 @@ static const GtkCssValueClass GTK_CSS_VALUE_BORDER = {
   gtk_css_value_border_transition,
   NULL,
   NULL,
-  gtk_css_value_border_print
+  gtk_css_value_border_print,
+  gtk_css_value_border_hash,
+  gtk_css_value_border_get_size
 };
 
 GtkCssValue *
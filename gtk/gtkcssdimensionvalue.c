@@ -167,6 +167,12 @@ gtk_css_value_dimension_equal (const GtkCssValue *number1,
          number1->value == number2->value;
 }
 
+static guint
+gtk_css_value_dimension_hash (const GtkCssValue *number)
+{
+  return gtk_css_value_hash_double (number->value) ^ number->unit;
+}
+
 static void
 gtk_css_value_dimension_print (const GtkCssValue *number,
                             GString           *string)
@@ -270,6 +276,12 @@ gtk_css_value_dimension_get_calc_term_order (const GtkCssValue *value)
   return 1000 + order_per_unit[value->unit];
 }
 
+static gsize
+gtk_css_value_dimension_get_size (const GtkCssValue *value)
+{
+  return sizeof (GtkCssValue);
+}
+
 static const GtkCssNumberValueClass GTK_CSS_VALUE_DIMENSION = {
   {
     gtk_css_value_dimension_free,
@@ -278,7 +290,9 @@ static const GtkCssNumberValueClass GTK_CSS_VALUE_DIMENSION = {
     gtk_css_number_value_transition,
     NULL,
     NULL,
-    gtk_css_value_dimension_print
+    gtk_css_value_dimension_print,
+    gtk_css_value_dimension_hash,
+    gtk_css_value_dimension_get_size
   },
   gtk_css_value_dimension_get,
   gtk_css_value_dimension_get_dimension,
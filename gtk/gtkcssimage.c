@@ -22,7 +22,10 @@
 #include "gtkcssimageprivate.h"
 
 #include "gtkcssstyleprivate.h"
-#include "gtksnapshot.h"
+#include "gtklrucacheprivate.h"
+#include "gtksnapshotprivate.h"
+
+#include <math.h>
 
 /* for the types only */
 #include "gtk/gtkcssimagecrossfadeprivate.h"
@@ -80,6 +83,13 @@ gtk_css_image_real_equal (GtkCssImage *image1,
   return FALSE;
 }
 
+static guint
+gtk_css_image_real_hash (GtkCssImage *image)
+{
+  /* Consistent with any equal() an image class implements */
+  return GPOINTER_TO_UINT (G_OBJECT_TYPE (image));
+}
+
 static GtkCssImage *
 gtk_css_image_real_transition (GtkCssImage *start,
                                GtkCssImage *end,
@@ -115,6 +125,12 @@ gtk_css_image_real_get_dynamic_image (GtkCssImage *image,
   return g_object_ref (image);
 }
 
+static gboolean
+gtk_css_image_real_is_cacheable (GtkCssImage *image)
+{
+  return FALSE;
+}
+
 static void
 _gtk_css_image_class_init (GtkCssImageClass *klass)
 {
@@ -123,10 +139,12 @@ _gtk_css_image_class_init (GtkCssImageClass *klass)
   klass->get_aspect_ratio = gtk_css_image_real_get_aspect_ratio;
   klass->compute = gtk_css_image_real_compute;
   klass->equal = gtk_css_image_real_equal;
+  klass->hash = gtk_css_image_real_hash;
   klass->transition = gtk_css_image_real_transition;
   klass->is_invalid = gtk_css_image_real_is_invalid;
   klass->is_dynamic = gtk_css_image_real_is_dynamic;
   klass->get_dynamic_image = gtk_css_image_real_get_dynamic_image;
+  klass->is_cacheable = gtk_css_image_real_is_cacheable;
 }
 
 static void
@@ -235,6 +253,18 @@ _gtk_css_image_equal (GtkCssImage *image1,
   return klass->equal (image1, image2);
 }
 
+guint
+gtk_css_image_hash (GtkCssImage *image)
+{
+  GtkCssImageClass *klass;
+
+  g_return_val_if_fail (GTK_IS_CSS_IMAGE (image), 0);
+
+  klass = GTK_CSS_IMAGE_GET_CLASS (image);
+
+  return klass->hash (image);
+}
+
 void
 _gtk_css_image_draw (GtkCssImage        *image,
                      cairo_t            *cr,
@@ -268,6 +298,162 @@ _gtk_css_image_draw (GtkCssImage        *image,
   cairo_restore (cr);
 }
 
+/* RASTER CACHE */
+
+/* Images without a native render node, like radial gradients, end up
+ * as Cairo fallbacks that are redrawn on every snapshot. Images that
+ * say so are rasterized once per size and scale and the texture is
+ * reused until it falls out of the cache.
+ *
+ * Entries are found by the image's value, as computing a style creates
+ * new images for equal gradients. It is bounded by the number of entries
+ * and by the size of the textures and drops the least recently used ones.
+ */
+#define RASTER_CACHE_MAX_SIZE 64
+#define RASTER_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+typedef struct _RasterEntry RasterEntry;
+
+struct _RasterEntry {
+  GtkCssImage *image;
+  double       width;
+  double       height;
+  int          scale;
+
+  GdkTexture  *texture;
+};
+
+static GtkLruCache *raster_cache;
+
+static guint
+raster_entry_hash (gconstpointer data)
+{
+  const RasterEntry *entry = data;
+  guint hash;
+
+  hash = gtk_css_image_hash (entry->image);
+  hash = (hash << 5) - hash + g_double_hash (&entry->width);
+  hash = (hash << 5) - hash + g_double_hash (&entry->height);
+
+  return hash ^ entry->scale;
+}
+
+static gboolean
+raster_entry_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const RasterEntry *entry_a = a;
+  const RasterEntry *entry_b = b;
+
+  return entry_a->width == entry_b->width &&
+         entry_a->height == entry_b->height &&
+         entry_a->scale == entry_b->scale &&
+         _gtk_css_image_equal (entry_a->image, entry_b->image);
+}
+
+static void
+raster_entry_free (gpointer data)
+{
+  RasterEntry *entry = data;
+
+  g_object_unref (entry->image);
+  g_object_unref (entry->texture);
+
+  g_slice_free (RasterEntry, entry);
+}
+
+static GdkTexture *
+gtk_css_image_rasterize (GtkCssImage *image,
+                         GskRenderer *renderer,
+                         double       width,
+                         double       height,
+                         int          scale)
+{
+  GtkSnapshot *snapshot;
+  GskRenderNode *node;
+  cairo_surface_t *surface;
+  GdkTexture *texture;
+  cairo_t *cr;
+
+  snapshot = gtk_snapshot_new (renderer, FALSE, NULL, "Raster<%s>", G_OBJECT_TYPE_NAME (image));
+  GTK_CSS_IMAGE_GET_CLASS (image)->snapshot (image, snapshot, width, height);
+  node = gtk_snapshot_free_to_node (snapshot);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        ceil (width * scale),
+                                        ceil (height * scale));
+  cairo_surface_set_device_scale (surface, scale, scale);
+
+  if (node != NULL)
+    {
+      cr = cairo_create (surface);
+      gsk_render_node_draw (node, cr);
+      cairo_destroy (cr);
+      gsk_render_node_unref (node);
+    }
+
+  texture = gdk_texture_new_for_surface (surface);
+  cairo_surface_destroy (surface);
+
+  return texture;
+}
+
+static GdkTexture *
+gtk_css_image_get_raster (GtkCssImage *image,
+                          GtkSnapshot *snapshot,
+                          double       width,
+                          double       height,
+                          int         *scale_out)
+{
+  GskRenderer *renderer;
+  RasterEntry key, *entry;
+  GdkWindow *window;
+  gsize n_bytes;
+  int scale;
+
+  /* The scale is needed to rasterize sharply */
+  renderer = gtk_snapshot_get_renderer (snapshot);
+  if (renderer == NULL)
+    return NULL;
+  window = gsk_renderer_get_window (renderer);
+  if (window == NULL)
+    return NULL;
+  scale = gdk_window_get_scale_factor (window);
+
+  key.image = image;
+  key.width = width;
+  key.height = height;
+  key.scale = scale;
+
+  *scale_out = scale;
+
+  if (raster_cache)
+    {
+      entry = gtk_lru_cache_lookup (raster_cache, &key);
+      if (entry)
+        return entry->texture;
+    }
+
+  n_bytes = 4 * (gsize) ceil (width * scale) * (gsize) ceil (height * scale);
+  if (n_bytes > RASTER_CACHE_MAX_BYTES / 4)
+    return NULL;
+
+  if (raster_cache == NULL)
+    raster_cache = gtk_lru_cache_new (raster_entry_hash, raster_entry_equal, raster_entry_free,
+                                      RASTER_CACHE_MAX_SIZE, RASTER_CACHE_MAX_BYTES);
+
+  entry = g_slice_new0 (RasterEntry);
+  entry->image = g_object_ref (image);
+  entry->width = width;
+  entry->height = height;
+  entry->scale = scale;
+  entry->texture = gtk_css_image_rasterize (image, renderer, width, height, scale);
+
+  gtk_lru_cache_insert (raster_cache, entry, n_bytes);
+
+  return entry->texture;
+}
+
 void
 gtk_css_image_snapshot (GtkCssImage *image,
                         GtkSnapshot *snapshot,
@@ -275,6 +461,8 @@ gtk_css_image_snapshot (GtkCssImage *image,
                         double       height)
 {
   GtkCssImageClass *klass;
+  GdkTexture *texture;
+  int scale;
 
   g_return_if_fail (GTK_IS_CSS_IMAGE (image));
   g_return_if_fail (snapshot != NULL);
@@ -283,6 +471,25 @@ gtk_css_image_snapshot (GtkCssImage *image,
 
   klass = GTK_CSS_IMAGE_GET_CLASS (image);
 
+  /* The raster is drawn pixel for pixel, which only looks the same
+   * as the image when nothing scales or rotates it */
+  if (klass->is_cacheable (image) && !klass->is_dynamic (image) &&
+      gtk_snapshot_is_translation (snapshot))
+    {
+      texture = gtk_css_image_get_raster (image, snapshot, width, height, &scale);
+      if (texture)
+        {
+          /* The texture covers whole pixels, so it can be a bit larger */
+          gtk_snapshot_append_texture (snapshot,
+                                       texture,
+                                       &GRAPHENE_RECT_INIT (0, 0,
+                                                            (double) gdk_texture_get_width (texture) / scale,
+                                                            (double) gdk_texture_get_height (texture) / scale),
+                                       "CachedImage<%s>", G_OBJECT_TYPE_NAME (image));
+          return;
+        }
+    }
+
   klass->snapshot (image, snapshot, width, height);
 }
 
@@ -64,6 +64,8 @@ struct _GtkCssImageClass
   /* compare two images for equality */
   gboolean     (* equal)                           (GtkCssImage                *image1,
                                                     GtkCssImage                *image2);
+  /* hash an image, images that are equal must hash the same (optional) */
+  guint        (* hash)                            (GtkCssImage                *image);
   /* transition between start and end image (end may be NULL), returns new reference (optional) */
   GtkCssImage *(* transition)                      (GtkCssImage                *start,
                                                     GtkCssImage                *end,
@@ -82,6 +84,8 @@ struct _GtkCssImageClass
   /* get image for given timestamp or @image when not dynamic (optional) */
   GtkCssImage *(* get_dynamic_image)               (GtkCssImage                *image,
                                                     gint64                      monotonic_time);
+  /* is snapshotting expensive enough to rasterize once and reuse the result? (optional) */
+  gboolean     (* is_cacheable)                    (GtkCssImage                *image);
   /* parse CSS, return TRUE on success */
   gboolean     (* parse)                           (GtkCssImage                *image,
                                                     GtkCssParser               *parser);
@@ -106,6 +110,7 @@ GtkCssImage *  _gtk_css_image_compute              (GtkCssImage                *
                                                     GtkCssStyle                *parent_style);
 gboolean       _gtk_css_image_equal                (GtkCssImage                *image1,
                                                     GtkCssImage                *image2);
+guint          gtk_css_image_hash                  (GtkCssImage                *image);
 GtkCssImage *  _gtk_css_image_transition           (GtkCssImage                *start,
                                                     GtkCssImage                *end,
                                                     guint                       property_id,
@@ -640,6 +640,39 @@ gtk_css_image_radial_equal (GtkCssImage *image1,
   return TRUE;
 }
 
+static guint
+gtk_css_image_radial_hash (GtkCssImage *image)
+{
+  GtkCssImageRadial *radial = GTK_CSS_IMAGE_RADIAL (image);
+  guint i, hash;
+
+  hash = radial->repeating | radial->size << 1;
+  hash = (hash << 5) - hash + gtk_css_value_hash (radial->position);
+  for (i = 0; i < 2; i++)
+    {
+      if (radial->sizes[i])
+        hash = (hash << 5) - hash + gtk_css_value_hash (radial->sizes[i]);
+    }
+
+  for (i = 0; i < radial->stops->len; i++)
+    {
+      GtkCssImageRadialColorStop *stop = &g_array_index (radial->stops, GtkCssImageRadialColorStop, i);
+
+      if (stop->offset)
+        hash = (hash << 5) - hash + gtk_css_value_hash (stop->offset);
+      hash = (hash << 5) - hash + gtk_css_value_hash (stop->color);
+    }
+
+  return hash;
+}
+
+static gboolean
+gtk_css_image_radial_is_cacheable (GtkCssImage *image)
+{
+  /* drawn with Cairo, there's no render node for radial gradients */
+  return TRUE;
+}
+
 static void
 gtk_css_image_radial_dispose (GObject *object)
 {
@@ -680,6 +713,8 @@ _gtk_css_image_radial_class_init (GtkCssImageRadialClass *klass)
   image_class->compute = gtk_css_image_radial_compute;
   image_class->transition = gtk_css_image_radial_transition;
   image_class->equal = gtk_css_image_radial_equal;
+  image_class->hash = gtk_css_image_radial_hash;
+  image_class->is_cacheable = gtk_css_image_radial_is_cacheable;
 
   object_class->dispose = gtk_css_image_radial_dispose;
 }
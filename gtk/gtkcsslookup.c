@@ -23,6 +23,7 @@
 #include "gtkcsstypesprivate.h"
 #include "gtkprivatetypebuiltins.h"
 #include "gtkprivate.h"
+#include "gtkstyleproviderprivate.h"
 
 void
 _gtk_css_lookup_init (GtkCssLookup     *lookup,
@@ -84,6 +85,37 @@ _gtk_css_lookup_set (GtkCssLookup  *lookup,
   lookup->values[id].section = section;
 }
 
+/**
+ * _gtk_css_lookup_set_deferred:
+ * @lookup: the lookup
+ * @id: id of the property to set
+ * @section: (allow-none): the section the value was defined in or %NULL
+ * @provider: the provider that found the value
+ * @deferred: what @provider needs to resolve the value
+ *
+ * Like _gtk_css_lookup_set(), for lookups with defer_values set, when
+ * getting the value would modify @provider. The value is obtained
+ * with gtk_style_provider_resolve_value() when @lookup is resolved.
+ **/
+void
+_gtk_css_lookup_set_deferred (GtkCssLookup     *lookup,
+                              guint             id,
+                              GtkCssSection    *section,
+                              GtkStyleProvider *provider,
+                              gpointer          deferred)
+{
+  gtk_internal_return_if_fail (lookup != NULL);
+  gtk_internal_return_if_fail (lookup->defer_values);
+  gtk_internal_return_if_fail (_gtk_bitmask_get (lookup->missing, id));
+  gtk_internal_return_if_fail (deferred != NULL);
+
+  lookup->missing = _gtk_bitmask_set (lookup->missing, id, FALSE);
+  lookup->values[id].value = NULL;
+  lookup->values[id].section = section;
+  lookup->values[id].provider = provider;
+  lookup->values[id].deferred = deferred;
+}
+
 /**
  * _gtk_css_lookup_resolve:
  * @lookup: the lookup
@@ -111,6 +143,10 @@ _gtk_css_lookup_resolve (GtkCssLookup      *lookup,
 
   for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
     {
+      if (lookup->values[i].deferred)
+        lookup->values[i].value = gtk_style_provider_resolve_value (lookup->values[i].provider,
+                                                                    lookup->values[i].deferred);
+
       if (lookup->values[i].value ||
           _gtk_bitmask_get (lookup->missing, i))
         gtk_css_static_style_compute_value (style,
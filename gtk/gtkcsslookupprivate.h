@@ -31,10 +31,13 @@ typedef struct _GtkCssLookup GtkCssLookup;
 typedef struct {
   GtkCssSection     *section;
   GtkCssValue       *value;
+  GtkStyleProvider  *provider; /* to resolve deferred with */
+  gpointer           deferred;
 } GtkCssLookupValue;
 
 struct _GtkCssLookup {
   GtkBitmask        *missing;
+  guint              defer_values : 1; /* see _gtk_css_lookup_set_deferred() */
   GtkCssLookupValue  values[GTK_CSS_PROPERTY_N_PROPERTIES];
 };
 
@@ -49,6 +52,11 @@ void                    _gtk_css_lookup_set                     (GtkCssLookup
                                                                  guint                       id,
                                                                  GtkCssSection              *section,
                                                                  GtkCssValue                *value);
+void                    _gtk_css_lookup_set_deferred            (GtkCssLookup               *lookup,
+                                                                 guint                       id,
+                                                                 GtkCssSection              *section,
+                                                                 GtkStyleProvider           *provider,
+                                                                 gpointer                    deferred);
 void                    _gtk_css_lookup_resolve                 (GtkCssLookup               *lookup,
                                                                  GtkStyleProvider           *provider,
                                                                  GtkCssStaticStyle          *style,
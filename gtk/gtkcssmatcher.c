@@ -158,6 +158,12 @@ gtk_css_matcher_widget_path_has_position (const GtkCssMatcher *matcher,
   return x / a >= 0;
 }
 
+static const GtkCssAncestorFilter *
+gtk_css_matcher_widget_path_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  return NULL;
+}
+
 static const GtkCssMatcherClass GTK_CSS_MATCHER_WIDGET_PATH = {
   gtk_css_matcher_widget_path_get_parent,
   gtk_css_matcher_widget_path_get_previous,
@@ -166,6 +172,7 @@ static const GtkCssMatcherClass GTK_CSS_MATCHER_WIDGET_PATH = {
   gtk_css_matcher_widget_path_has_class,
   gtk_css_matcher_widget_path_has_id,
   gtk_css_matcher_widget_path_has_position,
+  gtk_css_matcher_widget_path_get_ancestor_filter,
   FALSE
 };
 
@@ -308,6 +315,12 @@ gtk_css_matcher_node_has_position (const GtkCssMatcher *matcher,
                                          a, b);
 }
 
+static const GtkCssAncestorFilter *
+gtk_css_matcher_node_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  return gtk_css_node_get_ancestor_filter (matcher->node.node);
+}
+
 static const GtkCssMatcherClass GTK_CSS_MATCHER_NODE = {
   gtk_css_matcher_node_get_parent,
   gtk_css_matcher_node_get_previous,
@@ -316,6 +329,7 @@ static const GtkCssMatcherClass GTK_CSS_MATCHER_NODE = {
   gtk_css_matcher_node_has_class,
   gtk_css_matcher_node_has_id,
   gtk_css_matcher_node_has_position,
+  gtk_css_matcher_node_get_ancestor_filter,
   FALSE
 };
 
@@ -388,6 +402,12 @@ gtk_css_matcher_any_has_position (const GtkCssMatcher *matcher,
   return TRUE;
 }
 
+static const GtkCssAncestorFilter *
+gtk_css_matcher_any_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  return NULL;
+}
+
 static const GtkCssMatcherClass GTK_CSS_MATCHER_ANY = {
   gtk_css_matcher_any_get_parent,
   gtk_css_matcher_any_get_previous,
@@ -396,6 +416,7 @@ static const GtkCssMatcherClass GTK_CSS_MATCHER_ANY = {
   gtk_css_matcher_any_has_class,
   gtk_css_matcher_any_has_id,
   gtk_css_matcher_any_has_position,
+  gtk_css_matcher_any_get_ancestor_filter,
   TRUE
 };
 
@@ -481,6 +502,13 @@ gtk_css_matcher_superset_has_position (const GtkCssMatcher *matcher,
     return TRUE;
 }
 
+static const GtkCssAncestorFilter *
+gtk_css_matcher_superset_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  /* Parents are any matchers */
+  return NULL;
+}
+
 static const GtkCssMatcherClass GTK_CSS_MATCHER_SUPERSET = {
   gtk_css_matcher_superset_get_parent,
   gtk_css_matcher_superset_get_previous,
@@ -489,6 +517,7 @@ static const GtkCssMatcherClass GTK_CSS_MATCHER_SUPERSET = {
   gtk_css_matcher_superset_has_class,
   gtk_css_matcher_superset_has_id,
   gtk_css_matcher_superset_has_position,
+  gtk_css_matcher_superset_get_ancestor_filter,
   FALSE
 };
 
@@ -29,6 +29,15 @@ typedef struct _GtkCssMatcherSuperset GtkCssMatcherSuperset;
 typedef struct _GtkCssMatcherWidgetPath GtkCssMatcherWidgetPath;
 typedef struct _GtkCssMatcherClass GtkCssMatcherClass;
 
+/* A Bloom filter of the names, classes and ids of all ancestors of a
+ * matcher. It may contain false positives, but if a name, class or id
+ * isn't found, no ancestor has it. */
+#define GTK_CSS_ANCESTOR_FILTER_BITS 256
+
+struct _GtkCssAncestorFilter {
+  guint32 bits[GTK_CSS_ANCESTOR_FILTER_BITS / 32];
+};
+
 struct _GtkCssMatcherClass {
   gboolean        (* get_parent)                  (GtkCssMatcher          *matcher,
                                                    const GtkCssMatcher    *child);
@@ -46,6 +55,8 @@ struct _GtkCssMatcherClass {
                                                    gboolean               forward,
                                                    int                    a,
                                                    int                    b);
+  const GtkCssAncestorFilter *
+                  (* get_ancestor_filter)         (const GtkCssMatcher   *matcher);
   gboolean is_any;
 };
 
@@ -142,6 +153,60 @@ _gtk_css_matcher_matches_any (const GtkCssMatcher *matcher)
   return matcher->klass->is_any;
 }
 
+/* Returns %NULL if the ancestors aren't known */
+static inline const GtkCssAncestorFilter *
+_gtk_css_matcher_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  return matcher->klass->get_ancestor_filter (matcher);
+}
+
+/* Names and ids are interned, so their hash can be their address.
+ * The salt keeps names, classes and ids with equal hashes apart. */
+#define GTK_CSS_ANCESTOR_FILTER_SALT_NAME  0x00000000u
+#define GTK_CSS_ANCESTOR_FILTER_SALT_CLASS 0x5bd1e995u
+#define GTK_CSS_ANCESTOR_FILTER_SALT_ID    0xa54ff53au
+
+static inline guint32
+gtk_css_ancestor_filter_hash (guint32 key,
+                              guint32 salt)
+{
+  return (key ^ salt) * 0x9e3779b1u;
+}
+
+static inline void
+gtk_css_ancestor_filter_add (GtkCssAncestorFilter *filter,
+                             guint32               hash)
+{
+  filter->bits[(hash >> 24) / 32] |= 1u << ((hash >> 24) % 32);
+  filter->bits[((hash >> 16) & 0xff) / 32] |= 1u << (((hash >> 16) & 0xff) % 32);
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_name (/*interned*/ const char *name)
+{
+  return gtk_css_ancestor_filter_hash (GPOINTER_TO_UINT (name), GTK_CSS_ANCESTOR_FILTER_SALT_NAME);
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_class (GQuark class_name)
+{
+  return gtk_css_ancestor_filter_hash (class_name, GTK_CSS_ANCESTOR_FILTER_SALT_CLASS);
+}
+
+static inline guint32
+gtk_css_ancestor_filter_hash_id (/*interned*/ const char *id)
+{
+  return gtk_css_ancestor_filter_hash (GPOINTER_TO_UINT (id), GTK_CSS_ANCESTOR_FILTER_SALT_ID);
+}
+
+static inline gboolean
+gtk_css_ancestor_filter_may_contain (const GtkCssAncestorFilter *filter,
+                                     guint32                     hash)
+{
+  return (filter->bits[(hash >> 24) / 32] & (1u << ((hash >> 24) % 32))) &&
+         (filter->bits[((hash >> 16) & 0xff) / 32] & (1u << (((hash >> 16) & 0xff) % 32)));
+}
+
 
 G_END_DECLS
 
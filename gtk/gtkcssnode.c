@@ -20,13 +20,17 @@
 #include "gtkcssnodeprivate.h"
 
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcssproviderprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkintl.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
+#include "gtkstyleproviderprivate.h"
 #include "gtktypebuiltins.h"
 
+#include <string.h>
+
 /*
  * CSS nodes are the backbone of the GtkStyleContext implementation and
  * replace the role that GtkWidgetPath played in the past. A CSS node has
@@ -249,6 +253,7 @@ gtk_css_node_finalize (GObject *object)
 
   if (cssnode->style)
     g_object_unref (cssnode->style);
+  g_clear_pointer (&cssnode->match, gtk_css_static_style_match_free);
   gtk_css_node_declaration_unref (cssnode->decl);
 
   G_OBJECT_CLASS (gtk_css_node_parent_class)->finalize (object);
@@ -352,10 +357,136 @@ store_in_global_parent_cache (GtkCssNode                  *node,
                                                  style);
 }
 
+/* Collects the declarations of the ancestors for the shared style cache.
+ * Returns 0 if the node's matcher doesn't walk up the node tree, as the
+ * declarations wouldn't describe what is matched then. */
+static guint
+gtk_css_node_get_ancestor_declarations (GtkCssNode                   *node,
+                                        const GtkCssMatcher          *matcher,
+                                        const GtkCssNodeDeclaration **ancestors,
+                                        guint                         max_ancestors)
+{
+  GtkCssNode *iter;
+  guint n;
+
+  if (_gtk_css_matcher_get_ancestor_filter (matcher) == NULL)
+    return 0;
+
+  n = 0;
+  for (iter = node->parent; iter; iter = iter->parent)
+    {
+      if (n == max_ancestors)
+        return 0;
+
+      ancestors[n++] = iter->decl;
+    }
+
+  return n;
+}
+
+typedef struct {
+  const GtkCssNodeDeclaration *ancestors[SHARED_CACHE_MAX_ANCESTORS];
+  guint n_ancestors;
+  gboolean is_first;
+  gboolean is_last;
+} GtkCssSharedCacheKey;
+
+/* Looks up the node's style in the shared style cache and fills in @key,
+ * so a style computed after a miss can be inserted with it. @key has no
+ * ancestors if the node can't use the shared cache.
+ * Only counts as a lookup in the statistics if @count is set. */
+static GtkCssStyle *
+gtk_css_node_lookup_shared_style (GtkCssNode           *cssnode,
+                                  const GtkCssMatcher  *matcher,
+                                  gboolean              count,
+                                  GtkCssSharedCacheKey *key)
+{
+  GtkCssNode *parent = cssnode->parent;
+
+  key->n_ancestors = 0;
+
+  if (parent == NULL || parent->style == NULL || !may_use_global_parent_cache (cssnode))
+    return NULL;
+
+  key->n_ancestors = gtk_css_node_get_ancestor_declarations (cssnode, matcher, key->ancestors, G_N_ELEMENTS (key->ancestors));
+  if (key->n_ancestors == 0)
+    return NULL;
+
+  key->is_first = gtk_css_node_is_first_child (cssnode);
+  key->is_last = gtk_css_node_is_last_child (cssnode);
+
+  if (count)
+    return gtk_css_shared_style_cache_lookup (gtk_css_node_get_style_provider (cssnode),
+                                              parent->style,
+                                              gtk_css_node_get_declaration (cssnode),
+                                              key->is_first, key->is_last,
+                                              key->ancestors, key->n_ancestors);
+  else
+    return gtk_css_shared_style_cache_peek (gtk_css_node_get_style_provider (cssnode),
+                                            parent->style,
+                                            gtk_css_node_get_declaration (cssnode),
+                                            key->is_first, key->is_last,
+                                            key->ancestors, key->n_ancestors);
+}
+
+/* Selector matching for large restyles
+ *
+ * Matching selectors only reads the node tree and the style providers,
+ * so when many nodes need a new style, gtk_css_node_validate() matches
+ * all of them up front and spreads that work over a thread pool. The
+ * values are still computed here on the main thread, as GtkCssValues
+ * are neither refcounted atomically nor interned in a thread-safe way.
+ * That includes parsing the values the theme cache still has as text,
+ * and only those that were matched get parsed.
+ * Nodes that will find their style in a cache are not matched.
+ * Anything that changes what a node matches bumps match_generation and
+ * makes the prefetched matches unusable.
+ */
+#define PARALLEL_MATCH_MIN_NODES 256
+#define PARALLEL_MATCH_CHUNK_SIZE 16
+
+static guint match_generation;
+static guint prefetch_generation;
+static gboolean prefetching;
+static GThreadPool *match_pool;
+static guint match_threads;     /* 0 to use all processors */
+static GtkCssMatchStatistics match_stats;
+
+static inline void
+gtk_css_node_matching_changed (void)
+{
+  match_generation++;
+}
+
+static GtkCssStyle *
+gtk_css_node_compute_style (GtkCssNode          *cssnode,
+                            GtkStyleProvider    *provider,
+                            const GtkCssMatcher *matcher,
+                            GtkCssStyle         *parent)
+{
+  GtkCssStaticStyleMatch *match;
+  GtkCssStyle *style;
+
+  match = g_steal_pointer (&cssnode->match);
+  if (match == NULL)
+    return gtk_css_static_style_new_compute (provider, matcher, parent);
+
+  if (prefetch_generation == match_generation)
+    style = gtk_css_static_style_new_from_match (provider, match, parent);
+  else
+    style = gtk_css_static_style_new_compute (provider, matcher, parent);
+
+  gtk_css_static_style_match_free (match);
+
+  return style;
+}
+
 static GtkCssStyle *
 gtk_css_node_create_style (GtkCssNode *cssnode)
 {
   const GtkCssNodeDeclaration *decl;
+  GtkCssSharedCacheKey key;
+  GtkStyleProvider *provider;
   GtkCssMatcher matcher;
   GtkCssStyle *parent;
   GtkCssStyle *style;
@@ -367,15 +498,27 @@ gtk_css_node_create_style (GtkCssNode *cssnode)
     return g_object_ref (style);
 
   parent = cssnode->parent ? cssnode->parent->style : NULL;
+  provider = gtk_css_node_get_style_provider (cssnode);
 
   if (gtk_css_node_init_matcher (cssnode, &matcher))
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                              &matcher,
-                                              parent);
+    {
+      style = gtk_css_node_lookup_shared_style (cssnode, &matcher, TRUE, &key);
+      if (style)
+        {
+          style = g_object_ref (style);
+        }
+      else
+        {
+          style = gtk_css_node_compute_style (cssnode, provider, &matcher, parent);
+          if (key.n_ancestors > 0)
+            gtk_css_shared_style_cache_insert (provider, parent, decl,
+                                               key.is_first, key.is_last,
+                                               key.ancestors, key.n_ancestors,
+                                               style);
+        }
+    }
   else
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                              NULL,
-                                              parent);
+    style = gtk_css_static_style_new_compute (provider, NULL, parent);
 
   store_in_global_parent_cache (cssnode, decl, style);
 
@@ -423,7 +566,17 @@ gtk_css_node_real_update_style (GtkCssNode   *cssnode,
     }
 
   if (gtk_css_style_needs_recreation (static_style, change))
-    new_static_style = gtk_css_node_create_style (cssnode);
+    {
+      if (G_UNLIKELY (gtk_css_provider_get_profiling ()))
+        {
+          /* Blame the selectors that asked to be told about this change */
+          gtk_css_provider_profile_restyle (change & gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (static_style)));
+          new_static_style = gtk_css_node_create_style (cssnode);
+          gtk_css_provider_profile_restyle (0);
+        }
+      else
+        new_static_style = gtk_css_node_create_style (cssnode);
+    }
   else
     new_static_style = g_object_ref (static_style);
 
@@ -442,9 +595,26 @@ gtk_css_node_real_update_style (GtkCssNode   *cssnode,
     }
   else if (static_style != style && (change & GTK_CSS_CHANGE_TIMESTAMP))
     {
-      new_style = gtk_css_animated_style_new_advance (GTK_CSS_ANIMATED_STYLE (style),
-                                                      static_style,
-                                                      timestamp);
+      GtkCssNodeClass *klass = GTK_CSS_NODE_GET_CLASS (cssnode);
+      GtkCssAffects affects;
+
+      /* The style is changed in place, so only nodes that can tell
+       * their owner about it may take this shortcut. */
+      if (klass->render_values_changed &&
+          gtk_css_animated_style_advance_render_values (GTK_CSS_ANIMATED_STYLE (style),
+                                                        static_style,
+                                                        timestamp,
+                                                        &affects))
+        {
+          new_style = g_object_ref (style);
+          klass->render_values_changed (cssnode, affects);
+        }
+      else
+        {
+          new_style = gtk_css_animated_style_new_advance (GTK_CSS_ANIMATED_STYLE (style),
+                                                          static_style,
+                                                          timestamp);
+        }
     }
   else
     {
@@ -734,6 +904,31 @@ gtk_css_node_invalidate_style (GtkCssNode *cssnode)
     gtk_css_node_invalidate_style (cssnode->next_sibling);
 }
 
+static void
+gtk_css_node_invalidate_ancestor_filter (GtkCssNode *cssnode)
+{
+  GtkCssNode *child;
+
+  /* A valid filter needs a valid parent filter, so if this one is
+   * invalid, none of the children can be valid either. */
+  if (cssnode->ancestor_filter_state == GTK_CSS_ANCESTOR_FILTER_INVALID)
+    return;
+
+  cssnode->ancestor_filter_state = GTK_CSS_ANCESTOR_FILTER_INVALID;
+
+  for (child = cssnode->first_child; child; child = child->next_sibling)
+    gtk_css_node_invalidate_ancestor_filter (child);
+}
+
+static void
+gtk_css_node_invalidate_child_ancestor_filters (GtkCssNode *cssnode)
+{
+  GtkCssNode *child;
+
+  for (child = cssnode->first_child; child; child = child->next_sibling)
+    gtk_css_node_invalidate_ancestor_filter (child);
+}
+
 static void
 gtk_css_node_reposition (GtkCssNode *node,
                          GtkCssNode *new_parent,
@@ -747,6 +942,8 @@ gtk_css_node_reposition (GtkCssNode *node,
   /* Take a reference here so the whole function has a reference */
   g_object_ref (node);
 
+  gtk_css_node_matching_changed ();
+
   if (node->visible)
     {
       if (node->next_sibling)
@@ -767,6 +964,8 @@ gtk_css_node_reposition (GtkCssNode *node,
 
   if (old_parent != new_parent)
     {
+      gtk_css_node_invalidate_ancestor_filter (node);
+
       if (old_parent == NULL)
         {
           gtk_css_node_parent_will_be_set (node);
@@ -777,7 +976,7 @@ gtk_css_node_reposition (GtkCssNode *node,
         }
 
       if (gtk_css_node_get_style_provider_or_null (node) == NULL)
-        gtk_css_node_invalidate_style_provider (node);
+        gtk_css_node_invalidate_style_provider (node, NULL);
       gtk_css_node_invalidate (node, GTK_CSS_CHANGE_TIMESTAMP | GTK_CSS_CHANGE_ANIMATIONS);
 
       if (new_parent)
@@ -1047,6 +1246,7 @@ gtk_css_node_set_visible (GtkCssNode *cssnode,
     return;
 
   cssnode->visible = visible;
+  gtk_css_node_matching_changed ();
   g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_VISIBLE]);
 
   if (cssnode->invalid)
@@ -1104,13 +1304,34 @@ gtk_css_node_get_visible (GtkCssNode *cssnode)
   return cssnode->visible;
 }
 
+/* Whether any selector that might apply to @cssnode checks for @value,
+ * see gtk_style_provider_references(). If none does, the style cannot
+ * depend on @value and changing it does not need a restyle. */
+static gboolean
+gtk_css_node_references (GtkCssNode    *cssnode,
+                         GtkCssChange   change,
+                         gconstpointer  value)
+{
+  /* path nodes match on the widget type when there is no name */
+  if (change == GTK_CSS_CHANGE_NAME && value == NULL)
+    return TRUE;
+
+  return gtk_style_provider_references (gtk_css_node_get_style_provider (cssnode), change, value);
+}
+
 void
 gtk_css_node_set_name (GtkCssNode              *cssnode,
                        /*interned*/ const char *name)
 {
+  const char *old_name = gtk_css_node_get_name (cssnode);
+
   if (gtk_css_node_declaration_set_name (&cssnode->decl, name))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
+      gtk_css_node_matching_changed ();
+      gtk_css_node_invalidate_child_ancestor_filters (cssnode);
+      if (gtk_css_node_references (cssnode, GTK_CSS_CHANGE_NAME, old_name) ||
+          gtk_css_node_references (cssnode, GTK_CSS_CHANGE_NAME, name))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_NAME]);
     }
 }
@@ -1127,6 +1348,7 @@ gtk_css_node_set_widget_type (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_set_type (&cssnode->decl, widget_type))
     {
+      gtk_css_node_matching_changed ();
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_WIDGET_TYPE]);
     }
@@ -1142,9 +1364,15 @@ void
 gtk_css_node_set_id (GtkCssNode                *cssnode,
                      /* interned */ const char *id)
 {
+  const char *old_id = gtk_css_node_get_id (cssnode);
+
   if (gtk_css_node_declaration_set_id (&cssnode->decl, id))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ID);
+      gtk_css_node_matching_changed ();
+      gtk_css_node_invalidate_child_ancestor_filters (cssnode);
+      if (gtk_css_node_references (cssnode, GTK_CSS_CHANGE_ID, old_id) ||
+          gtk_css_node_references (cssnode, GTK_CSS_CHANGE_ID, id))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ID);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_ID]);
     }
 }
@@ -1159,9 +1387,13 @@ void
 gtk_css_node_set_state (GtkCssNode    *cssnode,
                         GtkStateFlags  state_flags)
 {
+  GtkStateFlags old_state = gtk_css_node_get_state (cssnode);
+
   if (gtk_css_node_declaration_set_state (&cssnode->decl, state_flags))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_STATE);
+      gtk_css_node_matching_changed ();
+      if (gtk_css_node_references (cssnode, GTK_CSS_CHANGE_STATE, GUINT_TO_POINTER (old_state ^ state_flags)))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_STATE);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_STATE]);
     }
 }
@@ -1175,9 +1407,20 @@ gtk_css_node_get_state (GtkCssNode *cssnode)
 static void
 gtk_css_node_clear_classes (GtkCssNode *cssnode)
 {
+  const GQuark *classes;
+  gboolean referenced = FALSE;
+  guint n_classes, i;
+
+  classes = gtk_css_node_declaration_get_classes (cssnode->decl, &n_classes);
+  for (i = 0; i < n_classes && !referenced; i++)
+    referenced = gtk_css_node_references (cssnode, GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (classes[i]));
+
   if (gtk_css_node_declaration_clear_classes (&cssnode->decl))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_matching_changed ();
+      gtk_css_node_invalidate_child_ancestor_filters (cssnode);
+      if (referenced)
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1228,7 +1471,10 @@ gtk_css_node_add_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_matching_changed ();
+      gtk_css_node_invalidate_child_ancestor_filters (cssnode);
+      if (gtk_css_node_references (cssnode, GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (style_class)))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1239,7 +1485,10 @@ gtk_css_node_remove_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
-      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
+      gtk_css_node_matching_changed ();
+      gtk_css_node_invalidate_child_ancestor_filters (cssnode);
+      if (gtk_css_node_references (cssnode, GTK_CSS_CHANGE_CLASS, GUINT_TO_POINTER (style_class)))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
 }
@@ -1264,22 +1513,73 @@ gtk_css_node_get_declaration (GtkCssNode *cssnode)
   return cssnode->decl;
 }
 
-void
-gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
+/* A node is affected by @selectors if one of them matches it now or
+ * may match it after a change to its state, position or siblings.
+ * The latter is what ends up in the change mask of the node's style,
+ * so those nodes need a new style, too, or the mask misses the new
+ * rules and the node won't be restyled when they start to match. */
+static gboolean
+gtk_css_node_is_affected_by (GtkCssNode               *cssnode,
+                             const GtkCssSelectorTree *selectors)
+{
+  GtkCssMatcher matcher, change_matcher;
+  GPtrArray *matches;
+
+  if (!gtk_css_node_init_matcher (cssnode, &matcher))
+    return TRUE;
+
+  matches = _gtk_css_selector_tree_match_all (selectors, &matcher);
+  if (matches != NULL)
+    {
+      g_ptr_array_free (matches, TRUE);
+      return TRUE;
+    }
+
+  _gtk_css_matcher_superset_init (&change_matcher, &matcher, GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_CLASS);
+
+  return _gtk_css_selector_tree_get_change_all (selectors, &change_matcher) != 0;
+}
+
+static void
+gtk_css_node_invalidate_selectors (GtkCssNode               *cssnode,
+                                   const GtkCssSelectorTree *selectors)
 {
   GtkCssNode *child;
 
-  gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+  if (selectors == NULL)
+    {
+      gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+    }
+  else
+    {
+      /* Styles in the caches may be computed from the old rules even
+       * if the node that cached them is not affected */
+      g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
+
+      if (gtk_css_node_is_affected_by (cssnode, selectors))
+        gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+    }
 
   for (child = cssnode->first_child;
        child;
        child = child->next_sibling)
     {
       if (gtk_css_node_get_style_provider_or_null (child) == NULL)
-        gtk_css_node_invalidate_style_provider (child);
+        gtk_css_node_invalidate_selectors (child, selectors);
     }
 }
 
+/* Called when the style provider changed. If @selectors is not %NULL,
+ * only they changed and only the nodes matching them are invalidated. */
+void
+gtk_css_node_invalidate_style_provider (GtkCssNode               *cssnode,
+                                        const GtkCssSelectorTree *selectors)
+{
+  gtk_css_node_matching_changed ();
+
+  gtk_css_node_invalidate_selectors (cssnode, selectors);
+}
+
 static void
 gtk_css_node_invalidate_timestamp (GtkCssNode *cssnode)
 {
@@ -1357,14 +1657,355 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
     }
 }
 
+typedef struct {
+  GtkCssNode *node;
+  GtkStyleProvider *provider;
+  GtkCssMatcher matcher;
+  GtkCssStaticStyleMatch *match;
+} GtkCssMatchJob;
+
+typedef struct {
+  GArray *jobs;
+  gint next_job;        /* atomic */
+  guint n_running;      /* protected by mutex */
+  GMutex mutex;
+  GCond cond;
+} GtkCssMatchBatch;
+
+static void
+gtk_css_match_batch_run (GtkCssMatchBatch *batch)
+{
+  guint i, start, end;
+
+  /* Threads take chunks of jobs until none are left, so a thread that
+   * got cheap nodes just takes more of them. */
+  while (TRUE)
+    {
+      start = g_atomic_int_add (&batch->next_job, PARALLEL_MATCH_CHUNK_SIZE);
+      if (start >= batch->jobs->len)
+        break;
+
+      end = MIN (start + PARALLEL_MATCH_CHUNK_SIZE, batch->jobs->len);
+      for (i = start; i < end; i++)
+        {
+          GtkCssMatchJob *job = &g_array_index (batch->jobs, GtkCssMatchJob, i);
+
+          job->match = gtk_css_static_style_match (job->provider, &job->matcher);
+        }
+    }
+}
+
+static void
+gtk_css_match_batch_thread (gpointer data,
+                            gpointer user_data)
+{
+  GtkCssMatchBatch *batch = data;
+
+  gtk_css_match_batch_run (batch);
+
+  g_mutex_lock (&batch->mutex);
+  /* Only read after waiting for the batch */
+  match_stats.thread_runs++;
+  batch->n_running--;
+  g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->mutex);
+}
+
+/* Siblings with equal declarations and positions get the style of
+ * the first of them from the parent's cache, see
+ * lookup_in_global_parent_cache(). */
+static gboolean
+gtk_css_node_has_equal_sibling (GtkCssNode *cssnode,
+                                GHashTable *siblings)
+{
+  const GtkCssNodeDeclaration *decl;
+  guint position, seen;
+
+  if (siblings == NULL || !may_use_global_parent_cache (cssnode))
+    return FALSE;
+
+  decl = gtk_css_node_get_declaration (cssnode);
+  position = 1 << (gtk_css_node_is_first_child (cssnode) | gtk_css_node_is_last_child (cssnode) << 1);
+  seen = GPOINTER_TO_UINT (g_hash_table_lookup (siblings, decl));
+
+  if (seen & position)
+    return TRUE;
+
+  g_hash_table_insert (siblings, (gpointer) decl, GUINT_TO_POINTER (seen | position));
+
+  return FALSE;
+}
+
+/* Does what gtk_css_node_create_style() does before matching, for
+ * nodes whose parent keeps its style. */
+static gboolean
+gtk_css_node_is_cached (GtkCssNode          *cssnode,
+                        const GtkCssMatcher *matcher)
+{
+  GtkCssSharedCacheKey key;
+  GtkCssNodeStyleCache *cache;
+  GtkCssNode *parent;
+
+  parent = cssnode->parent;
+  if (parent == NULL || parent->style == NULL || !may_use_global_parent_cache (cssnode))
+    return FALSE;
+
+  if (parent->cache)
+    {
+      cache = gtk_css_node_style_cache_lookup (parent->cache,
+                                               gtk_css_node_get_declaration (cssnode),
+                                               gtk_css_node_is_first_child (cssnode),
+                                               gtk_css_node_is_last_child (cssnode));
+      if (cache)
+        {
+          gtk_css_node_style_cache_unref (cache);
+          return TRUE;
+        }
+    }
+
+  return gtk_css_node_lookup_shared_style (cssnode, matcher, FALSE, &key) != NULL;
+}
+
+static void
+gtk_css_node_collect_match_jobs (GtkCssNode *cssnode,
+                                 gboolean    parent_restyled,
+                                 GHashTable *siblings,
+                                 GArray     *jobs)
+{
+  GHashTable *children;
+  GtkCssNode *child;
+  gboolean restyled;
+
+  restyled = parent_restyled ||
+             (cssnode->style_is_invalid && (cssnode->pending_changes & GTK_CSS_RADICAL_CHANGE));
+
+  if (restyled)
+    {
+      GtkCssMatchJob job = { NULL, };
+
+      /* Only nodes whose ancestors are all nodes can be matched from
+       * another thread, anything else calls into widgets. */
+      if (gtk_css_node_init_matcher (cssnode, &job.matcher) &&
+          _gtk_css_matcher_get_ancestor_filter (&job.matcher) != NULL &&
+          !gtk_css_node_has_equal_sibling (cssnode, siblings) &&
+          (parent_restyled || !gtk_css_node_is_cached (cssnode, &job.matcher)))
+        {
+          job.node = g_object_ref (cssnode);
+          job.provider = gtk_css_node_get_style_provider (cssnode);
+          g_array_append_val (jobs, job);
+        }
+    }
+
+  if (cssnode->first_child != cssnode->last_child)
+    children = g_hash_table_new (gtk_css_node_declaration_hash, gtk_css_node_declaration_equal);
+  else
+    children = NULL;
+
+  for (child = cssnode->first_child; child; child = child->next_sibling)
+    {
+      /* The filter is computed lazily, which must not happen on the
+       * matching threads. Invisible siblings are matched against, too. */
+      gtk_css_node_get_ancestor_filter (child);
+
+      if (child->visible)
+        gtk_css_node_collect_match_jobs (child, restyled, children, jobs);
+    }
+
+  if (children)
+    g_hash_table_unref (children);
+}
+
+/* The filters are computed lazily, which must not happen on the
+ * matching threads, as several of them may read the same ancestor's
+ * filter. gtk_css_node_collect_match_jobs() computes them for the
+ * nodes below @cssnode. */
+static void
+gtk_css_node_ensure_ancestor_filters (GtkCssNode *cssnode)
+{
+  for (; cssnode != NULL; cssnode = cssnode->parent)
+    gtk_css_node_get_ancestor_filter (cssnode);
+}
+
+static guint
+gtk_css_node_get_match_threads (void)
+{
+  if (match_threads > 0)
+    return match_threads;
+
+  return g_get_num_processors ();
+}
+
+/* Sets how many threads, including the main thread, match selectors
+ * in gtk_css_node_validate(), 0 to use one per processor. With less
+ * than 2, nodes are only matched when their style is created. */
+void
+gtk_css_node_set_match_threads (guint n_threads)
+{
+  match_threads = n_threads;
+
+  if (match_pool && gtk_css_node_get_match_threads () > 1)
+    g_thread_pool_set_max_threads (match_pool, gtk_css_node_get_match_threads () - 1, NULL);
+}
+
+void
+gtk_css_node_get_match_statistics (GtkCssMatchStatistics *stats)
+{
+  *stats = match_stats;
+}
+
+static GArray *
+gtk_css_node_prefetch_matches (GtkCssNode *cssnode)
+{
+  GtkCssMatchBatch batch;
+  GArray *jobs;
+  guint i, n_threads;
+
+  if (prefetching || gtk_css_provider_get_profiling ())
+    return NULL;
+
+  n_threads = gtk_css_node_get_match_threads ();
+  if (n_threads < 2)
+    return NULL;
+
+  gtk_css_node_ensure_ancestor_filters (cssnode);
+
+  jobs = g_array_new (FALSE, FALSE, sizeof (GtkCssMatchJob));
+  gtk_css_node_collect_match_jobs (cssnode, FALSE, NULL, jobs);
+
+  if (jobs->len < PARALLEL_MATCH_MIN_NODES)
+    {
+      for (i = 0; i < jobs->len; i++)
+        g_object_unref (g_array_index (jobs, GtkCssMatchJob, i).node);
+      g_array_unref (jobs);
+      return NULL;
+    }
+
+  if (match_pool == NULL)
+    match_pool = g_thread_pool_new (gtk_css_match_batch_thread, NULL, n_threads - 1, FALSE, NULL);
+
+  batch.jobs = jobs;
+  batch.next_job = 0;
+  batch.n_running = MIN (n_threads - 1, jobs->len / (4 * PARALLEL_MATCH_CHUNK_SIZE));
+  match_stats.prefetches++;
+  match_stats.jobs += jobs->len;
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+
+  for (i = 0; i < batch.n_running; i++)
+    g_thread_pool_push (match_pool, &batch, NULL);
+
+  gtk_css_match_batch_run (&batch);
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.n_running > 0)
+    g_cond_wait (&batch.cond, &batch.mutex);
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+
+  for (i = 0; i < jobs->len; i++)
+    {
+      GtkCssMatchJob *job = &g_array_index (jobs, GtkCssMatchJob, i);
+
+      g_clear_pointer (&job->node->match, gtk_css_static_style_match_free);
+      job->node->match = job->match;
+    }
+
+  prefetch_generation = match_generation;
+
+  return jobs;
+}
+
+static void
+gtk_css_node_clear_prefetched_matches (GArray *jobs)
+{
+  guint i;
+
+  for (i = 0; i < jobs->len; i++)
+    {
+      GtkCssMatchJob *job = &g_array_index (jobs, GtkCssMatchJob, i);
+
+      /* Nodes that ended up not being restyled */
+      g_clear_pointer (&job->node->match, gtk_css_static_style_match_free);
+      g_object_unref (job->node);
+    }
+
+  g_array_unref (jobs);
+}
+
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
   gint64 timestamp;
+  GArray *jobs;
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
+  jobs = gtk_css_node_prefetch_matches (cssnode);
+  if (jobs)
+    prefetching = TRUE;
+
   gtk_css_node_validate_internal (cssnode, timestamp);
+
+  if (jobs)
+    {
+      prefetching = FALSE;
+      gtk_css_node_clear_prefetched_matches (jobs);
+    }
+}
+
+/* The filter is built from the parent's filter and the parent's
+ * declaration, so it is computed top-down on first use and only
+ * invalidated when an ancestor changes. */
+const GtkCssAncestorFilter *
+gtk_css_node_get_ancestor_filter (GtkCssNode *cssnode)
+{
+  if (cssnode->ancestor_filter_state == GTK_CSS_ANCESTOR_FILTER_INVALID)
+    {
+      GtkCssNode *parent = cssnode->parent;
+      const GtkCssAncestorFilter *parent_filter;
+      GtkCssMatcher matcher;
+      const GQuark *classes;
+      const char *name, *id;
+      guint i, n_classes;
+
+      if (parent == NULL)
+        {
+          memset (&cssnode->ancestor_filter, 0, sizeof (GtkCssAncestorFilter));
+          cssnode->ancestor_filter_state = GTK_CSS_ANCESTOR_FILTER_VALID;
+          return &cssnode->ancestor_filter;
+        }
+
+      /* The matcher may not walk the node tree, ie for path nodes */
+      if (!gtk_css_node_init_matcher (parent, &matcher) ||
+          (parent_filter = _gtk_css_matcher_get_ancestor_filter (&matcher)) == NULL)
+        {
+          cssnode->ancestor_filter_state = GTK_CSS_ANCESTOR_FILTER_UNKNOWN;
+          return NULL;
+        }
+
+      cssnode->ancestor_filter = *parent_filter;
+
+      name = gtk_css_node_declaration_get_name (parent->decl);
+      if (name)
+        gtk_css_ancestor_filter_add (&cssnode->ancestor_filter, gtk_css_ancestor_filter_hash_name (name));
+
+      id = gtk_css_node_declaration_get_id (parent->decl);
+      if (id)
+        gtk_css_ancestor_filter_add (&cssnode->ancestor_filter, gtk_css_ancestor_filter_hash_id (id));
+
+      classes = gtk_css_node_declaration_get_classes (parent->decl, &n_classes);
+      for (i = 0; i < n_classes; i++)
+        gtk_css_ancestor_filter_add (&cssnode->ancestor_filter, gtk_css_ancestor_filter_hash_class (classes[i]));
+
+      cssnode->ancestor_filter_state = GTK_CSS_ANCESTOR_FILTER_VALID;
+    }
+
+  if (cssnode->ancestor_filter_state != GTK_CSS_ANCESTOR_FILTER_VALID)
+    return NULL;
+
+  return &cssnode->ancestor_filter;
 }
 
 gboolean
@@ -18,8 +18,11 @@
 #ifndef __GTK_CSS_NODE_PRIVATE_H__
 #define __GTK_CSS_NODE_PRIVATE_H__
 
+#include "gtkcssmatcherprivate.h"
 #include "gtkcssnodedeclarationprivate.h"
 #include "gtkcssnodestylecacheprivate.h"
+#include "gtkcssselectorprivate.h"
+#include "gtkcssstaticstyleprivate.h"
 #include "gtkcssstylechangeprivate.h"
 #include "gtkbitmaskprivate.h"
 #include "gtkcsstypesprivate.h"
@@ -35,6 +38,12 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssNodeClass         GtkCssNodeClass;
 
+typedef enum {
+  GTK_CSS_ANCESTOR_FILTER_INVALID,      /* needs to be computed from the parent */
+  GTK_CSS_ANCESTOR_FILTER_VALID,
+  GTK_CSS_ANCESTOR_FILTER_UNKNOWN       /* the ancestors aren't all nodes */
+} GtkCssAncestorFilterState;
+
 struct _GtkCssNode
 {
   GObject object;
@@ -51,6 +60,9 @@ struct _GtkCssNode
 
   GtkCssChange           pending_changes;       /* changes that accumulated since the style was last computed */
 
+  GtkCssAncestorFilter   ancestor_filter;       /* names, classes and ids of all ancestors */
+  GtkCssStaticStyleMatch *match;               /* selectors matched in advance by gtk_css_node_validate() */
+
   guint                  visible :1;            /* node will be skipped when validating or computing styles */
   guint                  invalid :1;            /* node or a child needs to be validated (even if just for animation) */
   guint                  needs_propagation :1;  /* children have state changes that need to be propagated to their siblings */
@@ -60,6 +72,7 @@ struct _GtkCssNode
    * So if a valid style is computed, one has to previously ensure that the parent's and the previous sibling's style
    * are valid. This allows both validation and invalidation to run in O(nodes-in-tree) */
   guint                  style_is_invalid :1;   /* the style needs to be recomputed */
+  guint                  ancestor_filter_state :2; /* GtkCssAncestorFilterState of ancestor_filter */
 };
 
 struct _GtkCssNodeClass
@@ -74,6 +87,9 @@ struct _GtkCssNodeClass
                                                          GtkCssNode            *previous);
   void                  (* style_changed)               (GtkCssNode            *cssnode,
                                                          GtkCssStyleChange     *style_change);
+  /* the style was animated in place, see gtk_css_animated_style_advance_render_values() */
+  void                  (* render_values_changed)       (GtkCssNode            *cssnode,
+                                                         GtkCssAffects          affects);
 
   gboolean              (* init_matcher)                (GtkCssNode            *cssnode,
                                                          GtkCssMatcher         *matcher);
@@ -93,6 +109,14 @@ struct _GtkCssNodeClass
   void                  (* validate)                    (GtkCssNode            *node);
 };
 
+typedef struct _GtkCssMatchStatistics GtkCssMatchStatistics;
+
+struct _GtkCssMatchStatistics {
+  guint prefetches;     /* validations that matched nodes in advance */
+  guint jobs;           /* nodes matched in advance */
+  guint thread_runs;    /* times a pool thread took part in matching */
+};
+
 GType                   gtk_css_node_get_type           (void) G_GNUC_CONST;
 
 GtkCssNode *            gtk_css_node_new                (void);
@@ -117,6 +141,8 @@ void                    gtk_css_node_set_visible        (GtkCssNode            *
                                                          gboolean               visible);
 gboolean                gtk_css_node_get_visible        (GtkCssNode            *cssnode);
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
 void                    gtk_css_node_set_name           (GtkCssNode            *cssnode,
                                                          /*interned*/const char*name);
 /*interned*/const char *gtk_css_node_get_name           (GtkCssNode            *cssnode);
@@ -147,16 +173,21 @@ GtkCssStyle *           gtk_css_node_get_style          (GtkCssNode            *
 
 
 void                    gtk_css_node_invalidate_style_provider
-                                                        (GtkCssNode            *cssnode);
+                                                        (GtkCssNode            *cssnode,
+                                                         const GtkCssSelectorTree *selectors);
 void                    gtk_css_node_invalidate_frame_clock
                                                         (GtkCssNode            *cssnode,
                                                          gboolean               just_timestamp);
 void                    gtk_css_node_invalidate         (GtkCssNode            *cssnode,
                                                          GtkCssChange           change);
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
 void                    gtk_css_node_validate           (GtkCssNode            *cssnode);
 
 gboolean                gtk_css_node_init_matcher       (GtkCssNode            *cssnode,
                                                          GtkCssMatcher         *matcher);
+const GtkCssAncestorFilter *
+                        gtk_css_node_get_ancestor_filter (GtkCssNode           *cssnode);
 GtkWidgetPath *         gtk_css_node_create_widget_path (GtkCssNode            *cssnode);
 const GtkWidgetPath *   gtk_css_node_get_widget_path    (GtkCssNode            *cssnode);
 GtkStyleProvider *      gtk_css_node_get_style_provider (GtkCssNode            *cssnode);
@@ -166,6 +197,13 @@ void                    gtk_css_node_print              (GtkCssNode
                                                          GString                   *string,
                                                          guint                      indent);
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+void                    gtk_css_node_set_match_threads  (guint                      n_threads);
+GDK_AVAILABLE_IN_ALL
+void                    gtk_css_node_get_match_statistics
+                                                        (GtkCssMatchStatistics     *stats);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_NODE_PRIVATE_H__ */
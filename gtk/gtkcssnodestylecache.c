@@ -21,6 +21,7 @@
 
 #include "gtkdebug.h"
 #include "gtkcssstaticstyleprivate.h"
+#include "gtklrucacheprivate.h"
 
 struct _GtkCssNodeStyleCache {
   guint        ref_count;
@@ -180,3 +181,299 @@ gtk_css_node_style_cache_lookup (GtkCssNodeStyleCache        *parent,
   return gtk_css_node_style_cache_ref (result);
 }
 
+
+/* SHARED CACHE */
+
+/* The caches above are per parent node, so identical nodes in different
+ * parts of the tree, like the rows of two lists, compute their styles
+ * independently. The shared cache is process-wide and keyed by the parent
+ * style instead of the parent node.
+ *
+ * Matching can depend on the ancestors, not just the parent style. Styles
+ * that do are stored with the declarations of all their ancestors, which
+ * must be equal for a hit. Styles that depend on the position of ancestors
+ * or their siblings are not stored.
+ *
+ * The cache keeps references to the styles and declarations in its keys,
+ * so a freed parent style's address can't be reused for a false hit. It
+ * doesn't keep providers alive, but drops their entries when they are
+ * finalized or emit their changed signal. It is bounded and drops the
+ * least recently used entries.
+ */
+#define SHARED_CACHE_MAX_SIZE 1024
+
+typedef struct _SharedEntry SharedEntry;
+
+struct _SharedEntry {
+  GtkStyleProvider             *provider;
+  GtkCssStyle                  *parent_style;
+  const GtkCssNodeDeclaration  *decl;
+  const GtkCssNodeDeclaration **ancestors;      /* NULL if the style doesn't depend on them */
+  guint                         n_ancestors;
+  guint                         is_first :1;
+  guint                         is_last :1;
+  guint                         hash;
+
+  GtkCssStyle                  *style;
+};
+
+static GtkLruCache *shared_cache;
+static guint shared_cache_n_with_ancestors;
+static GtkCssSharedStyleCacheStatistics shared_cache_stats;
+static GQuark shared_cache_provider_quark;
+
+static guint
+shared_entry_hash (gconstpointer data)
+{
+  const SharedEntry *entry = data;
+
+  return entry->hash;
+}
+
+static gboolean
+shared_entry_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const SharedEntry *entry_a = a;
+  const SharedEntry *entry_b = b;
+  guint i;
+
+  if (entry_a->provider != entry_b->provider ||
+      entry_a->parent_style != entry_b->parent_style ||
+      entry_a->is_first != entry_b->is_first ||
+      entry_a->is_last != entry_b->is_last ||
+      entry_a->n_ancestors != entry_b->n_ancestors)
+    return FALSE;
+
+  if (!gtk_css_node_declaration_equal (entry_a->decl, entry_b->decl))
+    return FALSE;
+
+  for (i = 0; i < entry_a->n_ancestors; i++)
+    {
+      if (!gtk_css_node_declaration_equal (entry_a->ancestors[i], entry_b->ancestors[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+shared_entry_init_key (SharedEntry                  *entry,
+                       GtkStyleProvider             *provider,
+                       GtkCssStyle                  *parent_style,
+                       const GtkCssNodeDeclaration  *decl,
+                       gboolean                      is_first,
+                       gboolean                      is_last,
+                       const GtkCssNodeDeclaration **ancestors,
+                       guint                         n_ancestors)
+{
+  guint i, hash;
+
+  entry->provider = provider;
+  entry->parent_style = parent_style;
+  entry->decl = decl;
+  entry->ancestors = ancestors;
+  entry->n_ancestors = n_ancestors;
+  entry->is_first = is_first;
+  entry->is_last = is_last;
+
+  hash = GPOINTER_TO_UINT (provider) ^ GPOINTER_TO_UINT (parent_style);
+  hash = (hash << 5) - hash + gtk_css_node_declaration_hash (decl);
+  for (i = 0; i < n_ancestors; i++)
+    hash = (hash << 5) - hash + gtk_css_node_declaration_hash (ancestors[i]);
+  entry->hash = (hash << 2) | (is_first ? 0x2 : 0) | (is_last ? 0x1 : 0);
+}
+
+static void
+shared_entry_free (gpointer data)
+{
+  SharedEntry *entry = data;
+  guint i;
+
+  if (entry->n_ancestors)
+    shared_cache_n_with_ancestors--;
+
+  g_object_unref (entry->parent_style);
+  gtk_css_node_declaration_unref ((GtkCssNodeDeclaration *) entry->decl);
+  for (i = 0; i < entry->n_ancestors; i++)
+    gtk_css_node_declaration_unref ((GtkCssNodeDeclaration *) entry->ancestors[i]);
+  g_free (entry->ancestors);
+  g_object_unref (entry->style);
+
+  g_slice_free (SharedEntry, entry);
+}
+
+static gboolean
+shared_entry_has_provider (gpointer entry,
+                           gpointer provider)
+{
+  return ((SharedEntry *) entry)->provider == provider;
+}
+
+static void
+shared_cache_provider_finalized (gpointer provider)
+{
+  gtk_css_shared_style_cache_remove_provider (provider);
+}
+
+/* @ancestors start at the parent and end at the root */
+static SharedEntry *
+gtk_css_shared_style_cache_find_entry (GtkStyleProvider             *provider,
+                                       GtkCssStyle                  *parent_style,
+                                       const GtkCssNodeDeclaration  *decl,
+                                       gboolean                      is_first,
+                                       gboolean                      is_last,
+                                       const GtkCssNodeDeclaration **ancestors,
+                                       guint                         n_ancestors)
+{
+  SharedEntry key, *entry;
+
+  shared_entry_init_key (&key, provider, parent_style, decl, is_first, is_last, NULL, 0);
+  entry = gtk_lru_cache_lookup (shared_cache, &key);
+
+  if (entry == NULL && shared_cache_n_with_ancestors > 0 && n_ancestors > 0)
+    {
+      shared_entry_init_key (&key, provider, parent_style, decl, is_first, is_last, ancestors, n_ancestors);
+      entry = gtk_lru_cache_lookup (shared_cache, &key);
+    }
+
+  return entry;
+}
+
+GtkCssStyle *
+gtk_css_shared_style_cache_lookup (GtkStyleProvider             *provider,
+                                   GtkCssStyle                  *parent_style,
+                                   const GtkCssNodeDeclaration  *decl,
+                                   gboolean                      is_first,
+                                   gboolean                      is_last,
+                                   const GtkCssNodeDeclaration **ancestors,
+                                   guint                         n_ancestors)
+{
+  SharedEntry *entry;
+
+  if (shared_cache == NULL)
+    return NULL;
+
+  shared_cache_stats.lookups++;
+
+  entry = gtk_css_shared_style_cache_find_entry (provider, parent_style, decl, is_first, is_last, ancestors, n_ancestors);
+  if (entry == NULL)
+    return NULL;
+
+  shared_cache_stats.hits++;
+
+  return entry->style;
+}
+
+/* Like gtk_css_shared_style_cache_lookup(), without counting as one */
+GtkCssStyle *
+gtk_css_shared_style_cache_peek (GtkStyleProvider             *provider,
+                                 GtkCssStyle                  *parent_style,
+                                 const GtkCssNodeDeclaration  *decl,
+                                 gboolean                      is_first,
+                                 gboolean                      is_last,
+                                 const GtkCssNodeDeclaration **ancestors,
+                                 guint                         n_ancestors)
+{
+  SharedEntry *entry;
+
+  if (shared_cache == NULL)
+    return NULL;
+
+  entry = gtk_css_shared_style_cache_find_entry (provider, parent_style, decl, is_first, is_last, ancestors, n_ancestors);
+  if (entry == NULL)
+    return NULL;
+
+  return entry->style;
+}
+
+static gboolean
+gtk_css_shared_style_cache_needs_ancestors (GtkCssStyle *style)
+{
+  GtkCssChange change = gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (style));
+
+  return (change & GTK_CSS_CHANGE_ANY_PARENT) != 0;
+}
+
+void
+gtk_css_shared_style_cache_insert (GtkStyleProvider             *provider,
+                                   GtkCssStyle                  *parent_style,
+                                   const GtkCssNodeDeclaration  *decl,
+                                   gboolean                      is_first,
+                                   gboolean                      is_last,
+                                   const GtkCssNodeDeclaration **ancestors,
+                                   guint                         n_ancestors,
+                                   GtkCssStyle                  *style)
+{
+  SharedEntry *entry;
+  GtkCssChange change;
+  guint i;
+
+  if (!may_be_stored_in_cache (style))
+    return;
+
+  /* Ancestor declarations don't tell us about their positions or siblings */
+  change = gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (style));
+  if (change & (GTK_CSS_CHANGE_PARENT_POSITION | GTK_CSS_CHANGE_PARENT_SIBLING_CLASS |
+                GTK_CSS_CHANGE_PARENT_SIBLING_ID | GTK_CSS_CHANGE_PARENT_SIBLING_NAME |
+                GTK_CSS_CHANGE_PARENT_SIBLING_POSITION | GTK_CSS_CHANGE_PARENT_SIBLING_STATE))
+    return;
+
+  if (!gtk_css_shared_style_cache_needs_ancestors (style))
+    n_ancestors = 0;
+  else if (n_ancestors == 0 || n_ancestors > SHARED_CACHE_MAX_ANCESTORS)
+    return;
+
+  if (shared_cache == NULL)
+    shared_cache = gtk_lru_cache_new (shared_entry_hash, shared_entry_equal, shared_entry_free,
+                                      SHARED_CACHE_MAX_SIZE, 0);
+
+  /* Entries don't keep their provider alive, so make sure they
+   * are gone before its address can be reused */
+  if (G_UNLIKELY (shared_cache_provider_quark == 0))
+    shared_cache_provider_quark = g_quark_from_static_string ("gtk-css-shared-style-cache");
+  if (g_object_get_qdata (G_OBJECT (provider), shared_cache_provider_quark) == NULL)
+    g_object_set_qdata_full (G_OBJECT (provider), shared_cache_provider_quark,
+                             provider, shared_cache_provider_finalized);
+
+  entry = g_slice_new0 (SharedEntry);
+
+  shared_entry_init_key (entry,
+                         provider,
+                         g_object_ref (parent_style),
+                         gtk_css_node_declaration_ref ((GtkCssNodeDeclaration *) decl),
+                         is_first,
+                         is_last,
+                         NULL,
+                         0);
+  if (n_ancestors > 0)
+    {
+      entry->ancestors = g_new (const GtkCssNodeDeclaration *, n_ancestors);
+      for (i = 0; i < n_ancestors; i++)
+        entry->ancestors[i] = gtk_css_node_declaration_ref ((GtkCssNodeDeclaration *) ancestors[i]);
+      shared_entry_init_key (entry, entry->provider, entry->parent_style, entry->decl,
+                             is_first, is_last, entry->ancestors, n_ancestors);
+      shared_cache_n_with_ancestors++;
+    }
+  entry->style = g_object_ref (style);
+
+  /* replaces an existing entry, if any */
+  shared_cache_stats.evictions += gtk_lru_cache_insert (shared_cache, entry, 0);
+  shared_cache_stats.inserts++;
+}
+
+/* Drops the styles computed with @provider, for when its
+ * rules changed or it goes away */
+void
+gtk_css_shared_style_cache_remove_provider (GtkStyleProvider *provider)
+{
+  if (shared_cache)
+    gtk_lru_cache_remove_matching (shared_cache, shared_entry_has_provider, provider);
+}
+
+void
+gtk_css_shared_style_cache_get_statistics (GtkCssSharedStyleCacheStatistics *stats)
+{
+  *stats = shared_cache_stats;
+  stats->size = shared_cache ? gtk_lru_cache_get_size (shared_cache) : 0;
+}
@@ -23,7 +23,20 @@
 
 G_BEGIN_DECLS
 
+/* The deepest node the shared style cache stores styles depending on
+ * their ancestors for */
+#define SHARED_CACHE_MAX_ANCESTORS 64
+
 typedef struct _GtkCssNodeStyleCache GtkCssNodeStyleCache;
+typedef struct _GtkCssSharedStyleCacheStatistics GtkCssSharedStyleCacheStatistics;
+
+struct _GtkCssSharedStyleCacheStatistics {
+  guint size;
+  guint lookups;
+  guint hits;
+  guint inserts;
+  guint evictions;
+};
 
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_new            (GtkCssStyle            *style);
 GtkCssNodeStyleCache *  gtk_css_node_style_cache_ref            (GtkCssNodeStyleCache   *cache);
@@ -41,6 +54,35 @@ GtkCssNodeStyleCache *  gtk_css_node_style_cache_lookup         (GtkCssNodeStyle
                                                                  gboolean                     is_first,
                                                                  gboolean                     is_last);
 
+GtkCssStyle *           gtk_css_shared_style_cache_lookup       (GtkStyleProvider             *provider,
+                                                                 GtkCssStyle                  *parent_style,
+                                                                 const GtkCssNodeDeclaration  *decl,
+                                                                 gboolean                      is_first,
+                                                                 gboolean                      is_last,
+                                                                 const GtkCssNodeDeclaration **ancestors,
+                                                                 guint                         n_ancestors);
+GtkCssStyle *           gtk_css_shared_style_cache_peek         (GtkStyleProvider             *provider,
+                                                                 GtkCssStyle                  *parent_style,
+                                                                 const GtkCssNodeDeclaration  *decl,
+                                                                 gboolean                      is_first,
+                                                                 gboolean                      is_last,
+                                                                 const GtkCssNodeDeclaration **ancestors,
+                                                                 guint                         n_ancestors);
+void                    gtk_css_shared_style_cache_insert       (GtkStyleProvider             *provider,
+                                                                 GtkCssStyle                  *parent_style,
+                                                                 const GtkCssNodeDeclaration  *decl,
+                                                                 gboolean                      is_first,
+                                                                 gboolean                      is_last,
+                                                                 const GtkCssNodeDeclaration **ancestors,
+                                                                 guint                         n_ancestors,
+                                                                 GtkCssStyle                  *style);
+void                    gtk_css_shared_style_cache_remove_provider
+                                                                (GtkStyleProvider             *provider);
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+void                    gtk_css_shared_style_cache_get_statistics
+                                                                (GtkCssSharedStyleCacheStatistics *stats);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_NODE_STYLE_CACHE_PRIVATE_H__ */
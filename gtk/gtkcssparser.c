@@ -35,6 +35,40 @@
 
 #define GTK_IS_CSS_PARSER(parser) ((parser) != NULL)
 
+/* Character classes, so the scanning loops need one table lookup per
+ * character instead of a strchr() over the allowed characters */
+enum {
+  CHAR_NEWLINE    = (1 << 0),
+  CHAR_WHITESPACE = (1 << 1),
+  CHAR_NMSTART    = (1 << 2),
+  CHAR_NMCHAR     = (1 << 3)
+};
+
+static guint8 char_classes[256];
+
+static void
+init_char_classes (void)
+{
+  static gsize initialized = 0;
+  const char *s;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+
+  for (s = NEWLINE_CHARS; *s; s++)
+    char_classes[(guchar) *s] |= CHAR_NEWLINE;
+  for (s = WHITESPACE_CHARS; *s; s++)
+    char_classes[(guchar) *s] |= CHAR_WHITESPACE;
+  for (s = NMSTART; *s; s++)
+    char_classes[(guchar) *s] |= CHAR_NMSTART;
+  for (s = NMCHAR; *s; s++)
+    char_classes[(guchar) *s] |= CHAR_NMCHAR;
+
+  g_once_init_leave (&initialized, 1);
+}
+
+#define CHAR_IS(c, class) (char_classes[(guchar) (c)] & (class))
+
 struct _GtkCssParser
 {
   const char            *data;
@@ -60,6 +94,8 @@ _gtk_css_parser_new (const char            *data,
   g_return_val_if_fail (data != NULL, NULL);
   g_return_val_if_fail (file == NULL || G_IS_FILE (file), NULL);
 
+  init_char_classes ();
+
   parser = g_slice_new0 (GtkCssParser);
 
   parser->data = data;
@@ -132,6 +168,15 @@ _gtk_css_parser_get_position (GtkCssParser *parser)
   return parser->data - parser->line_start;
 }
 
+/* The text that is still to be parsed */
+const char *
+_gtk_css_parser_get_data (GtkCssParser *parser)
+{
+  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+
+  return parser->data;
+}
+
 static GFile *
 gtk_css_parser_get_base_file (GtkCssParser *parser)
 {
@@ -244,30 +289,64 @@ gtk_css_parser_new_line (GtkCssParser *parser)
   return result;
 }
 
+/* Moves the parser forward to @end, which must not be past the
+ * terminating nul, and counts the lines on the way. Uses memchr()
+ * because that is vectorized in every libc worth using, so long
+ * runs of text are skipped a lot faster than byte by byte. */
+static void
+gtk_css_parser_advance_to (GtkCssParser *parser,
+                           const char   *end)
+{
+  const char *p;
+
+  for (p = parser->data; (p = memchr (p, '\n', end - p)); p++)
+    {
+      parser->line++;
+      parser->line_start = p + 1;
+    }
+
+  /* a \r on its own is a newline, too */
+  for (p = parser->data; (p = memchr (p, '\r', end - p)); p++)
+    {
+      if (p[1] == '\n')
+        continue;
+
+      parser->line++;
+      if (p + 1 > parser->line_start)
+        parser->line_start = p + 1;
+    }
+
+  parser->data = end;
+}
+
 static gboolean
 gtk_css_parser_skip_comment (GtkCssParser *parser)
 {
+  const char *end, *nested;
+
   if (parser->data[0] != '/' ||
       parser->data[1] != '*')
     return FALSE;
 
   parser->data += 2;
 
-  while (*parser->data)
-    {
-      gsize len = strcspn (parser->data, NEWLINE_CHARS "/");
+  end = strstr (parser->data, "*/");
+  if (end == NULL)
+    end = parser->data + strlen (parser->data);
 
-      parser->data += len;
-  
-      if (gtk_css_parser_new_line (parser))
-        continue;
+  /* the '/' of a nested comment may be right in front of the end */
+  while ((nested = g_strstr_len (parser->data, end - parser->data + 1, "/*")))
+    {
+      gtk_css_parser_advance_to (parser, nested + 1);
+      _gtk_css_parser_error (parser, "'/*' in comment block");
+    }
 
-      parser->data++;
+  gtk_css_parser_advance_to (parser, end);
 
-      if (len > 0 && parser->data[-2] == '*')
-        return TRUE;
-      if (parser->data[0] == '*')
-        _gtk_css_parser_error (parser, "'/*' in comment block");
+  if (*end)
+    {
+      parser->data += 2;
+      return TRUE;
     }
 
   /* FIXME: position */
@@ -275,24 +354,19 @@ gtk_css_parser_skip_comment (GtkCssParser *parser)
   return TRUE;
 }
 
+/* This is not vectorized like the comment scan: whitespace runs in CSS
+ * are an indentation of a few bytes between newlines, which have to be
+ * counted, so a wide compare would mostly stop in its first block. */
 void
 _gtk_css_parser_skip_whitespace (GtkCssParser *parser)
 {
-  size_t len;
-
-  while (*parser->data)
+  while (TRUE)
     {
-      if (gtk_css_parser_new_line (parser))
-        continue;
-
-      len = strspn (parser->data, WHITESPACE_CHARS);
-      if (len)
-        {
-          parser->data += len;
-          continue;
-        }
-      
-      if (!gtk_css_parser_skip_comment (parser))
+      if (CHAR_IS (*parser->data, CHAR_WHITESPACE))
+        parser->data++;
+      else if (CHAR_IS (*parser->data, CHAR_NEWLINE))
+        gtk_css_parser_new_line (parser);
+      else if (!gtk_css_parser_skip_comment (parser))
         break;
     }
 }
@@ -370,12 +444,12 @@ _gtk_css_parser_unescape (GtkCssParser *parser,
 static gboolean
 _gtk_css_parser_read_char (GtkCssParser *parser,
                            GString *     str,
-                           const char *  allowed)
+                           guint8        allowed)
 {
   if (*parser->data == 0)
     return FALSE;
 
-  if (strchr (allowed, *parser->data))
+  if (CHAR_IS (*parser->data, allowed))
     {
       g_string_append_c (str, *parser->data);
       parser->data++;
@@ -413,64 +487,190 @@ _gtk_css_parser_get_ident (GtkCssParser *parser)
   return result;
 }
 
-char *
-_gtk_css_parser_try_name (GtkCssParser *parser,
-                          gboolean      skip_whitespace)
+/* Reads a name, or an identifier if @ident is %TRUE.
+ *
+ * Nearly all names contain no escapes and no non-ASCII characters.
+ * Those are returned as a slice of the parser's data without copying
+ * them. All other names are unescaped into parser->ident_str and
+ * returned from there, use gtk_css_parser_dup_name() or
+ * gtk_css_parser_intern_name() to consume them.
+ */
+static gboolean
+gtk_css_parser_read_name (GtkCssParser  *parser,
+                          gboolean       ident,
+                          const char   **name,
+                          gsize         *len)
 {
-  GString *name;
+  const char *start, *p;
+  GString *str;
 
-  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+  start = parser->data;
+  p = start;
+
+  if (ident)
+    {
+      if (*p == '-')
+        p++;
+      if (!CHAR_IS (*p, CHAR_NMSTART))
+        goto unescape;
+      p++;
+    }
+
+  while (CHAR_IS (*p, CHAR_NMCHAR))
+    p++;
+
+  if (*p == '\\' || *p >= 127)
+    goto unescape;
 
+  parser->data = p;
+  *name = start;
+  *len = p - start;
+
+  return TRUE;
+
+unescape:
   if (parser->ident_str == NULL)
     parser->ident_str = g_string_new (NULL);
 
-  name = parser->ident_str;
+  str = parser->ident_str;
+
+  if (ident)
+    {
+      if (*parser->data == '-')
+        {
+          g_string_append_c (str, '-');
+          parser->data++;
+        }
 
-  while (_gtk_css_parser_read_char (parser, name, NMCHAR))
+      if (!_gtk_css_parser_read_char (parser, str, CHAR_NMSTART))
+        {
+          parser->data = start;
+          g_string_set_size (str, 0);
+          return FALSE;
+        }
+    }
+
+  while (_gtk_css_parser_read_char (parser, str, CHAR_NMCHAR))
     ;
 
+  *name = str->str;
+  *len = str->len;
+
+  return TRUE;
+}
+
+static char *
+gtk_css_parser_dup_name (GtkCssParser *parser,
+                         const char   *name,
+                         gsize         len)
+{
+  if (parser->ident_str && name == parser->ident_str->str)
+    return _gtk_css_parser_get_ident (parser);
+
+  return g_strndup (name, len);
+}
+
+static const char *
+gtk_css_parser_intern_name (GtkCssParser *parser,
+                            const char   *name,
+                            gsize         len)
+{
+  const char *result;
+  char buf[128];
+  char *tmp;
+
+  if (parser->ident_str && name == parser->ident_str->str)
+    {
+      result = g_intern_string (name);
+      g_string_set_size (parser->ident_str, 0);
+    }
+  else if (len < sizeof (buf))
+    {
+      memcpy (buf, name, len);
+      buf[len] = 0;
+      result = g_intern_string (buf);
+    }
+  else
+    {
+      tmp = g_strndup (name, len);
+      result = g_intern_string (tmp);
+      g_free (tmp);
+    }
+
+  return result;
+}
+
+char *
+_gtk_css_parser_try_name (GtkCssParser *parser,
+                          gboolean      skip_whitespace)
+{
+  const char *name;
+  gsize len;
+
+  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+
+  gtk_css_parser_read_name (parser, FALSE, &name, &len);
+
   if (skip_whitespace)
     _gtk_css_parser_skip_whitespace (parser);
 
-  return _gtk_css_parser_get_ident (parser);
+  return gtk_css_parser_dup_name (parser, name, len);
 }
 
 char *
 _gtk_css_parser_try_ident (GtkCssParser *parser,
                            gboolean      skip_whitespace)
 {
-  const char *start;
-  GString *ident;
+  const char *ident;
+  gsize len;
 
   g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
 
-  start = parser->data;
-  
-  if (parser->ident_str == NULL)
-    parser->ident_str = g_string_new (NULL);
+  if (!gtk_css_parser_read_name (parser, TRUE, &ident, &len))
+    return NULL;
 
-  ident = parser->ident_str;
+  if (skip_whitespace)
+    _gtk_css_parser_skip_whitespace (parser);
 
-  if (*parser->data == '-')
-    {
-      g_string_append_c (ident, '-');
-      parser->data++;
-    }
+  return gtk_css_parser_dup_name (parser, ident, len);
+}
 
-  if (!_gtk_css_parser_read_char (parser, ident, NMSTART))
-    {
-      parser->data = start;
-      g_string_set_size (ident, 0);
-      return NULL;
-    }
+/* Like _gtk_css_parser_try_name(), but returns an interned string.
+ * This avoids allocating for names that are interned anyway, like
+ * the names in selectors. */
+const char *
+_gtk_css_parser_try_name_interned (GtkCssParser *parser,
+                                   gboolean      skip_whitespace)
+{
+  const char *name;
+  gsize len;
 
-  while (_gtk_css_parser_read_char (parser, ident, NMCHAR))
-    ;
+  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+
+  gtk_css_parser_read_name (parser, FALSE, &name, &len);
+
+  if (skip_whitespace)
+    _gtk_css_parser_skip_whitespace (parser);
+
+  return gtk_css_parser_intern_name (parser, name, len);
+}
+
+const char *
+_gtk_css_parser_try_ident_interned (GtkCssParser *parser,
+                                    gboolean      skip_whitespace)
+{
+  const char *ident;
+  gsize len;
+
+  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+
+  if (!gtk_css_parser_read_name (parser, TRUE, &ident, &len))
+    return NULL;
 
   if (skip_whitespace)
     _gtk_css_parser_skip_whitespace (parser);
 
-  return _gtk_css_parser_get_ident (parser);
+  return gtk_css_parser_intern_name (parser, ident, len);
 }
 
 gboolean
@@ -509,6 +709,16 @@ _gtk_css_parser_read_string (GtkCssParser *parser)
     {
       gsize len = strcspn (parser->data, "\\'\"\n\r\f");
 
+      /* no escapes, no need to go through ident_str */
+      if (str->len == 0 && parser->data[len] == quote)
+        {
+          char *result = g_strndup (parser->data, len);
+
+          parser->data += len + 1;
+          _gtk_css_parser_skip_whitespace (parser);
+          return result;
+        }
+
       g_string_append_len (str, parser->data, len);
 
       parser->data += len;
@@ -669,7 +879,8 @@ gtk_css_dimension_value_parse (GtkCssParser           *parser,
     { "s",    GTK_CSS_S,       GTK_CSS_PARSE_TIME   },
     { "ms",   GTK_CSS_MS,      GTK_CSS_PARSE_TIME   }
   };
-  char *end, *unit_name;
+  const char *unit_name;
+  char *end;
   double value;
   GtkCssUnit unit;
 
@@ -697,7 +908,7 @@ gtk_css_dimension_value_parse (GtkCssParser           *parser,
       return NULL;
     }
 
-  unit_name = _gtk_css_parser_try_ident (parser, FALSE);
+  unit_name = _gtk_css_parser_try_ident_interned (parser, FALSE);
 
   if (unit_name)
     {
@@ -713,13 +924,10 @@ gtk_css_dimension_value_parse (GtkCssParser           *parser,
       if (i >= G_N_ELEMENTS (units))
         {
           _gtk_css_parser_error (parser, "'%s' is not a valid unit.", unit_name);
-          g_free (unit_name);
           return NULL;
         }
 
       unit = units[i].unit;
-
-      g_free (unit_name);
     }
   else
     {
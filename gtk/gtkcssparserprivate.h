@@ -47,6 +47,7 @@ void            _gtk_css_parser_error_full        (GtkCssParser          *parser
 
 guint           _gtk_css_parser_get_line          (GtkCssParser          *parser);
 guint           _gtk_css_parser_get_position      (GtkCssParser          *parser);
+const char *    _gtk_css_parser_get_data          (GtkCssParser          *parser);
 GFile *         _gtk_css_parser_get_file          (GtkCssParser          *parser);
 GFile *         _gtk_css_parser_get_file_for_path (GtkCssParser          *parser,
                                                    const char            *path);
@@ -73,6 +74,10 @@ char *          _gtk_css_parser_try_ident         (GtkCssParser          *parser
                                                    gboolean               skip_whitespace);
 char *          _gtk_css_parser_try_name          (GtkCssParser          *parser,
                                                    gboolean               skip_whitespace);
+const char *    _gtk_css_parser_try_ident_interned (GtkCssParser         *parser,
+                                                   gboolean               skip_whitespace);
+const char *    _gtk_css_parser_try_name_interned (GtkCssParser          *parser,
+                                                   gboolean               skip_whitespace);
 gboolean        _gtk_css_parser_try_int           (GtkCssParser          *parser,
                                                    int                   *value);
 gboolean        _gtk_css_parser_try_uint          (GtkCssParser          *parser,
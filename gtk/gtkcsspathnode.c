@@ -153,7 +153,7 @@ gtk_css_path_node_unset_context (GtkCssPathNode *node)
 
   node->context = NULL;
 
-  gtk_css_node_invalidate_style_provider (GTK_CSS_NODE (node));
+  gtk_css_node_invalidate_style_provider (GTK_CSS_NODE (node), NULL);
 }
 
 void
@@ -20,6 +20,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <glib/gstdio.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <cairo-gobject.h>
 
@@ -33,6 +35,7 @@
 #include "gtkcsssectionprivate.h"
 #include "gtkcssselectorprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
+#include "gtkcssstylepropertyprivate.h"
 #include "gtksettingsprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstylecontextprivate.h"
@@ -40,6 +43,7 @@
 #include "gtkstyleproviderprivate.h"
 #include "gtkwidgetpath.h"
 #include "gtkbindings.h"
+#include "gtkdebug.h"
 #include "gtkmarshalers.h"
 #include "gtkprivate.h"
 #include "gtkintl.h"
@@ -85,10 +89,59 @@ typedef enum ParserSymbol ParserSymbol;
 
 struct _PropertyValue {
   GtkCssStyleProperty *property;
-  GtkCssValue         *value;
+  GtkCssValue         *value; /* NULL until needed when loaded from the cache */
   GtkCssSection       *section;
+  guint                cache_index;
+
+  /* Where the value was parsed from, to write the cache */
+  GtkStyleProperty    *source; /* maybe a shorthand for property */
+  guint                source_index;
+  guint                source_offset;
+  guint                source_length;
+  guint                source_hash; /* of the text, to compare it on reload */
 };
 
+/* The theme cache, see gtk_css_provider_load_cache().
+ * All offsets are from the start of the file, strings are given
+ * as offsets into the string table.
+ */
+#define CACHE_MAGIC "GtkCssC1"
+#define CACHE_BYTE_ORDER 0x01020304
+#define CACHE_EMPTY_OFFSET G_MAXUINT32
+
+typedef struct {
+  char magic[8];
+  guint32 byte_order;
+  guint32 pointer_size;
+  guint32 version[3];
+  guint32 n_properties;
+  guint32 strings_offset, strings_len;
+  guint32 values_offset, n_values;
+  guint32 colors_offset, n_colors;
+  guint32 keyframes_offset, n_keyframes;
+  guint32 rulesets_offset, n_rulesets;
+  guint32 styles_offset, n_styles;
+  guint32 tree_offset, tree_len;
+} CacheHeader;
+
+typedef struct _CacheValue {
+  guint32 property; /* id of the style property */
+  guint32 source; /* name of the property that was parsed */
+  guint32 source_index; /* subproperty, if that is a shorthand */
+  guint32 text;
+} CacheValue;
+
+typedef struct {
+  guint32 name;
+  guint32 text;
+} CacheNamedValue;
+
+typedef struct {
+  guint32 first_style; /* rulesets with the same first_style share styles */
+  guint32 n_styles;
+  guint32 selector_match; /* offset into the tree */
+} CacheRuleset;
+
 struct GtkCssRuleset
 {
   GtkCssSelector *selector;
@@ -99,6 +152,15 @@ struct GtkCssRuleset
   guint owns_styles : 1;
 };
 
+typedef struct
+{
+  guint attempts;
+  guint matches;
+  guint restyles;
+  guint has_change : 1;
+  GtkCssChange change;
+} GtkCssRulesetProfile;
+
 struct _GtkCssScanner
 {
   GtkCssProvider *provider;
@@ -117,8 +179,28 @@ struct _GtkCssProviderPrivate
 
   GArray *rulesets;
   GtkCssSelectorTree *tree;
+  GtkCssSelectorReferences *references; /* created on demand */
   GResource *resource;
   gchar *path;
+
+  /* While loading a file that may be written to the theme cache */
+  guint cacheable : 1;
+  const char *source_text;
+  GHashTable *keyframes_sources;
+
+  /* When loaded from the theme cache */
+  GMappedFile *cache;
+  GFile *cache_file;
+  const char *cache_strings;
+  const CacheValue *cache_value_table;
+  GtkCssValue **cache_values;
+  guint n_cache_values;
+
+  /* While profiling, see gtk_css_provider_set_profiling() */
+  char *name;
+  GtkCssSelectorTreeProfile *tree_profile;
+  GtkCssRulesetProfile *ruleset_profiles;
+  guint profile_generation;
 };
 
 enum {
@@ -128,6 +210,11 @@ enum {
 
 static gboolean gtk_keep_css_sections = FALSE;
 
+static gboolean profiling = FALSE;
+static guint profiling_generation = 0;
+static GtkCssChange profiling_restyle = 0;
+static GList *profiled_providers = NULL;
+
 static guint css_provider_signals[LAST_SIGNAL] = { 0 };
 
 static void gtk_css_provider_finalize (GObject *object);
@@ -135,6 +222,15 @@ static void gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
 static void gtk_css_style_provider_emit_error (GtkStyleProvider *provider,
                                                GtkCssSection    *section,
                                                const GError     *error);
+static GtkCssValue *gtk_css_provider_get_value (GtkCssProvider *provider,
+                                                PropertyValue  *value);
+static void gtk_css_provider_clear_cache (GtkCssProvider *provider);
+static void gtk_css_ruleset_print (const GtkCssRuleset *ruleset,
+                                   GString             *str);
+static void gtk_css_provider_print_colors (GHashTable *colors,
+                                           GString    *str);
+static void gtk_css_provider_print_keyframes (GHashTable *keyframes,
+                                              GString    *str);
 
 static void
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
@@ -188,6 +284,115 @@ gtk_css_provider_set_keep_css_sections (void)
   gtk_keep_css_sections = TRUE;
 }
 
+/**
+ * gtk_css_provider_set_profiling:
+ * @enabled: whether to profile selector matching
+ *
+ * Turns the selector profiler on or off. Enabling it discards the
+ * numbers collected so far. The profiler counts for every selector
+ * of every provider how often it was tested and matched, the time
+ * spent on it and how often it caused a widget to be restyled.
+ */
+void
+gtk_css_provider_set_profiling (gboolean enabled)
+{
+  if (profiling == enabled)
+    return;
+
+  profiling = enabled;
+  if (enabled)
+    profiling_generation++;
+}
+
+gboolean
+gtk_css_provider_get_profiling (void)
+{
+  return profiling;
+}
+
+/**
+ * gtk_css_provider_profile_restyle:
+ * @change: the change that caused the restyle, or 0 after it
+ *
+ * Tells the profiler that the lookups until the next call are
+ * caused by @change, so selectors depending on it get blamed.
+ */
+void
+gtk_css_provider_profile_restyle (GtkCssChange change)
+{
+  profiling_restyle = change;
+}
+
+static void
+gtk_css_selector_profile_clear (gpointer data)
+{
+  GtkCssSelectorProfile *profile = data;
+
+  g_free (profile->selector);
+  g_free (profile->provider);
+}
+
+/**
+ * gtk_css_provider_get_profiles:
+ *
+ * Returns the numbers collected since profiling was enabled.
+ *
+ * Returns: (transfer full): a #GArray of #GtkCssSelectorProfile, one
+ *     for every selector that was tested at least once
+ */
+GArray *
+gtk_css_provider_get_profiles (void)
+{
+  GArray *profiles;
+  GList *l;
+  guint i;
+
+  profiles = g_array_new (FALSE, FALSE, sizeof (GtkCssSelectorProfile));
+  g_array_set_clear_func (profiles, gtk_css_selector_profile_clear);
+
+  for (l = profiled_providers; l; l = l->next)
+    {
+      GtkCssProvider *css_provider = l->data;
+      GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+      char *name;
+
+      if (priv->tree_profile == NULL || priv->profile_generation != profiling_generation)
+        continue;
+
+      if (priv->name)
+        name = g_strdup (priv->name);
+      else
+        name = g_strdup_printf ("%s %p", G_OBJECT_TYPE_NAME (css_provider), css_provider);
+
+      for (i = 0; i < priv->rulesets->len; i++)
+        {
+          GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+          GtkCssRulesetProfile *ruleset_profile = &priv->ruleset_profiles[i];
+          GtkCssSelectorProfile profile;
+          GString *str;
+
+          if (ruleset_profile->attempts == 0 || ruleset->selector_match == NULL)
+            continue;
+
+          str = g_string_new (NULL);
+          _gtk_css_selector_tree_match_print (ruleset->selector_match, str);
+
+          profile.selector = g_string_free (str, FALSE);
+          profile.provider = g_strdup (name);
+          profile.attempts = ruleset_profile->attempts;
+          profile.matches = ruleset_profile->matches;
+          profile.restyles = ruleset_profile->restyles;
+          profile.time = _gtk_css_selector_tree_profile_get_time (priv->tree_profile, ruleset->selector_match);
+
+          g_array_append_val (profiles, profile);
+        }
+
+      g_free (name);
+    }
+
+  return profiles;
+}
+
 static void
 gtk_css_provider_class_init (GtkCssProviderClass *klass)
 {
@@ -267,7 +472,7 @@ gtk_css_ruleset_clear (GtkCssRuleset *ruleset)
   memset (ruleset, 0, sizeof (GtkCssRuleset));
 }
 
-static void
+static PropertyValue *
 gtk_css_ruleset_add (GtkCssRuleset       *ruleset,
                      GtkCssStyleProperty *property,
                      GtkCssValue         *value,
@@ -275,7 +480,7 @@ gtk_css_ruleset_add (GtkCssRuleset       *ruleset,
 {
   guint i;
 
-  g_return_if_fail (ruleset->owns_styles || ruleset->n_styles == 0);
+  g_return_val_if_fail (ruleset->owns_styles || ruleset->n_styles == 0, NULL);
 
   if (ruleset->set_styles == NULL)
     ruleset->set_styles = _gtk_bitmask_new ();
@@ -310,6 +515,9 @@ gtk_css_ruleset_add (GtkCssRuleset       *ruleset,
     ruleset->styles[i].section = gtk_css_section_ref (section);
   else
     ruleset->styles[i].section = NULL;
+  ruleset->styles[i].source = NULL;
+
+  return &ruleset->styles[i];
 }
 
 static void
@@ -336,6 +544,11 @@ gtk_css_provider_emit_error (GtkCssProvider *provider,
                              GtkCssScanner  *scanner,
                              const GError   *error)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+
+  /* The cache would lose the error */
+  priv->cacheable = FALSE;
+
   gtk_css_style_provider_emit_error (GTK_STYLE_PROVIDER (provider),
                                      scanner ? scanner->section : NULL,
                                      error);
@@ -553,6 +766,64 @@ gtk_css_style_provider_get_keyframes (GtkStyleProvider *provider,
   return g_hash_table_lookup (priv->keyframes, name);
 }
 
+static void
+gtk_css_provider_profile_clear (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  g_clear_pointer (&priv->tree_profile, _gtk_css_selector_tree_profile_free);
+  g_clear_pointer (&priv->ruleset_profiles, g_free);
+}
+
+static void
+gtk_css_provider_profile_begin (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  if (priv->tree_profile && priv->profile_generation == profiling_generation)
+    return;
+
+  gtk_css_provider_profile_clear (css_provider);
+
+  priv->tree_profile = _gtk_css_selector_tree_profile_new ();
+  priv->ruleset_profiles = g_new0 (GtkCssRulesetProfile, priv->rulesets->len);
+  priv->profile_generation = profiling_generation;
+
+  if (g_list_find (profiled_providers, css_provider) == NULL)
+    profiled_providers = g_list_prepend (profiled_providers, css_provider);
+}
+
+static GtkCssRulesetProfile *
+gtk_css_provider_get_ruleset_profile (GtkCssProvider *css_provider,
+                                      GtkCssRuleset  *ruleset)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  return &priv->ruleset_profiles[ruleset - &g_array_index (priv->rulesets, GtkCssRuleset, 0)];
+}
+
+static void
+gtk_css_provider_profile_attempt (gpointer ruleset,
+                                  gpointer css_provider)
+{
+  GtkCssRulesetProfile *profile;
+
+  profile = gtk_css_provider_get_ruleset_profile (css_provider, ruleset);
+  profile->attempts++;
+
+  if (profiling_restyle == 0)
+    return;
+
+  if (!profile->has_change)
+    {
+      profile->change = _gtk_css_selector_tree_match_get_change (((GtkCssRuleset *) ruleset)->selector_match);
+      profile->has_change = TRUE;
+    }
+
+  if (profile->change & profiling_restyle)
+    profile->restyles++;
+}
+
 static void
 gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
                                const GtkCssMatcher *matcher,
@@ -565,12 +836,27 @@ gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
   guint j;
   int i;
   GPtrArray *tree_rules;
+  gint64 start = 0;
+
+  if (G_UNLIKELY (profiling))
+    {
+      start = g_get_monotonic_time ();
+      gtk_css_provider_profile_begin (css_provider);
+      tree_rules = _gtk_css_selector_tree_match_all_profiled (priv->tree, matcher, priv->tree_profile);
+    }
+  else
+    tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
 
-  tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
   if (tree_rules)
     {
       verify_tree_match_results (css_provider, matcher, tree_rules);
 
+      if (G_UNLIKELY (profiling))
+        {
+          for (j = 0; j < tree_rules->len; j++)
+            gtk_css_provider_get_ruleset_profile (css_provider, tree_rules->pdata[j])->matches++;
+        }
+
       for (i = tree_rules->len - 1; i >= 0; i--)
         {
           ruleset = tree_rules->pdata[i];
@@ -590,10 +876,18 @@ gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
               if (!_gtk_css_lookup_is_missing (lookup, id))
                 continue;
 
-              _gtk_css_lookup_set (lookup,
-                                   id,
-                                   ruleset->styles[j].section,
-                                  ruleset->styles[j].value);
+              /* Values from the theme cache are parsed on demand */
+              if (lookup->defer_values && ruleset->styles[j].value == NULL)
+                _gtk_css_lookup_set_deferred (lookup,
+                                              id,
+                                              ruleset->styles[j].section,
+                                              provider,
+                                              &ruleset->styles[j]);
+              else
+                _gtk_css_lookup_set (lookup,
+                                     id,
+                                     ruleset->styles[j].section,
+                                     gtk_css_provider_get_value (css_provider, &ruleset->styles[j]));
             }
 
           if (_gtk_bitmask_is_empty (_gtk_css_lookup_get_missing (lookup)))
@@ -612,6 +906,33 @@ gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
       *change = _gtk_css_selector_tree_get_change_all (priv->tree, &change_matcher);
       verify_tree_get_change_results (css_provider, &change_matcher, *change);
     }
+
+  if (G_UNLIKELY (profiling))
+    _gtk_css_selector_tree_profile_finish (priv->tree_profile,
+                                           g_get_monotonic_time () - start,
+                                           gtk_css_provider_profile_attempt,
+                                           css_provider);
+}
+
+static gboolean
+gtk_css_style_provider_references (GtkStyleProvider *provider,
+                                   GtkCssChange      change,
+                                   gconstpointer     value)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  if (priv->references == NULL)
+    priv->references = _gtk_css_selector_tree_get_references (priv->tree);
+
+  return _gtk_css_selector_references_contain (priv->references, change, value);
+}
+
+static GtkCssValue *
+gtk_css_style_provider_resolve_value (GtkStyleProvider *provider,
+                                      gpointer          deferred)
+{
+  return gtk_css_provider_get_value (GTK_CSS_PROVIDER (provider), deferred);
 }
 
 static void
@@ -621,6 +942,8 @@ gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_keyframes = gtk_css_style_provider_get_keyframes;
   iface->lookup = gtk_css_style_provider_lookup;
   iface->emit_error = gtk_css_style_provider_emit_error;
+  iface->references = gtk_css_style_provider_references;
+  iface->resolve_value = gtk_css_style_provider_resolve_value;
 }
 
 static void
@@ -635,10 +958,13 @@ gtk_css_provider_finalize (GObject *object)
 
   g_array_free (priv->rulesets, TRUE);
   _gtk_css_selector_tree_free (priv->tree);
+  _gtk_css_selector_references_free (priv->references);
 
   g_hash_table_destroy (priv->symbolic_colors);
   g_hash_table_destroy (priv->keyframes);
 
+  gtk_css_provider_clear_cache (css_provider);
+
   if (priv->resource)
     {
       g_resources_unregister (priv->resource);
@@ -648,6 +974,10 @@ gtk_css_provider_finalize (GObject *object)
 
   g_free (priv->path);
 
+  gtk_css_provider_profile_clear (css_provider);
+  profiled_providers = g_list_remove (profiled_providers, css_provider);
+  g_free (priv->name);
+
   G_OBJECT_CLASS (gtk_css_provider_parent_class)->finalize (object);
 }
 
@@ -745,12 +1075,31 @@ css_provider_commit (GtkCssProvider *css_provider,
   g_slist_free (selectors);
 }
 
+/* Drops the rules, but keeps where they were loaded from */
 static void
-gtk_css_provider_reset (GtkCssProvider *css_provider)
+gtk_css_provider_clear_rules (GtkCssProvider *css_provider)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
   guint i;
 
+  g_hash_table_remove_all (priv->symbolic_colors);
+  g_hash_table_remove_all (priv->keyframes);
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
+  g_array_set_size (priv->rulesets, 0);
+  _gtk_css_selector_tree_free (priv->tree);
+  priv->tree = NULL;
+  g_clear_pointer (&priv->references, _gtk_css_selector_references_free);
+
+  gtk_css_provider_clear_cache (css_provider);
+}
+
+static void
+gtk_css_provider_reset (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
   if (priv->resource)
     {
       g_resources_unregister (priv->resource);
@@ -764,15 +1113,10 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
       priv->path = NULL;
     }
 
-  g_hash_table_remove_all (priv->symbolic_colors);
-  g_hash_table_remove_all (priv->keyframes);
-
-  for (i = 0; i < priv->rulesets->len; i++)
-    gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
-  g_array_set_size (priv->rulesets, 0);
-  _gtk_css_selector_tree_free (priv->tree);
-  priv->tree = NULL;
+  g_clear_pointer (&priv->name, g_free);
+  gtk_css_provider_profile_clear (css_provider);
 
+  gtk_css_provider_clear_rules (css_provider);
 }
 
 static gboolean
@@ -901,6 +1245,7 @@ parse_color_definition (GtkCssScanner *scanner)
 static gboolean
 parse_binding_set (GtkCssScanner *scanner)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkBindingSet *binding_set;
   char *name;
 
@@ -912,6 +1257,9 @@ parse_binding_set (GtkCssScanner *scanner)
       return FALSE;
     }
 
+  /* Binding sets are global state the cache can't restore */
+  priv->cacheable = FALSE;
+
   name = _gtk_css_parser_try_ident (scanner->parser, TRUE);
   if (name == NULL)
     {
@@ -1011,6 +1359,7 @@ parse_keyframes (GtkCssScanner *scanner)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkCssKeyframes *keyframes;
+  const char *source;
   char *name;
 
   gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_KEYFRAMES);
@@ -1045,6 +1394,8 @@ parse_keyframes (GtkCssScanner *scanner)
       goto exit;
     }
 
+  source = _gtk_css_parser_get_data (scanner->parser);
+
   keyframes = _gtk_css_keyframes_parse (scanner->parser);
   if (keyframes == NULL)
     {
@@ -1055,7 +1406,14 @@ parse_keyframes (GtkCssScanner *scanner)
 
   g_hash_table_insert (priv->keyframes, name, keyframes);
 
-  if (!_gtk_css_parser_try (scanner->parser, "}", TRUE))
+  if (_gtk_css_parser_try (scanner->parser, "}", TRUE))
+    {
+      if (priv->keyframes_sources)
+        g_hash_table_insert (priv->keyframes_sources,
+                             g_strdup (name),
+                             g_strndup (source, _gtk_css_parser_get_data (scanner->parser) - source));
+    }
+  else
     {
       gtk_css_provider_error_literal (scanner->provider,
                                       scanner,
@@ -1122,6 +1480,39 @@ parse_selector_list (GtkCssScanner *scanner)
   return selectors;
 }
 
+static guint
+gtk_css_provider_hash_text (const char *text,
+                            gsize       length)
+{
+  guint hash = 5381;
+  gsize i;
+
+  for (i = 0; i < length; i++)
+    hash = (hash << 5) + hash + (guchar) text[i];
+
+  return hash;
+}
+
+/* Remembers where @value was parsed from, the parser is at its end */
+static void
+gtk_css_scanner_set_source (GtkCssScanner    *scanner,
+                            PropertyValue    *value,
+                            GtkStyleProperty *source,
+                            guint             index,
+                            const char       *start)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
+
+  if (priv->source_text == NULL || scanner->parent != NULL)
+    return;
+
+  value->source = source;
+  value->source_index = index;
+  value->source_offset = start - priv->source_text;
+  value->source_length = _gtk_css_parser_get_data (scanner->parser) - start;
+  value->source_hash = gtk_css_provider_hash_text (start, value->source_length);
+}
+
 static void
 parse_declaration (GtkCssScanner *scanner,
                    GtkCssRuleset *ruleset)
@@ -1149,11 +1540,13 @@ parse_declaration (GtkCssScanner *scanner,
   if (property)
     {
       GtkCssValue *value;
+      const char *source;
 
       g_free (name);
 
       gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_VALUE);
 
+      source = _gtk_css_parser_get_data (scanner->parser);
       value = _gtk_style_property_parse_value (property,
                                                scanner->parser);
 
@@ -1189,15 +1582,20 @@ parse_declaration (GtkCssScanner *scanner,
             {
               GtkCssStyleProperty *child = _gtk_css_shorthand_property_get_subproperty (shorthand, i);
               GtkCssValue *sub = _gtk_css_array_value_get_nth (value, i);
+              PropertyValue *added;
               
-              gtk_css_ruleset_add (ruleset, child, _gtk_css_value_ref (sub), scanner->section);
+              added = gtk_css_ruleset_add (ruleset, child, _gtk_css_value_ref (sub), scanner->section);
+              gtk_css_scanner_set_source (scanner, added, property, i, source);
             }
           
             _gtk_css_value_unref (value);
         }
       else if (GTK_IS_CSS_STYLE_PROPERTY (property))
         {
-          gtk_css_ruleset_add (ruleset, GTK_CSS_STYLE_PROPERTY (property), value, scanner->section);
+          PropertyValue *added;
+
+          added = gtk_css_ruleset_add (ruleset, GTK_CSS_STYLE_PROPERTY (property), value, scanner->section);
+          gtk_css_scanner_set_source (scanner, added, property, 0, source);
         }
       else
         {
@@ -1357,6 +1755,7 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
     }
 
   priv->tree = _gtk_css_selector_tree_builder_build (builder);
+  g_clear_pointer (&priv->references, _gtk_css_selector_references_free);
   _gtk_css_selector_tree_builder_free (builder);
 
 #ifndef VERIFY_TREE
@@ -1372,13 +1771,629 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
 #endif
 }
 
+/* THEME CACHE */
+
+/* Parsing a big theme takes a noticeable part of application startup,
+ * so the result of loading a file is written to a cache file, named
+ * after checksums of the file's location and contents. Writing it
+ * removes the caches of the file's earlier contents.
+ *
+ * The selector tree is stored as is, with its pointers replaced, see
+ * _gtk_css_selector_tree_serialize(). Values are stored as the text
+ * they were parsed from and only parsed when a lookup needs them, as
+ * most rules of a theme never match in a given application. The text
+ * is used instead of printing the values, as not all values print in
+ * a way that parses back to the same value.
+ *
+ * Colors defined with @define-color are the exception. They are stored
+ * printed and parsed again when the cache is loaded, as other colors
+ * may refer to them. Colors print in a way that parses back.
+ *
+ * The cache is not used for files with errors, imports or binding sets,
+ * when sections are kept for the inspector, or with GTK_DEBUG=no-css-cache.
+ */
+
+static gboolean
+gtk_css_provider_use_cache (void)
+{
+#ifdef VERIFY_TREE
+  /* The tree verification needs the selectors */
+  return FALSE;
+#else
+  if (gtk_keep_css_sections)
+    return FALSE;
+
+#ifdef G_ENABLE_DEBUG
+  if (GTK_DEBUG_CHECK (NO_CSS_CACHE))
+    return FALSE;
+#endif
+
+  return TRUE;
+#endif
+}
+
+/* Caches are named after the checksums of the file's URI and of its
+ * contents, so the caches of older contents can be found and removed.
+ */
+static char *
+gtk_css_provider_get_cache_path (GFile  *file,
+                                 GBytes *bytes)
+{
+  char *uri, *uri_checksum, *contents_checksum, *basename, *path;
+
+  uri = g_file_get_uri (file);
+  uri_checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  contents_checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+
+  basename = g_strconcat (uri_checksum, "-", contents_checksum, ".cache", NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", basename, NULL);
+
+  g_free (basename);
+  g_free (contents_checksum);
+  g_free (uri_checksum);
+  g_free (uri);
+
+  return path;
+}
+
+/* Removes the caches for other contents of the same file */
+static void
+gtk_css_provider_prune_cache (const char *path)
+{
+  char *dirname, *basename, *prefix;
+  const char *name;
+  GDir *dir;
+
+  dirname = g_path_get_dirname (path);
+  basename = g_path_get_basename (path);
+  prefix = g_strndup (basename, strchr (basename, '-') - basename + 1);
+
+  dir = g_dir_open (dirname, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          char *stale;
+
+          if (!g_str_has_prefix (name, prefix) ||
+              !g_str_has_suffix (name, ".cache") ||
+              strcmp (name, basename) == 0)
+            continue;
+
+          stale = g_build_filename (dirname, name, NULL);
+          g_unlink (stale);
+          g_free (stale);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_free (prefix);
+  g_free (basename);
+  g_free (dirname);
+}
+
+static void
+gtk_css_provider_clear_cache (GtkCssProvider *provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+  guint i;
+
+  for (i = 0; i < priv->n_cache_values; i++)
+    _gtk_css_value_unref (priv->cache_values[i]);
+  g_clear_pointer (&priv->cache_values, g_free);
+  priv->n_cache_values = 0;
+  priv->cache_value_table = NULL;
+  priv->cache_strings = NULL;
+
+  g_clear_pointer (&priv->cache, g_mapped_file_unref);
+  g_clear_object (&priv->cache_file);
+}
+
+static void
+gtk_css_provider_cache_parser_error (GtkCssParser *parser,
+                                     const GError *error,
+                                     gpointer      user_data)
+{
+  /* We only cache files that parsed without errors */
+}
+
+static GtkCssValue *
+gtk_css_provider_parse_cached_value (GtkCssProvider   *provider,
+                                     const CacheValue *cached)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+  GtkStyleProperty *source;
+  GtkCssParser *parser;
+  GtkCssValue *value;
+
+  source = _gtk_style_property_lookup (priv->cache_strings + cached->source);
+  if (source == NULL)
+    return NULL;
+
+  parser = _gtk_css_parser_new (priv->cache_strings + cached->text,
+                                priv->cache_file,
+                                gtk_css_provider_cache_parser_error,
+                                NULL);
+  value = _gtk_style_property_parse_value (source, parser);
+  _gtk_css_parser_free (parser);
+
+  if (value != NULL && GTK_IS_CSS_SHORTHAND_PROPERTY (source))
+    {
+      GtkCssShorthandProperty *shorthand = GTK_CSS_SHORTHAND_PROPERTY (source);
+      GtkCssValue *sub = NULL;
+
+      if (cached->source_index < _gtk_css_shorthand_property_get_n_subproperties (shorthand))
+        sub = _gtk_css_value_ref (_gtk_css_array_value_get_nth (value, cached->source_index));
+
+      _gtk_css_value_unref (value);
+      value = sub;
+    }
+
+  return value;
+}
+
+static GtkCssValue *
+gtk_css_provider_get_value (GtkCssProvider *provider,
+                            PropertyValue  *value)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+
+  if (G_LIKELY (value->value != NULL))
+    return value->value;
+
+  if (priv->cache_values[value->cache_index] == NULL)
+    {
+      GtkCssValue *parsed;
+
+      parsed = gtk_css_provider_parse_cached_value (provider, &priv->cache_value_table[value->cache_index]);
+      if (parsed == NULL)
+        {
+          g_warning ("Failed to parse %s value from the CSS cache",
+                     _gtk_style_property_get_name (GTK_STYLE_PROPERTY (value->property)));
+          parsed = _gtk_css_value_ref (_gtk_css_style_property_get_initial_value (value->property));
+        }
+
+      priv->cache_values[value->cache_index] = parsed;
+    }
+
+  value->value = _gtk_css_value_ref (priv->cache_values[value->cache_index]);
+
+  return value->value;
+}
+
+static gboolean
+cache_section_is_valid (gsize   size,
+                        guint32 offset,
+                        guint32 n_elements,
+                        gsize   element_size)
+{
+  return offset % 8 == 0 &&
+         offset <= size &&
+         n_elements <= (size - offset) / element_size;
+}
+
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *provider,
+                             GFile          *file,
+                             const char     *path)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+  const CacheHeader *header;
+  const CacheValue *values;
+  const CacheNamedValue *named;
+  const CacheRuleset *rulesets;
+  const guint32 *styles;
+  const char *data, *strings;
+  GHashTable *owners;
+  GMappedFile *cache;
+  gsize size;
+  guint n_properties;
+  guint i, j;
+
+  cache = g_mapped_file_new (path, FALSE, NULL);
+  if (cache == NULL)
+    return FALSE;
+
+  data = g_mapped_file_get_contents (cache);
+  size = g_mapped_file_get_length (cache);
+  header = (const CacheHeader *) data;
+  n_properties = _gtk_css_style_property_get_n_properties ();
+
+  if (size < sizeof (CacheHeader) ||
+      memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+      header->byte_order != CACHE_BYTE_ORDER ||
+      header->pointer_size != sizeof (gpointer) ||
+      header->version[0] != GTK_MAJOR_VERSION ||
+      header->version[1] != GTK_MINOR_VERSION ||
+      header->version[2] != GTK_MICRO_VERSION ||
+      header->n_properties != n_properties ||
+      !cache_section_is_valid (size, header->strings_offset, header->strings_len, 1) ||
+      !cache_section_is_valid (size, header->values_offset, header->n_values, sizeof (CacheValue)) ||
+      !cache_section_is_valid (size, header->colors_offset, header->n_colors, sizeof (CacheNamedValue)) ||
+      !cache_section_is_valid (size, header->keyframes_offset, header->n_keyframes, sizeof (CacheNamedValue)) ||
+      !cache_section_is_valid (size, header->rulesets_offset, header->n_rulesets, sizeof (CacheRuleset)) ||
+      !cache_section_is_valid (size, header->styles_offset, header->n_styles, sizeof (guint32)) ||
+      !cache_section_is_valid (size, header->tree_offset, header->tree_len, 1) ||
+      header->strings_len == 0 ||
+      data[header->strings_offset + header->strings_len - 1] != '\0')
+    {
+      g_mapped_file_unref (cache);
+      return FALSE;
+    }
+
+  strings = data + header->strings_offset;
+  values = (const CacheValue *) (data + header->values_offset);
+  styles = (const guint32 *) (data + header->styles_offset);
+  rulesets = (const CacheRuleset *) (data + header->rulesets_offset);
+
+  for (i = 0; i < header->n_values; i++)
+    {
+      if (values[i].property >= n_properties ||
+          values[i].source >= header->strings_len ||
+          values[i].text >= header->strings_len)
+        goto fail;
+    }
+
+  named = (const CacheNamedValue *) (data + header->colors_offset);
+  for (i = 0; i < header->n_colors; i++)
+    {
+      GtkCssParser *parser;
+      GtkCssValue *color;
+
+      if (named[i].name >= header->strings_len ||
+          named[i].text >= header->strings_len)
+        goto fail;
+
+      parser = _gtk_css_parser_new (strings + named[i].text, file,
+                                    gtk_css_provider_cache_parser_error, NULL);
+      color = _gtk_css_color_value_parse (parser);
+      _gtk_css_parser_free (parser);
+      if (color == NULL)
+        goto fail;
+
+      g_hash_table_insert (priv->symbolic_colors, g_strdup (strings + named[i].name), color);
+    }
+
+  named = (const CacheNamedValue *) (data + header->keyframes_offset);
+  for (i = 0; i < header->n_keyframes; i++)
+    {
+      GtkCssParser *parser;
+      GtkCssKeyframes *keyframes;
+
+      if (named[i].name >= header->strings_len ||
+          named[i].text >= header->strings_len)
+        goto fail;
+
+      parser = _gtk_css_parser_new (strings + named[i].text, file,
+                                    gtk_css_provider_cache_parser_error, NULL);
+      keyframes = _gtk_css_keyframes_parse (parser);
+      _gtk_css_parser_free (parser);
+      if (keyframes == NULL)
+        goto fail;
+
+      g_hash_table_insert (priv->keyframes, g_strdup (strings + named[i].name), keyframes);
+    }
+
+  /* The tree points into the array, so it must not move after this */
+  g_array_set_size (priv->rulesets, header->n_rulesets);
+  memset (priv->rulesets->data, 0, header->n_rulesets * sizeof (GtkCssRuleset));
+
+  owners = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < header->n_rulesets; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      GtkCssRuleset *owner;
+
+      if (rulesets[i].n_styles == 0)
+        continue;
+
+      if (rulesets[i].first_style > header->n_styles ||
+          rulesets[i].n_styles > header->n_styles - rulesets[i].first_style)
+        {
+          g_hash_table_unref (owners);
+          goto fail;
+        }
+
+      owner = g_hash_table_lookup (owners, GUINT_TO_POINTER (rulesets[i].first_style + 1));
+      if (owner && owner->n_styles == rulesets[i].n_styles)
+        {
+          ruleset->styles = owner->styles;
+          ruleset->n_styles = owner->n_styles;
+          ruleset->set_styles = _gtk_bitmask_copy (owner->set_styles);
+          continue;
+        }
+
+      ruleset->styles = g_new0 (PropertyValue, rulesets[i].n_styles);
+      ruleset->n_styles = rulesets[i].n_styles;
+      ruleset->owns_styles = TRUE;
+      ruleset->set_styles = _gtk_bitmask_new ();
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          guint32 index = styles[rulesets[i].first_style + j];
+
+          if (index >= header->n_values)
+            {
+              g_hash_table_unref (owners);
+              goto fail;
+            }
+
+          ruleset->styles[j].property = _gtk_css_style_property_lookup_by_id (values[index].property);
+          ruleset->styles[j].cache_index = index;
+          ruleset->set_styles = _gtk_bitmask_set (ruleset->set_styles, values[index].property, TRUE);
+        }
+
+      g_hash_table_insert (owners, GUINT_TO_POINTER (rulesets[i].first_style + 1), ruleset);
+    }
+  g_hash_table_unref (owners);
+
+  if (header->tree_len > 0)
+    {
+      priv->tree = _gtk_css_selector_tree_deserialize ((const guint8 *) data + header->tree_offset,
+                                                       header->tree_len,
+                                                       strings,
+                                                       header->strings_len,
+                                                       priv->rulesets->data,
+                                                       sizeof (GtkCssRuleset),
+                                                       header->n_rulesets);
+      if (priv->tree == NULL)
+        goto fail;
+    }
+  g_clear_pointer (&priv->references, _gtk_css_selector_references_free);
+
+  for (i = 0; i < header->n_rulesets; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+
+      if (rulesets[i].selector_match == CACHE_EMPTY_OFFSET)
+        continue;
+
+      if (rulesets[i].selector_match >= header->tree_len ||
+          rulesets[i].selector_match % sizeof (gpointer) != 0)
+        goto fail;
+
+      ruleset->selector_match = (GtkCssSelectorTree *) ((guint8 *) priv->tree + rulesets[i].selector_match);
+    }
+
+  priv->cache = cache;
+  priv->cache_file = g_object_ref (file);
+  priv->cache_strings = strings;
+  priv->cache_value_table = values;
+  priv->n_cache_values = header->n_values;
+  priv->cache_values = g_new0 (GtkCssValue *, header->n_values);
+
+  return TRUE;
+
+fail:
+  /* The file is parsed instead, which needs the name for errors */
+  gtk_css_provider_clear_rules (provider);
+  g_mapped_file_unref (cache);
+
+  return FALSE;
+}
+
+static guint32
+cache_add_string (GString    *strings,
+                  GHashTable *offsets,
+                  const char *string,
+                  gsize       len)
+{
+  gpointer offset;
+  char *key;
+
+  key = g_strndup (string, len);
+  if (g_hash_table_lookup_extended (offsets, key, NULL, &offset))
+    {
+      g_free (key);
+      return GPOINTER_TO_UINT (offset);
+    }
+
+  offset = GUINT_TO_POINTER (strings->len);
+  g_string_append_len (strings, key, len + 1);
+  g_hash_table_insert (offsets, key, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static guint32
+cache_append (GByteArray    *cache,
+              gconstpointer  data,
+              gsize          size)
+{
+  static const guint8 padding[8] = { 0, };
+  guint32 offset;
+
+  if (cache->len % 8)
+    g_byte_array_append (cache, padding, 8 - cache->len % 8);
+
+  offset = cache->len;
+  g_byte_array_append (cache, data, size);
+
+  return offset;
+}
+
+static void
+gtk_css_provider_save_cache (GtkCssProvider *provider,
+                             const char     *path)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (provider);
+  CacheHeader header = { CACHE_MAGIC, };
+  GHashTable *string_offsets, *value_indices, *first_styles;
+  GArray *values, *colors, *keyframes, *rulesets, *styles;
+  GHashTableIter iter;
+  gpointer key, item;
+  GByteArray *cache;
+  GString *strings;
+  GBytes *tree;
+  char *dir;
+  guint i, j;
+
+  strings = g_string_new (NULL);
+  string_offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  value_indices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  first_styles = g_hash_table_new (NULL, NULL);
+  values = g_array_new (FALSE, FALSE, sizeof (CacheValue));
+  colors = g_array_new (FALSE, FALSE, sizeof (CacheNamedValue));
+  keyframes = g_array_new (FALSE, FALSE, sizeof (CacheNamedValue));
+  rulesets = g_array_new (FALSE, FALSE, sizeof (CacheRuleset));
+  styles = g_array_new (FALSE, FALSE, sizeof (guint32));
+  cache = NULL;
+  tree = NULL;
+
+  g_hash_table_iter_init (&iter, priv->symbolic_colors);
+  while (g_hash_table_iter_next (&iter, &key, &item))
+    {
+      GString *text = g_string_new (NULL);
+      CacheNamedValue color;
+
+      _gtk_css_value_print (item, text);
+      color.name = cache_add_string (strings, string_offsets, key, strlen (key));
+      color.text = cache_add_string (strings, string_offsets, text->str, text->len);
+      g_array_append_val (colors, color);
+      g_string_free (text, TRUE);
+    }
+
+  g_hash_table_iter_init (&iter, priv->keyframes);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      const char *text = g_hash_table_lookup (priv->keyframes_sources, key);
+      CacheNamedValue keyframe;
+
+      if (text == NULL)
+        goto out;
+
+      keyframe.name = cache_add_string (strings, string_offsets, key, strlen (key));
+      keyframe.text = cache_add_string (strings, string_offsets, text, strlen (text));
+      g_array_append_val (keyframes, keyframe);
+    }
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      CacheRuleset cached;
+
+      cached.n_styles = ruleset->n_styles;
+      if (ruleset->selector_match)
+        cached.selector_match = (guint8 *) ruleset->selector_match - (guint8 *) priv->tree;
+      else
+        cached.selector_match = CACHE_EMPTY_OFFSET;
+
+      if (ruleset->n_styles == 0)
+        cached.first_style = 0;
+      else if (g_hash_table_lookup_extended (first_styles, ruleset->styles, NULL, &item))
+        cached.first_style = GPOINTER_TO_UINT (item);
+      else
+        {
+          cached.first_style = styles->len;
+          g_hash_table_insert (first_styles, ruleset->styles, GUINT_TO_POINTER (cached.first_style));
+
+          for (j = 0; j < ruleset->n_styles; j++)
+            {
+              PropertyValue *prop = &ruleset->styles[j];
+              const char *source_name;
+              guint32 index;
+              char *value_key;
+
+              if (prop->source == NULL)
+                goto out;
+
+              source_name = _gtk_style_property_get_name (prop->source);
+              value_key = g_strdup_printf ("%s %u %.*s",
+                                           source_name, prop->source_index,
+                                           prop->source_length, priv->source_text + prop->source_offset);
+
+              if (g_hash_table_lookup_extended (value_indices, value_key, NULL, &item))
+                {
+                  index = GPOINTER_TO_UINT (item);
+                  g_free (value_key);
+                }
+              else
+                {
+                  CacheValue value;
+
+                  value.property = _gtk_css_style_property_get_id (prop->property);
+                  value.source = cache_add_string (strings, string_offsets, source_name, strlen (source_name));
+                  value.source_index = prop->source_index;
+                  value.text = cache_add_string (strings, string_offsets,
+                                                 priv->source_text + prop->source_offset,
+                                                 prop->source_length);
+
+                  index = values->len;
+                  g_array_append_val (values, value);
+                  g_hash_table_insert (value_indices, value_key, GUINT_TO_POINTER (index));
+                }
+
+              g_array_append_val (styles, index);
+            }
+        }
+
+      g_array_append_val (rulesets, cached);
+    }
+
+  tree = _gtk_css_selector_tree_serialize (priv->tree,
+                                           priv->rulesets->data,
+                                           sizeof (GtkCssRuleset),
+                                           strings);
+
+  header.byte_order = CACHE_BYTE_ORDER;
+  header.pointer_size = sizeof (gpointer);
+  header.version[0] = GTK_MAJOR_VERSION;
+  header.version[1] = GTK_MINOR_VERSION;
+  header.version[2] = GTK_MICRO_VERSION;
+  header.n_properties = _gtk_css_style_property_get_n_properties ();
+
+  cache = g_byte_array_new ();
+  cache_append (cache, &header, sizeof (header));
+
+  header.strings_len = strings->len;
+  header.strings_offset = cache_append (cache, strings->str, strings->len);
+  header.n_values = values->len;
+  header.values_offset = cache_append (cache, values->data, values->len * sizeof (CacheValue));
+  header.n_colors = colors->len;
+  header.colors_offset = cache_append (cache, colors->data, colors->len * sizeof (CacheNamedValue));
+  header.n_keyframes = keyframes->len;
+  header.keyframes_offset = cache_append (cache, keyframes->data, keyframes->len * sizeof (CacheNamedValue));
+  header.n_rulesets = rulesets->len;
+  header.rulesets_offset = cache_append (cache, rulesets->data, rulesets->len * sizeof (CacheRuleset));
+  header.n_styles = styles->len;
+  header.styles_offset = cache_append (cache, styles->data, styles->len * sizeof (guint32));
+  header.tree_len = g_bytes_get_size (tree);
+  header.tree_offset = cache_append (cache, g_bytes_get_data (tree, NULL), header.tree_len);
+
+  memcpy (cache->data, &header, sizeof (header));
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0755) == 0 &&
+      g_file_set_contents (path, (const char *) cache->data, cache->len, NULL))
+    gtk_css_provider_prune_cache (path);
+  g_free (dir);
+
+out:
+  if (cache)
+    g_byte_array_unref (cache);
+  if (tree)
+    g_bytes_unref (tree);
+  g_array_unref (styles);
+  g_array_unref (rulesets);
+  g_array_unref (keyframes);
+  g_array_unref (colors);
+  g_array_unref (values);
+  g_hash_table_unref (first_styles);
+  g_hash_table_unref (value_indices);
+  g_hash_table_unref (string_offsets);
+  g_string_free (strings, TRUE);
+}
+
 static void
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GtkCssScanner  *parent,
                                 GFile          *file,
                                 const char     *text)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
   GtkCssScanner *scanner;
+  char *cache_path = NULL;
   GBytes *bytes;
 
   if (text == NULL)
@@ -1426,8 +2441,38 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
       bytes = NULL;
     }
 
+  if (parent == NULL && file)
+    {
+      g_free (priv->name);
+      priv->name = g_file_get_parse_name (file);
+    }
+
+  if (parent == NULL && bytes && gtk_css_provider_use_cache ())
+    {
+      cache_path = gtk_css_provider_get_cache_path (file, bytes);
+
+      if (gtk_css_provider_load_cache (css_provider, file, cache_path))
+        {
+          g_free (cache_path);
+          g_bytes_unref (bytes);
+          return;
+        }
+    }
+
   if (text)
     {
+      if (parent == NULL)
+        {
+          priv->cacheable = TRUE;
+          priv->source_text = text;
+          priv->keyframes_sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        }
+      else
+        {
+          /* The cache has no notion of imported files */
+          priv->cacheable = FALSE;
+        }
+
       scanner = gtk_css_scanner_new (css_provider,
                                      parent,
                                      parent ? parent->section : NULL,
@@ -1439,13 +2484,272 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
       gtk_css_scanner_destroy (scanner);
 
       if (parent == NULL)
-        gtk_css_provider_postprocess (css_provider);
+        {
+          gtk_css_provider_postprocess (css_provider);
+
+          if (cache_path && priv->cacheable)
+            gtk_css_provider_save_cache (css_provider, cache_path);
+
+          priv->source_text = NULL;
+          g_clear_pointer (&priv->keyframes_sources, g_hash_table_unref);
+        }
     }
 
+  g_free (cache_path);
   if (bytes)
     g_bytes_unref (bytes);
 }
 
+/* Reloading
+ *
+ * A reload often changes only a few rules, for example when editing a
+ * stylesheet. The rulesets are compared before and after the reload, so
+ * that only the nodes matching the selectors of added, removed or
+ * modified rulesets need a new style.
+ *
+ * Rulesets are compared by their selector and hashes of the text their
+ * declarations were parsed from, so values that are still unparsed in
+ * the theme cache stay that way, and the text itself needn't be kept.
+ */
+
+typedef struct {
+  char *definitions;   /* colors and keyframes */
+  GPtrArray *rulesets; /* rulesets as text, in cascading order */
+} GtkCssProviderSnapshot;
+
+/* Uses the format of the value keys of gtk_css_provider_save_cache(),
+ * with the text hashed */
+static void
+gtk_css_provider_print_unparsed (GtkCssProvider *css_provider,
+                                 PropertyValue  *value,
+                                 GString        *str)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  if (priv->cache)
+    {
+      const CacheValue *cached = &priv->cache_value_table[value->cache_index];
+
+      const char *text = priv->cache_strings + cached->text;
+
+      g_string_append_printf (str, "%s %u %08x",
+                              priv->cache_strings + cached->source,
+                              cached->source_index,
+                              gtk_css_provider_hash_text (text, strlen (text)));
+    }
+  else if (value->source)
+    {
+      g_string_append_printf (str, "%s %u %08x",
+                              _gtk_style_property_get_name (value->source),
+                              value->source_index,
+                              value->source_hash);
+    }
+  else
+    {
+      /* From an imported file, these are parsed right away */
+      g_string_append (str, _gtk_style_property_get_name (GTK_STYLE_PROPERTY (value->property)));
+      g_string_append (str, ": ");
+      _gtk_css_value_print (value->value, str);
+    }
+}
+
+static GtkCssProviderSnapshot *
+gtk_css_provider_snapshot_new (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GtkCssProviderSnapshot *snapshot;
+  GString *str;
+  guint i, j;
+
+  snapshot = g_slice_new (GtkCssProviderSnapshot);
+
+  str = g_string_new (NULL);
+  gtk_css_provider_print_colors (priv->symbolic_colors, str);
+  gtk_css_provider_print_keyframes (priv->keyframes, str);
+  snapshot->definitions = g_string_free (str, FALSE);
+
+  snapshot->rulesets = g_ptr_array_new_full (priv->rulesets->len, g_free);
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+
+      str = g_string_new (NULL);
+      _gtk_css_selector_tree_match_print (ruleset->selector_match, str);
+      g_string_append (str, " {\n");
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          g_string_append (str, "  ");
+          gtk_css_provider_print_unparsed (css_provider, &ruleset->styles[j], str);
+          g_string_append (str, ";\n");
+        }
+      g_string_append (str, "}\n");
+      g_ptr_array_add (snapshot->rulesets, g_string_free (str, FALSE));
+    }
+
+  return snapshot;
+}
+
+static void
+gtk_css_provider_snapshot_free (GtkCssProviderSnapshot *snapshot)
+{
+  g_free (snapshot->definitions);
+  g_ptr_array_unref (snapshot->rulesets);
+  g_slice_free (GtkCssProviderSnapshot, snapshot);
+}
+
+/* Returns NULL if a ruleset is in @snapshot twice */
+static GHashTable *
+gtk_css_provider_snapshot_get_set (GtkCssProviderSnapshot *snapshot)
+{
+  GHashTable *set;
+  guint i;
+
+  set = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < snapshot->rulesets->len; i++)
+    {
+      if (!g_hash_table_add (set, snapshot->rulesets->pdata[i]))
+        {
+          g_hash_table_unref (set);
+          return NULL;
+        }
+    }
+
+  return set;
+}
+
+static void
+ignore_parser_error (GtkCssParser *parser,
+                     const GError *error,
+                     gpointer      user_data)
+{
+}
+
+/* Builds a tree from the selectors of the rulesets in @changed */
+static GtkCssSelectorTree *
+gtk_css_provider_build_changed_tree (GPtrArray *changed)
+{
+  GtkCssSelectorTreeBuilder *builder;
+  GtkCssSelectorTree *tree, **matches;
+  GPtrArray *selectors;
+  guint i;
+
+  builder = _gtk_css_selector_tree_builder_new ();
+  selectors = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_css_selector_free);
+  matches = g_new (GtkCssSelectorTree *, changed->len);
+  tree = NULL;
+
+  for (i = 0; i < changed->len; i++)
+    {
+      const char *text = changed->pdata[i];
+      GtkCssSelector *selector;
+      GtkCssParser *parser;
+      char *selector_text;
+
+      selector_text = g_strndup (text, strstr (text, " {") - text);
+      parser = _gtk_css_parser_new (selector_text, NULL, ignore_parser_error, NULL);
+      selector = _gtk_css_selector_parse (parser);
+      _gtk_css_parser_free (parser);
+      g_free (selector_text);
+
+      if (selector == NULL)
+        goto out;
+
+      g_ptr_array_add (selectors, selector);
+      _gtk_css_selector_tree_builder_add (builder, selector, &matches[i], &matches[i]);
+    }
+
+  tree = _gtk_css_selector_tree_builder_build (builder);
+
+out:
+  _gtk_css_selector_tree_builder_free (builder);
+  g_ptr_array_unref (selectors);
+  g_free (matches);
+
+  return tree;
+}
+
+/* Emits the changed signal for the difference between @old and the
+ * current contents of the provider. */
+static void
+gtk_css_provider_changed_since (GtkCssProvider         *css_provider,
+                                GtkCssProviderSnapshot *old)
+{
+  GtkCssProviderSnapshot *new;
+  GHashTable *old_set, *new_set;
+  GtkCssSelectorTree *tree;
+  GPtrArray *changed;
+  guint i, j;
+
+  if (old == NULL)
+    {
+      gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+      return;
+    }
+
+  new = gtk_css_provider_snapshot_new (css_provider);
+  old_set = gtk_css_provider_snapshot_get_set (old);
+  new_set = gtk_css_provider_snapshot_get_set (new);
+  changed = g_ptr_array_new ();
+  tree = NULL;
+
+  if (old_set == NULL || new_set == NULL ||
+      !g_str_equal (old->definitions, new->definitions))
+    goto everything;
+
+  /* The rulesets in both snapshots must keep their order, or they
+   * might cascade differently. */
+  for (i = 0, j = 0; ; i++, j++)
+    {
+      while (i < old->rulesets->len && !g_hash_table_contains (new_set, old->rulesets->pdata[i]))
+        g_ptr_array_add (changed, old->rulesets->pdata[i++]);
+      while (j < new->rulesets->len && !g_hash_table_contains (old_set, new->rulesets->pdata[j]))
+        g_ptr_array_add (changed, new->rulesets->pdata[j++]);
+
+      if (i >= old->rulesets->len || j >= new->rulesets->len)
+        break;
+
+      if (!g_str_equal (old->rulesets->pdata[i], new->rulesets->pdata[j]))
+        goto everything;
+    }
+
+  if (changed->len == 0)
+    goto out;
+
+  /* Matching a big tree against every node is no cheaper than restyling */
+  if (changed->len > MAX (old->rulesets->len, new->rulesets->len) / 2)
+    goto everything;
+
+  tree = gtk_css_provider_build_changed_tree (changed);
+  if (tree == NULL)
+    goto everything;
+
+  gtk_style_provider_changed_selectors (GTK_STYLE_PROVIDER (css_provider), tree);
+  goto out;
+
+everything:
+  gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+
+out:
+  _gtk_css_selector_tree_free (tree);
+  g_ptr_array_unref (changed);
+  g_clear_pointer (&old_set, g_hash_table_unref);
+  g_clear_pointer (&new_set, g_hash_table_unref);
+  gtk_css_provider_snapshot_free (new);
+}
+
+/* Only worth it if something may have been styled with the old rules */
+static GtkCssProviderSnapshot *
+gtk_css_provider_snapshot_for_reload (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  if (priv->rulesets->len == 0)
+    return NULL;
+
+  return gtk_css_provider_snapshot_new (css_provider);
+}
+
 /**
  * gtk_css_provider_load_from_data:
  * @css_provider: a #GtkCssProvider
@@ -1462,6 +2766,7 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
                                  const gchar     *data,
                                  gssize           length)
 {
+  GtkCssProviderSnapshot *snapshot;
   char *free_data;
 
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
@@ -1478,13 +2783,17 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
       data = free_data;
     }
 
+  snapshot = gtk_css_provider_snapshot_for_reload (css_provider);
+
   gtk_css_provider_reset (css_provider);
 
   gtk_css_provider_load_internal (css_provider, NULL, NULL, data);
 
   g_free (free_data);
 
-  gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+  gtk_css_provider_changed_since (css_provider, snapshot);
+  if (snapshot)
+    gtk_css_provider_snapshot_free (snapshot);
 }
 
 /**
@@ -1499,14 +2808,20 @@ void
 gtk_css_provider_load_from_file (GtkCssProvider  *css_provider,
                                  GFile           *file)
 {
+  GtkCssProviderSnapshot *snapshot;
+
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
   g_return_if_fail (G_IS_FILE (file));
 
+  snapshot = gtk_css_provider_snapshot_for_reload (css_provider);
+
   gtk_css_provider_reset (css_provider);
 
   gtk_css_provider_load_internal (css_provider, NULL, file, NULL);
 
-  gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+  gtk_css_provider_changed_since (css_provider, snapshot);
+  if (snapshot)
+    gtk_css_provider_snapshot_free (snapshot);
 }
 
 /**
@@ -1959,9 +3274,15 @@ gtk_css_provider_to_string (GtkCssProvider *provider)
 
   for (i = 0; i < priv->rulesets->len; i++)
     {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      guint j;
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        gtk_css_provider_get_value (provider, &ruleset->styles[j]);
+
       if (str->len != 0)
         g_string_append (str, "\n");
-      gtk_css_ruleset_print (&g_array_index (priv->rulesets, GtkCssRuleset, i), str);
+      gtk_css_ruleset_print (ruleset, str);
     }
 
   return g_string_free (str, FALSE);
@@ -19,6 +19,7 @@
 #define __GTK_CSS_PROVIDER_PRIVATE_H__
 
 #include "gtkcssprovider.h"
+#include "gtkcsstypesprivate.h"
 
 G_BEGIN_DECLS
 
@@ -32,6 +33,23 @@ void   _gtk_css_provider_load_named    (GtkCssProvider *provider,
 
 void   gtk_css_provider_set_keep_css_sections (void);
 
+typedef struct {
+  char *selector;
+  char *provider;
+  guint attempts;    /* lookups that tested the selector's last node */
+  guint matches;
+  guint restyles;    /* restyles the selector's change flags asked for */
+  double time;       /* estimated share of lookup time, in microseconds */
+} GtkCssSelectorProfile;
+
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+void     gtk_css_provider_set_profiling   (gboolean      enabled);
+gboolean gtk_css_provider_get_profiling   (void);
+void     gtk_css_provider_profile_restyle (GtkCssChange  change);
+GDK_AVAILABLE_IN_ALL
+GArray * gtk_css_provider_get_profiles    (void);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_PROVIDER_PRIVATE_H__ */
@@ -926,9 +926,9 @@ parse_selector_class (GtkCssParser   *parser,
                       GtkCssSelector *selector,
                       gboolean        negate)
 {
-  char *name;
+  const char *name;
     
-  name = _gtk_css_parser_try_name (parser, FALSE);
+  name = _gtk_css_parser_try_name_interned (parser, FALSE);
 
   if (name == NULL)
     {
@@ -941,9 +941,7 @@ parse_selector_class (GtkCssParser   *parser,
   selector = gtk_css_selector_new (negate ? &GTK_CSS_SELECTOR_NOT_CLASS
                                           : &GTK_CSS_SELECTOR_CLASS,
                                    selector);
-  selector->style_class.style_class = g_quark_from_string (name);
-
-  g_free (name);
+  selector->style_class.style_class = g_quark_from_static_string (name);
 
   return selector;
 }
@@ -953,9 +951,9 @@ parse_selector_id (GtkCssParser   *parser,
                    GtkCssSelector *selector,
                    gboolean        negate)
 {
-  char *name;
+  const char *name;
     
-  name = _gtk_css_parser_try_name (parser, FALSE);
+  name = _gtk_css_parser_try_name_interned (parser, FALSE);
 
   if (name == NULL)
     {
@@ -968,9 +966,7 @@ parse_selector_id (GtkCssParser   *parser,
   selector = gtk_css_selector_new (negate ? &GTK_CSS_SELECTOR_NOT_ID
                                           : &GTK_CSS_SELECTOR_ID,
                                    selector);
-  selector->id.name = g_intern_string (name);
-
-  g_free (name);
+  selector->id.name = name;
 
   return selector;
 }
@@ -1169,15 +1165,14 @@ static GtkCssSelector *
 parse_selector_negation (GtkCssParser   *parser,
                          GtkCssSelector *selector)
 {
-  char *name;
+  const char *name;
 
-  name = _gtk_css_parser_try_ident (parser, FALSE);
+  name = _gtk_css_parser_try_ident_interned (parser, FALSE);
   if (name)
     {
       selector = gtk_css_selector_new (&GTK_CSS_SELECTOR_NOT_NAME,
                                        selector);
-      selector->name.name = g_intern_string (name);
-      g_free (name);
+      selector->name.name = name;
     }
   else if (_gtk_css_parser_try (parser, "*", FALSE))
     selector = gtk_css_selector_new (&GTK_CSS_SELECTOR_NOT_ANY, selector);
@@ -1213,14 +1208,13 @@ parse_simple_selector (GtkCssParser   *parser,
                        GtkCssSelector *selector)
 {
   gboolean parsed_something = FALSE;
-  char *name;
+  const char *name;
 
-  name = _gtk_css_parser_try_ident (parser, FALSE);
+  name = _gtk_css_parser_try_ident_interned (parser, FALSE);
   if (name)
     {
       selector = gtk_css_selector_new (&GTK_CSS_SELECTOR_NAME, selector);
-      selector->name.name = g_intern_string (name);
-      g_free (name);
+      selector->name.name = name;
       parsed_something = TRUE;
     }
   else if (_gtk_css_parser_try (parser, "*", FALSE))
@@ -1476,23 +1470,103 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
   return (GtkCssSelector *)gtk_css_selector_previous (selector);
 }
 
+/* Checks if the first selector of an ancestor's compound selector can
+ * possibly match any of the ancestors in @filter */
+static gboolean
+gtk_css_selector_may_match_ancestor (const GtkCssSelector       *selector,
+                                     const GtkCssAncestorFilter *filter)
+{
+  if (selector->class == &GTK_CSS_SELECTOR_NAME)
+    return gtk_css_ancestor_filter_may_contain (filter, gtk_css_ancestor_filter_hash_name (selector->name.name));
+  else if (selector->class == &GTK_CSS_SELECTOR_CLASS)
+    return gtk_css_ancestor_filter_may_contain (filter, gtk_css_ancestor_filter_hash_class (selector->style_class.style_class));
+  else if (selector->class == &GTK_CSS_SELECTOR_ID)
+    return gtk_css_ancestor_filter_may_contain (filter, gtk_css_ancestor_filter_hash_id (selector->id.name));
+  else
+    return TRUE;
+}
+
+typedef struct {
+  GPtrArray *matches;
+  GtkCssSelectorTreeProfile *profile;
+} GtkCssSelectorTreeMatch;
+
+static gboolean gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
+                                                     const GtkCssMatcher  *matcher,
+                                                     gpointer              res);
+
+/* Like gtk_css_selector_descendant_foreach_matcher(), but skips the
+ * subtrees that the ancestor filter rules out before walking up */
+static void
+gtk_css_selector_tree_match_descendant (const GtkCssSelectorTree *tree,
+                                        const GtkCssMatcher      *matcher,
+                                        gpointer                  res)
+{
+  const GtkCssAncestorFilter *filter;
+  const GtkCssSelectorTree *prev;
+  GtkCssMatcher ancestor;
+
+  filter = _gtk_css_matcher_get_ancestor_filter (matcher);
+  if (filter == NULL)
+    {
+      gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+      return;
+    }
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    {
+      if (gtk_css_selector_may_match_ancestor (&prev->selector, filter))
+        break;
+    }
+
+  if (prev == NULL)
+    return;
+
+  while (_gtk_css_matcher_get_parent (&ancestor, matcher))
+    {
+      matcher = &ancestor;
+
+      for (prev = gtk_css_selector_tree_get_previous (tree);
+           prev != NULL;
+           prev = gtk_css_selector_tree_get_sibling (prev))
+        {
+          if (gtk_css_selector_may_match_ancestor (&prev->selector, filter))
+            gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+        }
+
+      if (_gtk_css_matcher_matches_any (matcher))
+        break;
+    }
+}
+
 static gboolean
 gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
                                      const GtkCssMatcher  *matcher,
                                      gpointer              res)
 {
   const GtkCssSelectorTree *tree = (const GtkCssSelectorTree *) selector;
+  GtkCssSelectorTreeMatch *match = res;
   const GtkCssSelectorTree *prev;
 
+  if (G_UNLIKELY (match->profile))
+    g_ptr_array_add (match->profile->tested, (gpointer) tree);
+
   if (!gtk_css_selector_match (selector, matcher))
     return FALSE;
 
-  gtk_css_selector_tree_found_match (tree, res);
+  gtk_css_selector_tree_found_match (tree, &match->matches);
 
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    {
+      if (prev->selector.class == &GTK_CSS_SELECTOR_DESCENDANT)
+        gtk_css_selector_tree_match_descendant (prev, matcher, res);
+      else
+        gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    }
 
   return FALSE;
 }
@@ -1501,13 +1575,281 @@ GPtrArray *
 _gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
 				  const GtkCssMatcher *matcher)
 {
-  GPtrArray *array = NULL;
+  GtkCssSelectorTreeMatch match = { NULL, NULL };
+
+  for (; tree != NULL;
+       tree = gtk_css_selector_tree_get_sibling (tree))
+    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &match);
+
+  return match.matches;
+}
+
+static void
+gtk_css_selector_tree_add_references (const GtkCssSelectorTree *tree,
+                                      GtkCssSelectorReferences *references)
+{
+  const GtkCssSelectorClass *class;
+
+  for (; tree != NULL; tree = gtk_css_selector_tree_get_sibling (tree))
+    {
+      class = tree->selector.class;
+
+      if (class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        g_hash_table_add (references->classes, GUINT_TO_POINTER (tree->selector.style_class.style_class));
+      else if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+        g_hash_table_add (references->names, (gpointer) tree->selector.name.name);
+      else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+        g_hash_table_add (references->ids, (gpointer) tree->selector.id.name);
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE || class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        references->states |= tree->selector.state.state;
+
+      gtk_css_selector_tree_add_references (gtk_css_selector_tree_get_previous (tree), references);
+    }
+}
+
+/**
+ * _gtk_css_selector_tree_get_references:
+ * @tree: (allow-none): the tree
+ *
+ * Collects the classes, names, ids and states that any selector in
+ * @tree checks for. Nodes can change anything else without their
+ * style being affected.
+ *
+ * Returns: a new #GtkCssSelectorReferences
+ */
+GtkCssSelectorReferences *
+_gtk_css_selector_tree_get_references (const GtkCssSelectorTree *tree)
+{
+  GtkCssSelectorReferences *references;
+
+  references = g_slice_new (GtkCssSelectorReferences);
+  references->classes = g_hash_table_new (NULL, NULL);
+  references->names = g_hash_table_new (NULL, NULL);
+  references->ids = g_hash_table_new (NULL, NULL);
+  references->states = 0;
+
+  gtk_css_selector_tree_add_references (tree, references);
+
+  return references;
+}
+
+void
+_gtk_css_selector_references_free (GtkCssSelectorReferences *references)
+{
+  if (references == NULL)
+    return;
+
+  g_hash_table_unref (references->classes);
+  g_hash_table_unref (references->names);
+  g_hash_table_unref (references->ids);
+  g_slice_free (GtkCssSelectorReferences, references);
+}
+
+gboolean
+_gtk_css_selector_references_contain (const GtkCssSelectorReferences *references,
+                                      GtkCssChange                    change,
+                                      gconstpointer                   value)
+{
+  switch (change)
+    {
+    case GTK_CSS_CHANGE_CLASS:
+      return g_hash_table_contains (references->classes, value);
+    case GTK_CSS_CHANGE_NAME:
+      return g_hash_table_contains (references->names, value);
+    case GTK_CSS_CHANGE_ID:
+      return g_hash_table_contains (references->ids, value);
+    case GTK_CSS_CHANGE_STATE:
+      return (references->states & GPOINTER_TO_UINT (value)) != 0;
+    default:
+      return TRUE;
+    }
+}
+
+/* Profiling
+ *
+ * The tree shares the work of matching between all selectors that have
+ * a common suffix, so there is no cost per selector to measure. Instead
+ * the profile records which nodes were tested during a match. The time
+ * of the whole match is split evenly between those tests, and the time
+ * of each node is split evenly between the selectors going through it.
+ */
+
+typedef struct {
+  guint n_matches; /* selectors going through this node, 0 if not counted yet */
+  double time;
+} GtkCssSelectorTreeNodeProfile;
+
+struct _GtkCssSelectorTreeProfile {
+  GHashTable *nodes;
+  GPtrArray *tested; /* nodes tested since the last finish */
+};
+
+GtkCssSelectorTreeProfile *
+_gtk_css_selector_tree_profile_new (void)
+{
+  GtkCssSelectorTreeProfile *profile;
+
+  profile = g_slice_new (GtkCssSelectorTreeProfile);
+  profile->nodes = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  profile->tested = g_ptr_array_new ();
+
+  return profile;
+}
+
+void
+_gtk_css_selector_tree_profile_free (GtkCssSelectorTreeProfile *profile)
+{
+  if (profile == NULL)
+    return;
+
+  g_hash_table_unref (profile->nodes);
+  g_ptr_array_unref (profile->tested);
+  g_slice_free (GtkCssSelectorTreeProfile, profile);
+}
+
+static GtkCssSelectorTreeNodeProfile *
+gtk_css_selector_tree_profile_get_node (GtkCssSelectorTreeProfile *profile,
+                                        const GtkCssSelectorTree  *tree)
+{
+  GtkCssSelectorTreeNodeProfile *node;
+
+  node = g_hash_table_lookup (profile->nodes, tree);
+  if (node == NULL)
+    {
+      node = g_new0 (GtkCssSelectorTreeNodeProfile, 1);
+      g_hash_table_insert (profile->nodes, (gpointer) tree, node);
+    }
+
+  return node;
+}
+
+GPtrArray *
+_gtk_css_selector_tree_match_all_profiled (const GtkCssSelectorTree  *tree,
+                                           const GtkCssMatcher       *matcher,
+                                           GtkCssSelectorTreeProfile *profile)
+{
+  GtkCssSelectorTreeMatch match = { NULL, profile };
 
   for (; tree != NULL;
        tree = gtk_css_selector_tree_get_sibling (tree))
-    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &match);
+
+  return match.matches;
+}
+
+/**
+ * _gtk_css_selector_tree_profile_finish:
+ * @profile: the profile
+ * @time: the time the match took, including the work done with the result
+ * @attempt_func: called with the match of each selector whose last
+ *     node was tested
+ * @user_data: data for @attempt_func
+ *
+ * Accounts the nodes tested since the last call.
+ */
+void
+_gtk_css_selector_tree_profile_finish (GtkCssSelectorTreeProfile *profile,
+                                       double                     time,
+                                       GFunc                      attempt_func,
+                                       gpointer                   user_data)
+{
+  GtkCssSelectorTreeNodeProfile *node;
+  const GtkCssSelectorTree *tree;
+  gpointer *matches;
+  double share;
+  guint i, j;
+
+  if (profile->tested->len == 0)
+    return;
+
+  share = time / profile->tested->len;
+
+  for (i = 0; i < profile->tested->len; i++)
+    {
+      tree = g_ptr_array_index (profile->tested, i);
+
+      node = gtk_css_selector_tree_profile_get_node (profile, tree);
+      node->time += share;
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          for (j = 0; matches[j] != NULL; j++)
+            attempt_func (matches[j], user_data);
+        }
+    }
+
+  g_ptr_array_set_size (profile->tested, 0);
+}
+
+static guint
+gtk_css_selector_tree_count_matches (GtkCssSelectorTreeProfile *profile,
+                                     const GtkCssSelectorTree  *tree)
+{
+  GtkCssSelectorTreeNodeProfile *node;
+  const GtkCssSelectorTree *prev;
+  gpointer *matches;
+  guint i;
+
+  node = gtk_css_selector_tree_profile_get_node (profile, tree);
+  if (node->n_matches)
+    return node->n_matches;
 
-  return array;
+  matches = gtk_css_selector_tree_get_matches (tree);
+  if (matches)
+    {
+      for (i = 0; matches[i] != NULL; i++)
+        node->n_matches++;
+    }
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    node->n_matches += gtk_css_selector_tree_count_matches (profile, prev);
+
+  return node->n_matches;
+}
+
+/**
+ * _gtk_css_selector_tree_profile_get_time:
+ * @profile: the profile
+ * @selector_match: the last node of a selector, as returned by
+ *     _gtk_css_selector_tree_builder_add()
+ *
+ * Returns: the share of the profiled time spent on the selector
+ */
+double
+_gtk_css_selector_tree_profile_get_time (GtkCssSelectorTreeProfile *profile,
+                                         const GtkCssSelectorTree  *selector_match)
+{
+  GtkCssSelectorTreeNodeProfile *node;
+  const GtkCssSelectorTree *tree;
+  double time = 0;
+
+  for (tree = selector_match; tree; tree = gtk_css_selector_tree_get_parent (tree))
+    {
+      node = g_hash_table_lookup (profile->nodes, tree);
+      if (node == NULL || node->time == 0)
+        continue;
+
+      time += node->time / gtk_css_selector_tree_count_matches (profile, tree);
+    }
+
+  return time;
+}
+
+/* The change of the selector ending at @selector_match,
+ * see _gtk_css_selector_get_change() */
+GtkCssChange
+_gtk_css_selector_tree_match_get_change (const GtkCssSelectorTree *selector_match)
+{
+  const GtkCssSelectorTree *tree;
+  GtkCssChange change = 0;
+
+  for (tree = selector_match; tree; tree = gtk_css_selector_tree_get_parent (tree))
+    change = tree->selector.class->get_change (&tree->selector, change);
+
+  return change;
 }
 
 /* When checking for changes via the tree we need to know if a rule further
@@ -1903,3 +2245,312 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/* SERIALIZATION */
+
+/* The tree is a single block of memory that only refers to itself by
+ * offsets, so all it takes to store it is to replace the pointers in
+ * it: selector classes by their index in this table, names and style
+ * classes by offsets into a string table and matches by their index.
+ * The index is stored plus one, so 0 still terminates a match list.
+ */
+static const GtkCssSelectorClass *selector_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION,
+};
+
+static gsize
+gtk_css_selector_tree_get_size (const GtkCssSelectorTree *tree,
+                                const guint8             *data)
+{
+  gsize size = 0;
+
+  while (tree != NULL)
+    {
+      gpointer *matches;
+
+      size = MAX (size, (const guint8 *) tree - data + sizeof (GtkCssSelectorTree));
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          guint i;
+
+          for (i = 0; matches[i] != NULL; i++)
+            ;
+          size = MAX (size, (const guint8 *) &matches[i + 1] - data);
+        }
+
+      size = MAX (size, gtk_css_selector_tree_get_size (gtk_css_selector_tree_get_previous (tree), data));
+
+      tree = gtk_css_selector_tree_get_sibling (tree);
+    }
+
+  return size;
+}
+
+static gsize
+add_string (GString    *strings,
+            GHashTable *offsets,
+            const char *string)
+{
+  gpointer offset;
+
+  if (!g_hash_table_lookup_extended (offsets, string, NULL, &offset))
+    {
+      offset = GSIZE_TO_POINTER (strings->len);
+      g_hash_table_insert (offsets, (gpointer) string, offset);
+      g_string_append_len (strings, string, strlen (string) + 1);
+    }
+
+  return GPOINTER_TO_SIZE (offset);
+}
+
+static void
+serialize_trees (GtkCssSelectorTree *tree,
+                 gconstpointer       matches_base,
+                 gsize               match_size,
+                 GString            *strings,
+                 GHashTable         *offsets)
+{
+  while (tree != NULL)
+    {
+      GtkCssSelector *selector = &tree->selector;
+      gpointer *matches;
+      guint i;
+
+      if (selector->class == &GTK_CSS_SELECTOR_NAME ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        selector->name.name = GSIZE_TO_POINTER (add_string (strings, offsets, selector->name.name));
+      else if (selector->class == &GTK_CSS_SELECTOR_ID ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_ID)
+        selector->id.name = GSIZE_TO_POINTER (add_string (strings, offsets, selector->id.name));
+      else if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        selector->style_class.style_class = add_string (strings, offsets, g_quark_to_string (selector->style_class.style_class));
+
+      for (i = 0; i < G_N_ELEMENTS (selector_classes); i++)
+        {
+          if (selector->class == selector_classes[i])
+            break;
+        }
+      g_assert (i < G_N_ELEMENTS (selector_classes));
+      selector->class = GUINT_TO_POINTER (i);
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          for (i = 0; matches[i] != NULL; i++)
+            matches[i] = GSIZE_TO_POINTER (((const guint8 *) matches[i] - (const guint8 *) matches_base) / match_size + 1);
+        }
+
+      serialize_trees ((GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree),
+                       matches_base, match_size, strings, offsets);
+
+      tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree);
+    }
+}
+
+/*
+ * _gtk_css_selector_tree_serialize:
+ * @tree: (nullable): a tree
+ * @matches_base: the array the matches passed to the builder are elements of
+ * @match_size: the size of an element of that array
+ * @strings: string table to add names to
+ *
+ * Returns: the tree in a form that can be stored and restored with
+ *     _gtk_css_selector_tree_deserialize() by the same build of GTK.
+ */
+GBytes *
+_gtk_css_selector_tree_serialize (const GtkCssSelectorTree *tree,
+                                  gconstpointer             matches_base,
+                                  gsize                     match_size,
+                                  GString                  *strings)
+{
+  GHashTable *offsets;
+  guint8 *data;
+  gsize size;
+
+  if (tree == NULL)
+    return g_bytes_new (NULL, 0);
+
+  size = gtk_css_selector_tree_get_size (tree, (const guint8 *) tree);
+  data = g_memdup (tree, size);
+
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  serialize_trees ((GtkCssSelectorTree *) data, matches_base, match_size, strings, offsets);
+  g_hash_table_unref (offsets);
+
+  return g_bytes_new_take (data, size);
+}
+
+static gboolean
+deserialize_string (gpointer    *target,
+                    const char  *strings,
+                    gsize        strings_len)
+{
+  gsize offset = GPOINTER_TO_SIZE (*target);
+
+  if (offset >= strings_len)
+    return FALSE;
+
+  *target = (gpointer) g_intern_string (strings + offset);
+  return TRUE;
+}
+
+#define TREE_ALIGNMENT ((gint32) sizeof (gpointer))
+
+static gboolean
+deserialize_trees (GtkCssSelectorTree *tree,
+                   guint8             *data,
+                   gsize               len,
+                   const char         *strings,
+                   gsize               strings_len,
+                   gpointer            matches_base,
+                   gsize               match_size,
+                   guint               n_matches)
+{
+  while (tree != NULL)
+    {
+      GtkCssSelector *selector = &tree->selector;
+      gsize offset = (guint8 *) tree - data;
+      gpointer *matches;
+      guint i;
+
+      if (offset + sizeof (GtkCssSelectorTree) > len)
+        return FALSE;
+
+      /* Children and siblings are always stored after their node, so
+       * checking that keeps us from looping on a broken tree */
+      if ((tree->previous_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           (tree->previous_offset <= 0 || tree->previous_offset > len - offset)) ||
+          (tree->sibling_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           (tree->sibling_offset <= 0 || tree->sibling_offset > len - offset)) ||
+          (tree->parent_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           (tree->parent_offset >= 0 || -tree->parent_offset > offset)) ||
+          (tree->matches_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           (tree->matches_offset <= 0 || tree->matches_offset > len - offset)))
+        return FALSE;
+
+      /* The nodes and the matches are made of pointers and are cast
+       * to them, so @data has them all at multiples of their size */
+      if ((tree->previous_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           tree->previous_offset % TREE_ALIGNMENT != 0) ||
+          (tree->sibling_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           tree->sibling_offset % TREE_ALIGNMENT != 0) ||
+          (tree->parent_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           tree->parent_offset % TREE_ALIGNMENT != 0) ||
+          (tree->matches_offset != GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET &&
+           tree->matches_offset % TREE_ALIGNMENT != 0))
+        return FALSE;
+
+      i = GPOINTER_TO_UINT (selector->class);
+      if (i >= G_N_ELEMENTS (selector_classes))
+        return FALSE;
+      selector->class = selector_classes[i];
+
+      if (selector->class == &GTK_CSS_SELECTOR_NAME ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        {
+          if (!deserialize_string ((gpointer *) &selector->name.name, strings, strings_len))
+            return FALSE;
+        }
+      else if (selector->class == &GTK_CSS_SELECTOR_ID ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_ID)
+        {
+          if (!deserialize_string ((gpointer *) &selector->id.name, strings, strings_len))
+            return FALSE;
+        }
+      else if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        {
+          if (selector->style_class.style_class >= strings_len)
+            return FALSE;
+          selector->style_class.style_class = g_quark_from_string (strings + selector->style_class.style_class);
+        }
+
+      matches = gtk_css_selector_tree_get_matches (tree);
+      if (matches)
+        {
+          for (i = 0; ; i++)
+            {
+              gsize index;
+
+              if ((guint8 *) &matches[i + 1] - data > len)
+                return FALSE;
+              if (matches[i] == NULL)
+                break;
+
+              index = GPOINTER_TO_SIZE (matches[i]);
+              if (index > n_matches)
+                return FALSE;
+              matches[i] = (guint8 *) matches_base + (index - 1) * match_size;
+            }
+        }
+
+      if (!deserialize_trees ((GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree),
+                              data, len, strings, strings_len,
+                              matches_base, match_size, n_matches))
+        return FALSE;
+
+      tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree);
+    }
+
+  return TRUE;
+}
+
+/*
+ * _gtk_css_selector_tree_deserialize:
+ * @data: data returned by _gtk_css_selector_tree_serialize()
+ * @len: length of @data
+ * @strings: the string table passed to _gtk_css_selector_tree_serialize()
+ * @strings_len: length of @strings, including the final nul
+ * @matches_base: the array the matches are now elements of
+ * @match_size: the size of an element of that array
+ * @n_matches: the number of elements in that array
+ *
+ * Returns: the restored tree, or %NULL if @data is empty or broken.
+ *     Use @len to tell these apart.
+ */
+GtkCssSelectorTree *
+_gtk_css_selector_tree_deserialize (const guint8 *data,
+                                    gsize         len,
+                                    const char   *strings,
+                                    gsize         strings_len,
+                                    gpointer      matches_base,
+                                    gsize         match_size,
+                                    guint         n_matches)
+{
+  guint8 *tree;
+
+  if (len < sizeof (GtkCssSelectorTree) ||
+      len >= GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET ||
+      strings_len == 0 || strings[strings_len - 1] != '\0')
+    return NULL;
+
+  tree = g_memdup (data, len);
+
+  if (!deserialize_trees ((GtkCssSelectorTree *) tree, tree, len,
+                          strings, strings_len,
+                          matches_base, match_size, n_matches))
+    {
+      g_free (tree);
+      return NULL;
+    }
+
+  return (GtkCssSelectorTree *) tree;
+}
@@ -26,6 +26,14 @@ G_BEGIN_DECLS
 typedef union _GtkCssSelector GtkCssSelector;
 typedef struct _GtkCssSelectorTree GtkCssSelectorTree;
 typedef struct _GtkCssSelectorTreeBuilder GtkCssSelectorTreeBuilder;
+typedef struct _GtkCssSelectorTreeProfile GtkCssSelectorTreeProfile;
+
+typedef struct {
+  GHashTable *classes;  /* GQuarks */
+  GHashTable *names;    /* interned strings */
+  GHashTable *ids;      /* interned strings */
+  GtkStateFlags states;
+} GtkCssSelectorReferences;
 
 GtkCssSelector *  _gtk_css_selector_parse           (GtkCssParser           *parser);
 void              _gtk_css_selector_free            (GtkCssSelector         *selector);
@@ -47,6 +55,26 @@ GtkCssChange _gtk_css_selector_tree_get_change_all   (const GtkCssSelectorTree *
 						      const GtkCssMatcher *matcher);
 void         _gtk_css_selector_tree_match_print      (const GtkCssSelectorTree *tree,
 						      GString                  *str);
+GtkCssChange _gtk_css_selector_tree_match_get_change (const GtkCssSelectorTree *selector_match);
+
+GtkCssSelectorReferences *_gtk_css_selector_tree_get_references (const GtkCssSelectorTree       *tree);
+void                      _gtk_css_selector_references_free     (GtkCssSelectorReferences       *references);
+gboolean                  _gtk_css_selector_references_contain  (const GtkCssSelectorReferences *references,
+                                                                 GtkCssChange                    change,
+                                                                 gconstpointer                   value);
+
+GtkCssSelectorTreeProfile *_gtk_css_selector_tree_profile_new     (void);
+void                       _gtk_css_selector_tree_profile_free    (GtkCssSelectorTreeProfile *profile);
+GPtrArray *                _gtk_css_selector_tree_match_all_profiled
+                                                                  (const GtkCssSelectorTree  *tree,
+                                                                   const GtkCssMatcher       *matcher,
+                                                                   GtkCssSelectorTreeProfile *profile);
+void                       _gtk_css_selector_tree_profile_finish  (GtkCssSelectorTreeProfile *profile,
+                                                                   double                     time,
+                                                                   GFunc                      attempt_func,
+                                                                   gpointer                   user_data);
+double                     _gtk_css_selector_tree_profile_get_time (GtkCssSelectorTreeProfile *profile,
+                                                                   const GtkCssSelectorTree  *selector_match);
 
 
 GtkCssSelectorTreeBuilder *_gtk_css_selector_tree_builder_new   (void);
@@ -57,6 +85,18 @@ void                       _gtk_css_selector_tree_builder_add   (GtkCssSelectorT
 GtkCssSelectorTree *       _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder);
 void                       _gtk_css_selector_tree_builder_free  (GtkCssSelectorTreeBuilder *builder);
 
+GBytes *                   _gtk_css_selector_tree_serialize     (const GtkCssSelectorTree  *tree,
+                                                                 gconstpointer              matches_base,
+                                                                 gsize                      match_size,
+                                                                 GString                   *strings);
+GtkCssSelectorTree *       _gtk_css_selector_tree_deserialize   (const guint8              *data,
+                                                                 gsize                      len,
+                                                                 const char                *strings,
+                                                                 gsize                      strings_len,
+                                                                 gpointer                   matches_base,
+                                                                 gsize                      match_size,
+                                                                 guint                      n_matches);
+
 const char *gtk_css_pseudoclass_name (GtkStateFlags flags);
 
 G_END_DECLS
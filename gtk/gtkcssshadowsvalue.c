@@ -113,6 +113,18 @@ gtk_css_value_shadows_equal (const GtkCssValue *value1,
   return TRUE;
 }
 
+static guint
+gtk_css_value_shadows_hash (const GtkCssValue *value)
+{
+  guint i, hash;
+
+  hash = value->len;
+  for (i = 0; i < value->len; i++)
+    hash = hash * 31 + gtk_css_value_hash (value->values[i]);
+
+  return hash;
+}
+
 static GtkCssValue *
 gtk_css_value_shadows_transition (GtkCssValue *start,
                                   GtkCssValue *end,
@@ -199,6 +211,12 @@ gtk_css_value_shadows_print (const GtkCssValue *value,
     }
 }
 
+static gsize
+gtk_css_value_shadows_get_size (const GtkCssValue *value)
+{
+  return sizeof (GtkCssValue) + sizeof (GtkCssValue *) * (MAX (value->len, 1) - 1);
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_SHADOWS = {
   gtk_css_value_shadows_free,
   gtk_css_value_shadows_compute,
@@ -206,7 +224,9 @@ static const GtkCssValueClass GTK_CSS_VALUE_SHADOWS = {
   gtk_css_value_shadows_transition,
   NULL,
   NULL,
-  gtk_css_value_shadows_print
+  gtk_css_value_shadows_print,
+  gtk_css_value_shadows_hash,
+  gtk_css_value_shadows_get_size
 };
 
 static GtkCssValue none_singleton = { &GTK_CSS_VALUE_SHADOWS, 1, 0, { NULL } };
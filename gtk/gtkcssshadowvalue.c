@@ -109,6 +109,20 @@ gtk_css_value_shadow_equal (const GtkCssValue *shadow1,
       && _gtk_css_value_equal (shadow1->color, shadow2->color);
 }
 
+static guint
+gtk_css_value_shadow_hash (const GtkCssValue *shadow)
+{
+  guint hash;
+
+  hash = gtk_css_value_hash (shadow->hoffset);
+  hash = hash * 31 + gtk_css_value_hash (shadow->voffset);
+  hash = hash * 31 + gtk_css_value_hash (shadow->radius);
+  hash = hash * 31 + gtk_css_value_hash (shadow->spread);
+  hash = hash * 31 + gtk_css_value_hash (shadow->color);
+
+  return hash ^ shadow->inset;
+}
+
 static GtkCssValue *
 gtk_css_value_shadow_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -154,6 +168,12 @@ gtk_css_value_shadow_print (const GtkCssValue *shadow,
 
 }
 
+static gsize
+gtk_css_value_shadow_get_size (const GtkCssValue *value)
+{
+  return sizeof (GtkCssValue);
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_SHADOW = {
   gtk_css_value_shadow_free,
   gtk_css_value_shadow_compute,
@@ -161,7 +181,9 @@ static const GtkCssValueClass GTK_CSS_VALUE_SHADOW = {
   gtk_css_value_shadow_transition,
   NULL,
   NULL,
-  gtk_css_value_shadow_print
+  gtk_css_value_shadow_print,
+  gtk_css_value_shadow_hash,
+  gtk_css_value_shadow_get_size
 };
 
 static GtkCssValue *
@@ -39,8 +39,313 @@
 #include "gtkstylepropertyprivate.h"
 #include "gtkstyleproviderprivate.h"
 
+#include <string.h>
+
 G_DEFINE_TYPE (GtkCssStaticStyle, gtk_css_static_style, GTK_TYPE_CSS_STYLE)
 
+/* GROUPS */
+
+/* A group holds the computed values of a set of properties. While a
+ * style is computed its groups are private to it. Once it is done they
+ * are sealed: they become immutable and are replaced by an identical
+ * group from other styles if there is one.
+ *
+ * Groups compare values by pointer, so equal values that aren't the same
+ * object don't share. Inherited and initial values, the common case, do.
+ */
+struct _GtkCssStyleGroup
+{
+  int                    ref_count;
+  guint                  group :8;
+  guint                  sealed :1;
+  guint                  hash;
+  GtkCssValue           *values[1];
+};
+
+static const guint core_properties[] = {
+  GTK_CSS_PROPERTY_COLOR,
+  GTK_CSS_PROPERTY_DPI,
+  GTK_CSS_PROPERTY_FONT_SIZE,
+  GTK_CSS_PROPERTY_ICON_THEME,
+  GTK_CSS_PROPERTY_ICON_PALETTE,
+};
+
+static const guint font_properties[] = {
+  GTK_CSS_PROPERTY_FONT_FAMILY,
+  GTK_CSS_PROPERTY_FONT_STYLE,
+  GTK_CSS_PROPERTY_FONT_WEIGHT,
+  GTK_CSS_PROPERTY_FONT_STRETCH,
+  GTK_CSS_PROPERTY_FONT_KERNING,
+  GTK_CSS_PROPERTY_FONT_VARIANT_LIGATURES,
+  GTK_CSS_PROPERTY_FONT_VARIANT_POSITION,
+  GTK_CSS_PROPERTY_FONT_VARIANT_CAPS,
+  GTK_CSS_PROPERTY_FONT_VARIANT_NUMERIC,
+  GTK_CSS_PROPERTY_FONT_VARIANT_ALTERNATES,
+  GTK_CSS_PROPERTY_FONT_VARIANT_EAST_ASIAN,
+  GTK_CSS_PROPERTY_FONT_FEATURE_SETTINGS,
+  GTK_CSS_PROPERTY_FONT_VARIATION_SETTINGS,
+};
+
+static const guint text_properties[] = {
+  GTK_CSS_PROPERTY_LETTER_SPACING,
+  GTK_CSS_PROPERTY_TEXT_DECORATION_LINE,
+  GTK_CSS_PROPERTY_TEXT_DECORATION_COLOR,
+  GTK_CSS_PROPERTY_TEXT_DECORATION_STYLE,
+  GTK_CSS_PROPERTY_TEXT_SHADOW,
+  GTK_CSS_PROPERTY_CARET_COLOR,
+  GTK_CSS_PROPERTY_SECONDARY_CARET_COLOR,
+};
+
+static const guint size_properties[] = {
+  GTK_CSS_PROPERTY_MARGIN_TOP,
+  GTK_CSS_PROPERTY_MARGIN_LEFT,
+  GTK_CSS_PROPERTY_MARGIN_BOTTOM,
+  GTK_CSS_PROPERTY_MARGIN_RIGHT,
+  GTK_CSS_PROPERTY_PADDING_TOP,
+  GTK_CSS_PROPERTY_PADDING_LEFT,
+  GTK_CSS_PROPERTY_PADDING_BOTTOM,
+  GTK_CSS_PROPERTY_PADDING_RIGHT,
+  GTK_CSS_PROPERTY_BORDER_SPACING,
+  GTK_CSS_PROPERTY_MIN_WIDTH,
+  GTK_CSS_PROPERTY_MIN_HEIGHT,
+};
+
+static const guint border_properties[] = {
+  GTK_CSS_PROPERTY_BORDER_TOP_STYLE,
+  GTK_CSS_PROPERTY_BORDER_TOP_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_LEFT_STYLE,
+  GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_STYLE,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_TOP_COLOR,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_COLOR,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR,
+  GTK_CSS_PROPERTY_BORDER_LEFT_COLOR,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_SLICE,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH,
+};
+
+static const guint outline_properties[] = {
+  GTK_CSS_PROPERTY_OUTLINE_STYLE,
+  GTK_CSS_PROPERTY_OUTLINE_WIDTH,
+  GTK_CSS_PROPERTY_OUTLINE_OFFSET,
+  GTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_COLOR,
+};
+
+static const guint background_properties[] = {
+  GTK_CSS_PROPERTY_BACKGROUND_COLOR,
+  GTK_CSS_PROPERTY_BOX_SHADOW,
+  GTK_CSS_PROPERTY_BACKGROUND_CLIP,
+  GTK_CSS_PROPERTY_BACKGROUND_ORIGIN,
+  GTK_CSS_PROPERTY_BACKGROUND_SIZE,
+  GTK_CSS_PROPERTY_BACKGROUND_POSITION,
+  GTK_CSS_PROPERTY_BACKGROUND_REPEAT,
+  GTK_CSS_PROPERTY_BACKGROUND_IMAGE,
+  GTK_CSS_PROPERTY_BACKGROUND_BLEND_MODE,
+};
+
+static const guint icon_properties[] = {
+  GTK_CSS_PROPERTY_ICON_SOURCE,
+  GTK_CSS_PROPERTY_ICON_SIZE,
+  GTK_CSS_PROPERTY_ICON_SHADOW,
+  GTK_CSS_PROPERTY_ICON_STYLE,
+  GTK_CSS_PROPERTY_ICON_TRANSFORM,
+  GTK_CSS_PROPERTY_ICON_FILTER,
+};
+
+static const guint transition_properties[] = {
+  GTK_CSS_PROPERTY_TRANSITION_PROPERTY,
+  GTK_CSS_PROPERTY_TRANSITION_DURATION,
+  GTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION,
+  GTK_CSS_PROPERTY_TRANSITION_DELAY,
+};
+
+static const guint animation_properties[] = {
+  GTK_CSS_PROPERTY_ANIMATION_NAME,
+  GTK_CSS_PROPERTY_ANIMATION_DURATION,
+  GTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION,
+  GTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT,
+  GTK_CSS_PROPERTY_ANIMATION_DIRECTION,
+  GTK_CSS_PROPERTY_ANIMATION_PLAY_STATE,
+  GTK_CSS_PROPERTY_ANIMATION_DELAY,
+  GTK_CSS_PROPERTY_ANIMATION_FILL_MODE,
+};
+
+static const guint other_properties[] = {
+  GTK_CSS_PROPERTY_OPACITY,
+  GTK_CSS_PROPERTY_FILTER,
+  GTK_CSS_PROPERTY_GTK_KEY_BINDINGS,
+};
+
+static const struct {
+  const guint *properties;
+  guint n_properties;
+} group_properties[GTK_CSS_STYLE_N_GROUPS] = {
+  [GTK_CSS_STYLE_GROUP_CORE] = { core_properties, G_N_ELEMENTS (core_properties) },
+  [GTK_CSS_STYLE_GROUP_FONT] = { font_properties, G_N_ELEMENTS (font_properties) },
+  [GTK_CSS_STYLE_GROUP_TEXT] = { text_properties, G_N_ELEMENTS (text_properties) },
+  [GTK_CSS_STYLE_GROUP_SIZE] = { size_properties, G_N_ELEMENTS (size_properties) },
+  [GTK_CSS_STYLE_GROUP_BORDER] = { border_properties, G_N_ELEMENTS (border_properties) },
+  [GTK_CSS_STYLE_GROUP_OUTLINE] = { outline_properties, G_N_ELEMENTS (outline_properties) },
+  [GTK_CSS_STYLE_GROUP_BACKGROUND] = { background_properties, G_N_ELEMENTS (background_properties) },
+  [GTK_CSS_STYLE_GROUP_ICON] = { icon_properties, G_N_ELEMENTS (icon_properties) },
+  [GTK_CSS_STYLE_GROUP_TRANSITION] = { transition_properties, G_N_ELEMENTS (transition_properties) },
+  [GTK_CSS_STYLE_GROUP_ANIMATION] = { animation_properties, G_N_ELEMENTS (animation_properties) },
+  [GTK_CSS_STYLE_GROUP_OTHER] = { other_properties, G_N_ELEMENTS (other_properties) },
+};
+
+/* maps property ids to their group and their index in it */
+static guint8 property_group[GTK_CSS_PROPERTY_N_PROPERTIES];
+static guint8 property_index[GTK_CSS_PROPERTY_N_PROPERTIES];
+
+static GHashTable *sealed_groups;
+
+static void
+gtk_css_style_groups_init (void)
+{
+  guint i, j;
+
+  memset (property_group, 0xff, sizeof (property_group));
+
+  for (i = 0; i < GTK_CSS_STYLE_N_GROUPS; i++)
+    {
+      for (j = 0; j < group_properties[i].n_properties; j++)
+        {
+          guint id = group_properties[i].properties[j];
+
+          g_assert (property_group[id] == 0xff);
+          property_group[id] = i;
+          property_index[id] = j;
+        }
+    }
+
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    g_assert (property_group[i] != 0xff);
+}
+
+static gsize
+gtk_css_style_group_size (guint group)
+{
+  return sizeof (GtkCssStyleGroup) + sizeof (GtkCssValue *) * (group_properties[group].n_properties - 1);
+}
+
+static GtkCssStyleGroup *
+gtk_css_style_group_new (guint group)
+{
+  GtkCssStyleGroup *result;
+
+  result = g_slice_alloc0 (gtk_css_style_group_size (group));
+  result->ref_count = 1;
+  result->group = group;
+
+  return result;
+}
+
+static GtkCssStyleGroup *
+gtk_css_style_group_ref (GtkCssStyleGroup *group)
+{
+  group->ref_count++;
+
+  return group;
+}
+
+static void
+gtk_css_style_group_unref (GtkCssStyleGroup *group)
+{
+  guint i;
+
+  group->ref_count--;
+  if (group->ref_count > 0)
+    return;
+
+  if (group->sealed)
+    g_hash_table_remove (sealed_groups, group);
+
+  for (i = 0; i < group_properties[group->group].n_properties; i++)
+    {
+      if (group->values[i])
+        _gtk_css_value_unref (group->values[i]);
+    }
+
+  g_slice_free1 (gtk_css_style_group_size (group->group), group);
+}
+
+static guint
+gtk_css_style_group_hash (gconstpointer data)
+{
+  const GtkCssStyleGroup *group = data;
+
+  return group->hash;
+}
+
+static gboolean
+gtk_css_style_group_equal (gconstpointer a,
+                           gconstpointer b)
+{
+  const GtkCssStyleGroup *group_a = a;
+  const GtkCssStyleGroup *group_b = b;
+
+  return group_a->group == group_b->group &&
+         memcmp (group_a->values, group_b->values,
+                 sizeof (GtkCssValue *) * group_properties[group_a->group].n_properties) == 0;
+}
+
+/* Returns the group to use instead of @group, which is consumed */
+static GtkCssStyleGroup *
+gtk_css_style_group_seal (GtkCssStyleGroup *group)
+{
+  GtkCssStyleGroup *shared;
+  guint i, hash;
+
+  g_assert (!group->sealed);
+
+  if (G_UNLIKELY (sealed_groups == NULL))
+    sealed_groups = g_hash_table_new (gtk_css_style_group_hash, gtk_css_style_group_equal);
+
+  hash = group->group;
+  for (i = 0; i < group_properties[group->group].n_properties; i++)
+    hash = (hash << 5) - hash + GPOINTER_TO_UINT (group->values[i]);
+  group->hash = hash;
+
+  shared = g_hash_table_lookup (sealed_groups, group);
+  if (shared)
+    {
+      gtk_css_style_group_ref (shared);
+      gtk_css_style_group_unref (group);
+      return shared;
+    }
+
+  group->sealed = TRUE;
+  g_hash_table_add (sealed_groups, group);
+
+  return group;
+}
+
+const guint *
+gtk_css_style_group_get_properties (GtkCssStyleGroupId  group,
+                                    guint              *n_properties)
+{
+  g_return_val_if_fail (group < GTK_CSS_STYLE_N_GROUPS, NULL);
+
+  *n_properties = group_properties[group].n_properties;
+
+  return group_properties[group].properties;
+}
+
+/* STYLE */
+
 static GtkCssValue *
 gtk_css_static_style_get_value (GtkCssStyle *style,
                                 guint        id)
@@ -48,7 +353,7 @@ gtk_css_static_style_get_value (GtkCssStyle *style,
   /* This is called a lot, so we avoid a dynamic type check here */
   GtkCssStaticStyle *sstyle = (GtkCssStaticStyle *) style;
 
-  return sstyle->values[id];
+  return sstyle->groups[property_group[id]]->values[property_index[id]];
 }
 
 static GtkCssSection *
@@ -70,11 +375,8 @@ gtk_css_static_style_dispose (GObject *object)
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
-    {
-      if (style->values[i])
-        _gtk_css_value_unref (style->values[i]);
-    }
+  for (i = 0; i < GTK_CSS_STYLE_N_GROUPS; i++)
+    g_clear_pointer (&style->groups[i], gtk_css_style_group_unref);
   if (style->sections)
     {
       g_ptr_array_unref (style->sections);
@@ -94,11 +396,17 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 
   style_class->get_value = gtk_css_static_style_get_value;
   style_class->get_section = gtk_css_static_style_get_section;
+
+  gtk_css_style_groups_init ();
 }
 
 static void
 gtk_css_static_style_init (GtkCssStaticStyle *style)
 {
+  guint i;
+
+  for (i = 0; i < GTK_CSS_STYLE_N_GROUPS; i++)
+    style->groups[i] = gtk_css_style_group_new (i);
 }
 
 static void
@@ -114,9 +422,14 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *style,
                                 GtkCssValue       *value,
                                 GtkCssSection     *section)
 {
-  if (style->values[id])
-    _gtk_css_value_unref (style->values[id]);
-  style->values[id] = _gtk_css_value_ref (value);
+  GtkCssStyleGroup *group = style->groups[property_group[id]];
+  guint index = property_index[id];
+
+  g_assert (!group->sealed);
+
+  if (group->values[index])
+    _gtk_css_value_unref (group->values[index]);
+  group->values[index] = _gtk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -174,6 +487,7 @@ gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
   GtkCssStaticStyle *result;
   GtkCssLookup lookup;
   GtkCssChange change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
+  guint i;
 
   _gtk_css_lookup_init (&lookup, NULL);
 
@@ -194,6 +508,139 @@ gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
 
   _gtk_css_lookup_destroy (&lookup);
 
+  for (i = 0; i < GTK_CSS_STYLE_N_GROUPS; i++)
+    result->groups[i] = gtk_css_style_group_seal (result->groups[i]);
+
+  return GTK_CSS_STYLE (result);
+}
+
+/* The result of a lookup, kept small as there may be one for every
+ * node of a window */
+struct _GtkCssStaticStyleMatch
+{
+  GtkCssChange change;
+  guint n_values;
+  struct {
+    guint id;
+    GtkCssSection *section;
+    GtkCssValue *value;
+    GtkStyleProvider *provider;
+    gpointer deferred;
+  } values[1];
+};
+
+/**
+ * gtk_css_static_style_match:
+ * @provider: the provider
+ * @matcher: the matcher
+ *
+ * Does the selector matching part of gtk_css_static_style_new_compute().
+ * Unlike computing the style, this does not modify any shared state, so
+ * it may be called from another thread while the main thread waits.
+ * Values the provider has yet to parse are left for
+ * gtk_css_static_style_new_from_match() to resolve.
+ *
+ * Returns: the match to pass to gtk_css_static_style_new_from_match()
+ */
+GtkCssStaticStyleMatch *
+gtk_css_static_style_match (GtkStyleProvider    *provider,
+                            const GtkCssMatcher *matcher)
+{
+  GtkCssStaticStyleMatch *match;
+  GtkCssLookup lookup;
+  GtkCssChange change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
+  guint i, n;
+
+  _gtk_css_lookup_init (&lookup, NULL);
+  lookup.defer_values = TRUE;
+
+  gtk_style_provider_lookup (provider, matcher, &lookup, &change);
+
+  n = 0;
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      if (lookup.values[i].value || lookup.values[i].deferred)
+        n++;
+    }
+
+  match = g_malloc (sizeof (GtkCssStaticStyleMatch) + sizeof (match->values[0]) * (MAX (n, 1) - 1));
+  match->change = change;
+  match->n_values = 0;
+
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      if (lookup.values[i].value == NULL && lookup.values[i].deferred == NULL)
+        continue;
+
+      match->values[match->n_values].id = i;
+      match->values[match->n_values].section = lookup.values[i].section;
+      match->values[match->n_values].value = lookup.values[i].value;
+      match->values[match->n_values].provider = lookup.values[i].provider;
+      match->values[match->n_values].deferred = lookup.values[i].deferred;
+      match->n_values++;
+    }
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  return match;
+}
+
+void
+gtk_css_static_style_match_free (GtkCssStaticStyleMatch *match)
+{
+  g_free (match);
+}
+
+/**
+ * gtk_css_static_style_new_from_match:
+ * @provider: the provider that was used for @match
+ * @match: the result of gtk_css_static_style_match()
+ * @parent: (allow-none): the parent style
+ *
+ * Computes a style like gtk_css_static_style_new_compute() from
+ * the result of an earlier lookup. Until then, nothing must have
+ * changed what @match refers to.
+ *
+ * Returns: the new style
+ */
+GtkCssStyle *
+gtk_css_static_style_new_from_match (GtkStyleProvider             *provider,
+                                     const GtkCssStaticStyleMatch *match,
+                                     GtkCssStyle                  *parent)
+{
+  GtkCssStaticStyle *result;
+  GtkCssLookup lookup;
+  guint i;
+
+  _gtk_css_lookup_init (&lookup, NULL);
+  lookup.defer_values = TRUE;
+
+  for (i = 0; i < match->n_values; i++)
+    {
+      if (match->values[i].deferred)
+        _gtk_css_lookup_set_deferred (&lookup,
+                                      match->values[i].id,
+                                      match->values[i].section,
+                                      match->values[i].provider,
+                                      match->values[i].deferred);
+      else
+        _gtk_css_lookup_set (&lookup, match->values[i].id, match->values[i].section, match->values[i].value);
+    }
+
+  result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
+
+  result->change = match->change;
+
+  _gtk_css_lookup_resolve (&lookup,
+                           provider,
+                           result,
+                           parent);
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  for (i = 0; i < GTK_CSS_STYLE_N_GROUPS; i++)
+    result->groups[i] = gtk_css_style_group_seal (result->groups[i]);
+
   return GTK_CSS_STYLE (result);
 }
 
@@ -244,3 +691,16 @@ gtk_css_static_style_get_change (GtkCssStaticStyle *style)
 
   return style->change;
 }
+
+/* Sealed groups are only shared if all their values are identical,
+ * so this is a quick way to check that none of them changed */
+gboolean
+gtk_css_static_style_shares_group (GtkCssStaticStyle  *style,
+                                   GtkCssStaticStyle  *other,
+                                   GtkCssStyleGroupId  group)
+{
+  gtk_internal_return_val_if_fail (GTK_IS_CSS_STATIC_STYLE (style), FALSE);
+  gtk_internal_return_val_if_fail (GTK_IS_CSS_STATIC_STYLE (other), FALSE);
+
+  return style->groups[group] == other->groups[group];
+}
@@ -34,12 +34,32 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyle           GtkCssStaticStyle;
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssStyleGroup            GtkCssStyleGroup;
+typedef struct _GtkCssStaticStyleMatch      GtkCssStaticStyleMatch;
+
+/* Properties are grouped by what they are used for, so that styles
+ * that only differ in a few properties can share the other groups */
+typedef enum {
+  GTK_CSS_STYLE_GROUP_CORE,
+  GTK_CSS_STYLE_GROUP_FONT,
+  GTK_CSS_STYLE_GROUP_TEXT,
+  GTK_CSS_STYLE_GROUP_SIZE,
+  GTK_CSS_STYLE_GROUP_BORDER,
+  GTK_CSS_STYLE_GROUP_OUTLINE,
+  GTK_CSS_STYLE_GROUP_BACKGROUND,
+  GTK_CSS_STYLE_GROUP_ICON,
+  GTK_CSS_STYLE_GROUP_TRANSITION,
+  GTK_CSS_STYLE_GROUP_ANIMATION,
+  GTK_CSS_STYLE_GROUP_OTHER,
+  /* add more */
+  GTK_CSS_STYLE_N_GROUPS
+} GtkCssStyleGroupId;
 
 struct _GtkCssStaticStyle
 {
   GtkCssStyle parent;
 
-  GtkCssValue           *values[GTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
+  GtkCssStyleGroup      *groups[GTK_CSS_STYLE_N_GROUPS]; /* the values, shared between styles */
   GPtrArray             *sections;             /* sections the values are defined in */
 
   GtkCssChange           change;               /* change as returned by value lookup */
@@ -57,6 +77,13 @@ GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProvide
                                                                  const GtkCssMatcher    *matcher,
                                                                  GtkCssStyle            *parent);
 
+GtkCssStaticStyleMatch *gtk_css_static_style_match              (GtkStyleProvider       *provider,
+                                                                 const GtkCssMatcher    *matcher);
+void                    gtk_css_static_style_match_free         (GtkCssStaticStyleMatch *match);
+GtkCssStyle *           gtk_css_static_style_new_from_match     (GtkStyleProvider       *provider,
+                                                                 const GtkCssStaticStyleMatch *match,
+                                                                 GtkCssStyle            *parent);
+
 void                    gtk_css_static_style_compute_value      (GtkCssStaticStyle      *style,
                                                                  GtkStyleProvider       *provider,
                                                                  GtkCssStyle            *parent_style,
@@ -66,6 +93,12 @@ void                    gtk_css_static_style_compute_value      (GtkCssStaticSty
 
 GtkCssChange            gtk_css_static_style_get_change         (GtkCssStaticStyle      *style);
 
+gboolean                gtk_css_static_style_shares_group       (GtkCssStaticStyle      *style,
+                                                                 GtkCssStaticStyle      *other,
+                                                                 GtkCssStyleGroupId      group);
+const guint *           gtk_css_style_group_get_properties      (GtkCssStyleGroupId      group,
+                                                                 guint                  *n_properties);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_STATIC_STYLE_PRIVATE_H__ */
@@ -19,8 +19,55 @@
 
 #include "gtkcssstylechangeprivate.h"
 
+#include "gtkcssstaticstyleprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 
+static void
+gtk_css_style_change_add (GtkCssStyleChange *change,
+                          guint              id)
+{
+  change->affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (id));
+  change->changes = _gtk_bitmask_set (change->changes, id, TRUE);
+}
+
+static void
+gtk_css_style_compare_value (GtkCssStyleChange *change,
+                             guint              id)
+{
+  if (!_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, id),
+                             gtk_css_style_get_value (change->new_style, id)))
+    gtk_css_style_change_add (change, id);
+}
+
+/* Static styles share their groups of values if they are identical,
+ * so only the properties of groups that differ need to be compared */
+static void
+gtk_css_style_compare_static_groups (GtkCssStyleChange *change)
+{
+  GtkCssStaticStyle *old_style = GTK_CSS_STATIC_STYLE (change->old_style);
+  GtkCssStaticStyle *new_style = GTK_CSS_STATIC_STYLE (change->new_style);
+  const guint *properties;
+  guint group, i, n_properties;
+
+  for (group = 0; group < GTK_CSS_STYLE_N_GROUPS; group++)
+    {
+      if (gtk_css_static_style_shares_group (old_style, new_style, group))
+        continue;
+
+      /* all values of static styles are computed, so most of them
+       * are interned and can be compared by pointer */
+      properties = gtk_css_style_group_get_properties (group, &n_properties);
+      for (i = 0; i < n_properties; i++)
+        {
+          if (!gtk_css_value_equal_computed (gtk_css_style_get_value (change->old_style, properties[i]),
+                                             gtk_css_style_get_value (change->new_style, properties[i])))
+            gtk_css_style_change_add (change, properties[i]);
+        }
+    }
+
+  change->n_compared = GTK_CSS_PROPERTY_N_PROPERTIES;
+}
+
 void
 gtk_css_style_change_init (GtkCssStyleChange *change,
                            GtkCssStyle       *old_style,
@@ -37,6 +84,8 @@ gtk_css_style_change_init (GtkCssStyleChange *change,
   /* Make sure we don't do extra work if old and new are equal. */
   if (old_style == new_style)
     change->n_compared = GTK_CSS_PROPERTY_N_PROPERTIES;
+  else if (GTK_IS_CSS_STATIC_STYLE (old_style) && GTK_IS_CSS_STATIC_STYLE (new_style))
+    gtk_css_style_compare_static_groups (change);
 }
 
 void
@@ -65,12 +114,7 @@ gtk_css_style_compare_next_value (GtkCssStyleChange *change)
   if (change->n_compared == GTK_CSS_PROPERTY_N_PROPERTIES)
     return FALSE;
 
-  if (!_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, change->n_compared),
-                             gtk_css_style_get_value (change->new_style, change->n_compared)))
-    {
-      change->affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (change->n_compared));
-      change->changes = _gtk_bitmask_set (change->changes, change->n_compared, TRUE);
-    }
+  gtk_css_style_compare_value (change, change->n_compared);
 
   change->n_compared++;
 
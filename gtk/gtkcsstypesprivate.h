@@ -24,6 +24,7 @@
 
 G_BEGIN_DECLS
 
+typedef struct _GtkCssAncestorFilter GtkCssAncestorFilter;
 typedef union _GtkCssMatcher GtkCssMatcher;
 typedef struct _GtkCssNode GtkCssNode;
 typedef struct _GtkCssNodeDeclaration GtkCssNodeDeclaration;
@@ -66,6 +66,107 @@ gtk_css_value_unref (GtkCssValue *value)
   value->class->free (value);
 }
 
+/* Computed values are immutable and very often identical, think of all
+ * the 0px margins and black text colors, so they are interned. The table
+ * keeps a reference to every interned value. Values that only the table
+ * references anymore are swept whenever the table doubled in size.
+ */
+#define INTERN_MIN_SWEEP_SIZE 1024
+
+static GHashTable *interned_values;
+static guint intern_sweep_size = INTERN_MIN_SWEEP_SIZE;
+static GtkCssValueInternStatistics intern_stats;
+
+static guint
+gtk_css_value_intern_hash (gconstpointer value)
+{
+  return gtk_css_value_hash (value);
+}
+
+static gboolean
+gtk_css_value_intern_equal (gconstpointer value1,
+                            gconstpointer value2)
+{
+  return _gtk_css_value_equal (value1, value2);
+}
+
+static gboolean
+gtk_css_value_is_unused (gpointer key,
+                         gpointer value,
+                         gpointer unused)
+{
+  return ((GtkCssValue *) key)->ref_count == 1;
+}
+
+static GtkCssValue *
+gtk_css_value_intern (GtkCssValue *value)
+{
+  GtkCssValue *interned;
+
+  if (value == NULL || value->class->hash == NULL)
+    return value;
+
+  if (G_UNLIKELY (interned_values == NULL))
+    interned_values = g_hash_table_new_full (gtk_css_value_intern_hash,
+                                             gtk_css_value_intern_equal,
+                                             (GDestroyNotify) gtk_css_value_unref,
+                                             NULL);
+
+  intern_stats.lookups++;
+
+  interned = g_hash_table_lookup (interned_values, value);
+  if (interned)
+    {
+      intern_stats.hits++;
+      if (interned != value)
+        {
+          gtk_css_value_ref (interned);
+          gtk_css_value_unref (value);
+        }
+      return interned;
+    }
+
+  g_hash_table_add (interned_values, gtk_css_value_ref (value));
+
+  if (g_hash_table_size (interned_values) >= intern_sweep_size)
+    {
+      g_hash_table_foreach_remove (interned_values, gtk_css_value_is_unused, NULL);
+      intern_sweep_size = MAX (INTERN_MIN_SWEEP_SIZE, 2 * g_hash_table_size (interned_values));
+      intern_stats.sweeps++;
+    }
+
+  return value;
+}
+
+void
+gtk_css_value_get_intern_statistics (GtkCssValueInternStatistics *stats)
+{
+  GHashTableIter iter;
+  GtkCssValue *value;
+
+  *stats = intern_stats;
+  stats->size = 0;
+  stats->references = 0;
+  stats->bytes = 0;
+  stats->bytes_saved = 0;
+
+  if (interned_values == NULL)
+    return;
+
+  stats->size = g_hash_table_size (interned_values);
+
+  g_hash_table_iter_init (&iter, interned_values);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &value, NULL))
+    {
+      gsize size = value->class->get_size (value);
+
+      stats->references += value->ref_count - 1;
+      stats->bytes += size;
+      if (value->ref_count > 2)
+        stats->bytes_saved += (value->ref_count - 2) * size;
+    }
+}
+
 /**
  * _gtk_css_value_compute:
  * @value: the value to compute from
@@ -79,6 +180,9 @@ gtk_css_value_unref (GtkCssValue *value)
  * This step is explained in detail in the
  * [CSS Documentation](http://www.w3.org/TR/css3-cascade/#computed).
  *
+ * If the value's class has a hash function, the result is interned, so
+ * equal computed values are the same instance.
+ *
  * Returns: the computed value
  **/
 GtkCssValue *
@@ -94,7 +198,7 @@ _gtk_css_value_compute (GtkCssValue      *value,
   gtk_internal_return_val_if_fail (GTK_IS_CSS_STYLE (style), NULL);
   gtk_internal_return_val_if_fail (parent_style == NULL || GTK_IS_CSS_STYLE (parent_style), NULL);
 
-  return value->class->compute (value, property_id, provider, style, parent_style);
+  return gtk_css_value_intern (value->class->compute (value, property_id, provider, style, parent_style));
 }
 
 gboolean
@@ -113,6 +217,53 @@ _gtk_css_value_equal (const GtkCssValue *value1,
   return value1->class->equal (value1, value2);
 }
 
+/**
+ * gtk_css_value_equal_computed:
+ * @value1: a value returned by _gtk_css_value_compute()
+ * @value2: another value returned by _gtk_css_value_compute()
+ *
+ * Like _gtk_css_value_equal(), but takes advantage of computed values
+ * being interned. For interned classes, this is a pointer comparison.
+ *
+ * Returns: %TRUE if the values are equal
+ **/
+gboolean
+gtk_css_value_equal_computed (const GtkCssValue *value1,
+                              const GtkCssValue *value2)
+{
+  gtk_internal_return_val_if_fail (value1 != NULL, FALSE);
+  gtk_internal_return_val_if_fail (value2 != NULL, FALSE);
+
+  if (value1 == value2)
+    return TRUE;
+
+  if (value1->class != value2->class ||
+      value1->class->hash != NULL)
+    return FALSE;
+
+  return value1->class->equal (value1, value2);
+}
+
+/**
+ * gtk_css_value_hash:
+ * @value: a #GtkCssValue
+ *
+ * Computes a hash for @value that is consistent with _gtk_css_value_equal().
+ * Values without a hash function all hash to the same value per class.
+ *
+ * Returns: the hash
+ **/
+guint
+gtk_css_value_hash (const GtkCssValue *value)
+{
+  gtk_internal_return_val_if_fail (value != NULL, 0);
+
+  if (value->class->hash == NULL)
+    return GPOINTER_TO_UINT (value->class);
+
+  return value->class->hash (value);
+}
+
 gboolean
 _gtk_css_value_equal0 (const GtkCssValue *value1,
                        const GtkCssValue *value2)
@@ -31,6 +31,7 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssValue           GtkCssValue;
 typedef struct _GtkCssValueClass      GtkCssValueClass;
+typedef struct _GtkCssValueInternStatistics GtkCssValueInternStatistics;
 
 /* using define instead of struct here so compilers get the packing right */
 #define GTK_CSS_VALUE_BASE \
@@ -56,6 +57,20 @@ struct _GtkCssValueClass {
                                                        gint64                      monotonic_time);
   void          (* print)                             (const GtkCssValue          *value,
                                                        GString                    *string);
+  /* Optional. Computed values of classes with a hash function are interned */
+  guint         (* hash)                              (const GtkCssValue          *value);
+  /* Required with hash. The bytes the value takes, without other values */
+  gsize         (* get_size)                          (const GtkCssValue          *value);
+};
+
+struct _GtkCssValueInternStatistics {
+  guint size;
+  guint references;
+  guint lookups;
+  guint hits;
+  guint sweeps;
+  gsize bytes;          /* held by the interned values */
+  gsize bytes_saved;    /* that a copy per reference would take in addition */
 };
 
 GType        _gtk_css_value_get_type                  (void) G_GNUC_CONST;
@@ -78,6 +93,9 @@ gboolean     _gtk_css_value_equal                     (const GtkCssValue
                                                        const GtkCssValue          *value2);
 gboolean     _gtk_css_value_equal0                    (const GtkCssValue          *value1,
                                                        const GtkCssValue          *value2);
+gboolean        gtk_css_value_equal_computed          (const GtkCssValue          *value1,
+                                                       const GtkCssValue          *value2);
+guint           gtk_css_value_hash                    (const GtkCssValue          *value);
 GtkCssValue *_gtk_css_value_transition                (GtkCssValue                *start,
                                                        GtkCssValue                *end,
                                                        guint                       property_id,
@@ -90,6 +108,18 @@ char *       _gtk_css_value_to_string                 (const GtkCssValue
 void         _gtk_css_value_print                     (const GtkCssValue          *value,
                                                        GString                    *string);
 
+void            gtk_css_value_get_intern_statistics   (GtkCssValueInternStatistics *stats);
+
+static inline guint
+gtk_css_value_hash_double (double d)
+{
+  /* -0.0 and 0.0 compare equal, so they must hash equal */
+  if (d == 0.0)
+    return 0;
+
+  return g_double_hash (&d);
+}
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_VALUE_PRIVATE_H__ */
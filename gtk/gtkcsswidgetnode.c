@@ -52,6 +52,16 @@ gtk_css_widget_node_style_changed (GtkCssNode        *cssnode,
   GTK_CSS_NODE_CLASS (gtk_css_widget_node_parent_class)->style_changed (cssnode, change);
 }
 
+static void
+gtk_css_widget_node_render_values_changed (GtkCssNode    *cssnode,
+                                           GtkCssAffects  affects)
+{
+  GtkCssWidgetNode *node = GTK_CSS_WIDGET_NODE (cssnode);
+
+  if (node->widget)
+    _gtk_widget_css_render_values_changed (node->widget, affects);
+}
+
 static gboolean
 gtk_css_widget_node_queue_callback (GtkWidget     *widget,
                                     GdkFrameClock *frame_clock,
@@ -214,6 +224,7 @@ gtk_css_widget_node_class_init (GtkCssWidgetNodeClass *klass)
   node_class->get_style_provider = gtk_css_widget_node_get_style_provider;
   node_class->get_frame_clock = gtk_css_widget_node_get_frame_clock;
   node_class->style_changed = gtk_css_widget_node_style_changed;
+  node_class->render_values_changed = gtk_css_widget_node_render_values_changed;
 }
 
 static void
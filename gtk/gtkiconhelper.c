@@ -31,6 +31,7 @@
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkcsstransientnodeprivate.h"
 #include "gtkiconthemeprivate.h"
+#include "gtklrucacheprivate.h"
 #include "gtkrendericonprivate.h"
 #include "gtksnapshot.h"
 #include "gtkwidgetprivate.h"
@@ -113,6 +114,187 @@ ensure_paintable_from_paintable (GtkIconHelper *self,
   return g_object_ref (paintable);
 }
 
+/* TEXTURE CACHE */
+
+/* Icon helpers showing the same icon share its texture. The icon theme
+ * only shares textures while their GtkIconInfo is alive, and it keeps
+ * just a few of those around, so without this cache a list with many
+ * rows loads the same icons over and over.
+ *
+ * Symbolic icons are recolored when drawing, so the colors are not
+ * part of the key. The cache keeps references to everything in its
+ * keys and to the textures, is bounded by the size of the textures and
+ * drops the least recently used entries. Textures that are still in
+ * use stay alive with their helpers.
+ */
+#define TEXTURE_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+typedef struct _TextureEntry TextureEntry;
+
+struct _TextureEntry {
+  GtkIconTheme       *icon_theme;
+  GIcon              *gicon;
+  int                 size;
+  int                 scale;
+  GtkIconLookupFlags  flags;
+  guint               hash;
+
+  GdkTexture         *texture;
+  gboolean            symbolic;
+};
+
+static GtkLruCache *texture_cache;
+static GtkIconHelperTextureCacheStatistics texture_cache_stats;
+
+static guint
+texture_entry_hash (gconstpointer data)
+{
+  const TextureEntry *entry = data;
+
+  return entry->hash;
+}
+
+static gboolean
+texture_entry_equal (gconstpointer a,
+                     gconstpointer b)
+{
+  const TextureEntry *entry_a = a;
+  const TextureEntry *entry_b = b;
+
+  return entry_a->icon_theme == entry_b->icon_theme &&
+         entry_a->size == entry_b->size &&
+         entry_a->scale == entry_b->scale &&
+         entry_a->flags == entry_b->flags &&
+         g_icon_equal (entry_a->gicon, entry_b->gicon);
+}
+
+static void
+texture_entry_init_key (TextureEntry       *entry,
+                        GtkIconTheme       *icon_theme,
+                        GIcon              *gicon,
+                        int                 size,
+                        int                 scale,
+                        GtkIconLookupFlags  flags)
+{
+  guint hash;
+
+  entry->icon_theme = icon_theme;
+  entry->gicon = gicon;
+  entry->size = size;
+  entry->scale = scale;
+  entry->flags = flags;
+
+  hash = GPOINTER_TO_UINT (icon_theme) ^ g_icon_hash (gicon);
+  hash = (hash << 5) - hash + size;
+  hash = (hash << 5) - hash + scale;
+  entry->hash = (hash << 5) - hash + flags;
+}
+
+static void
+texture_entry_free (gpointer data)
+{
+  TextureEntry *entry = data;
+
+  g_object_unref (entry->icon_theme);
+  g_object_unref (entry->gicon);
+  g_object_unref (entry->texture);
+
+  g_slice_free (TextureEntry, entry);
+}
+
+static gboolean
+texture_entry_has_icon_theme (gpointer data,
+                              gpointer icon_theme)
+{
+  TextureEntry *entry = data;
+
+  return entry->icon_theme == icon_theme;
+}
+
+static void
+texture_cache_icon_theme_changed (GtkIconTheme *icon_theme)
+{
+  gtk_lru_cache_remove_matching (texture_cache, texture_entry_has_icon_theme, icon_theme);
+}
+
+static GdkTexture *
+texture_cache_lookup (GtkIconTheme       *icon_theme,
+                      GIcon              *gicon,
+                      int                 size,
+                      int                 scale,
+                      GtkIconLookupFlags  flags,
+                      gboolean           *symbolic)
+{
+  TextureEntry key, *entry;
+
+  texture_cache_stats.lookups++;
+
+  if (texture_cache == NULL)
+    return NULL;
+
+  texture_entry_init_key (&key, icon_theme, gicon, size, scale, flags);
+  entry = gtk_lru_cache_lookup (texture_cache, &key);
+  if (entry == NULL)
+    return NULL;
+
+  texture_cache_stats.hits++;
+
+  *symbolic = entry->symbolic;
+
+  return g_object_ref (entry->texture);
+}
+
+static void
+texture_cache_insert (GtkIconTheme       *icon_theme,
+                      GIcon              *gicon,
+                      int                 size,
+                      int                 scale,
+                      GtkIconLookupFlags  flags,
+                      GdkTexture         *texture,
+                      gboolean            symbolic)
+{
+  static GQuark quark_connected;
+  TextureEntry *entry;
+
+  if (texture_cache == NULL)
+    {
+      texture_cache = gtk_lru_cache_new (texture_entry_hash, texture_entry_equal, texture_entry_free,
+                                         G_MAXUINT, TEXTURE_CACHE_MAX_BYTES);
+      quark_connected = g_quark_from_static_string ("gtk-icon-helper-texture-cache");
+    }
+
+  /* Drop the textures when the theme's icons change */
+  if (g_object_get_qdata (G_OBJECT (icon_theme), quark_connected) == NULL)
+    {
+      g_signal_connect (icon_theme, "changed", G_CALLBACK (texture_cache_icon_theme_changed), NULL);
+      g_object_set_qdata (G_OBJECT (icon_theme), quark_connected, GINT_TO_POINTER (TRUE));
+    }
+
+  entry = g_slice_new0 (TextureEntry);
+
+  texture_entry_init_key (entry,
+                          g_object_ref (icon_theme),
+                          g_object_ref (gicon),
+                          size,
+                          scale,
+                          flags);
+  entry->texture = g_object_ref (texture);
+  entry->symbolic = symbolic;
+
+  /* replaces an existing entry, if any */
+  texture_cache_stats.evictions +=
+    gtk_lru_cache_insert (texture_cache, entry,
+                          4 * (gsize) gdk_texture_get_width (texture) * gdk_texture_get_height (texture));
+  texture_cache_stats.inserts++;
+}
+
+void
+gtk_icon_helper_get_texture_cache_statistics (GtkIconHelperTextureCacheStatistics *stats)
+{
+  *stats = texture_cache_stats;
+  stats->size = texture_cache ? gtk_lru_cache_get_size (texture_cache) : 0;
+}
+
 static GdkPaintable *
 ensure_paintable_for_gicon (GtkIconHelper    *self,
                             GtkCssStyle      *style,
@@ -133,6 +315,10 @@ ensure_paintable_for_gicon (GtkIconHelper    *self,
 
   width = height = get_default_size (self);
 
+  texture = texture_cache_lookup (icon_theme, gicon, MIN (width, height), scale, flags, symbolic);
+  if (texture)
+    return GDK_PAINTABLE (texture);
+
   info = gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
                                                    gicon,
                                                    MIN (width, height),
@@ -145,6 +331,9 @@ ensure_paintable_for_gicon (GtkIconHelper    *self,
 
   *symbolic = gtk_icon_info_is_symbolic (info);
   texture = gtk_icon_info_load_texture (info);
+  g_object_unref (info);
+
+  texture_cache_insert (icon_theme, gicon, MIN (width, height), scale, flags, texture, *symbolic);
 
   return GDK_PAINTABLE (texture);
 }
@@ -387,13 +576,26 @@ gtk_icon_helper_invalidate (GtkIconHelper *self)
     gtk_widget_queue_resize (self->owner);
 }
 
+/* Symbolic textures are recolored when drawing, so changes to the
+ * colors alone don't need a new texture, just a redraw. */
+static gboolean
+gtk_icon_helper_symbolic_texture_changed (GtkCssStyleChange *change)
+{
+  if (!gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_SYMBOLIC_ICON))
+    return FALSE;
+
+  return gtk_css_style_change_changes_property (change, GTK_CSS_PROPERTY_ICON_THEME) ||
+         gtk_css_style_change_changes_property (change, GTK_CSS_PROPERTY_ICON_SIZE) ||
+         gtk_css_style_change_changes_property (change, GTK_CSS_PROPERTY_ICON_STYLE);
+}
+
 void
 gtk_icon_helper_invalidate_for_change (GtkIconHelper     *self,
                                        GtkCssStyleChange *change)
 {
   if (change == NULL ||
-      ((gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_SYMBOLIC_ICON) &&
-        self->texture_is_symbolic) ||
+      ((self->texture_is_symbolic &&
+        gtk_icon_helper_symbolic_texture_changed (change)) ||
        (gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_ICON) &&
         !self->texture_is_symbolic)))
     {
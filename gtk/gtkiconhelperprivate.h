@@ -32,6 +32,16 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE(GtkIconHelper, gtk_icon_helper, GTK, ICON_HELPER, GObject)
 
+typedef struct _GtkIconHelperTextureCacheStatistics GtkIconHelperTextureCacheStatistics;
+
+struct _GtkIconHelperTextureCacheStatistics {
+  guint size;
+  guint lookups;
+  guint hits;
+  guint inserts;
+  guint evictions;
+};
+
 GtkIconHelper *gtk_icon_helper_new (GtkCssNode    *css_node,
                                     GtkWidget     *owner);
 
@@ -84,6 +94,10 @@ void      gtk_icon_helper_invalidate_for_change (GtkIconHelper     *self,
 void      gtk_icon_size_set_style_classes (GtkCssNode  *cssnode,
                                            GtkIconSize  icon_size);
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+void      gtk_icon_helper_get_texture_cache_statistics (GtkIconHelperTextureCacheStatistics *stats);
+
 G_END_DECLS
 
 #endif /* __GTK_ICON_HELPER_H__ */
@@ -4173,6 +4173,21 @@ gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
                                                error_color ? error_color : &error_default);
 }
 
+/* Symbolic SVGs are loaded as a mask with one plane per color, see
+ * gtk_make_symbolic_pixbuf_from_data(). That mask can be colored like
+ * a .symbolic.png instead of rendering the SVG again for every set of
+ * colors.
+ */
+static gboolean
+icon_info_pixbuf_is_symbolic_mask (GtkIconInfo *icon_info)
+{
+  return icon_info->is_svg &&
+         icon_info->cache_pixbuf == NULL &&
+         icon_info->emblem_infos == NULL &&
+         (icon_info->is_resource || icon_info->icon_file != NULL) &&
+         gtk_icon_info_is_symbolic (icon_info);
+}
+
 static GdkPixbuf *
 gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
                                  const GdkRGBA  *fg,
@@ -4347,7 +4362,8 @@ gtk_icon_info_load_symbolic_internal (GtkIconInfo    *icon_info,
   g_return_val_if_fail (fg != NULL, NULL);
 
   icon_uri = g_file_get_uri (icon_info->icon_file);
-  if (g_str_has_suffix (icon_uri, ".symbolic.png"))
+  if (g_str_has_suffix (icon_uri, ".symbolic.png") ||
+      icon_info_pixbuf_is_symbolic_mask (icon_info))
     pixbuf = gtk_icon_info_load_symbolic_png (icon_info, fg, success_color, warning_color, error_color, error);
   else
     pixbuf = gtk_icon_info_load_symbolic_svg (icon_info, fg, success_color, warning_color, error_color, error);
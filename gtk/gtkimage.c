@@ -86,6 +86,7 @@ struct _GtkImagePrivate
 
   gchar                *filename;       /* Only used with GTK_IMAGE_SURFACE */
   gchar                *resource_path;  /* Only used with GTK_IMAGE_SURFACE */
+  GCancellable         *load_cancellable; /* Only used during gtk_image_load_file() */
 
   guint keep_aspect_ratio : 1;
   guint can_shrink : 1;
@@ -736,6 +737,91 @@ gtk_image_set_from_file   (GtkImage    *image,
   g_object_thaw_notify (G_OBJECT (image));
 }
 
+/* Loads that didn't call back yet, including canceled ones */
+static guint n_running_loads;
+
+guint
+gtk_image_get_n_running_loads (void)
+{
+  return n_running_loads;
+}
+
+static void
+gtk_image_load_file_done (GObject      *source,
+                          GAsyncResult *result,
+                          gpointer      data)
+{
+  GtkImage *image = data;
+  GtkImagePrivate *priv;
+  GdkTexture *texture;
+  GError *error = NULL;
+
+  n_running_loads--;
+
+  texture = gdk_texture_new_from_file_finish (result, &error);
+
+  /* The image may be gone already, so don't touch it */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free (error);
+      return;
+    }
+
+  priv = gtk_image_get_instance_private (image);
+  g_clear_object (&priv->load_cancellable);
+
+  if (texture == NULL)
+    {
+      gtk_image_set_from_icon_name (image, "image-missing");
+      g_error_free (error);
+      return;
+    }
+
+  gtk_image_set_from_paintable (image, GDK_PAINTABLE (texture));
+  g_object_unref (texture);
+}
+
+/**
+ * gtk_image_load_file:
+ * @image: a #GtkImage
+ * @file: the #GFile to load
+ *
+ * Loads @file into @image without blocking.
+ *
+ * Unlike gtk_image_set_from_file(), the file is read and decoded in
+ * a separate thread. Until that is done, @image shows the
+ * “image-loading” icon. If the file can't be loaded, @image shows
+ * the “image-missing” icon, just like gtk_image_set_from_file().
+ *
+ * Setting other contents on @image before the file is loaded
+ * cancels the load.
+ **/
+void
+gtk_image_load_file (GtkImage *image,
+                     GFile    *file)
+{
+  GtkImagePrivate *priv = gtk_image_get_instance_private (image);
+
+  g_return_if_fail (GTK_IS_IMAGE (image));
+  g_return_if_fail (G_IS_FILE (file));
+
+  g_object_freeze_notify (G_OBJECT (image));
+
+  gtk_image_clear (image);
+
+  _gtk_icon_helper_set_icon_name (priv->icon_helper, "image-loading");
+  g_object_notify_by_pspec (G_OBJECT (image), image_props[PROP_ICON_NAME]);
+
+  priv->load_cancellable = g_cancellable_new ();
+  n_running_loads++;
+  gdk_texture_new_from_file_async (file,
+                                   priv->load_cancellable,
+                                   gtk_image_load_file_done,
+                                   image);
+
+  g_object_thaw_notify (G_OBJECT (image));
+}
+
 #ifndef GDK_PIXBUF_MAGIC_NUMBER
 #define GDK_PIXBUF_MAGIC_NUMBER (0x47646b50)    /* 'GdkP' */
 #endif
@@ -1256,6 +1342,12 @@ gtk_image_clear (GtkImage *image)
   g_object_freeze_notify (G_OBJECT (image));
   storage_type = gtk_image_get_storage_type (image);
 
+  if (priv->load_cancellable)
+    {
+      g_cancellable_cancel (priv->load_cancellable);
+      g_clear_object (&priv->load_cancellable);
+    }
+
   if (storage_type != GTK_IMAGE_EMPTY)
     g_object_notify_by_pspec (G_OBJECT (image), image_props[PROP_STORAGE_TYPE]);
 
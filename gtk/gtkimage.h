@@ -120,6 +120,9 @@ GDK_AVAILABLE_IN_ALL
 void gtk_image_set_from_file      (GtkImage        *image,
                                    const gchar     *filename);
 GDK_AVAILABLE_IN_ALL
+void gtk_image_load_file          (GtkImage        *image,
+                                   GFile           *file);
+GDK_AVAILABLE_IN_ALL
 void gtk_image_set_from_resource  (GtkImage        *image,
                                    const gchar     *resource_path);
 GDK_AVAILABLE_IN_ALL
@@ -42,6 +42,10 @@ void            gtk_image_get_image_size                (GtkImage
                                                          int                    *width,
                                                          int                    *height);
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+guint           gtk_image_get_n_running_loads           (void);
+
 
 G_END_DECLS
 
@@ -0,0 +1,190 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2018 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtklrucacheprivate.h"
+
+/* A hash table that is bounded by the number of entries and by their
+ * size in bytes and drops the least recently used entries first.
+ *
+ * Entries are their own keys: the hash and equal functions are called
+ * with entries or with stack allocated keys of the same type, and the
+ * free function is called when an entry is replaced or dropped.
+ */
+
+typedef struct _GtkLruNode GtkLruNode;
+
+struct _GtkLruCache {
+  GHashTable     *table;        /* entry => GtkLruNode */
+  GQueue          lru;          /* most recently used first */
+  GDestroyNotify  free_func;
+  guint           max_size;
+  gsize           max_bytes;
+  gsize           n_bytes;
+};
+
+struct _GtkLruNode {
+  GtkLruCache *cache;
+  gpointer     entry;
+  gsize        n_bytes;
+  GList        link;            /* in the LRU queue */
+};
+
+static void
+gtk_lru_node_free (gpointer data)
+{
+  GtkLruNode *node = data;
+  GtkLruCache *cache = node->cache;
+
+  g_queue_unlink (&cache->lru, &node->link);
+  cache->n_bytes -= node->n_bytes;
+
+  if (cache->free_func)
+    cache->free_func (node->entry);
+
+  g_slice_free (GtkLruNode, node);
+}
+
+GtkLruCache *
+gtk_lru_cache_new (GHashFunc      hash_func,
+                   GEqualFunc     equal_func,
+                   GDestroyNotify free_func,
+                   guint          max_size,
+                   gsize          max_bytes)
+{
+  GtkLruCache *cache;
+
+  g_return_val_if_fail (max_size > 0, NULL);
+
+  cache = g_slice_new0 (GtkLruCache);
+  cache->table = g_hash_table_new_full (hash_func, equal_func, NULL, gtk_lru_node_free);
+  g_queue_init (&cache->lru);
+  cache->free_func = free_func;
+  cache->max_size = max_size;
+  cache->max_bytes = max_bytes > 0 ? max_bytes : G_MAXSIZE;
+
+  return cache;
+}
+
+void
+gtk_lru_cache_free (GtkLruCache *cache)
+{
+  g_hash_table_unref (cache->table);
+
+  g_slice_free (GtkLruCache, cache);
+}
+
+/* Returns the entry equal to @key and marks it as most recently used */
+gpointer
+gtk_lru_cache_lookup (GtkLruCache   *cache,
+                      gconstpointer  key)
+{
+  GtkLruNode *node;
+
+  node = g_hash_table_lookup (cache->table, key);
+  if (node == NULL)
+    return NULL;
+
+  g_queue_unlink (&cache->lru, &node->link);
+  g_queue_push_head_link (&cache->lru, &node->link);
+
+  return node->entry;
+}
+
+/* Takes ownership of @entry and replaces an equal entry, if any.
+ * Drops least recently used entries until the cache is within its
+ * bounds again, but never @entry itself.
+ *
+ * Returns: the number of entries that were dropped
+ */
+guint
+gtk_lru_cache_insert (GtkLruCache *cache,
+                      gpointer     entry,
+                      gsize        n_bytes)
+{
+  GtkLruNode *node, *last;
+  guint n_evicted = 0;
+
+  /* Remove first, so the old entry isn't used as the key */
+  g_hash_table_remove (cache->table, entry);
+
+  node = g_slice_new0 (GtkLruNode);
+  node->cache = cache;
+  node->entry = entry;
+  node->n_bytes = n_bytes;
+  node->link.data = node;
+
+  g_hash_table_insert (cache->table, entry, node);
+  g_queue_push_head_link (&cache->lru, &node->link);
+  cache->n_bytes += n_bytes;
+
+  while ((g_hash_table_size (cache->table) > cache->max_size ||
+          cache->n_bytes > cache->max_bytes) &&
+         g_hash_table_size (cache->table) > 1)
+    {
+      last = g_queue_peek_tail (&cache->lru);
+      g_hash_table_remove (cache->table, last->entry);
+      n_evicted++;
+    }
+
+  return n_evicted;
+}
+
+typedef struct {
+  GtkLruCacheMatchFunc func;
+  gpointer             user_data;
+} MatchData;
+
+static gboolean
+gtk_lru_node_matches (gpointer key,
+                      gpointer value,
+                      gpointer data)
+{
+  MatchData *match = data;
+
+  return match->func (key, match->user_data);
+}
+
+/* Returns: the number of entries that were removed */
+guint
+gtk_lru_cache_remove_matching (GtkLruCache          *cache,
+                               GtkLruCacheMatchFunc  func,
+                               gpointer              user_data)
+{
+  MatchData match = { func, user_data };
+
+  return g_hash_table_foreach_remove (cache->table, gtk_lru_node_matches, &match);
+}
+
+void
+gtk_lru_cache_remove_all (GtkLruCache *cache)
+{
+  g_hash_table_remove_all (cache->table);
+}
+
+guint
+gtk_lru_cache_get_size (GtkLruCache *cache)
+{
+  return g_hash_table_size (cache->table);
+}
+
+gsize
+gtk_lru_cache_get_n_bytes (GtkLruCache *cache)
+{
+  return cache->n_bytes;
+}
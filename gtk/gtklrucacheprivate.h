@@ -0,0 +1,52 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2018 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_LRU_CACHE_PRIVATE_H__
+#define __GTK_LRU_CACHE_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkLruCache GtkLruCache;
+
+typedef gboolean (* GtkLruCacheMatchFunc) (gpointer entry,
+                                           gpointer user_data);
+
+GtkLruCache *           gtk_lru_cache_new                       (GHashFunc               hash_func,
+                                                                 GEqualFunc              equal_func,
+                                                                 GDestroyNotify          free_func,
+                                                                 guint                   max_size,
+                                                                 gsize                   max_bytes);
+void                    gtk_lru_cache_free                      (GtkLruCache            *cache);
+
+gpointer                gtk_lru_cache_lookup                    (GtkLruCache            *cache,
+                                                                 gconstpointer           key);
+guint                   gtk_lru_cache_insert                    (GtkLruCache            *cache,
+                                                                 gpointer                entry,
+                                                                 gsize                   n_bytes);
+guint                   gtk_lru_cache_remove_matching           (GtkLruCache            *cache,
+                                                                 GtkLruCacheMatchFunc    func,
+                                                                 gpointer                user_data);
+void                    gtk_lru_cache_remove_all                (GtkLruCache            *cache);
+
+guint                   gtk_lru_cache_get_size                  (GtkLruCache            *cache);
+gsize                   gtk_lru_cache_get_n_bytes               (GtkLruCache            *cache);
+
+G_END_DECLS
+
+#endif /* __GTK_LRU_CACHE_PRIVATE_H__ */
@@ -1279,6 +1279,29 @@ gtk_snapshot_get_offset (GtkSnapshot *snapshot,
     *y = current_state->translate_y;
 }
 
+/* Whether the nodes appended now are only moved, not scaled
+ * or rotated, by the transforms that are pushed. */
+gboolean
+gtk_snapshot_is_translation (GtkSnapshot *snapshot)
+{
+  guint i;
+
+  for (i = 0; i < snapshot->state_stack->len; i++)
+    {
+      const GtkSnapshotState *state = &g_array_index (snapshot->state_stack, GtkSnapshotState, i);
+      double xx, yx, xy, yy, x0, y0;
+
+      if (state->collect_func != gtk_snapshot_collect_transform)
+        continue;
+
+      if (!graphene_matrix_to_2d (&state->data.transform.transform, &xx, &yx, &xy, &yy, &x0, &y0) ||
+          xx != 1.0 || yy != 1.0 || xy != 0.0 || yx != 0.0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 /**
  * gtk_snapshot_append_node:
  * @snapshot: a #GtkSnapshot
@@ -98,6 +98,10 @@ struct _GtkSnapshotClass {
   GObjectClass           parent_class; /* it's really GdkSnapshotClass, but don't tell anyone! */
 };
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
+gboolean        gtk_snapshot_is_translation             (GtkSnapshot            *snapshot);
+
 G_END_DECLS
 
 #endif /* __GTK_SNAPSHOT_PRIVATE_H__ */
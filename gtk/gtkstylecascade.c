@@ -223,6 +223,30 @@ gtk_style_cascade_lookup (GtkStyleProvider    *provider,
   gtk_style_cascade_iter_clear (&iter);
 }
 
+static gboolean
+gtk_style_cascade_references (GtkStyleProvider *provider,
+                              GtkCssChange      change,
+                              gconstpointer     value)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+  GtkStyleCascadeIter iter;
+  GtkStyleProvider *item;
+
+  for (item = gtk_style_cascade_iter_init (cascade, &iter);
+       item;
+       item = gtk_style_cascade_iter_next (cascade, &iter))
+    {
+      if (gtk_style_provider_references (item, change, value))
+        {
+          gtk_style_cascade_iter_clear (&iter);
+          return TRUE;
+        }
+    }
+
+  gtk_style_cascade_iter_clear (&iter);
+  return FALSE;
+}
+
 static void
 gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -231,6 +255,7 @@ gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_scale = gtk_style_cascade_get_scale;
   iface->get_keyframes = gtk_style_cascade_get_keyframes;
   iface->lookup = gtk_style_cascade_lookup;
+  iface->references = gtk_style_cascade_references;
 }
 
 G_DEFINE_TYPE_EXTENDED (GtkStyleCascade, _gtk_style_cascade, G_TYPE_OBJECT, 0,
@@ -295,14 +320,14 @@ _gtk_style_cascade_set_parent (GtkStyleCascade *cascade,
       g_object_ref (parent);
       g_signal_connect_swapped (parent,
                                 "-gtk-private-changed",
-                                G_CALLBACK (gtk_style_provider_changed),
+                                G_CALLBACK (gtk_style_provider_forward_changed),
                                 cascade);
     }
 
   if (cascade->parent)
     {
       g_signal_handlers_disconnect_by_func (cascade->parent, 
-                                            gtk_style_provider_changed,
+                                            gtk_style_provider_forward_changed,
                                             cascade);
       g_object_unref (cascade->parent);
     }
@@ -326,7 +351,7 @@ _gtk_style_cascade_add_provider (GtkStyleCascade  *cascade,
   data.priority = priority;
   data.changed_signal_id = g_signal_connect_swapped (provider,
                                                      "-gtk-private-changed",
-                                                     G_CALLBACK (gtk_style_provider_changed),
+                                                     G_CALLBACK (gtk_style_provider_forward_changed),
                                                      cascade);
 
   /* ensure it gets removed first */
@@ -19,6 +19,7 @@
 
 #include "gtkstyleproviderprivate.h"
 
+#include "gtkcssnodestylecacheprivate.h"
 #include "gtkintl.h"
 #include "gtkprivate.h"
 #include "gtkwidgetpath.h"
@@ -45,13 +46,16 @@ static guint signals[LAST_SIGNAL];
 static void
 gtk_style_provider_default_init (GtkStyleProviderInterface *iface)
 {
+  /* The argument is the GtkCssSelectorTree of the rules that changed,
+   * or %NULL if anything may have changed */
   signals[CHANGED] = g_signal_new (I_("-gtk-private-changed"),
                                    G_TYPE_FROM_INTERFACE (iface),
                                    G_SIGNAL_RUN_LAST,
                                    G_STRUCT_OFFSET (GtkStyleProviderInterface, changed),
                                    NULL, NULL,
-                                   g_cclosure_marshal_VOID__VOID,
-                                   G_TYPE_NONE, 0);
+                                   g_cclosure_marshal_VOID__POINTER,
+                                   G_TYPE_NONE, 1,
+                                   G_TYPE_POINTER);
 
 }
 
@@ -115,12 +119,99 @@ gtk_style_provider_lookup (GtkStyleProvider    *provider,
   iface->lookup (provider, matcher, lookup, out_change);
 }
 
+/**
+ * gtk_style_provider_references:
+ * @provider: the provider
+ * @change: one of %GTK_CSS_CHANGE_CLASS, %GTK_CSS_CHANGE_NAME,
+ *     %GTK_CSS_CHANGE_ID or %GTK_CSS_CHANGE_STATE
+ * @value: the class as a #GQuark, the interned name or id, or the
+ *     #GtkStateFlags, packed into a pointer
+ *
+ * Checks if any selector of @provider mentions @value. If it does not,
+ * adding or removing @value from a node cannot change its style.
+ * States count as referenced if any of the flags is.
+ *
+ * Returns: %FALSE if @value does not matter to @provider
+ */
+gboolean
+gtk_style_provider_references (GtkStyleProvider *provider,
+                               GtkCssChange      change,
+                               gconstpointer     value)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), TRUE);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  /* Providers without rules, like GtkSettings, match nothing */
+  if (!iface->references)
+    return iface->lookup != NULL;
+
+  return iface->references (provider, change, value);
+}
+
+/**
+ * gtk_style_provider_resolve_value:
+ * @provider: the provider
+ * @deferred: what @provider passed to _gtk_css_lookup_set_deferred()
+ *
+ * Gets a value that a lookup with defer_values set did not get
+ * because that would have modified @provider, for example by
+ * parsing it. Such lookups may run in several threads at once,
+ * this must be called on the main thread.
+ *
+ * Returns: (transfer none): the value
+ */
+GtkCssValue *
+gtk_style_provider_resolve_value (GtkStyleProvider *provider,
+                                  gpointer          deferred)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), NULL);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  gtk_internal_return_val_if_fail (iface->resolve_value != NULL, NULL);
+
+  return iface->resolve_value (provider, deferred);
+}
+
 void
 gtk_style_provider_changed (GtkStyleProvider *provider)
+{
+  gtk_style_provider_changed_selectors (provider, NULL);
+}
+
+/**
+ * gtk_style_provider_changed_selectors:
+ * @provider: the provider
+ * @selectors: (allow-none): the selectors of all rules that changed,
+ *     or %NULL if anything may have changed
+ *
+ * Like gtk_style_provider_changed(), but tells handlers that only
+ * nodes matching @selectors need to be restyled. Handlers get
+ * @selectors as the argument of the signal.
+ */
+void
+gtk_style_provider_changed_selectors (GtkStyleProvider         *provider,
+                                      const GtkCssSelectorTree *selectors)
 {
   gtk_internal_return_if_fail (GTK_IS_STYLE_PROVIDER (provider));
 
-  g_signal_emit (provider, signals[CHANGED], 0);
+  gtk_css_shared_style_cache_remove_provider (provider);
+
+  g_signal_emit (provider, signals[CHANGED], 0, selectors);
+}
+
+/* For forwarding the changed signal of another provider,
+ * connected with g_signal_connect_swapped() */
+void
+gtk_style_provider_forward_changed (GtkStyleProvider         *provider,
+                                    const GtkCssSelectorTree *selectors)
+{
+  gtk_style_provider_changed_selectors (provider, selectors);
 }
 
 GtkSettings *
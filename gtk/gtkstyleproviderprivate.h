@@ -22,6 +22,7 @@
 #include "gtk/gtkcsskeyframesprivate.h"
 #include "gtk/gtkcsslookupprivate.h"
 #include "gtk/gtkcssmatcherprivate.h"
+#include "gtk/gtkcssselectorprivate.h"
 #include "gtk/gtkcssvalueprivate.h"
 #include <gtk/gtktypes.h>
 
@@ -48,8 +49,14 @@ struct _GtkStyleProviderInterface
   void                  (* emit_error)          (GtkStyleProvider *provider,
                                                  GtkCssSection           *section,
                                                  const GError            *error);
+  gboolean              (* references)          (GtkStyleProvider *provider,
+                                                 GtkCssChange             change,
+                                                 gconstpointer            value);
+  GtkCssValue *         (* resolve_value)       (GtkStyleProvider *provider,
+                                                 gpointer                 deferred);
   /* signal */
-  void                  (* changed)             (GtkStyleProvider *provider);
+  void                  (* changed)             (GtkStyleProvider *provider,
+                                                 const GtkCssSelectorTree *selectors);
 };
 
 GtkSettings *           gtk_style_provider_get_settings          (GtkStyleProvider *provider);
@@ -63,7 +70,18 @@ void                    gtk_style_provider_lookup                (GtkStyleProvid
                                                                   GtkCssLookup            *lookup,
                                                                   GtkCssChange            *out_change);
 
+gboolean                gtk_style_provider_references            (GtkStyleProvider *provider,
+                                                                  GtkCssChange             change,
+                                                                  gconstpointer            value);
+
+GtkCssValue *           gtk_style_provider_resolve_value         (GtkStyleProvider *provider,
+                                                                  gpointer                 deferred);
+
 void                    gtk_style_provider_changed               (GtkStyleProvider *provider);
+void                    gtk_style_provider_changed_selectors     (GtkStyleProvider *provider,
+                                                                  const GtkCssSelectorTree *selectors);
+void                    gtk_style_provider_forward_changed       (GtkStyleProvider *provider,
+                                                                  const GtkCssSelectorTree *selectors);
 
 void                    gtk_style_provider_emit_error            (GtkStyleProvider *provider,
                                                                   GtkCssSection           *section,
@@ -12764,6 +12764,25 @@ _gtk_widget_style_context_invalidated (GtkWidget *widget)
   g_signal_emit (widget, widget_signals[STYLE_UPDATED], 0);
 }
 
+/* Called instead of ::style-updated when an animation only changed values
+ * that are used when rendering, like opacity. Sizes and text are not
+ * affected, so this skips everything but the redraw. */
+void
+_gtk_widget_css_render_values_changed (GtkWidget     *widget,
+                                       GtkCssAffects  affects)
+{
+  gtk_widget_update_alpha (widget);
+
+  if (!widget->priv->anchored)
+    return;
+
+  /* transformed icons may draw outside the allocation */
+  if (affects & GTK_CSS_AFFECTS_CLIP)
+    gtk_widget_queue_allocate (widget);
+  else if (affects & GTK_CSS_AFFECTS_REDRAW)
+    gtk_widget_queue_draw (widget);
+}
+
 GtkCssNode *
 gtk_widget_get_css_node (GtkWidget *widget)
 {
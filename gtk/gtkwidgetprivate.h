@@ -167,6 +167,8 @@ struct _GtkWidgetPrivate
   GdkCursor *cursor;
 };
 
+/* Exported for the tests */
+GDK_AVAILABLE_IN_ALL
 GtkCssNode *  gtk_widget_get_css_node       (GtkWidget *widget);
 void         _gtk_widget_set_visible_flag   (GtkWidget *widget,
                                              gboolean   visible);
@@ -248,6 +250,8 @@ gboolean          _gtk_widget_captured_event               (GtkWidget      *widg
 GtkWidgetPath *   _gtk_widget_create_path                  (GtkWidget    *widget);
 void              gtk_widget_clear_path                    (GtkWidget    *widget);
 void              _gtk_widget_style_context_invalidated    (GtkWidget    *widget);
+void              _gtk_widget_css_render_values_changed    (GtkWidget    *widget,
+                                                            GtkCssAffects affects);
 
 void              _gtk_widget_update_parent_muxer          (GtkWidget    *widget);
 GtkActionMuxer *  _gtk_widget_get_action_muxer             (GtkWidget    *widget,
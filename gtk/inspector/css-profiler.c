@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2018 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "css-profiler.h"
+
+#include "gtkcelllayout.h"
+#include "gtkcellrenderertext.h"
+#include "gtkcssproviderprivate.h"
+#include "gtkliststore.h"
+#include "gtktogglebutton.h"
+#include "gtktreeview.h"
+
+enum
+{
+  PROP_0,
+  PROP_BUTTON
+};
+
+struct _GtkInspectorCssProfilerPrivate
+{
+  GtkListStore *model;
+  GtkTreeView *view;
+  GtkTreeViewColumn *column_time;
+  GtkCellRenderer *renderer_time;
+  GtkWidget *button;
+  guint update_source_id;
+};
+
+enum
+{
+  COLUMN_SELECTOR,
+  COLUMN_PROVIDER,
+  COLUMN_ATTEMPTS,
+  COLUMN_MATCHES,
+  COLUMN_RESTYLES,
+  COLUMN_TIME
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtkInspectorCssProfiler, gtk_inspector_css_profiler, GTK_TYPE_BOX)
+
+static gboolean
+update_profiles (gpointer data)
+{
+  GtkInspectorCssProfiler *sl = data;
+  GArray *profiles;
+  guint i;
+
+  profiles = gtk_css_provider_get_profiles ();
+
+  gtk_list_store_clear (sl->priv->model);
+
+  for (i = 0; i < profiles->len; i++)
+    {
+      GtkCssSelectorProfile *profile = &g_array_index (profiles, GtkCssSelectorProfile, i);
+
+      gtk_list_store_insert_with_values (sl->priv->model, NULL, -1,
+                                         COLUMN_SELECTOR, profile->selector,
+                                         COLUMN_PROVIDER, profile->provider,
+                                         COLUMN_ATTEMPTS, profile->attempts,
+                                         COLUMN_MATCHES, profile->matches,
+                                         COLUMN_RESTYLES, profile->restyles,
+                                         COLUMN_TIME, profile->time,
+                                         -1);
+    }
+
+  g_array_unref (profiles);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+toggle_record (GtkToggleButton         *button,
+               GtkInspectorCssProfiler *sl)
+{
+  if (gtk_toggle_button_get_active (button) == (sl->priv->update_source_id != 0))
+    return;
+
+  if (gtk_toggle_button_get_active (button))
+    {
+      gtk_css_provider_set_profiling (TRUE);
+      sl->priv->update_source_id = g_timeout_add_seconds (1, update_profiles, sl);
+      update_profiles (sl);
+    }
+  else
+    {
+      g_source_remove (sl->priv->update_source_id);
+      sl->priv->update_source_id = 0;
+      update_profiles (sl);
+      gtk_css_provider_set_profiling (FALSE);
+    }
+}
+
+static void
+cell_data_time (GtkCellLayout   *layout,
+                GtkCellRenderer *cell,
+                GtkTreeModel    *model,
+                GtkTreeIter     *iter,
+                gpointer         data)
+{
+  double time;
+  gchar *text;
+
+  gtk_tree_model_get (model, iter, COLUMN_TIME, &time, -1);
+
+  text = g_strdup_printf ("%.3f ms", time / 1000.0);
+  g_object_set (cell, "text", text, NULL);
+  g_free (text);
+}
+
+static void
+gtk_inspector_css_profiler_init (GtkInspectorCssProfiler *sl)
+{
+  sl->priv = gtk_inspector_css_profiler_get_instance_private (sl);
+  gtk_widget_init_template (GTK_WIDGET (sl));
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (sl->priv->column_time),
+                                      sl->priv->renderer_time,
+                                      cell_data_time,
+                                      NULL, NULL);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (sl->priv->model),
+                                        COLUMN_TIME,
+                                        GTK_SORT_DESCENDING);
+}
+
+static void
+constructed (GObject *object)
+{
+  GtkInspectorCssProfiler *sl = GTK_INSPECTOR_CSS_PROFILER (object);
+
+  g_signal_connect (sl->priv->button, "toggled",
+                    G_CALLBACK (toggle_record), sl);
+}
+
+static void
+finalize (GObject *object)
+{
+  GtkInspectorCssProfiler *sl = GTK_INSPECTOR_CSS_PROFILER (object);
+
+  if (sl->priv->update_source_id)
+    {
+      g_source_remove (sl->priv->update_source_id);
+      gtk_css_provider_set_profiling (FALSE);
+    }
+
+  G_OBJECT_CLASS (gtk_inspector_css_profiler_parent_class)->finalize (object);
+}
+
+static void
+get_property (GObject    *object,
+              guint       param_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+  GtkInspectorCssProfiler *sl = GTK_INSPECTOR_CSS_PROFILER (object);
+
+  switch (param_id)
+    {
+    case PROP_BUTTON:
+      g_value_set_object (value, sl->priv->button);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+      break;
+    }
+}
+
+static void
+set_property (GObject      *object,
+              guint         param_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+  GtkInspectorCssProfiler *sl = GTK_INSPECTOR_CSS_PROFILER (object);
+
+  switch (param_id)
+    {
+    case PROP_BUTTON:
+      sl->priv->button = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+      break;
+    }
+}
+
+static void
+gtk_inspector_css_profiler_class_init (GtkInspectorCssProfilerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->get_property = get_property;
+  object_class->set_property = set_property;
+  object_class->constructed = constructed;
+  object_class->finalize = finalize;
+
+  g_object_class_install_property (object_class, PROP_BUTTON,
+      g_param_spec_object ("button", NULL, NULL,
+                           GTK_TYPE_WIDGET, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+  gtk_widget_class_set_template_from_resource (widget_class, "/org/gtk/libgtk/inspector/css-profiler.ui");
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssProfiler, model);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssProfiler, view);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssProfiler, column_time);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssProfiler, renderer_time);
+}
+
+// vim: set et sw=2 ts=2:
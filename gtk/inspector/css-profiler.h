@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018 the GTK+ Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GTK_INSPECTOR_CSS_PROFILER_H_
+#define _GTK_INSPECTOR_CSS_PROFILER_H_
+
+#include <gtk/gtkbox.h>
+
+#define GTK_TYPE_INSPECTOR_CSS_PROFILER            (gtk_inspector_css_profiler_get_type())
+#define GTK_INSPECTOR_CSS_PROFILER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), GTK_TYPE_INSPECTOR_CSS_PROFILER, GtkInspectorCssProfiler))
+#define GTK_INSPECTOR_CSS_PROFILER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), GTK_TYPE_INSPECTOR_CSS_PROFILER, GtkInspectorCssProfilerClass))
+#define GTK_INSPECTOR_IS_CSS_PROFILER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), GTK_TYPE_INSPECTOR_CSS_PROFILER))
+#define GTK_INSPECTOR_IS_CSS_PROFILER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GTK_TYPE_INSPECTOR_CSS_PROFILER))
+#define GTK_INSPECTOR_CSS_PROFILER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), GTK_TYPE_INSPECTOR_CSS_PROFILER, GtkInspectorCssProfilerClass))
+
+
+typedef struct _GtkInspectorCssProfilerPrivate GtkInspectorCssProfilerPrivate;
+
+typedef struct _GtkInspectorCssProfiler
+{
+  GtkBox parent;
+  GtkInspectorCssProfilerPrivate *priv;
+} GtkInspectorCssProfiler;
+
+typedef struct _GtkInspectorCssProfilerClass
+{
+  GtkBoxClass parent;
+} GtkInspectorCssProfilerClass;
+
+G_BEGIN_DECLS
+
+GType      gtk_inspector_css_profiler_get_type   (void);
+
+G_END_DECLS
+
+#endif // _GTK_INSPECTOR_CSS_PROFILER_H_
+
+// vim: set et sw=2 ts=2:
@@ -0,0 +1,6 @@
+N_("Selector");
+N_("Style Sheet");
+N_("Tested");
+N_("Matched");
+N_("Restyles");
+N_("Time");
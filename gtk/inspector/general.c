@@ -26,6 +26,9 @@
 #include "gtkswitch.h"
 #include "gtklistbox.h"
 #include "gtkprivate.h"
+#include "gtkcssnodestylecacheprivate.h"
+#include "gtkcssvalueprivate.h"
+#include "gtkiconhelperprivate.h"
 #include "gtksizegroup.h"
 #include "gtkimage.h"
 #include "gtkadjustment.h"
@@ -66,6 +69,7 @@ struct _GtkInspectorGeneralPrivate
   GtkWidget *gl_box;
   GtkWidget *vulkan_box;
   GtkWidget *device_box;
+  GtkWidget *css_box;
   GtkWidget *gtk_version;
   GtkWidget *gdk_backend;
   GtkWidget *gsk_renderer;
@@ -783,6 +787,81 @@ init_device (GtkInspectorGeneral *gen)
   populate_seats (gen);
 }
 
+static void
+add_count_row (GtkInspectorGeneral *gen,
+               const char          *name,
+               guint                count,
+               gint                 indent)
+{
+  char *value;
+
+  value = g_strdup_printf ("%u", count);
+  add_label_row (gen, GTK_LIST_BOX (gen->priv->css_box), name, value, indent);
+  g_free (value);
+}
+
+static void
+add_size_row (GtkInspectorGeneral *gen,
+              const char          *name,
+              gsize                size,
+              gint                 indent)
+{
+  char *value;
+
+  value = g_format_size (size);
+  add_label_row (gen, GTK_LIST_BOX (gen->priv->css_box), name, value, indent);
+  g_free (value);
+}
+
+static void
+populate_css (GtkInspectorGeneral *gen)
+{
+  GtkCssValueInternStatistics values;
+  GtkCssSharedStyleCacheStatistics styles;
+  GtkIconHelperTextureCacheStatistics textures;
+  GList *list, *l;
+
+  list = gtk_container_get_children (GTK_CONTAINER (gen->priv->css_box));
+  for (l = list; l; l = l->next)
+    gtk_widget_destroy (GTK_WIDGET (l->data));
+  g_list_free (list);
+
+  gtk_css_value_get_intern_statistics (&values);
+  add_label_row (gen, GTK_LIST_BOX (gen->priv->css_box), "Interned CSS values", NULL, 0);
+  add_count_row (gen, "Values", values.size, 10);
+  add_count_row (gen, "References", values.references, 10);
+  add_count_row (gen, "Lookups", values.lookups, 10);
+  add_count_row (gen, "Hits", values.hits, 10);
+  add_count_row (gen, "Sweeps", values.sweeps, 10);
+  add_size_row (gen, "Memory", values.bytes, 10);
+  add_size_row (gen, "Memory saved", values.bytes_saved, 10);
+
+  gtk_css_shared_style_cache_get_statistics (&styles);
+  add_label_row (gen, GTK_LIST_BOX (gen->priv->css_box), "Shared style cache", NULL, 0);
+  add_count_row (gen, "Styles", styles.size, 10);
+  add_count_row (gen, "Lookups", styles.lookups, 10);
+  add_count_row (gen, "Hits", styles.hits, 10);
+  add_count_row (gen, "Inserts", styles.inserts, 10);
+  add_count_row (gen, "Evictions", styles.evictions, 10);
+
+  gtk_icon_helper_get_texture_cache_statistics (&textures);
+  add_label_row (gen, GTK_LIST_BOX (gen->priv->css_box), "Icon texture cache", NULL, 0);
+  add_count_row (gen, "Textures", textures.size, 10);
+  add_count_row (gen, "Lookups", textures.lookups, 10);
+  add_count_row (gen, "Hits", textures.hits, 10);
+  add_count_row (gen, "Inserts", textures.inserts, 10);
+  add_count_row (gen, "Evictions", textures.evictions, 10);
+}
+
+static void
+init_css (GtkInspectorGeneral *gen)
+{
+  /* The statistics change all the time, update them when shown */
+  g_signal_connect (gen, "map", G_CALLBACK (populate_css), NULL);
+
+  populate_css (gen);
+}
+
 static void
 gtk_inspector_general_init (GtkInspectorGeneral *gen)
 {
@@ -794,6 +873,7 @@ gtk_inspector_general_init (GtkInspectorGeneral *gen)
   init_gl (gen);
   init_vulkan (gen);
   init_device (gen);
+  init_css (gen);
 }
 
 static gboolean
@@ -812,6 +892,10 @@ keynav_failed (GtkWidget *widget, GtkDirectionType direction, GtkInspectorGenera
     next = gen->priv->vulkan_box;
   else if (direction == GTK_DIR_DOWN && widget == gen->priv->vulkan_box)
     next = gen->priv->device_box;
+  else if (direction == GTK_DIR_DOWN && widget == gen->priv->device_box)
+    next = gen->priv->css_box;
+  else if (direction == GTK_DIR_UP && widget == gen->priv->css_box)
+    next = gen->priv->device_box;
   else if (direction == GTK_DIR_UP && widget == gen->priv->device_box)
     next = gen->priv->vulkan_box;
   else if (direction == GTK_DIR_UP && widget == gen->priv->vulkan_box)
@@ -867,6 +951,7 @@ gtk_inspector_general_constructed (GObject *object)
    g_signal_connect (gen->priv->gl_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
    g_signal_connect (gen->priv->vulkan_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
    g_signal_connect (gen->priv->device_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
+   g_signal_connect (gen->priv->css_box, "keynav-failed", G_CALLBACK (keynav_failed), gen);
 }
 
 static void
@@ -903,6 +988,7 @@ gtk_inspector_general_class_init (GtkInspectorGeneralClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorGeneral, display_composited);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorGeneral, display_rgba);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorGeneral, device_box);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorGeneral, css_box);
 }
 
 // vim: set et sw=2 ts=2:
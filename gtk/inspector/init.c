@@ -28,6 +28,7 @@
 #include "cellrenderergraph.h"
 #include "css-editor.h"
 #include "css-node-tree.h"
+#include "css-profiler.h"
 #include "data-list.h"
 #include "general.h"
 #include "gestures.h"
@@ -66,6 +67,7 @@ gtk_inspector_init (void)
   g_type_ensure (GTK_TYPE_INSPECTOR_ACTIONS);
   g_type_ensure (GTK_TYPE_INSPECTOR_CSS_EDITOR);
   g_type_ensure (GTK_TYPE_INSPECTOR_CSS_NODE_TREE);
+  g_type_ensure (GTK_TYPE_INSPECTOR_CSS_PROFILER);
   g_type_ensure (GTK_TYPE_INSPECTOR_DATA_LIST);
   g_type_ensure (GTK_TYPE_INSPECTOR_GENERAL);
   g_type_ensure (GTK_TYPE_INSPECTOR_GESTURES);
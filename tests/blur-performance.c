@@ -1,6 +1,7 @@
 /* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
 
 #include <gsk/gskcairoblurprivate.h>
+#include <stdlib.h>
 
 static void
 init_surface (cairo_t *cr)
@@ -16,39 +17,59 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
-int
-main (int argc, char **argv)
+static void
+run_blur (int          size,
+          GskBlurFlags flags,
+          const char  *label)
 {
   cairo_surface_t *surface;
   cairo_t *cr;
   GTimer *timer;
   double msec;
   int i, j;
-  int size;
 
   timer = g_timer_new ();
 
-  size = 2000;
-
   surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
 
   cr = cairo_create (surface);
 
-  /* We do everything three times, first two as warmup */
+  g_print ("%dx%d, %s:\n", size, size, label);
+
+  /* We do everything twice, first as warmup */
   for (j = 0; j < 2; j++)
     {
       for (i = 1; i < 16; i++)
 	{
 	  init_surface (cr);
 	  g_timer_start (timer);
-	  gsk_cairo_blur_surface (surface, i, GSK_BLUR_X | GSK_BLUR_Y);
+	  gsk_cairo_blur_surface (surface, i, flags);
 	  msec = g_timer_elapsed (timer, NULL) * 1000;
 	  if (j == 1)
 	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec:\n", i, msec, size*size/(msec*1000));
 	}
     }
 
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
   g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  int size;
+
+  size = 2000;
+  if (argc > 1)
+    size = atoi (argv[1]);
+
+  g_print ("Using %s blur kernel\n", gsk_cairo_blur_get_implementation ());
+
+  run_blur (size, GSK_BLUR_X | GSK_BLUR_Y, "x and y");
+  run_blur (size, GSK_BLUR_X, "x only");
+  run_blur (size, GSK_BLUR_Y, "y only");
+  run_blur (200, GSK_BLUR_X | GSK_BLUR_Y, "x and y");
 
   return 0;
 }
@@ -0,0 +1,773 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Capacity benchmark for gtk4-broadwayd.
+ *
+ * This starts a broadwayd, connects a headless websocket consumer in
+ * place of the browser, and then runs a number of simulated clients.
+ * Each client shows a window and renders a scripted node tree, paced
+ * like GTK: a frame is only drawn once the previous one was acked.
+ *
+ * Run with --no-spawn to measure an already running daemon, in that
+ * case no server CPU time is reported.
+ */
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "broadway/broadway-protocol.h"
+
+#define SURFACE_WIDTH 640
+#define SURFACE_HEIGHT 480
+
+static int n_clients = 8;
+static int n_frames = 300;
+static int n_cells = 64;
+static char *display = NULL;
+static char *broadwayd = NULL;
+static gboolean no_spawn = FALSE;
+
+static GOptionEntry options[] = {
+  { "clients", 'c', 0, G_OPTION_ARG_INT, &n_clients, "Number of simulated clients", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames, "Frames to render per client", "N" },
+  { "cells", 0, 0, G_OPTION_ARG_INT, &n_cells, "Static nodes per frame", "N" },
+  { "display", 'd', 0, G_OPTION_ARG_STRING, &display, "Broadway display to use", ":DISPLAY" },
+  { "broadwayd", 0, 0, G_OPTION_ARG_FILENAME, &broadwayd, "Daemon to start", "PATH" },
+  { "no-spawn", 0, 0, G_OPTION_ARG_NONE, &no_spawn, "Use a running daemon", NULL },
+  { NULL }
+};
+
+typedef struct {
+  int index;
+  GThread *thread;
+  GSocketConnection *connection;
+  guint32 serial;
+  guint32 surface;
+
+  GArray *frame_times; /* gint64, microseconds */
+  gint64 encode_time;
+  guint64 request_bytes;
+} Client;
+
+typedef struct {
+  GSocketConnection *connection;
+  GCancellable *cancellable;
+  GThread *thread;
+
+  guint64 bytes;
+  guint64 node_bytes;
+  guint32 n_node_updates;
+  guint32 n_roundtrips;
+} Consumer;
+
+static int
+display_number (void)
+{
+  if (display[0] != ':' || !g_ascii_isdigit (display[1]))
+    {
+      g_printerr ("Unsupported display %s\n", display);
+      exit (1);
+    }
+
+  return strtol (display + 1, NULL, 10);
+}
+
+static GSocketAddress *
+get_daemon_address (void)
+{
+  GSocketAddress *address;
+  char *basename, *path;
+
+  basename = g_strdup_printf ("broadway%d.socket", display_number () + 1);
+  path = g_build_filename (g_get_user_runtime_dir (), basename, NULL);
+  address = g_unix_socket_address_new_with_type (path, -1,
+                                                 G_UNIX_SOCKET_ADDRESS_PATH);
+  g_free (path);
+  g_free (basename);
+
+  return address;
+}
+
+static GSocketConnection *
+connect_http (void)
+{
+  GSocketClient *client;
+  GSocketConnection *connection;
+  GError *error = NULL;
+
+  client = g_socket_client_new ();
+  connection = g_socket_client_connect_to_host (client, "localhost",
+                                                8080 + display_number (),
+                                                NULL, &error);
+  g_object_unref (client);
+
+  if (connection == NULL)
+    {
+      g_printerr ("Can't connect to the daemon: %s\n", error->message);
+      exit (1);
+    }
+
+  return connection;
+}
+
+/* Simulated clients */
+
+static void
+add_uint32 (GArray *nodes, guint32 v)
+{
+  g_array_append_val (nodes, v);
+}
+
+static void
+add_float (GArray *nodes, float f)
+{
+  add_uint32 (nodes, (guint32) (gint32) (f * 256.0f));
+}
+
+static void
+add_rect (GArray *nodes, float x, float y, float width, float height)
+{
+  add_float (nodes, x);
+  add_float (nodes, y);
+  add_float (nodes, width);
+  add_float (nodes, height);
+}
+
+/* A window with a mostly static grid of cells, a label-like cell that
+ * changes every 16 frames and a translucent box moving across it.
+ */
+static void
+build_frame (Client *client,
+             int     frame,
+             GArray *nodes)
+{
+  int columns = MAX (1, (int) sqrt (n_cells));
+  int cell_width = SURFACE_WIDTH / columns;
+  int cell_height = SURFACE_HEIGHT / ((n_cells + columns - 1) / columns);
+  int i;
+
+  add_uint32 (nodes, BROADWAY_NODE_CONTAINER);
+  add_uint32 (nodes, n_cells + 2);
+
+  add_uint32 (nodes, BROADWAY_NODE_COLOR);
+  add_rect (nodes, 0, 0, SURFACE_WIDTH, SURFACE_HEIGHT);
+  add_uint32 (nodes, 0xfff6f5f4);
+
+  for (i = 0; i < n_cells; i++)
+    {
+      guint32 color = 0xff000000 | ((i * 0x3b1d5) ^ (client->index * 0x10101));
+
+      if (i == client->index % n_cells)
+        color ^= (frame / 16) & 0xff;
+
+      add_uint32 (nodes, BROADWAY_NODE_COLOR);
+      add_rect (nodes,
+                (i % columns) * cell_width + 2, (i / columns) * cell_height + 2,
+                cell_width - 4, cell_height - 4);
+      add_uint32 (nodes, color);
+    }
+
+  add_uint32 (nodes, BROADWAY_NODE_OPACITY);
+  add_float (nodes, 0.5);
+  add_uint32 (nodes, BROADWAY_NODE_COLOR);
+  add_rect (nodes, (frame * 4) % (SURFACE_WIDTH - 64), SURFACE_HEIGHT / 2 - 32, 64, 64);
+  add_uint32 (nodes, 0xff3584e4);
+}
+
+static guint32
+send_request (Client             *client,
+              BroadwayRequestBase *base,
+              gsize               size,
+              guint32             type)
+{
+  GOutputStream *out;
+
+  base->size = size;
+  base->type = type;
+  base->serial = client->serial++;
+
+  out = g_io_stream_get_output_stream (G_IO_STREAM (client->connection));
+  if (!g_output_stream_write_all (out, base, size, NULL, NULL, NULL))
+    {
+      g_printerr ("Client %d: unable to write to the daemon\n", client->index);
+      exit (1);
+    }
+
+  client->request_bytes += size;
+
+  return base->serial;
+}
+
+#define send_simple_request(_client, _msg, _type) \
+  send_request (_client, (BroadwayRequestBase *) &_msg, sizeof (_msg), _type)
+
+static BroadwayReply *
+read_reply (Client *client)
+{
+  GInputStream *in;
+  BroadwayReply *reply;
+  guint32 size;
+
+  in = g_io_stream_get_input_stream (G_IO_STREAM (client->connection));
+
+  if (!g_input_stream_read_all (in, &size, sizeof (size), NULL, NULL, NULL) ||
+      size < sizeof (BroadwayReplyBase))
+    {
+      g_printerr ("Client %d: lost connection to the daemon\n", client->index);
+      exit (1);
+    }
+
+  reply = g_malloc0 (MAX (size, sizeof (BroadwayReply)));
+  reply->base.size = size;
+  if (!g_input_stream_read_all (in, (guchar *) reply + sizeof (size), size - sizeof (size), NULL, NULL, NULL))
+    {
+      g_printerr ("Client %d: lost connection to the daemon\n", client->index);
+      exit (1);
+    }
+
+  return reply;
+}
+
+static BroadwayReply *
+wait_for_reply (Client  *client,
+                guint32  serial)
+{
+  while (TRUE)
+    {
+      BroadwayReply *reply = read_reply (client);
+
+      if (reply->base.type != BROADWAY_REPLY_EVENT &&
+          reply->base.in_reply_to == serial)
+        return reply;
+
+      g_free (reply);
+    }
+}
+
+/* Roundtrip notifications go to every client, so check that it is ours */
+static void
+wait_for_roundtrip (Client  *client,
+                    guint32  tag)
+{
+  while (TRUE)
+    {
+      BroadwayReply *reply = read_reply (client);
+      gboolean done;
+
+      done = reply->base.type == BROADWAY_REPLY_EVENT &&
+             reply->event.msg.base.type == BROADWAY_EVENT_ROUNDTRIP_NOTIFY &&
+             reply->event.msg.roundtrip_notify.id == client->surface &&
+             reply->event.msg.roundtrip_notify.tag == tag;
+      g_free (reply);
+
+      if (done)
+        return;
+    }
+}
+
+static void
+send_nodes (Client *client,
+            GArray *nodes)
+{
+  gsize size = sizeof (BroadwayRequestSetNodes) + sizeof (guint32) * (nodes->len - 1);
+  BroadwayRequestSetNodes *msg = g_malloc (size);
+
+  memcpy (msg->data, nodes->data, sizeof (guint32) * nodes->len);
+  msg->id = client->surface;
+  send_request (client, (BroadwayRequestBase *) msg, size, BROADWAY_REQUEST_SET_NODES);
+  g_free (msg);
+}
+
+static gpointer
+client_thread (gpointer data)
+{
+  Client *client = data;
+  GSocketClient *socket_client;
+  GSocketAddress *address;
+  BroadwayRequestNewSurface new_surface;
+  BroadwayRequestShowSurface show_surface;
+  BroadwayRequestDestroySurface destroy_surface;
+  BroadwayRequestSync sync;
+  BroadwayRequestRoundtrip roundtrip;
+  BroadwayRequestFlush flush;
+  BroadwayReply *reply;
+  GArray *nodes;
+  GError *error = NULL;
+  int frame;
+
+  socket_client = g_socket_client_new ();
+  address = get_daemon_address ();
+  client->connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address), NULL, &error);
+  g_object_unref (address);
+  g_object_unref (socket_client);
+
+  if (client->connection == NULL)
+    {
+      g_printerr ("Client %d: %s\n", client->index, error->message);
+      exit (1);
+    }
+
+  new_surface.x = 20 * (client->index % 32);
+  new_surface.y = 20 * (client->index % 32);
+  new_surface.width = SURFACE_WIDTH;
+  new_surface.height = SURFACE_HEIGHT;
+  new_surface.is_temp = FALSE;
+  reply = wait_for_reply (client, send_simple_request (client, new_surface, BROADWAY_REQUEST_NEW_SURFACE));
+  client->surface = reply->new_surface.id;
+  g_free (reply);
+
+  show_surface.id = client->surface;
+  send_simple_request (client, show_surface, BROADWAY_REQUEST_SHOW_SURFACE);
+
+  nodes = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  for (frame = 0; frame < n_frames; frame++)
+    {
+      gint64 start, frame_time;
+
+      g_array_set_size (nodes, 0);
+      build_frame (client, frame, nodes);
+
+      start = g_get_monotonic_time ();
+      send_nodes (client, nodes);
+
+      /* The daemon answers a sync once it has written out the frame */
+      reply = wait_for_reply (client, send_simple_request (client, sync, BROADWAY_REQUEST_SYNC));
+      g_free (reply);
+      client->encode_time += g_get_monotonic_time () - start;
+
+      roundtrip.id = client->surface;
+      roundtrip.tag = frame;
+      send_simple_request (client, roundtrip, BROADWAY_REQUEST_ROUNDTRIP);
+      send_simple_request (client, flush, BROADWAY_REQUEST_FLUSH);
+      wait_for_roundtrip (client, frame);
+
+      frame_time = g_get_monotonic_time () - start;
+      g_array_append_val (client->frame_times, frame_time);
+    }
+
+  destroy_surface.id = client->surface;
+  send_simple_request (client, destroy_surface, BROADWAY_REQUEST_DESTROY_SURFACE);
+  reply = wait_for_reply (client, send_simple_request (client, sync, BROADWAY_REQUEST_SYNC));
+  g_free (reply);
+
+  g_array_unref (nodes);
+  g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+  g_object_unref (client->connection);
+
+  return NULL;
+}
+
+/* Headless consumer */
+
+static void
+consumer_send_roundtrip_notify (Consumer *consumer,
+                                guint32   serial,
+                                guint32   id,
+                                guint32   tag)
+{
+  guchar frame[2 + 5 * 4];
+  guint32 *p = (guint32 *) (frame + 2);
+
+  frame[0] = 0x80 | 0x2; /* fin, binary */
+  frame[1] = 5 * 4;
+  p[0] = g_htonl (BROADWAY_EVENT_ROUNDTRIP_NOTIFY);
+  p[1] = g_htonl (serial);
+  p[2] = g_htonl (0);
+  p[3] = g_htonl (id);
+  p[4] = g_htonl (tag);
+
+  g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (consumer->connection)),
+                             frame, sizeof (frame), NULL, consumer->cancellable, NULL);
+}
+
+#define GET_16(p) ((p)[0] | ((p)[1] << 8))
+#define GET_32(p) ((guint32) (p)[0] | ((guint32) (p)[1] << 8) | ((guint32) (p)[2] << 16) | ((guint32) (p)[3] << 24))
+
+/* Walks the commands like broadway.js does, acking roundtrips right away */
+static void
+consumer_handle_commands (Consumer     *consumer,
+                          const guchar *data,
+                          gsize         len)
+{
+  const guchar *p = data, *end = data + len;
+
+  while (p + 5 <= end)
+    {
+      char command = *p++;
+      guint32 serial = GET_32 (p);
+      guint32 size, flags;
+
+      p += 4;
+
+      switch (command)
+        {
+        case BROADWAY_OP_DISCONNECTED:
+        case BROADWAY_OP_UNGRAB_POINTER:
+          break;
+        case BROADWAY_OP_NEW_SURFACE:
+          p += 2 + 2 + 2 + 2 + 2 + 1;
+          break;
+        case BROADWAY_OP_SHOW_SURFACE:
+        case BROADWAY_OP_HIDE_SURFACE:
+        case BROADWAY_OP_DESTROY_SURFACE:
+        case BROADWAY_OP_RAISE_SURFACE:
+        case BROADWAY_OP_LOWER_SURFACE:
+        case BROADWAY_OP_SET_SHOW_KEYBOARD:
+          p += 2;
+          break;
+        case BROADWAY_OP_SET_TRANSIENT_FOR:
+          p += 2 + 2;
+          break;
+        case BROADWAY_OP_GRAB_POINTER:
+          p += 2 + 1;
+          break;
+        case BROADWAY_OP_ROUNDTRIP:
+          consumer->n_roundtrips++;
+          consumer_send_roundtrip_notify (consumer, serial, GET_16 (p), GET_32 (p + 2));
+          p += 2 + 4;
+          break;
+        case BROADWAY_OP_MOVE_RESIZE:
+          p += 2;
+          flags = *p++;
+          if (flags & 1)
+            p += 4;
+          if (flags & 2)
+            p += 4;
+          break;
+        case BROADWAY_OP_UPLOAD_TEXTURE:
+          size = GET_32 (p + 4);
+          p += 4 + 4 + size;
+          break;
+        case BROADWAY_OP_RELEASE_TEXTURE:
+          p += 4;
+          break;
+        case BROADWAY_OP_SET_NODES:
+          size = GET_32 (p + 2);
+          p += 2 + 4 + 4 * size;
+          consumer->node_bytes += 1 + 4 + 2 + 4 + 4 * size;
+          consumer->n_node_updates++;
+          break;
+        default:
+          g_printerr ("Consumer: unknown op %c\n", command);
+          return;
+        }
+    }
+}
+
+static gboolean
+read_exactly (Consumer *consumer,
+              gpointer  buffer,
+              gsize     size)
+{
+  GInputStream *in = g_io_stream_get_input_stream (G_IO_STREAM (consumer->connection));
+  gsize read;
+
+  return g_input_stream_read_all (in, buffer, size, &read, consumer->cancellable, NULL) &&
+         read == size;
+}
+
+static gpointer
+consumer_thread (gpointer data)
+{
+  Consumer *consumer = data;
+  guchar header[8];
+  guchar *payload = NULL;
+  gsize payload_size = 0;
+
+  while (read_exactly (consumer, header, 2))
+    {
+      guint64 len = header[1] & 0x7f;
+
+      if (len == 126)
+        {
+          if (!read_exactly (consumer, header, 2))
+            break;
+          len = ((guint64) header[0] << 8) | header[1];
+        }
+      else if (len == 127)
+        {
+          if (!read_exactly (consumer, header, 8))
+            break;
+          len = GUINT64_FROM_BE (*(guint64 *) header);
+        }
+
+      if (len > payload_size)
+        {
+          payload_size = len;
+          payload = g_realloc (payload, payload_size);
+        }
+
+      if (!read_exactly (consumer, payload, len))
+        break;
+
+      consumer->bytes += len;
+      consumer_handle_commands (consumer, payload, len);
+    }
+
+  g_free (payload);
+
+  return NULL;
+}
+
+static void
+consumer_start (Consumer *consumer)
+{
+  const char *handshake =
+    "GET /socket HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Protocol: broadway\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n";
+  GString *response;
+  char c;
+
+  consumer->connection = connect_http ();
+  consumer->cancellable = g_cancellable_new ();
+
+  g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (consumer->connection)),
+                             handshake, strlen (handshake), NULL, NULL, NULL);
+
+  response = g_string_new ("");
+  while (!g_str_has_suffix (response->str, "\r\n\r\n"))
+    {
+      if (!read_exactly (consumer, &c, 1))
+        {
+          g_printerr ("Consumer: websocket handshake failed\n");
+          exit (1);
+        }
+      g_string_append_c (response, c);
+    }
+
+  if (!g_str_has_prefix (response->str, "HTTP/1.1 101"))
+    {
+      g_printerr ("Consumer: websocket handshake failed:\n%s", response->str);
+      exit (1);
+    }
+
+  g_string_free (response, TRUE);
+
+  consumer->thread = g_thread_new ("consumer", consumer_thread, consumer);
+}
+
+static void
+consumer_stop (Consumer *consumer)
+{
+  g_cancellable_cancel (consumer->cancellable);
+  g_thread_join (consumer->thread);
+  g_object_unref (consumer->cancellable);
+  g_object_unref (consumer->connection);
+}
+
+/* The daemon */
+
+static GSubprocess *
+start_daemon (void)
+{
+  GSubprocess *subprocess;
+  GSocketClient *socket_client;
+  GSocketAddress *address;
+  GError *error = NULL;
+  int i;
+
+  subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error,
+                                 broadwayd, display, NULL);
+  if (subprocess == NULL)
+    {
+      g_printerr ("Can't start %s: %s\n", broadwayd, error->message);
+      exit (1);
+    }
+
+  /* Wait for it to listen */
+  socket_client = g_socket_client_new ();
+  address = get_daemon_address ();
+  for (i = 0; i < 100; i++)
+    {
+      GSocketConnection *connection;
+
+      connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+      if (connection)
+        {
+          g_object_unref (connection);
+          break;
+        }
+      g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+    }
+  g_object_unref (address);
+  g_object_unref (socket_client);
+
+  if (i == 100)
+    {
+      g_printerr ("%s did not start listening on %s\n", broadwayd, display);
+      exit (1);
+    }
+
+  return subprocess;
+}
+
+/* User and system time of the process in seconds, or -1 */
+static double
+get_cpu_time (GSubprocess *subprocess)
+{
+  char *path, *contents, *p;
+  char **fields;
+  double cpu_time = -1;
+
+  if (subprocess == NULL)
+    return -1;
+
+  path = g_strdup_printf ("/proc/%s/stat", g_subprocess_get_identifier (subprocess));
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      /* Fields after the command name, utime and stime are the 14th and 15th */
+      p = strrchr (contents, ')');
+      fields = g_strsplit (p ? p + 2 : contents, " ", -1);
+      if (g_strv_length (fields) > 12)
+        cpu_time = (g_ascii_strtod (fields[11], NULL) + g_ascii_strtod (fields[12], NULL)) / sysconf (_SC_CLK_TCK);
+      g_strfreev (fields);
+      g_free (contents);
+    }
+  g_free (path);
+
+  return cpu_time;
+}
+
+static void
+print_daemon_stats (void)
+{
+  GSocketConnection *connection;
+  const char *request = "GET /stats HTTP/1.0\r\nHost: localhost\r\n\r\n";
+  GInputStream *in;
+  GString *response;
+  char buffer[1024];
+  gssize len;
+  char *body;
+
+  connection = connect_http ();
+  g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (connection)),
+                             request, strlen (request), NULL, NULL, NULL);
+
+  response = g_string_new ("");
+  in = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  while ((len = g_input_stream_read (in, buffer, sizeof (buffer), NULL, NULL)) > 0)
+    g_string_append_len (response, buffer, len);
+
+  body = strstr (response->str, "\r\n\r\n");
+  if (body)
+    g_print ("Daemon stats: %s", body + 4);
+
+  g_string_free (response, TRUE);
+  g_object_unref (connection);
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+
+  return ta < tb ? -1 : ta > tb;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GSubprocess *daemon = NULL;
+  Consumer consumer = { NULL, };
+  Client *clients;
+  GArray *frame_times;
+  gint64 start, encode_time;
+  double elapsed, cpu_start, cpu_time;
+  int i, total_frames;
+
+  context = g_option_context_new ("- broadwayd scaling benchmark");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (display == NULL)
+    display = g_strdup (":42");
+  if (broadwayd == NULL)
+    broadwayd = g_strdup ("gtk4-broadwayd");
+  n_clients = MAX (n_clients, 1);
+  n_frames = MAX (n_frames, 1);
+  n_cells = MAX (n_cells, 1);
+
+  if (!no_spawn)
+    daemon = start_daemon ();
+
+  consumer_start (&consumer);
+
+  cpu_start = get_cpu_time (daemon);
+  start = g_get_monotonic_time ();
+
+  clients = g_new0 (Client, n_clients);
+  for (i = 0; i < n_clients; i++)
+    {
+      clients[i].index = i;
+      clients[i].frame_times = g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_frames);
+      clients[i].thread = g_thread_new ("client", client_thread, &clients[i]);
+    }
+
+  frame_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+  encode_time = 0;
+  for (i = 0; i < n_clients; i++)
+    {
+      g_thread_join (clients[i].thread);
+      g_array_append_vals (frame_times, clients[i].frame_times->data, clients[i].frame_times->len);
+      encode_time += clients[i].encode_time;
+      g_array_unref (clients[i].frame_times);
+    }
+
+  elapsed = (g_get_monotonic_time () - start) / (double) G_USEC_PER_SEC;
+  cpu_time = get_cpu_time (daemon);
+  total_frames = frame_times->len;
+  g_array_sort (frame_times, compare_times);
+
+  g_print ("%d clients, %d frames each, %.2f s\n", n_clients, n_frames, elapsed);
+  g_print ("Frames per second: %.1f total, %.1f per client\n",
+           total_frames / elapsed, total_frames / elapsed / n_clients);
+  g_print ("Bytes per frame: %.0f to the browser, %.0f of it node updates (%u updates)\n",
+           (double) consumer.bytes / total_frames,
+           (double) consumer.node_bytes / total_frames,
+           consumer.n_node_updates);
+  g_print ("Encode latency: %.3f ms average\n",
+           encode_time / 1000.0 / total_frames);
+  g_print ("Frame latency: %.3f ms median, %.3f ms 95th percentile, %.3f ms max\n",
+           g_array_index (frame_times, gint64, total_frames / 2) / 1000.0,
+           g_array_index (frame_times, gint64, total_frames * 95 / 100) / 1000.0,
+           g_array_index (frame_times, gint64, total_frames - 1) / 1000.0);
+  if (cpu_start >= 0 && cpu_time >= 0)
+    g_print ("Server CPU: %.1f%% per client, %.3f ms per frame\n",
+             100 * (cpu_time - cpu_start) / elapsed / n_clients,
+             1000 * (cpu_time - cpu_start) / total_frames);
+
+  print_daemon_stats ();
+
+  consumer_stop (&consumer);
+
+  if (daemon)
+    {
+      g_subprocess_force_exit (daemon);
+      g_subprocess_wait (daemon, NULL, NULL);
+      g_object_unref (daemon);
+    }
+
+  g_array_unref (frame_times);
+  g_free (clients);
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+/* Parsing benchmark for GtkCssProvider.
+ *
+ * Loads a stylesheet, by default Adwaita's gtk-contained.css, from
+ * memory a number of times and reports how long parsing took. Loading
+ * from memory bypasses the parsed theme cache, so this measures the
+ * tokenizer and the value parsers.
+ */
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+static int n_runs = 50;
+static int n_warmup = 5;
+
+static GOptionEntry options[] = {
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &n_runs, "Number of measured runs", "N" },
+  { "warmup", 'w', 0, G_OPTION_ARG_INT, &n_warmup, "Number of runs to discard", "N" },
+  { NULL }
+};
+
+static void
+parsing_error_cb (GtkCssProvider *provider,
+                  GtkCssSection  *section,
+                  const GError   *error,
+                  guint          *n_errors)
+{
+  *n_errors += 1;
+}
+
+static gint64
+parse_once (const char *data,
+            gsize       length,
+            guint      *n_errors)
+{
+  GtkCssProvider *provider;
+  gint64 start, end;
+
+  provider = gtk_css_provider_new ();
+  g_signal_connect (provider, "parsing-error", G_CALLBACK (parsing_error_cb), n_errors);
+
+  start = g_get_monotonic_time ();
+  gtk_css_provider_load_from_data (provider, data, length);
+  end = g_get_monotonic_time ();
+
+  g_object_unref (provider);
+
+  return end - start;
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+
+  return ta < tb ? -1 : ta > tb;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  const char *filename;
+  char *default_filename;
+  char *data;
+  gsize length;
+  GArray *times;
+  gint64 total;
+  guint n_errors;
+  int i;
+
+  context = g_option_context_new ("[FILE] - CSS parsing benchmark");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  gtk_init ();
+
+  default_filename = g_build_filename (GTK_SRCDIR, "..", "gtk", "theme", "Adwaita", "gtk-contained.css", NULL);
+  filename = argc > 1 ? argv[1] : default_filename;
+
+  if (!g_file_get_contents (filename, &data, &length, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  n_errors = 0;
+  for (i = 0; i < n_warmup; i++)
+    parse_once (data, length, &n_errors);
+
+  n_errors = 0;
+  total = 0;
+  times = g_array_sized_new (FALSE, FALSE, sizeof (gint64), n_runs);
+  for (i = 0; i < n_runs; i++)
+    {
+      gint64 t = parse_once (data, length, &n_errors);
+
+      g_array_append_val (times, t);
+      total += t;
+    }
+
+  if (n_runs > 0)
+    {
+      g_array_sort (times, compare_times);
+
+      g_print ("%s: %" G_GSIZE_FORMAT " bytes, %d runs\n", filename, length, n_runs);
+      g_print ("  min     %8.3f ms\n", g_array_index (times, gint64, 0) / 1000.0);
+      g_print ("  median  %8.3f ms\n", g_array_index (times, gint64, n_runs / 2) / 1000.0);
+      g_print ("  mean    %8.3f ms\n", total / 1000.0 / n_runs);
+      g_print ("  max     %8.3f ms\n", g_array_index (times, gint64, n_runs - 1) / 1000.0);
+      g_print ("  %.1f MB/s, %u parsing errors per run\n",
+               length / (g_array_index (times, gint64, n_runs / 2) / (double) G_USEC_PER_SEC) / (1024 * 1024),
+               n_errors / n_runs);
+    }
+
+  g_array_unref (times);
+  g_free (data);
+  g_free (default_filename);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+static const struct {
+  GdkMemoryFormat format;
+  const char *name;
+  int bpp;
+} formats[] = {
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, "B8G8R8A8_PREMULTIPLIED", 4 },
+  { GDK_MEMORY_A8R8G8B8_PREMULTIPLIED, "A8R8G8B8_PREMULTIPLIED", 4 },
+  { GDK_MEMORY_B8G8R8A8, "B8G8R8A8", 4 },
+  { GDK_MEMORY_A8R8G8B8, "A8R8G8B8", 4 },
+  { GDK_MEMORY_R8G8B8A8, "R8G8B8A8", 4 },
+  { GDK_MEMORY_A8B8G8R8, "A8B8G8R8", 4 },
+  { GDK_MEMORY_R8G8B8, "R8G8B8", 3 },
+  { GDK_MEMORY_B8G8R8, "B8G8R8", 3 },
+};
+
+int
+main (int argc, char **argv)
+{
+  GTimer *timer;
+  guchar *data, *dest;
+  GBytes *bytes;
+  double msec;
+  int size, n_runs;
+  int i, j;
+
+  size = 2000;
+  if (argc > 1)
+    size = atoi (argv[1]);
+  n_runs = 10;
+
+  /* Run with GDK_MEMORY_CONVERT_IMPL=c to compare with the scalar code */
+  timer = g_timer_new ();
+  dest = g_malloc (size * size * 4);
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      GdkTexture *texture;
+
+      data = g_malloc (size * size * formats[i].bpp);
+      for (j = 0; j < size * size * formats[i].bpp; j++)
+        data[j] = g_random_int_range (0, 256);
+      bytes = g_bytes_new_take (data, size * size * formats[i].bpp);
+
+      texture = gdk_memory_texture_new (size, size,
+                                        formats[i].format,
+                                        bytes,
+                                        size * formats[i].bpp);
+
+      /* warmup */
+      gdk_texture_download (texture, dest, size * 4);
+
+      g_timer_start (timer);
+      for (j = 0; j < n_runs; j++)
+        gdk_texture_download (texture, dest, size * 4);
+      msec = g_timer_elapsed (timer, NULL) * 1000 / n_runs;
+
+      g_print ("%-24s: %.2f msec, %.2f kpixels/msec\n",
+               formats[i].name, msec, size * size / (msec * 1000));
+
+      g_object_unref (texture);
+      g_bytes_unref (bytes);
+    }
+
+  g_free (dest);
+  g_timer_destroy (timer);
+
+  return 0;
+}
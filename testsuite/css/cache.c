@@ -0,0 +1,212 @@
+/* Tests that a theme loaded from the theme cache is the same
+ * as the theme parsed from its file.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+/* The colors are stored printed, the other values as they were written */
+static const char *theme =
+  "@define-color base #3465a4;\n"
+  "@define-color translucent rgba(52, 101, 164, 0.35);\n"
+  "@define-color named red;\n"
+  "@define-color clear transparent;\n"
+  "@define-color ref @base;\n"
+  "@define-color shaded shade(@base, 1.25);\n"
+  "@define-color lighter lighter(@base);\n"
+  "@define-color darker darker(#abcdef);\n"
+  "@define-color mixed mix(@base, @named, 0.3);\n"
+  "@define-color faded alpha(@shaded, 0.5);\n"
+  "\n"
+  "@keyframes pulse {\n"
+  "  from { opacity: 1; }\n"
+  "  to { opacity: 0.5; }\n"
+  "}\n"
+  "\n"
+  "* { color: @ref; }\n"
+  "button { background-color: @mixed; border: 1px solid @faded; }\n"
+  "button:hover { background-image: linear-gradient(to bottom, @lighter, @darker); }\n"
+  "label.title { font: bold 12px Sans; padding: 1px 2px 3px 4px; }\n"
+  "entry > text selection { color: @clear; background-color: @translucent; }\n"
+  "spinner:checked { animation: pulse 1s infinite; }\n"
+  "#name, .class:not(:backdrop) { margin: 3px; box-shadow: inset 0 1px alpha(black, 0.1); }\n";
+
+static char *cache_dir;
+static char *theme_dir;
+
+static void
+parsing_error (GtkCssProvider *provider,
+               GtkCssSection  *section,
+               const GError   *error)
+{
+  g_error ("%s", error->message);
+}
+
+static GtkCssProvider *
+provider_new (void)
+{
+  GtkCssProvider *provider;
+
+  provider = gtk_css_provider_new ();
+  g_signal_connect (provider, "parsing-error", G_CALLBACK (parsing_error), NULL);
+
+  return provider;
+}
+
+/* Caches are named after the checksum of the file's URI */
+static guint
+count_caches (const char *path)
+{
+  GFile *file;
+  char *uri, *prefix;
+  const char *name;
+  guint n = 0;
+  GDir *dir;
+
+  file = g_file_new_for_path (path);
+  uri = g_file_get_uri (file);
+  prefix = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+
+  dir = g_dir_open (cache_dir, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          if (g_str_has_prefix (name, prefix) && g_str_has_suffix (name, ".cache"))
+            n++;
+        }
+      g_dir_close (dir);
+    }
+
+  g_free (prefix);
+  g_free (uri);
+  g_object_unref (file);
+
+  return n;
+}
+
+static char *
+write_theme (const char *name,
+             const char *contents)
+{
+  char *path;
+
+  path = g_build_filename (theme_dir, name, NULL);
+  g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+
+  return path;
+}
+
+static char *
+load_path (const char *path)
+{
+  GtkCssProvider *provider;
+  char *result;
+
+  provider = provider_new ();
+  gtk_css_provider_load_from_path (provider, path);
+  result = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  return result;
+}
+
+static void
+test_round_trip (void)
+{
+  GtkCssProvider *provider;
+  char *path, *parsed, *written, *cached;
+
+  provider = provider_new ();
+  gtk_css_provider_load_from_data (provider, theme, -1);
+  parsed = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  path = write_theme ("round-trip.css", theme);
+  g_assert_cmpuint (count_caches (path), ==, 0);
+
+  /* The first load parses the file and writes the cache */
+  written = load_path (path);
+  g_assert_cmpuint (count_caches (path), ==, 1);
+
+  /* The second load reads it */
+  cached = load_path (path);
+  g_assert_cmpuint (count_caches (path), ==, 1);
+
+  g_assert_cmpstr (written, ==, parsed);
+  g_assert_cmpstr (cached, ==, parsed);
+
+  g_free (cached);
+  g_free (written);
+  g_free (parsed);
+  g_free (path);
+}
+
+static void
+test_prune (void)
+{
+  char *path, *first, *second;
+
+  path = write_theme ("prune.css", "* { color: red; }");
+  first = load_path (path);
+  g_assert_cmpuint (count_caches (path), ==, 1);
+  g_free (path);
+
+  /* The cache of the old contents is replaced */
+  path = write_theme ("prune.css", "* { color: blue; }");
+  second = load_path (path);
+  g_assert_cmpuint (count_caches (path), ==, 1);
+  g_assert_cmpstr (first, !=, second);
+  g_free (second);
+
+  second = load_path (path);
+  g_assert_cmpuint (count_caches (path), ==, 1);
+  g_assert_cmpstr (strstr (second, "rgb(0,0,255)"), !=, NULL);
+
+  g_free (second);
+  g_free (first);
+  g_free (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  char *tmp;
+  int result;
+
+  /* Must happen before anything asks for the cache dir */
+  tmp = g_dir_make_tmp ("gtk-css-cache-XXXXXX", NULL);
+  g_assert_nonnull (tmp);
+  theme_dir = g_build_filename (tmp, "themes", NULL);
+  g_mkdir (theme_dir, 0755);
+  g_setenv ("XDG_CACHE_HOME", tmp, TRUE);
+  cache_dir = g_build_filename (tmp, "gtk-4.0", "css", NULL);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cache/round-trip", test_round_trip);
+  g_test_add_func ("/cache/prune", test_prune);
+
+  result = g_test_run ();
+
+  g_free (cache_dir);
+  g_free (theme_dir);
+  g_free (tmp);
+
+  return result;
+}
@@ -0,0 +1,482 @@
+/* Tests that styles follow changes to the nodes and to the style
+ * providers when only parts of the style tree are recomputed.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#define GTK_COMPILATION
+#include "gtk/gtkcssnodeprivate.h"
+#include "gtk/gtkcssnodestylecacheprivate.h"
+#include "gtk/gtkcssproviderprivate.h"
+#include "gtk/gtkwidgetprivate.h"
+
+/* A widget with a name no theme has rules for, so that only the rules
+ * of the tests decide which changes it gets restyled for. */
+typedef GtkWidget RestyleTestWidget;
+typedef GtkWidgetClass RestyleTestWidgetClass;
+
+static GType restyle_test_widget_get_type (void);
+
+G_DEFINE_TYPE (RestyleTestWidget, restyle_test_widget, GTK_TYPE_WIDGET)
+
+static void
+restyle_test_widget_class_init (RestyleTestWidgetClass *klass)
+{
+  gtk_widget_class_set_css_name (klass, "restyletest");
+}
+
+static void
+restyle_test_widget_init (RestyleTestWidget *widget)
+{
+}
+
+static void
+assert_color (GtkWidget  *widget,
+              const char *expected)
+{
+  GdkRGBA color, expected_color;
+
+  gdk_rgba_parse (&expected_color, expected);
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget), &color);
+
+  g_assert_true (gdk_rgba_equal (&color, &expected_color));
+}
+
+static void
+test_reload_state_rule (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *widget;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "restyletest { color: blue; }\n"
+                                   "restyletest.a { color: yellow; }\n"
+                                   "restyletest.b { color: green; }\n",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  widget = g_object_ref_sink (g_object_new (restyle_test_widget_get_type (), NULL));
+  assert_color (widget, "blue");
+
+  /* The new rule doesn't match until the widget is hovered, but the
+   * widget must learn that it depends on being hovered now */
+  gtk_css_provider_load_from_data (provider,
+                                   "restyletest { color: blue; }\n"
+                                   "restyletest.a { color: yellow; }\n"
+                                   "restyletest.b { color: green; }\n"
+                                   "restyletest:hover { color: red; }\n",
+                                   -1);
+  assert_color (widget, "blue");
+
+  gtk_widget_set_state_flags (widget, GTK_STATE_FLAG_PRELIGHT, FALSE);
+  assert_color (widget, "red");
+
+  gtk_widget_unset_state_flags (widget, GTK_STATE_FLAG_PRELIGHT);
+  assert_color (widget, "blue");
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (widget);
+  g_object_unref (provider);
+}
+
+/* How often the selectors of @provider were tested, so far */
+static guint
+count_attempts (GtkCssProvider *provider)
+{
+  GArray *profiles;
+  char *name;
+  guint i, attempts;
+
+  profiles = gtk_css_provider_get_profiles ();
+  name = g_strdup_printf ("%s %p", G_OBJECT_TYPE_NAME (provider), provider);
+  attempts = 0;
+
+  for (i = 0; i < profiles->len; i++)
+    {
+      GtkCssSelectorProfile *profile = &g_array_index (profiles, GtkCssSelectorProfile, i);
+
+      if (g_str_equal (profile->provider, name))
+        attempts += profile->attempts;
+    }
+
+  g_free (name);
+  g_array_unref (profiles);
+
+  return attempts;
+}
+
+static void
+test_unreferenced_class (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  GtkWidget *widget;
+  guint attempts;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "restyletest { color: blue; }\n"
+                                   "restyletest.b { color: green; }\n",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  widget = g_object_ref_sink (g_object_new (restyle_test_widget_get_type (), NULL));
+  context = gtk_widget_get_style_context (widget);
+  assert_color (widget, "blue");
+
+  gtk_css_provider_set_profiling (TRUE);
+  attempts = count_attempts (provider);
+
+  /* No rule mentions the class, so the widget keeps its style */
+  gtk_style_context_add_class (context, "restyle-unreferenced");
+  assert_color (widget, "blue");
+  g_assert_cmpuint (count_attempts (provider), ==, attempts);
+
+  gtk_style_context_add_class (context, "b");
+  assert_color (widget, "green");
+  g_assert_cmpuint (count_attempts (provider), >, attempts);
+
+  gtk_css_provider_set_profiling (FALSE);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (widget);
+  g_object_unref (provider);
+}
+
+/* Descendant selectors are only tested against nodes whose ancestors
+ * may match, see GtkCssAncestorFilter. These tests change the ancestors
+ * and check that the filter follows. */
+#define ANCESTOR_CSS \
+  "restyletest { color: blue; }\n" \
+  "restyleouter restyletest { color: yellow; }\n" \
+  "#restyle-outer restyletest { color: red; }\n" \
+  ".restyle-outer restyletest { color: green; }\n"
+
+typedef struct {
+  GtkCssProvider *provider;
+  GtkWidget *outer;
+  GtkWidget *middle;
+  GtkWidget *widget;
+} AncestorTree;
+
+static void
+ancestor_tree_init (AncestorTree *tree)
+{
+  tree->provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (tree->provider, ANCESTOR_CSS, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (tree->provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  tree->outer = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
+  tree->middle = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  tree->widget = g_object_new (restyle_test_widget_get_type (), NULL);
+  gtk_container_add (GTK_CONTAINER (tree->middle), tree->widget);
+  gtk_container_add (GTK_CONTAINER (tree->outer), tree->middle);
+}
+
+static void
+ancestor_tree_finish (AncestorTree *tree)
+{
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (tree->provider));
+  g_object_unref (tree->outer);
+  g_object_unref (tree->provider);
+}
+
+/* Only validating from the top passes a change on to the descendants */
+static void
+assert_tree_color (GtkWidget  *root,
+                   GtkWidget  *widget,
+                   const char *expected)
+{
+  gtk_css_node_validate (gtk_widget_get_css_node (root));
+  assert_color (widget, expected);
+}
+
+static void
+test_ancestor_reparent (void)
+{
+  AncestorTree tree;
+  GtkWidget *other;
+
+  ancestor_tree_init (&tree);
+  other = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
+  gtk_style_context_add_class (gtk_widget_get_style_context (other), "restyle-outer");
+
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  g_object_ref (tree.middle);
+  gtk_container_remove (GTK_CONTAINER (tree.outer), tree.middle);
+  gtk_container_add (GTK_CONTAINER (other), tree.middle);
+  assert_tree_color (other, tree.widget, "green");
+
+  gtk_container_remove (GTK_CONTAINER (other), tree.middle);
+  gtk_container_add (GTK_CONTAINER (tree.outer), tree.middle);
+  g_object_unref (tree.middle);
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  g_object_unref (other);
+  ancestor_tree_finish (&tree);
+}
+
+static void
+test_ancestor_name (void)
+{
+  AncestorTree tree;
+  GtkCssNode *node;
+
+  ancestor_tree_init (&tree);
+  node = gtk_widget_get_css_node (tree.outer);
+
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  gtk_css_node_set_name (node, g_intern_static_string ("restyleouter"));
+  assert_tree_color (tree.outer, tree.widget, "yellow");
+
+  gtk_css_node_set_name (node, g_intern_static_string ("box"));
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  ancestor_tree_finish (&tree);
+}
+
+static void
+test_ancestor_id (void)
+{
+  AncestorTree tree;
+
+  ancestor_tree_init (&tree);
+
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  gtk_widget_set_name (tree.outer, "restyle-outer");
+  assert_tree_color (tree.outer, tree.widget, "red");
+
+  gtk_widget_set_name (tree.outer, "restyle-other");
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  ancestor_tree_finish (&tree);
+}
+
+static void
+test_ancestor_classes (void)
+{
+  AncestorTree tree;
+  GtkStyleContext *context;
+
+  ancestor_tree_init (&tree);
+  context = gtk_widget_get_style_context (tree.outer);
+
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  gtk_style_context_add_class (context, "restyle-outer");
+  assert_tree_color (tree.outer, tree.widget, "green");
+
+  gtk_style_context_remove_class (context, "restyle-outer");
+  assert_tree_color (tree.outer, tree.widget, "blue");
+
+  ancestor_tree_finish (&tree);
+}
+
+/* Rows in the middle of a box share their style and its children have
+ * to be restyled when the provider changes, which is when they look in
+ * the shared cache. Its entries must be gone by then, or the children
+ * would get their old style. */
+#define SHARED_CACHE_CSS \
+  "restyletest { color: blue; }\n" \
+  "restylerow { padding-left: 1px; }\n" \
+  "restylerow restyletest.a { padding-left: 2px; }\n" \
+  "restylerow restyletest.b { padding-left: 3px; }\n"
+
+#define N_ROWS 5
+
+static void
+test_shared_cache (void)
+{
+  GtkCssSharedStyleCacheStatistics before, after;
+  GtkWidget *widgets[N_ROWS];
+  GtkCssProvider *provider;
+  GtkWidget *box, *row;
+  guint i;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, SHARED_CACHE_CSS, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  box = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
+  for (i = 0; i < N_ROWS; i++)
+    {
+      row = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+      gtk_css_node_set_name (gtk_widget_get_css_node (row), g_intern_static_string ("restylerow"));
+      widgets[i] = g_object_new (restyle_test_widget_get_type (), NULL);
+      gtk_container_add (GTK_CONTAINER (row), widgets[i]);
+      gtk_container_add (GTK_CONTAINER (box), row);
+    }
+
+  for (i = 0; i < N_ROWS; i++)
+    assert_tree_color (box, widgets[i], "blue");
+
+  gtk_css_shared_style_cache_get_statistics (&before);
+  g_assert_cmpuint (before.size, >, 0);
+
+  /* Only one rule changes, so the rows keep their style */
+  gtk_css_provider_load_from_data (provider,
+                                   "restyletest { color: red; }\n"
+                                   "restylerow { padding-left: 1px; }\n"
+                                   "restylerow restyletest.a { padding-left: 2px; }\n"
+                                   "restylerow restyletest.b { padding-left: 3px; }\n",
+                                   -1);
+  gtk_css_shared_style_cache_get_statistics (&after);
+  g_assert_cmpuint (after.size, ==, 0);
+
+  for (i = 0; i < N_ROWS; i++)
+    assert_tree_color (box, widgets[i], "red");
+
+  gtk_css_shared_style_cache_get_statistics (&after);
+  g_assert_cmpuint (after.hits, >, before.hits);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (box);
+  g_object_unref (provider);
+}
+
+/* Enough to make a window match its selectors on several threads */
+#define N_LABELS 400
+
+static GtkWidget *
+create_window (guint       n,
+               GtkWidget **labels)
+{
+  const char *classes[] = { "a", "b", "c" };
+  GtkWidget *window, *box;
+  guint i;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_container_add (GTK_CONTAINER (window), box);
+  gtk_widget_show (box);
+
+  for (i = 0; i < N_LABELS; i++)
+    {
+      GtkStyleContext *context;
+      char *unique;
+
+      labels[i] = gtk_label_new ("label");
+      context = gtk_widget_get_style_context (labels[i]);
+      gtk_style_context_add_class (context, classes[i % G_N_ELEMENTS (classes)]);
+      /* Or the labels of both windows would share their styles */
+      unique = g_strdup_printf ("item-%u-%u", n, i);
+      gtk_style_context_add_class (context, unique);
+      g_free (unique);
+
+      gtk_container_add (GTK_CONTAINER (box), labels[i]);
+      gtk_widget_show (labels[i]);
+    }
+
+  return window;
+}
+
+static void
+test_parallel_matching (void)
+{
+  GtkWidget *serial_window, *parallel_window;
+  GtkWidget *serial[N_LABELS], *parallel[N_LABELS];
+  GtkCssMatchStatistics before, after;
+  GtkCssProvider *provider;
+  guint i;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "label.a { color: rgb(255,0,0); }\n"
+                                   "box > label.b:nth-child(2n) { color: rgb(0,0,255); padding: 3px; }\n"
+                                   "window label.c:last-child { padding-left: 7px; }\n"
+                                   "label:first-child ~ label.a:nth-child(5n+1) { color: rgb(0,128,0); }\n",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  gtk_css_node_set_match_threads (1);
+  gtk_css_node_get_match_statistics (&before);
+  serial_window = create_window (0, serial);
+  gtk_widget_show (serial_window);
+  gtk_css_node_get_match_statistics (&after);
+  g_assert_cmpuint (after.prefetches, ==, before.prefetches);
+  g_assert_cmpuint (after.jobs, ==, before.jobs);
+
+  /* Even on a single processor */
+  gtk_css_node_set_match_threads (2);
+  gtk_css_node_get_match_statistics (&before);
+  parallel_window = create_window (1, parallel);
+  gtk_widget_show (parallel_window);
+  gtk_css_node_get_match_statistics (&after);
+  g_assert_cmpuint (after.prefetches, >, before.prefetches);
+  g_assert_cmpuint (after.jobs - before.jobs, >=, N_LABELS);
+  g_assert_cmpuint (after.thread_runs, >, before.thread_runs);
+
+  gtk_css_node_set_match_threads (0);
+
+  for (i = 0; i < N_LABELS; i++)
+    {
+      GtkStyleContext *serial_context = gtk_widget_get_style_context (serial[i]);
+      GtkStyleContext *parallel_context = gtk_widget_get_style_context (parallel[i]);
+      GdkRGBA serial_color, parallel_color;
+      GtkBorder serial_padding, parallel_padding;
+
+      gtk_style_context_get_color (serial_context, &serial_color);
+      gtk_style_context_get_color (parallel_context, &parallel_color);
+      g_assert_true (gdk_rgba_equal (&serial_color, &parallel_color));
+
+      gtk_style_context_get_padding (serial_context, &serial_padding);
+      gtk_style_context_get_padding (parallel_context, &parallel_padding);
+      g_assert_cmpint (serial_padding.left, ==, parallel_padding.left);
+      g_assert_cmpint (serial_padding.top, ==, parallel_padding.top);
+    }
+
+  gtk_widget_destroy (serial_window);
+  gtk_widget_destroy (parallel_window);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/restyle/reload/state-rule", test_reload_state_rule);
+  g_test_add_func ("/restyle/references/class", test_unreferenced_class);
+  g_test_add_func ("/restyle/ancestors/reparent", test_ancestor_reparent);
+  g_test_add_func ("/restyle/ancestors/name", test_ancestor_name);
+  g_test_add_func ("/restyle/ancestors/id", test_ancestor_id);
+  g_test_add_func ("/restyle/ancestors/classes", test_ancestor_classes);
+  g_test_add_func ("/restyle/shared-cache", test_shared_cache);
+  g_test_add_func ("/restyle/parallel", test_parallel_matching);
+
+  return g_test_run ();
+}
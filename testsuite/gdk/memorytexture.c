@@ -1,6 +1,11 @@
 #include <locale.h>
+#include <string.h>
+#include <glib/gstdio.h>
 #include <gdk/gdk.h>
 
+#define GDK_COMPILATION
+#include "gdk/gdkmemorytextureprivate.h"
+
 /* maximum bytes per pixel */
 #define MAX_BPP 4
 
@@ -32,6 +37,18 @@ typedef struct _TestData {
   Color color;
 } TestData;
 
+typedef struct _ConvertData {
+  GdkMemoryFormat src_format;
+  GdkMemoryFormat dest_format;
+  gsize width;
+} ConvertData;
+
+/* Widths around the vector sizes, so both the vectorized and
+ * the scalar code convert parts of each row */
+static const gsize convert_widths[] = { 1, 15, 16, 17, 67 };
+
+#define CONVERT_HEIGHT 3
+
 #define RGBA(a, b, c, d) { 0x ## a, 0x ## b, 0x ## c, 0x ## d }
 
 static MemoryData tests[GDK_MEMORY_N_FORMATS] = {
@@ -71,9 +88,9 @@ compare_textures (GdkTexture *expected,
       for (x = 0; x < width; x++)
         {
           if (ignore_alpha)
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[y * width + x * 4] & 0xFFFFFF);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[(y * width + x) * 4] & 0xFFFFFF);
           else
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4], ==, *(guint32 *) &test_data[y * width + x * 4]);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4], ==, *(guint32 *) &test_data[(y * width + x) * 4]);
         }
     }
 
@@ -172,12 +189,88 @@ test_download_4x4_with_stride (gconstpointer data)
   g_object_unref (test);
 }
 
+/* Converts random pixels with odd strides from an unaligned start,
+ * including the padding, which must be left alone */
+static guchar *
+convert_random (const ConvertData *data,
+                gsize             *size)
+{
+  gsize src_stride, dest_stride, i;
+  guchar *src, *dest;
+  GRand *rand;
+
+  src_stride = (data->width * tests[data->src_format].bytes_per_pixel + 2) | 1;
+  dest_stride = (data->width * 4 + 2) | 1;
+
+  rand = g_rand_new_with_seed (data->src_format * 1000 + data->dest_format * 100 + data->width);
+  src = g_malloc (CONVERT_HEIGHT * src_stride + 1);
+  for (i = 0; i < CONVERT_HEIGHT * src_stride + 1; i++)
+    src[i] = g_rand_int_range (rand, 0, 256);
+  g_rand_free (rand);
+
+  *size = CONVERT_HEIGHT * dest_stride;
+  dest = g_malloc (*size);
+  memset (dest, 0xAA, *size);
+
+  gdk_memory_convert (dest, dest_stride, data->dest_format,
+                      src + 1, src_stride, data->src_format,
+                      data->width, CONVERT_HEIGHT);
+
+  g_free (src);
+
+  return dest;
+}
+
+/* Compares the converters in use with the scalar ones, which
+ * a subprocess uses with GDK_MEMORY_CONVERT_IMPL=c */
+static void
+test_convert (gconstpointer data)
+{
+  guchar *result, *reference;
+  gsize result_size, reference_size;
+  char *path;
+  int fd;
+
+  if (g_test_subprocess ())
+    {
+      g_assert_cmpstr (g_getenv ("GDK_MEMORY_CONVERT_IMPL"), ==, "c");
+
+      reference = convert_random (data, &reference_size);
+      g_assert_true (g_file_set_contents (g_getenv ("MEMORYTEXTURE_REFERENCE"),
+                                          (const char *) reference, reference_size,
+                                          NULL));
+      g_free (reference);
+      return;
+    }
+
+  fd = g_file_open_tmp ("memorytexture-XXXXXX", &path, NULL);
+  g_assert_cmpint (fd, !=, -1);
+  g_close (fd, NULL);
+
+  g_setenv ("GDK_MEMORY_CONVERT_IMPL", "c", TRUE);
+  g_setenv ("MEMORYTEXTURE_REFERENCE", path, TRUE);
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_unsetenv ("MEMORYTEXTURE_REFERENCE");
+  g_unsetenv ("GDK_MEMORY_CONVERT_IMPL");
+  g_test_trap_assert_passed ();
+
+  g_assert_true (g_file_get_contents (path, (char **) &reference, &reference_size, NULL));
+  result = convert_random (data, &result_size);
+  g_assert_cmpmem (result, result_size, reference, reference_size);
+
+  g_unlink (path);
+  g_free (path);
+  g_free (reference);
+  g_free (result);
+}
+
 int
 main (int argc, char *argv[])
 {
-  GdkMemoryFormat format;
+  GdkMemoryFormat format, dest_format;
   Color color;
   GEnumClass *enum_class;
+  gsize i;
 
   g_test_init (&argc, &argv, NULL);
 
@@ -225,6 +318,24 @@ main (int argc, char *argv[])
           g_test_add_data_func_full (test_name, test_data, test_download_4x4_with_stride, g_free);
           g_free (test_name);
         }
+
+      /* gdk_memory_convert() only writes the first two formats */
+      for (dest_format = 0; dest_format < 2; dest_format++)
+        {
+          for (i = 0; i < G_N_ELEMENTS (convert_widths); i++)
+            {
+              ConvertData *convert_data = g_new (ConvertData, 1);
+              char *test_name = g_strdup_printf ("/memorytexture/convert/%s/%s/%" G_GSIZE_FORMAT,
+                                                 g_enum_get_value (enum_class, format)->value_nick,
+                                                 g_enum_get_value (enum_class, dest_format)->value_nick,
+                                                 convert_widths[i]);
+              convert_data->src_format = format;
+              convert_data->dest_format = dest_format;
+              convert_data->width = convert_widths[i];
+              g_test_add_data_func_full (test_name, convert_data, test_convert, g_free);
+              g_free (test_name);
+            }
+        }
     }
 
   return g_test_run ();
@@ -0,0 +1,184 @@
+#include <locale.h>
+#include <glib/gstdio.h>
+#include <gdk/gdk.h>
+
+#define WIDTH 7
+#define HEIGHT 5
+
+static char *png_path;
+static char *invalid_path;
+
+typedef struct {
+  GdkTexture *texture;
+  GError *error;
+  gboolean done;
+} LoadData;
+
+static void
+load_done (GObject      *source,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  LoadData *data = user_data;
+
+  g_assert_null (source);
+  data->texture = gdk_texture_new_from_file_finish (result, &data->error);
+  data->done = TRUE;
+}
+
+static void
+load (const char   *path,
+      GCancellable *cancellable,
+      LoadData     *data)
+{
+  GFile *file;
+
+  file = g_file_new_for_path (path);
+  gdk_texture_new_from_file_async (file, cancellable, load_done, data);
+  g_object_unref (file);
+
+  if (cancellable)
+    g_cancellable_cancel (cancellable);
+
+  while (!data->done)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static GdkPixbuf *
+create_pixbuf (void)
+{
+  GdkPixbuf *pixbuf;
+  guchar *pixels;
+  int x, y, stride;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, WIDTH, HEIGHT);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  stride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  for (y = 0; y < HEIGHT; y++)
+    for (x = 0; x < WIDTH; x++)
+      {
+        pixels[y * stride + 4 * x + 0] = x * 255 / WIDTH;
+        pixels[y * stride + 4 * x + 1] = y * 255 / HEIGHT;
+        pixels[y * stride + 4 * x + 2] = 0x80;
+        pixels[y * stride + 4 * x + 3] = (x + y) % 2 ? 0xFF : 0x80;
+      }
+
+  return pixbuf;
+}
+
+static void
+test_load_async (void)
+{
+  LoadData data = { NULL, };
+  GdkTexture *expected;
+  GdkPixbuf *pixbuf;
+  guchar *expected_data, *data_data;
+
+  load (png_path, NULL, &data);
+
+  g_assert_no_error (data.error);
+  g_assert_true (GDK_IS_TEXTURE (data.texture));
+  g_assert_cmpint (gdk_texture_get_width (data.texture), ==, WIDTH);
+  g_assert_cmpint (gdk_texture_get_height (data.texture), ==, HEIGHT);
+
+  pixbuf = create_pixbuf ();
+  expected = gdk_texture_new_for_pixbuf (pixbuf);
+
+  expected_data = g_malloc (WIDTH * HEIGHT * 4);
+  gdk_texture_download (expected, expected_data, WIDTH * 4);
+  data_data = g_malloc (WIDTH * HEIGHT * 4);
+  gdk_texture_download (data.texture, data_data, WIDTH * 4);
+  g_assert_cmpmem (data_data, WIDTH * HEIGHT * 4, expected_data, WIDTH * HEIGHT * 4);
+
+  g_free (data_data);
+  g_free (expected_data);
+  g_object_unref (expected);
+  g_object_unref (pixbuf);
+  g_object_unref (data.texture);
+}
+
+static void
+test_load_async_missing (void)
+{
+  LoadData data = { NULL, };
+  char *path;
+
+  path = g_build_filename (g_get_tmp_dir (), "gdk-texture-test-does-not-exist.png", NULL);
+  load (path, NULL, &data);
+
+  g_assert_error (data.error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_null (data.texture);
+
+  g_error_free (data.error);
+  g_free (path);
+}
+
+static void
+test_load_async_invalid (void)
+{
+  LoadData data = { NULL, };
+
+  load (invalid_path, NULL, &data);
+
+  g_assert_nonnull (data.error);
+  g_assert_null (data.texture);
+
+  g_error_free (data.error);
+}
+
+static void
+test_load_async_cancel (void)
+{
+  LoadData data = { NULL, };
+  GCancellable *cancellable;
+
+  /* Cancelled right after starting, so the load may or may not have
+   * finished in its thread, but the result must be the cancellation */
+  cancellable = g_cancellable_new ();
+  load (png_path, cancellable, &data);
+
+  g_assert_error (data.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (data.texture);
+
+  g_error_free (data.error);
+  g_object_unref (cancellable);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GdkPixbuf *pixbuf;
+  char *dir;
+  int result;
+
+  g_test_init (&argc, &argv, NULL);
+  setlocale (LC_ALL, "C");
+
+  dir = g_dir_make_tmp ("gdk-texture-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+
+  png_path = g_build_filename (dir, "image.png", NULL);
+  pixbuf = create_pixbuf ();
+  g_assert_true (gdk_pixbuf_save (pixbuf, png_path, "png", NULL, NULL));
+  g_object_unref (pixbuf);
+
+  invalid_path = g_build_filename (dir, "invalid.png", NULL);
+  g_assert_true (g_file_set_contents (invalid_path, "This is not an image", -1, NULL));
+
+  g_test_add_func ("/texture/load-async", test_load_async);
+  g_test_add_func ("/texture/load-async/missing", test_load_async_missing);
+  g_test_add_func ("/texture/load-async/invalid", test_load_async_invalid);
+  g_test_add_func ("/texture/load-async/cancel", test_load_async_cancel);
+
+  result = g_test_run ();
+
+  g_unlink (png_path);
+  g_unlink (invalid_path);
+  g_rmdir (dir);
+  g_free (invalid_path);
+  g_free (png_path);
+  g_free (dir);
+
+  return result;
+}
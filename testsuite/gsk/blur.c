@@ -0,0 +1,144 @@
+/* Tests for the box blur kernels.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <gtk/gtk.h>
+
+#define GTK_COMPILATION
+#include "gsk/gskcairoblurprivate.h"
+
+typedef struct {
+  int width;
+  int height;
+  int radius;
+  GskBlurFlags flags;
+} BlurSize;
+
+/* The widths cover whole strips of 16 and 32 pixels plus the columns
+ * the scalar code does, the radius of 4358 gives the largest filter
+ * the vectorized kernels are used for, where the window sums get
+ * closest to where the reciprocal stops being exact. */
+static const BlurSize sizes[] = {
+  {   16,   16,    2, GSK_BLUR_X | GSK_BLUR_Y },
+  {   33,   17,    3, GSK_BLUR_X | GSK_BLUR_Y },
+  {   70,   45,    5, GSK_BLUR_X | GSK_BLUR_Y },
+  {  100,   77,    8, GSK_BLUR_X | GSK_BLUR_Y },
+  {  129,  200,   17, GSK_BLUR_X | GSK_BLUR_Y },
+  {  300,  300,   50, GSK_BLUR_X | GSK_BLUR_Y },
+  {  520,  600,  250, GSK_BLUR_Y },
+  {   72, 8300, 4358, GSK_BLUR_Y },
+};
+
+/* Random alpha, or opaque with random holes, which gets the window
+ * sums up to their maximum */
+static cairo_surface_t *
+create_random_surface (const BlurSize *size,
+                       gboolean        opaque)
+{
+  cairo_surface_t *surface;
+  guchar *data;
+  int stride, x, y;
+  GRand *rand;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size->width, size->height);
+  cairo_surface_flush (surface);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  rand = g_rand_new_with_seed (size->width * 1000 + size->radius * 2 + opaque);
+  for (y = 0; y < size->height; y++)
+    for (x = 0; x < stride; x++)
+      {
+        if (opaque && g_rand_int_range (rand, 0, 16) != 0)
+          data[y * stride + x] = 255;
+        else
+          data[y * stride + x] = g_rand_int_range (rand, 0, 256);
+      }
+  g_rand_free (rand);
+
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static void
+assert_surfaces_equal (cairo_surface_t *surface,
+                       cairo_surface_t *expected)
+{
+  int stride, height;
+
+  stride = cairo_image_surface_get_stride (surface);
+  height = cairo_image_surface_get_height (surface);
+  g_assert_cmpint (stride, ==, cairo_image_surface_get_stride (expected));
+  g_assert_cmpint (height, ==, cairo_image_surface_get_height (expected));
+
+  g_assert_cmpmem (cairo_image_surface_get_data (surface), stride * height,
+                   cairo_image_surface_get_data (expected), stride * height);
+}
+
+static void
+test_blur (gconstpointer data)
+{
+  const char *name = data;
+  cairo_surface_t *surface, *expected;
+  gsize i;
+  int opaque;
+
+  if (!gsk_cairo_blur_set_implementation (name))
+    {
+      g_test_skip ("Not supported on this machine");
+      return;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      for (opaque = 0; opaque < 2; opaque++)
+        {
+          surface = create_random_surface (&sizes[i], opaque);
+          gsk_cairo_blur_set_implementation (name);
+          gsk_cairo_blur_surface (surface, sizes[i].radius, sizes[i].flags);
+
+          expected = create_random_surface (&sizes[i], opaque);
+          gsk_cairo_blur_set_implementation ("c");
+          gsk_cairo_blur_surface (expected, sizes[i].radius, sizes[i].flags);
+
+          assert_surfaces_equal (surface, expected);
+
+          cairo_surface_destroy (surface);
+          cairo_surface_destroy (expected);
+        }
+    }
+
+  gsk_cairo_blur_set_implementation (NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *names[] = { "sse2", "avx2", "neon" };
+  gsize i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      char *test_name = g_strdup_printf ("/blur/%s", names[i]);
+      g_test_add_data_func (test_name, names[i], test_blur);
+      g_free (test_name);
+    }
+
+  return g_test_run ();
+}
@@ -0,0 +1,212 @@
+/* GtkImage tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#define GTK_COMPILATION
+#include "gtk/gtkiconhelperprivate.h"
+#include "gtk/gtkimageprivate.h"
+
+#define WIDTH 7
+#define HEIGHT 5
+
+static char *png_path;
+
+static GtkWidget *
+image_new (void)
+{
+  return g_object_ref_sink (gtk_image_new ());
+}
+
+static void
+load_file (GtkImage   *image,
+           const char *path)
+{
+  GFile *file;
+
+  file = g_file_new_for_path (path);
+  gtk_image_load_file (image, file);
+  g_object_unref (file);
+}
+
+static void
+wait_for_load (GtkImage *image)
+{
+  while (gtk_image_get_storage_type (image) == GTK_IMAGE_ICON_NAME &&
+         g_strcmp0 (gtk_image_get_icon_name (image), "image-loading") == 0)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+/* A canceled load doesn't change the image, but its callback still
+ * runs in the main loop once the thread is done */
+static void
+wait_for_cancelled_load (void)
+{
+  while (gtk_image_get_n_running_loads () > 0)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+test_load_file (void)
+{
+  GtkWidget *image;
+  GdkPaintable *paintable;
+
+  image = image_new ();
+  load_file (GTK_IMAGE (image), png_path);
+
+  g_assert_cmpint (gtk_image_get_storage_type (GTK_IMAGE (image)), ==, GTK_IMAGE_ICON_NAME);
+  g_assert_cmpstr (gtk_image_get_icon_name (GTK_IMAGE (image)), ==, "image-loading");
+
+  wait_for_load (GTK_IMAGE (image));
+
+  g_assert_cmpint (gtk_image_get_storage_type (GTK_IMAGE (image)), ==, GTK_IMAGE_PAINTABLE);
+  paintable = gtk_image_get_paintable (GTK_IMAGE (image));
+  g_assert_true (GDK_IS_TEXTURE (paintable));
+  g_assert_cmpint (gdk_texture_get_width (GDK_TEXTURE (paintable)), ==, WIDTH);
+  g_assert_cmpint (gdk_texture_get_height (GDK_TEXTURE (paintable)), ==, HEIGHT);
+
+  g_object_unref (image);
+}
+
+static void
+test_load_file_missing (void)
+{
+  GtkWidget *image;
+  char *path;
+
+  path = g_build_filename (g_get_tmp_dir (), "gtk-image-test-does-not-exist.png", NULL);
+
+  image = image_new ();
+  load_file (GTK_IMAGE (image), path);
+  wait_for_load (GTK_IMAGE (image));
+
+  g_assert_cmpint (gtk_image_get_storage_type (GTK_IMAGE (image)), ==, GTK_IMAGE_ICON_NAME);
+  g_assert_cmpstr (gtk_image_get_icon_name (GTK_IMAGE (image)), ==, "image-missing");
+
+  g_object_unref (image);
+  g_free (path);
+}
+
+static void
+test_load_file_replaced (void)
+{
+  GtkWidget *image;
+
+  /* Setting other contents cancels the load */
+  image = image_new ();
+  load_file (GTK_IMAGE (image), png_path);
+  gtk_image_set_from_icon_name (GTK_IMAGE (image), "edit-copy");
+
+  wait_for_cancelled_load ();
+
+  g_assert_cmpint (gtk_image_get_storage_type (GTK_IMAGE (image)), ==, GTK_IMAGE_ICON_NAME);
+  g_assert_cmpstr (gtk_image_get_icon_name (GTK_IMAGE (image)), ==, "edit-copy");
+
+  /* And so does loading another file */
+  load_file (GTK_IMAGE (image), "/does/not/exist.png");
+  load_file (GTK_IMAGE (image), png_path);
+  wait_for_load (GTK_IMAGE (image));
+  wait_for_cancelled_load ();
+
+  g_assert_cmpint (gtk_image_get_storage_type (GTK_IMAGE (image)), ==, GTK_IMAGE_PAINTABLE);
+
+  g_object_unref (image);
+}
+
+static void
+test_load_file_destroyed (void)
+{
+  GtkWidget *image;
+
+  /* The image is gone before the load finishes */
+  image = image_new ();
+  load_file (GTK_IMAGE (image), png_path);
+  g_object_unref (image);
+
+  wait_for_cancelled_load ();
+}
+
+#define N_IMAGES 50
+
+static void
+test_icon_texture_shared (void)
+{
+  GtkIconHelperTextureCacheStatistics before, after;
+  GtkWidget *window, *box, *image;
+  int min, nat;
+  guint i;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_container_add (GTK_CONTAINER (window), box);
+
+  gtk_icon_helper_get_texture_cache_statistics (&before);
+
+  /* A name no other test uses, the missing icon is loaded for it */
+  for (i = 0; i < N_IMAGES; i++)
+    {
+      image = gtk_image_new_from_icon_name ("gtk-test-shared-icon");
+      gtk_container_add (GTK_CONTAINER (box), image);
+
+      /* Without a pixel size, measuring loads the icon */
+      gtk_widget_measure (image, GTK_ORIENTATION_HORIZONTAL, -1, &min, &nat, NULL, NULL);
+      g_assert_cmpint (nat, >, 0);
+    }
+
+  gtk_icon_helper_get_texture_cache_statistics (&after);
+
+  g_assert_cmpuint (after.lookups - before.lookups, ==, N_IMAGES);
+  g_assert_cmpuint (after.inserts - before.inserts, ==, 1);
+  g_assert_cmpuint (after.hits - before.hits, ==, N_IMAGES - 1);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GdkPixbuf *pixbuf;
+  char *dir;
+  int result;
+
+  gtk_test_init (&argc, &argv);
+
+  dir = g_dir_make_tmp ("gtk-image-XXXXXX", NULL);
+  g_assert_nonnull (dir);
+
+  png_path = g_build_filename (dir, "image.png", NULL);
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, WIDTH, HEIGHT);
+  gdk_pixbuf_fill (pixbuf, 0x3465a4ff);
+  g_assert_true (gdk_pixbuf_save (pixbuf, png_path, "png", NULL, NULL));
+  g_object_unref (pixbuf);
+
+  g_test_add_func ("/image/load-file", test_load_file);
+  g_test_add_func ("/image/load-file/missing", test_load_file_missing);
+  g_test_add_func ("/image/load-file/replaced", test_load_file_replaced);
+  g_test_add_func ("/image/load-file/destroyed", test_load_file_destroyed);
+  g_test_add_func ("/image/icon-texture-shared", test_icon_texture_shared);
+
+  result = g_test_run ();
+
+  g_unlink (png_path);
+  g_rmdir (dir);
+  g_free (png_path);
+  g_free (dir);
+
+  return result;
+}
@@ -0,0 +1,250 @@
+/* GtkLruCache tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+
+#include "../../gtk/gtklrucacheprivate.h"
+
+typedef struct {
+  guint  key;
+  guint  value;
+  guint *n_freed;
+} Entry;
+
+static guint
+entry_hash (gconstpointer data)
+{
+  const Entry *entry = data;
+
+  return entry->key;
+}
+
+static gboolean
+entry_equal (gconstpointer a,
+             gconstpointer b)
+{
+  const Entry *entry_a = a;
+  const Entry *entry_b = b;
+
+  return entry_a->key == entry_b->key;
+}
+
+static void
+entry_free (gpointer data)
+{
+  Entry *entry = data;
+
+  (*entry->n_freed)++;
+  g_free (entry);
+}
+
+static Entry *
+entry_new (guint  key,
+           guint  value,
+           guint *n_freed)
+{
+  Entry *entry = g_new (Entry, 1);
+
+  entry->key = key;
+  entry->value = value;
+  entry->n_freed = n_freed;
+
+  return entry;
+}
+
+static Entry *
+lookup (GtkLruCache *cache,
+        guint        key)
+{
+  Entry entry = { key, 0, NULL };
+
+  return gtk_lru_cache_lookup (cache, &entry);
+}
+
+static void
+test_lookup (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+  Entry *entry;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 8, 0);
+
+  g_assert_null (lookup (cache, 1));
+
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (1, 10, &n_freed), 0), ==, 0);
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (2, 20, &n_freed), 0), ==, 0);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 2);
+
+  entry = lookup (cache, 1);
+  g_assert_nonnull (entry);
+  g_assert_cmpuint (entry->value, ==, 10);
+  entry = lookup (cache, 2);
+  g_assert_nonnull (entry);
+  g_assert_cmpuint (entry->value, ==, 20);
+  g_assert_null (lookup (cache, 3));
+
+  gtk_lru_cache_free (cache);
+  g_assert_cmpuint (n_freed, ==, 2);
+}
+
+static void
+test_replace (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 8, 0);
+
+  gtk_lru_cache_insert (cache, entry_new (1, 10, &n_freed), 100);
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (1, 11, &n_freed), 50), ==, 0);
+
+  g_assert_cmpuint (n_freed, ==, 1);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 1);
+  g_assert_cmpuint (gtk_lru_cache_get_n_bytes (cache), ==, 50);
+  g_assert_cmpuint (lookup (cache, 1)->value, ==, 11);
+
+  gtk_lru_cache_free (cache);
+  g_assert_cmpuint (n_freed, ==, 2);
+}
+
+static void
+test_evict_size (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+  guint i;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 4, 0);
+
+  for (i = 0; i < 4; i++)
+    gtk_lru_cache_insert (cache, entry_new (i, i, &n_freed), 0);
+
+  /* 0 becomes the most recently used, so 1 goes first */
+  g_assert_nonnull (lookup (cache, 0));
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (4, 4, &n_freed), 0), ==, 1);
+
+  g_assert_cmpuint (n_freed, ==, 1);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 4);
+  g_assert_nonnull (lookup (cache, 0));
+  g_assert_null (lookup (cache, 1));
+  g_assert_nonnull (lookup (cache, 2));
+  g_assert_nonnull (lookup (cache, 3));
+  g_assert_nonnull (lookup (cache, 4));
+
+  gtk_lru_cache_free (cache);
+}
+
+static void
+test_evict_bytes (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 8, 100);
+
+  gtk_lru_cache_insert (cache, entry_new (1, 1, &n_freed), 40);
+  gtk_lru_cache_insert (cache, entry_new (2, 2, &n_freed), 40);
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (3, 3, &n_freed), 40), ==, 1);
+
+  g_assert_null (lookup (cache, 1));
+  g_assert_cmpuint (gtk_lru_cache_get_n_bytes (cache), ==, 80);
+
+  /* the entry that was just inserted is kept, even if too large */
+  g_assert_cmpuint (gtk_lru_cache_insert (cache, entry_new (4, 4, &n_freed), 200), ==, 2);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 1);
+  g_assert_nonnull (lookup (cache, 4));
+  g_assert_cmpuint (gtk_lru_cache_get_n_bytes (cache), ==, 200);
+
+  gtk_lru_cache_free (cache);
+  g_assert_cmpuint (n_freed, ==, 4);
+}
+
+static void
+test_remove_all (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+  guint i;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 8, 0);
+
+  for (i = 0; i < 5; i++)
+    gtk_lru_cache_insert (cache, entry_new (i, i, &n_freed), 10);
+
+  gtk_lru_cache_remove_all (cache);
+  g_assert_cmpuint (n_freed, ==, 5);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 0);
+  g_assert_cmpuint (gtk_lru_cache_get_n_bytes (cache), ==, 0);
+
+  /* the cache is still usable */
+  gtk_lru_cache_insert (cache, entry_new (1, 1, &n_freed), 10);
+  g_assert_nonnull (lookup (cache, 1));
+
+  gtk_lru_cache_free (cache);
+  g_assert_cmpuint (n_freed, ==, 6);
+}
+
+static gboolean
+entry_is_odd (gpointer data,
+              gpointer user_data)
+{
+  Entry *entry = data;
+
+  return entry->key % 2;
+}
+
+static void
+test_remove_matching (void)
+{
+  GtkLruCache *cache;
+  guint n_freed = 0;
+  guint i;
+
+  cache = gtk_lru_cache_new (entry_hash, entry_equal, entry_free, 8, 0);
+
+  for (i = 0; i < 5; i++)
+    gtk_lru_cache_insert (cache, entry_new (i, i, &n_freed), 10);
+
+  g_assert_cmpuint (gtk_lru_cache_remove_matching (cache, entry_is_odd, NULL), ==, 2);
+  g_assert_cmpuint (n_freed, ==, 2);
+  g_assert_cmpuint (gtk_lru_cache_get_size (cache), ==, 3);
+  g_assert_cmpuint (gtk_lru_cache_get_n_bytes (cache), ==, 30);
+  g_assert_nonnull (lookup (cache, 0));
+  g_assert_null (lookup (cache, 1));
+  g_assert_nonnull (lookup (cache, 2));
+  g_assert_null (lookup (cache, 3));
+  g_assert_nonnull (lookup (cache, 4));
+
+  gtk_lru_cache_free (cache);
+  g_assert_cmpuint (n_freed, ==, 5);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  setlocale (LC_ALL, "C");
+
+  g_test_add_func ("/lrucache/lookup", test_lookup);
+  g_test_add_func ("/lrucache/replace", test_replace);
+  g_test_add_func ("/lrucache/evict-size", test_evict_size);
+  g_test_add_func ("/lrucache/evict-bytes", test_evict_bytes);
+  g_test_add_func ("/lrucache/remove-matching", test_remove_matching);
+  g_test_add_func ("/lrucache/remove-all", test_remove_all);
+
+  return g_test_run ();
+}
@@ -0,0 +1,73 @@
+/* GtkSnapshot tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#define GTK_COMPILATION
+#include "gtk/gtksnapshotprivate.h"
+
+/* Cached rasters of CSS images are only used when this is TRUE */
+static void
+test_is_translation (void)
+{
+  GtkSnapshot *snapshot;
+  graphene_matrix_t matrix;
+  GskRenderNode *node;
+
+  snapshot = gtk_snapshot_new (NULL, FALSE, NULL, "Test");
+  g_assert_true (gtk_snapshot_is_translation (snapshot));
+
+  gtk_snapshot_offset (snapshot, 10, 20);
+  g_assert_true (gtk_snapshot_is_translation (snapshot));
+
+  graphene_matrix_init_translate (&matrix, &GRAPHENE_POINT3D_INIT (5.5, 3, 0));
+  gtk_snapshot_push_transform (snapshot, &matrix, "Translate");
+  g_assert_true (gtk_snapshot_is_translation (snapshot));
+
+  graphene_matrix_init_scale (&matrix, 2, 2, 1);
+  gtk_snapshot_push_transform (snapshot, &matrix, "Scale");
+  g_assert_false (gtk_snapshot_is_translation (snapshot));
+
+  /* a clip inside the scale doesn't undo it */
+  gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (0, 0, 10, 10), "Clip");
+  g_assert_false (gtk_snapshot_is_translation (snapshot));
+  gtk_snapshot_pop (snapshot);
+
+  gtk_snapshot_pop (snapshot);
+  g_assert_true (gtk_snapshot_is_translation (snapshot));
+
+  graphene_matrix_init_rotate (&matrix, 90, graphene_vec3_z_axis ());
+  gtk_snapshot_push_transform (snapshot, &matrix, "Rotate");
+  g_assert_false (gtk_snapshot_is_translation (snapshot));
+  gtk_snapshot_pop (snapshot);
+
+  gtk_snapshot_pop (snapshot);
+  g_assert_true (gtk_snapshot_is_translation (snapshot));
+
+  node = gtk_snapshot_free_to_node (snapshot);
+  if (node)
+    gsk_render_node_unref (node);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/snapshot/is-translation", test_is_translation);
+
+  return g_test_run ();
+}